@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * ndnfs-diff compares the trees served by two ndnfs-server instances through the digest tree
+ * (<path>/%C1.FS.tree, see server/tree.h): it fetches the nodes of both roots, and goes down
+ * only into the directories whose digests differ, so the number of nodes fetched grows with
+ * the number of changed paths times their depth, not with the size of the trees. Large directories
+ * are compared by their buckets, and only the buckets whose digests differ are fetched. The segments
+ * of a node are asked for all at once, once the first one tells how many there are.
+ * Prints one line per difference: '+' for a path only in the second tree, '-' for a path only
+ * in the first, 'M' for a path whose content or type differs; directories end with '/'.
+ * Exits with 0 if the trees are the same, 1 if they differ, and 2 on error, like diff.
+ * Usage: ./ndnfs-diff -a prefix -b prefix [-A host] [-B host] [-w window]
+ */
+
+#include <ndn-cpp/face.hpp>
+#include <ndn-cpp/interest.hpp>
+#include <ndn-cpp/data.hpp>
+
+#include <iostream>
+#include <deque>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include <chrono>
+
+#include "dir.pb.h"
+#include "namespace.h"
+#include "file-type.h"
+
+#define MAX_RETRIES 3
+
+using namespace std;
+using namespace ndn;
+using namespace std::chrono;
+
+struct TreeSide {
+  Face *face;
+  Name prefix;
+};
+
+static TreeSide sides[2];
+
+// A directory, or one of its buckets (-1 for the directory itself), to compare
+struct PendingNode {
+  string path;
+  int bucket;
+};
+
+// The nodes of one directory (or bucket) in both trees, while they are fetched
+struct DirCompare {
+  string path;
+  int bucket;
+  vector<string> segments[2];
+  vector<bool> received[2];
+  size_t left[2];
+  bool done[2];
+  // Interests still expressed for it; it's freed once they're all answered or timed out
+  int expressed;
+};
+
+static deque<PendingNode> pendingDirs;
+static int outstanding = 0;
+static int window = 16;
+static bool failed = false;
+
+static int64_t interests = 0;
+static int64_t bytes = 0;
+static int64_t nodes = 0;
+static int64_t differences = 0;
+
+static void fetchSegment(DirCompare *compare, int side, const Name &name, int retries);
+static void onSegment(DirCompare *compare, int side, const ptr_lib::shared_ptr<Data> &data);
+
+static string displayPath(const string &dir, const string &name, int type)
+{
+  string path = (dir == "/") ? "/" + name : dir + "/" + name;
+  if (type == DIRECTORY)
+    path += "/";
+  return path;
+}
+
+static void report(char change, const string &dir, const Ndnfs::TreeEntry &entry)
+{
+  cout << change << " " << displayPath(dir, entry.name(), entry.type()) << endl;
+  differences ++;
+}
+
+static void queueNode(const string &path, int bucket)
+{
+  PendingNode node;
+  node.path = path;
+  node.bucket = bucket;
+  pendingDirs.push_back(node);
+}
+
+/**
+ * compareBuckets queues the buckets of directory path that differ between a and b; if only
+ * one of them is split into buckets, every bucket is compared.
+ */
+static void compareBuckets(const string &path, const Ndnfs::TreeNode &a, const Ndnfs::TreeNode &b)
+{
+  if (a.bucket_size() == 0 || b.bucket_size() == 0) {
+    int buckets = max(a.buckets(), b.buckets());
+    for (int i = 0; i < buckets; i ++)
+      queueNode(path, i);
+    return;
+  }
+
+  int i = 0, j = 0;
+  while (i < a.bucket_size() || j < b.bucket_size()) {
+    int order = (i == a.bucket_size()) ? 1 : (j == b.bucket_size()) ? -1 : a.bucket(i).index() - b.bucket(j).index();
+    if (order < 0) {
+      queueNode(path, a.bucket(i ++).index());
+    }
+    else if (order > 0) {
+      queueNode(path, b.bucket(j ++).index());
+    }
+    else {
+      if (a.bucket(i).digest() != b.bucket(j).digest())
+        queueNode(path, a.bucket(i).index());
+      i ++;
+      j ++;
+    }
+  }
+}
+
+/**
+ * compareNodes walks the entries of both nodes, which come sorted by name, and queues
+ * the directories that are in both trees with different digests.
+ */
+static void compareNodes(const string &path, const Ndnfs::TreeNode &a, const Ndnfs::TreeNode &b)
+{
+  if (a.digest() == b.digest())
+    return;
+  if (a.buckets() > 0 || b.buckets() > 0) {
+    compareBuckets(path, a, b);
+    return;
+  }
+
+  int i = 0, j = 0;
+  while (i < a.entry_size() || j < b.entry_size()) {
+    int order = (i == a.entry_size()) ? 1 : (j == b.entry_size()) ? -1 : a.entry(i).name().compare(b.entry(j).name());
+    if (order < 0) {
+      report('-', path, a.entry(i ++));
+    }
+    else if (order > 0) {
+      report('+', path, b.entry(j ++));
+    }
+    else {
+      const Ndnfs::TreeEntry &ea = a.entry(i ++);
+      const Ndnfs::TreeEntry &eb = b.entry(j ++);
+      if (ea.digest() == eb.digest() && ea.type() == eb.type())
+        continue;
+      if (ea.type() == DIRECTORY && eb.type() == DIRECTORY)
+        queueNode(displayPath(path, ea.name(), 0), -1);
+      else
+        report('M', path, ea);
+    }
+  }
+}
+
+static void startNext();
+
+static void onNodeDone(DirCompare *compare)
+{
+  // After an error, the comparisons in progress are only finished
+  Ndnfs::TreeNode node[2];
+  for (int side = 0; side < 2 && !failed; side ++) {
+    string content;
+    for (size_t i = 0; i < compare->segments[side].size(); i ++)
+      content += compare->segments[side][i];
+    if (!node[side].ParseFromString(content)) {
+      cerr << "Protobuf decoding error: node of " << compare->path << " from " << sides[side].prefix.toUri() << endl;
+      failed = true;
+    }
+  }
+  if (!failed)
+    compareNodes(compare->path, node[0], node[1]);
+  outstanding --;
+  startNext();
+}
+
+static void onSideDone(DirCompare *compare, int side)
+{
+  compare->done[side] = true;
+  if (compare->done[0] && compare->done[1])
+    onNodeDone(compare);
+}
+
+// Called at the end of each callback of an Interest of compare
+static void releaseCompare(DirCompare *compare)
+{
+  if (-- compare->expressed == 0 && compare->done[0] && compare->done[1])
+    delete compare;
+}
+
+static void fetchSegment(DirCompare *compare, int side, const Name &name, int retries)
+{
+  Interest interest(name);
+  interest.setMustBeFresh(true);
+  interest.setInterestLifetimeMilliseconds(2000);
+  interests ++;
+  compare->expressed ++;
+
+  sides[side].face->expressInterest(interest,
+    [compare, side](const ptr_lib::shared_ptr<const Interest> &, const ptr_lib::shared_ptr<Data> &data) {
+      onSegment(compare, side, data);
+      releaseCompare(compare);
+    },
+    [compare, side, retries](const ptr_lib::shared_ptr<const Interest> &interest) {
+      if (!compare->done[side]) {
+        if (retries < MAX_RETRIES) {
+          fetchSegment(compare, side, interest->getName(), retries + 1);
+        } else {
+          cerr << "Timeout: " << interest->getName().toUri() << endl;
+          failed = true;
+          onSideDone(compare, side);
+        }
+      }
+      releaseCompare(compare);
+    });
+}
+
+static void onSegment(DirCompare *compare, int side, const ptr_lib::shared_ptr<Data> &data)
+{
+  if (compare->done[side])
+    return;
+  bytes += data->wireEncode().size();
+  const Name &dataName = data->getName();
+  int64_t seg = dataName.get(dataName.size() - 1).toSegment();
+
+  // The first reply tells how many segments there are, and the version to ask for them under
+  if (compare->segments[side].empty()) {
+    int64_t last = seg;
+    if (data->getMetaInfo().getFinalBlockId().getValue().size() > 0)
+      last = max(seg, (int64_t)data->getMetaInfo().getFinalBlockId().toSegment());
+    compare->segments[side].resize(last + 1);
+    compare->received[side].resize(last + 1, false);
+    compare->left[side] = last + 1;
+    Name versionName = dataName.getPrefix(dataName.size() - 1);
+    for (int64_t i = 0; i <= last; i ++) {
+      if (i != seg)
+        fetchSegment(compare, side, Name(versionName).appendSegment(i), 0);
+    }
+  }
+  if (seg >= (int64_t)compare->segments[side].size() || compare->received[side][seg])
+    return;
+  compare->segments[side][seg].assign((const char *)data->getContent().buf(), data->getContent().size());
+  compare->received[side][seg] = true;
+  if (-- compare->left[side] == 0) {
+    nodes ++;
+    onSideDone(compare, side);
+  }
+}
+
+static void startNext()
+{
+  while (!failed && outstanding < window && !pendingDirs.empty()) {
+    DirCompare *compare = new DirCompare();
+    compare->path = pendingDirs.front().path;
+    compare->bucket = pendingDirs.front().bucket;
+    pendingDirs.pop_front();
+    compare->done[0] = compare->done[1] = false;
+    compare->left[0] = compare->left[1] = 0;
+    compare->expressed = 0;
+    outstanding ++;
+
+    for (int side = 0; side < 2; side ++) {
+      Name name(sides[side].prefix);
+      name.append(Name(compare->path));
+      name.append(Name::fromEscapedString(NdnfsNamespace::treeComponentName_));
+      if (compare->bucket != -1)
+        name.appendSequenceNumber(compare->bucket);
+      fetchSegment(compare, side, name, 0);
+    }
+  }
+}
+
+static void usage()
+{
+  cerr << "usage: ./ndnfs-diff -a prefix -b prefix [-A host] [-B host] [-w window]" << endl;
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  string prefixes[2];
+  string hosts[2] = {"localhost", "localhost"};
+
+  int opt;
+  while ((opt = getopt(argc, argv, "a:b:A:B:w:")) != -1) {
+    switch (opt) {
+    case 'a':
+      prefixes[0] = optarg;
+      break;
+    case 'b':
+      prefixes[1] = optarg;
+      break;
+    case 'A':
+      hosts[0] = optarg;
+      break;
+    case 'B':
+      hosts[1] = optarg;
+      break;
+    case 'w':
+      window = atoi(optarg);
+      break;
+    default:
+      usage();
+    }
+  }
+  if (prefixes[0].empty() || prefixes[1].empty() || window <= 0)
+    usage();
+
+  // Servers behind the same forwarder share a face
+  Face faceA(hosts[0].c_str());
+  Face *faceB = (hosts[1] == hosts[0]) ? NULL : new Face(hosts[1].c_str());
+  sides[0].face = &faceA;
+  sides[0].prefix = Name(prefixes[0]);
+  sides[1].face = (faceB != NULL) ? faceB : &faceA;
+  sides[1].prefix = Name(prefixes[1]);
+
+  steady_clock::time_point start = steady_clock::now();
+  queueNode("/", -1);
+  startNext();
+  while (outstanding > 0) {
+    faceA.processEvents();
+    if (faceB != NULL)
+      faceB->processEvents();
+    usleep(100);
+  }
+
+  int64_t elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+  cerr << differences << " differences, " << nodes << " nodes fetched (" << interests << " Interests, "
+       << bytes << " bytes) in " << elapsed << " ms" << endl;
+  delete faceB;
+
+  if (failed)
+    return 2;
+  return (differences > 0) ? 1 : 0;
+}
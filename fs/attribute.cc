@@ -56,7 +56,8 @@ int ndnfs_chmod(const char *path, mode_t mode)
 }
 
 
-// Dummy function to stop commands such as 'cp' from complaining
+// Only STREAM_XATTR_NAME is handled; other attributes are accepted and dropped
+// to stop commands such as 'cp' from complaining
 
 #ifdef NDNFS_OSXFUSE
 int ndnfs_setxattr(const char *path, const char *name, const char *value, size_t size, int flags, uint32_t position)
@@ -64,5 +65,9 @@ int ndnfs_setxattr(const char *path, const char *name, const char *value, size_t
 int ndnfs_setxattr(const char *path, const char *name, const char *value, size_t size, int flags)
 #endif
 {
+  if (strcmp(name, STREAM_XATTR_NAME) == 0) {
+    bool streaming = (size > 0 && value[0] == '1');
+    return set_stream_flag(path, streaming);
+  }
   return 0;
 }
@@ -23,6 +23,7 @@
 
 #include "ndnfs.h"
 #include "version.h"
+#include "stream.h"
 
 int ndnfs_getattr(const char *path, struct stat *stbuf);
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <sstream>
+
+#include "content-digest.h"
+#include "logger.h"
+
+using namespace std;
+
+#define DIGEST_BUF_SIZE 65536
+
+void find_holes(int fd, off_t file_size, hole_list &holes)
+{
+  off_t offset = 0;
+  while (offset < file_size) {
+    // Fails with EINVAL where SEEK_HOLE is not supported; the file is then treated as all data
+    off_t hole = lseek(fd, offset, SEEK_HOLE);
+    if (hole == -1 || hole >= file_size)
+      break;
+    off_t data = lseek(fd, hole, SEEK_DATA);
+    if (data == -1 || data > file_size)
+      data = file_size;
+    holes.push_back(make_pair(hole, data));
+    offset = data;
+  }
+}
+
+void hash_zeros(SHA256_CTX *ctx, int64_t len)
+{
+  static const char zeros[DIGEST_BUF_SIZE] = {0};
+  while (len > 0) {
+    size_t n = (size_t)min(len, (int64_t)DIGEST_BUF_SIZE);
+    SHA256_Update(ctx, zeros, n);
+    len -= n;
+  }
+}
+
+int compute_file_digest(int fd, uint8_t *digest)
+{
+  SHA256_CTX ctx;
+  SHA256_Init(&ctx);
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    FILE_LOG(LOG_ERROR) << "compute_file_digest: stat error. Errno: " << errno << endl;
+    return -errno;
+  }
+
+  hole_list holes;
+  find_holes(fd, st.st_size, holes);
+
+  char buf[DIGEST_BUF_SIZE];
+  off_t offset = 0;
+  int size = 0;
+
+  for (size_t i = 0; i <= holes.size(); i ++) {
+    off_t end = (i < holes.size()) ? holes[i].first : st.st_size;
+    while (offset < end && (size = pread(fd, buf, min((off_t)DIGEST_BUF_SIZE, end - offset), offset)) > 0) {
+      SHA256_Update(&ctx, buf, size);
+      offset += size;
+    }
+    if (size == -1) {
+      FILE_LOG(LOG_ERROR) << "compute_file_digest: read error. Errno: " << errno << endl;
+      return -errno;
+    }
+    if (i < holes.size()) {
+      hash_zeros(&ctx, holes[i].second - holes[i].first);
+      offset = holes[i].second;
+    }
+  }
+
+  SHA256_Final(digest, &ctx);
+  return 0;
+}
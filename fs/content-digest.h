@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_CONTENT_DIGEST_H
+#define NDNFS_CONTENT_DIGEST_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <vector>
+#include <utility>
+#include <openssl/sha.h>
+
+#define CONTENT_DIGEST_SIZE 32
+
+/**
+ * The content digest of a version is the plain SHA-256 of its logical content: holes
+ * are hashed as the zeros they read as, so the digest doesn't depend on how the file
+ * is laid out on disk, and ndnfs-import computes the same digest from read() alone.
+ */
+
+// Ranges [start, end) of a file that are holes
+typedef std::vector<std::pair<off_t, off_t> > hole_list;
+
+/**
+ * find_holes lists the holes of the first file_size bytes of fd; it finds none where
+ * SEEK_HOLE is not supported.
+ */
+void find_holes(int fd, off_t file_size, hole_list &holes);
+
+/**
+ * hash_zeros feeds len zero bytes to ctx.
+ */
+void hash_zeros(SHA256_CTX *ctx, int64_t len);
+
+/**
+ * compute_file_digest hashes the whole content of fd with SHA-256; holes are not read.
+ * @return 0 on success, -errno on read error
+ */
+int compute_file_digest(int fd, uint8_t *digest);
+
+#endif // NDNFS_CONTENT_DIGEST_H
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DIR_CHANGE_TYPE_H
+#define DIR_CHANGE_TYPE_H
+
+/**
+ * DirChangeTypes are stored into the database (dir_changes table, see dir-changes.h)
+ * Added: the entry was created in, or moved into the directory;
+ * Removed: the entry was removed from, or moved out of the directory;
+ * Modified: the entry got a new current version.
+ * Pruned: the row with an empty name, recording up to which version removals in the directory were dropped.
+ */
+enum DirChangeType {DIR_CHANGE_PRUNED, DIR_CHANGE_ADDED, DIR_CHANGE_REMOVED, DIR_CHANGE_MODIFIED};
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "dir-changes.h"
+#include "version.h"
+#include "transaction.h"
+
+using namespace std;
+
+// Version of the last change logged, -1 until read from dir_changes; guarded by the transaction
+static int64_t last_change_version = -1;
+
+void log_dir_change(const char *path, enum DirChangeType change)
+{
+  string parent, name;
+  if (split_last_component(path, parent, name) == -1 || name.empty())
+    return;
+
+  // Changes are stamped and committed in the same order, so a reader never sees a change
+  // before an earlier-stamped one that's still to be committed
+  begin_transaction();
+
+  sqlite3_stmt *stmt;
+  if (last_change_version < 0) {
+    last_change_version = 0;
+    sqlite3_prepare_v2(db, "SELECT MAX(version) FROM dir_changes;", -1, &stmt, 0);
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+      last_change_version = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+  }
+  // Clock going backwards, or two changes within the same microsecond
+  last_change_version = max(version_now(), last_change_version + 1);
+
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO dir_changes (parent, name, version, change) VALUES (?,?,?,?);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, parent.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 3, last_change_version);
+  sqlite3_bind_int(stmt, 4, change);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  end_transaction();
+}
+
+void prune_dir_changes()
+{
+  int64_t horizon = version_now() - (int64_t)DIR_CHANGE_RETENTION_DAYS * 24 * 3600 * 1000000;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO dir_changes (parent, name, version, change) \
+                          SELECT parent, '', MAX(version), ?1 FROM dir_changes WHERE change = ?2 AND version < ?3 GROUP BY parent;", -1, &stmt, 0);
+  sqlite3_bind_int(stmt, 1, DIR_CHANGE_PRUNED);
+  sqlite3_bind_int(stmt, 2, DIR_CHANGE_REMOVED);
+  sqlite3_bind_int64(stmt, 3, horizon);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  sqlite3_prepare_v2(db, "DELETE FROM dir_changes WHERE change = ? AND version < ?;", -1, &stmt, 0);
+  sqlite3_bind_int(stmt, 1, DIR_CHANGE_REMOVED);
+  sqlite3_bind_int64(stmt, 2, horizon);
+  sqlite3_step(stmt);
+  int pruned = sqlite3_changes(db);
+  sqlite3_finalize(stmt);
+
+  if (pruned > 0) {
+    FILE_LOG(LOG_DEBUG) << "prune_dir_changes: dropped " << pruned << " removals older than " << DIR_CHANGE_RETENTION_DAYS << " days" << endl;
+  }
+}
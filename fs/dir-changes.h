@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_DIR_CHANGES_H
+#define NDNFS_DIR_CHANGES_H
+
+#include "ndnfs.h"
+#include "dir-change-types.h"
+
+/**
+ * Directory change log: each entry added to, removed from or modified in a directory is recorded
+ * in dir_changes under its parent, with the time of the change (in microseconds, like versions)
+ * as version. A later change of an entry replaces the earlier one, so the log of a directory holds
+ * at most one row per name. ndnfs-server answers <dir>/%C1.FS.dir/<since-version>/delta with the
+ * rows of version > since-version, so a client holding a listing only fetches what changed.
+ *
+ * Versions of changes strictly increase, and each change is committed in the transaction it is
+ * stamped in, so changes become visible in the order of their versions: a delta never skips a
+ * change stamped before its own version.
+ */
+void log_dir_change(const char *path, enum DirChangeType change);
+
+/**
+ * Removals are kept for DIR_CHANGE_RETENTION_DAYS. prune_dir_changes drops older ones at mount,
+ * and records per directory the last version it dropped, so that ndnfs-server refuses deltas
+ * since an earlier version (and clients fetch the whole listing instead).
+ */
+#define DIR_CHANGE_RETENTION_DAYS 30
+
+void prune_dir_changes();
+
+#endif
@@ -20,6 +20,7 @@
  */
 
 #include "directory.h"
+#include "version.h"
 
 using namespace std;
 
@@ -58,12 +59,6 @@ int ndnfs_mkdir(const char *path, mode_t mode)
 {
   FILE_LOG(LOG_DEBUG) << "ndnfs_mkdir: path=" << path << ", mode=0" << std::oct << mode << endl;
   
-  // TODO: test mk-sub-dir directly
-  /*  
-  string dir_path, dir_name;
-  split_last_component(path, dir_path, dir_name);
-  */
-  
   char fullPath[PATH_MAX];
   abs_path(fullPath, path);
   int ret = mkdir(fullPath, mode);
@@ -73,6 +68,8 @@ int ndnfs_mkdir(const char *path, mode_t mode)
     return -errno;
   }
   
+  // Listings of the parent come from the entries that point to it
+  add_file_entry(path, DIRECTORY);
   return 0;
 }
 
@@ -99,5 +96,6 @@ int ndnfs_rmdir(const char *path)
     return -errno;
   }
   
+  remove_file_entry(path);
   return 0;
 }
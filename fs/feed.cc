@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "feed.h"
+
+using namespace std;
+
+void feed_append(const char *path, int64_t version)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT INTO publish_feed (path, version, size) \
+                          SELECT path, version, size FROM file_versions WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  if (sqlite3_step(stmt) != SQLITE_DONE) {
+    FILE_LOG(LOG_ERROR) << "feed_append: " << sqlite3_errmsg(db) << endl;
+  }
+  sqlite3_finalize(stmt);
+}
+
+void feed_remove(const char *path)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT INTO publish_feed (path, version, removed) \
+                          SELECT path, current_version, 1 FROM file_system WHERE path = ? AND current_version IS NOT NULL;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) != SQLITE_DONE) {
+    FILE_LOG(LOG_ERROR) << "feed_remove: " << sqlite3_errmsg(db) << endl;
+  }
+  sqlite3_finalize(stmt);
+}
+
+void prune_feed()
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "DELETE FROM publish_feed WHERE seq <= (SELECT MAX(seq) FROM publish_feed) - ?;", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, FEED_RETENTION);
+  sqlite3_step(stmt);
+  int pruned = sqlite3_changes(db);
+  sqlite3_finalize(stmt);
+
+  if (pruned > 0) {
+    FILE_LOG(LOG_DEBUG) << "prune_feed: dropped " << pruned << " entries" << endl;
+  }
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_FEED_H
+#define NDNFS_FEED_H
+
+#include "ndnfs.h"
+
+/**
+ * Change feed: each published version is appended to publish_feed, with the next sequence
+ * number, once it can be served: when all its segments are signed, or when it is recorded
+ * to be signed on request (lazy versions and links). ndnfs-server serves the feed in blocks
+ * of entries under <root>/%C1.FS.feed, so that one consumer can follow the whole tree by
+ * fetching the new blocks, instead of asking for the current version of every file.
+ * A rename appends the moved current versions under their new names.
+ */
+void feed_append(const char *path, int64_t version);
+
+/**
+ * feed_remove appends a removal record for path (publish_feed.removed set), with its current
+ * version, so that consumers drop it; called before its entry goes, on removal and on rename
+ * away. Entries without version (directories) get none.
+ */
+void feed_remove(const char *path);
+
+/**
+ * The feed keeps the last FEED_RETENTION entries; prune_feed drops older ones at mount.
+ * Sequence numbers are not reused.
+ */
+#define FEED_RETENTION 1000000
+
+void prune_feed();
+
+#endif
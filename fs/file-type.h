@@ -22,7 +22,7 @@ enum FileType {
   EVENT_PORT        = 5,
   UNIX_SOCKET       = 6,
   REGULAR           = 7,
-  DIRECTORY         = 8 // don't expect to this in database
+  DIRECTORY         = 8
 };
 
 #endif
@@ -22,6 +22,9 @@
 #include "file.h"
 
 #include "signature-states.h"
+#include "publish.h"
+#include "stream.h"
+#include "rename.h"
 
 using namespace std;
 
@@ -50,10 +53,10 @@ int ndnfs_open (const char *path, struct fuse_file_info *fi)
     return -ENOENT;
   }
     
-  int curr_ver = sqlite3_column_int (stmt, 0);
+  int64_t curr_ver = sqlite3_column_int64 (stmt, 0);
   sqlite3_finalize (stmt);
   
-  int temp_ver = time(0);
+  int64_t temp_ver = version_now();
       
   switch (fi->flags & O_ACCMODE) {
     case O_RDONLY:
@@ -66,6 +69,17 @@ int ndnfs_open (const char *path, struct fuse_file_info *fi)
       if (duplicate_version (path, curr_ver, temp_ver) < 0)
         return -EACCES;
 
+      if (is_stream_path (path)) {
+        if (begin_stream (path) < 0)
+          return -EACCES;
+      } else {
+        begin_write (path);
+        // With FUSE_CAP_ATOMIC_O_TRUNC, open(O_TRUNC) comes here instead of to truncate
+        if (fi->flags & O_TRUNC) {
+          mark_modified (path);
+          inflight_truncate (path, 0);
+        }
+      }
       break;
     default:
       break;
@@ -80,7 +94,7 @@ int ndnfs_open (const char *path, struct fuse_file_info *fi)
  * In Linux(Ubuntu), current implementation reports "utimens: no such file" when executing touch; digging out why.
  * For the newly created file, getattr is called before mknod/open(O_CREAT); wonder how that works.
  */
-int ndnfs_mknod (const char *path, mode_t mode, dev_t dev)
+static int make_node (const char *path, mode_t mode, dev_t dev)
 {
   FILE_LOG(LOG_DEBUG) << "ndnfs_mknod: path=" << path << ", mode=0" << std::oct << mode << endl;
 
@@ -103,22 +117,27 @@ int ndnfs_mknod (const char *path, mode_t mode, dev_t dev)
   mime_infer(mime_type, path);
   
   // Generate first version entry for the new file
-  int ver = time(0);
+  int64_t ver = new_version(path);
   
-  sqlite3_prepare_v2(db, "INSERT INTO file_versions (path, version) VALUES (?, ?);", -1, &stmt, 0);
+  sqlite3_prepare_v2(db, "INSERT INTO file_versions (path, version, seg_size, signature_type) VALUES (?, ?, ?, ?);", -1, &stmt, 0);
   sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
-  sqlite3_bind_int(stmt, 2, ver);
+  sqlite3_bind_int64(stmt, 2, ver);
+  sqlite3_bind_int(stmt, 3, choose_seg_size(0, version_name(path, ver)));
+  sqlite3_bind_int(stmt, 4, ndnfs::signature_type);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
+  string parent, name;
+  split_last_component(path, parent, name);
+
   // Add the file entry to database
   sqlite3_prepare_v2(db, 
                      "INSERT INTO file_system \
-                      (path, current_version, mime_type, ready_signed, type) \
-                      VALUES (?, ?, ?, ?, ?);", 
+                      (path, current_version, mime_type, ready_signed, type, parent) \
+                      VALUES (?, ?, ?, ?, ?, ?);", 
                      -1, &stmt, 0);
   sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
-  sqlite3_bind_int(stmt, 2, ver);  // current version
+  sqlite3_bind_int64(stmt, 2, ver);  // current version
   sqlite3_bind_text(stmt, 3, mime_type, -1, SQLITE_STATIC); // mime_type based on ext
   
   enum SignatureState signatureState = NOT_READY;
@@ -151,9 +170,12 @@ int ndnfs_mknod (const char *path, mode_t mode, dev_t dev)
       break;
   }
   sqlite3_bind_int(stmt, 5, fileType);
+  sqlite3_bind_text(stmt, 6, parent.c_str(), -1, SQLITE_STATIC);
   
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+  log_dir_change(path, DIR_CHANGE_ADDED);
+  tree_entry_changed(path);
   
   // Create the actual file
   char full_path[PATH_MAX];
@@ -180,6 +202,39 @@ int ndnfs_mknod (const char *path, mode_t mode, dev_t dev)
   return 0;
 }
 
+int ndnfs_mknod (const char *path, mode_t mode, dev_t dev)
+{
+  int ret = make_node (path, mode, dev);
+  // Nothing opens a regular file made by mknod(2) for it to be published at release
+  if (ret == 0 && S_ISREG(mode))
+    schedule_publish (path);
+  return ret;
+}
+
+/**
+ * create makes the file the way mknod does and opens it; the file is published at
+ * release, even if nothing is written to it.
+ */
+int ndnfs_create (const char *path, mode_t mode, struct fuse_file_info *fi)
+{
+  int ret = make_node (path, (mode & ~S_IFMT) | S_IFREG, 0);
+  if (ret != 0)
+    return ret;
+
+  // The file exists by now
+  int flags = fi->flags;
+  fi->flags &= ~(O_CREAT | O_EXCL);
+  ret = ndnfs_open (path, fi);
+  fi->flags = flags;
+  if (ret != 0)
+    return ret;
+
+  // A stream is published as it's written; a file opened read-only has no release to publish it
+  if (!is_stream_path (path) && !mark_modified (path))
+    schedule_publish (path);
+  return 0;
+}
+
 int ndnfs_read(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi)
 {
   FILE_LOG(LOG_DEBUG) << "ndnfs_read: path=" << path << ", offset=" << std::dec << offset << ", size=" << size << endl;
@@ -251,6 +306,11 @@ int ndnfs_write (const char *path, const char *buf, size_t size, off_t offset, s
     return -errno;
   }
   
+  // Files in streaming mode get completed segments signed right away
+  if (!stream_write(path, fd, offset, write_len)) {
+    mark_modified(path);
+    inflight_write(path, buf, write_len, offset);
+  }
   close(fd);
   
   return write_len;  // return the number of bytes written on success
@@ -280,7 +340,13 @@ int ndnfs_truncate (const char *path, off_t length)
     return -errno;
   }
   
-  return res;
+  if (!stream_truncate(path, length)) {
+    inflight_truncate(path, length);
+    // Without a writer, no release is coming to publish the change
+    if (!mark_modified(path))
+      schedule_publish(path);
+  }
+  return 0;
 }
 
 
@@ -289,6 +355,8 @@ int ndnfs_unlink(const char *path)
   FILE_LOG(LOG_DEBUG) << "ndnfs_unlink: path=" << path << endl;
 
   // TODO: update remove_versions
+  cancel_publish(path);
+  discard_inflight(path);
   remove_file_entry(path);
 
   // Then, remove file entry
@@ -313,7 +381,6 @@ int ndnfs_unlink(const char *path)
 int ndnfs_release (const char *path, struct fuse_file_info *fi)
 {
   FILE_LOG(LOG_DEBUG) << "ndnfs_release: path=" << path << ", flag=0x" << std::hex << fi->flags << endl;
-  int curr_version = time(0);
 
   // First we check if the file exists
   sqlite3_stmt *stmt;
@@ -327,21 +394,15 @@ int ndnfs_release (const char *path, struct fuse_file_info *fi)
   sqlite3_finalize (stmt);
         
   if ((fi->flags & O_ACCMODE) != O_RDONLY) {
-    sqlite3_prepare_v2 (db, "UPDATE file_system SET current_version = ? WHERE path = ?;", -1, &stmt, 0);
-    sqlite3_bind_int (stmt, 1, curr_version);  // set current_version to the current timestamp
-    sqlite3_bind_text (stmt, 2, path, -1, SQLITE_STATIC);
-    res = sqlite3_step (stmt);
-    if (res != SQLITE_OK && res != SQLITE_DONE) {
-      FILE_LOG(LOG_ERROR) << "ndnfs_release: update file_system error. " << res << endl;
-      return res;
-    }
-    sqlite3_finalize (stmt);
+    if (is_streaming (path))
+      return end_stream (path);
     
-    sqlite3_prepare_v2 (db, "INSERT INTO file_versions (path, version) VALUES (?,?);", -1, &stmt, 0);
-    sqlite3_bind_text (stmt, 1, path, -1, SQLITE_STATIC);
-    sqlite3_bind_int (stmt, 2, curr_version);
-    sqlite3_step (stmt);
-    sqlite3_finalize (stmt);
+    // Tools such as editors and rsync open with write access without writing;
+    // the current version stays valid for those.
+    if (!end_write (path)) {
+      FILE_LOG(LOG_DEBUG) << "ndnfs_release: " << path << " not modified, keeping current version" << endl;
+      return 0;
+    }
     
     // TODO: since older version is removed anyway, it makes sense to rely on system 
     // function calls for multiple file accesses. Simplification of versioning method?
@@ -350,31 +411,7 @@ int ndnfs_release (const char *path, struct fuse_file_info *fi)
     
     // After releasing, start a new signing thread for the file; 
     // If a signing thread for the file in question has already started, kill that thread.
-    char full_path[PATH_MAX];
-    abs_path(full_path, path);
-  
-    int fd = open(full_path, O_RDONLY);
-    
-    if (fd == -1) {
-      FILE_LOG(LOG_ERROR) << "ndnfs_release: open error. Errno: " << errno << endl;
-      return -errno;
-    }
-    
-    char buf[ndnfs::seg_size];
-    int size = ndnfs::seg_size;
-    int seg = 0;
-    
-    while (size == ndnfs::seg_size) {
-      size = pread(fd, buf, ndnfs::seg_size, seg << ndnfs::seg_size_shift);
-      if (size == -1) {
-        FILE_LOG(LOG_ERROR) << "ndnfs_release: read error. Errno: " << errno << endl;
-        return -errno;    
-      }
-      sign_segment (path, curr_version, seg, buf, size);
-      seg ++;
-    }
-    
-    close(fd);
+    return schedule_publish (path);
   }
   
   return 0;
@@ -397,6 +434,9 @@ int ndnfs_utimens(const char *path, const struct timespec ts[2])
   if (res == -1)
     return -errno;
 
+  // Outside a write, only the times changed; a pending publish records them itself
+  if (!mark_modified(path) && !is_publish_pending(path))
+    touch_current_version(path);
   return 0;
 }
 
@@ -416,145 +456,90 @@ int ndnfs_readlink(const char *path, char *buf, size_t size)
 }
 
 /**
- * symlink handling inserts file and version entry for the symlink name, 
- * but does not create segments entry;
- * TODO: file_segments entries should be linked to another name in file_system;
- * Symlink, as well as hard links will not be available for remote fetching.
+ * A symlink to a file inside the mount gets an entry that references the content of the
+ * file (see link.h); symlinks to anything else are not available for remote fetching.
+ * The link is stored as given, like readlink returns it.
  */
 int ndnfs_symlink(const char *from, const char *to)
 {
-  int res;
-  
-  /*
-  sqlite3_stmt *stmt;
-  sqlite3_prepare_v2(db, "SELECT * FROM file_system WHERE path = ?;", -1, &stmt, 0);
-  sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
-  res = sqlite3_step(stmt);
-  if (res == SQLITE_ROW) {
-      // Cannot create symlink that has conflicting file name
-      sqlite3_finalize(stmt);
-      return -ENOENT;
-  }
-  
-  sqlite3_finalize(stmt);
-  
-  // Generate first version entry for the new symlink
-  int ver = time(0);
-  
-  sqlite3_prepare_v2(db, "INSERT INTO file_versions (path, version) VALUES (?, ?);", -1, &stmt, 0);
-  sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
-  sqlite3_bind_int(stmt, 2, ver);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-
-  // Add the symlink entry to database
-  sqlite3_prepare_v2(db, 
-                     "INSERT INTO file_system \
-                      (path, current_version, mime_type, type) \
-                      VALUES (?, ?, ?, ?);", 
-                     -1, &stmt, 0);
-  sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
-  sqlite3_bind_int(stmt, 2, ver);  // current version
-  sqlite3_bind_text(stmt, 3, "", -1, SQLITE_STATIC);
-  sqlite3_bind_int(stmt, 4, SYMBOLIC_LINK);
-  
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);  
-  */
-  
-  char full_path_from[PATH_MAX];
-  abs_path(full_path_from, from);
-  
   char full_path_to[PATH_MAX];
   abs_path(full_path_to, to);
   
-  res = symlink(full_path_from, full_path_to);
-  if (res == -1)
+  if (symlink(from, full_path_to) == -1)
     return -errno;
 
+  string target = resolve_symlink(to, from);
+  if (target.empty() || link_version(to, target.c_str(), SYMBOLIC_LINK) != 0) {
+    // Still listed in its directory
+    FILE_LOG(LOG_DEBUG) << "ndnfs_symlink: " << to << " -> " << from << " does not point to a published file" << endl;
+    add_file_entry(to, SYMBOLIC_LINK);
+    // Linked once the target is published
+    if (!target.empty())
+      add_pending_link(to, target.c_str());
+  }
   return 0;
 }
 
 /**
- * Link is called on the creation of hard links
- * TODO: file_segments entries should be linked to another name in file_system;
- * This is not implemented and hard links will not be available for remote fetching.
+ * Link is called on the creation of hard links; the new name references the content
+ * of the existing one, without signing it again (see link.h).
  */
 int ndnfs_link(const char *from, const char *to)
 {
-  int res;
-  
-  // actual linking of paths
   char full_path_from[PATH_MAX];
   abs_path(full_path_from, from);
   
   char full_path_to[PATH_MAX];
   abs_path(full_path_to, to);
   
-  res = link(full_path_from, full_path_to);
-  if (res == -1)
+  if (link(full_path_from, full_path_to) == -1)
     return -errno;
 
+  // Content that is not published yet is published under the new name on its own,
+  // which links it to the other name if that is published by then
+  if (link_version(to, from, REGULAR) != 0) {
+    add_file_entry(to);
+    schedule_publish(to);
+  }
   return 0;
 }
 
 /**
- * Right now, rename changes every entry related with the content, without creating new version
- * TODO: Rename would require checking if rename target (avoid collision error in db) already exists, and resigning of everything...
- * Rename should better work as a duplicate.
+ * rename moves the entries of from and everything below it to the new name, and keeps
+ * the old name servable until the moved versions are signed again; see rename.h.
+ * Publishes of both names wait for it, and it waits for the ones that are running.
  */
 int ndnfs_rename(const char *from, const char *to)
 {
-  int res = 0;
-  sqlite3_stmt *stmt;
+  char full_path_from[PATH_MAX];
+  abs_path(full_path_from, from);
   
-  sqlite3_prepare_v2(db, "UPDATE file_system SET PATH = ? WHERE path = ?;", -1, &stmt, 0);
-  sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
-  sqlite3_bind_text(stmt, 2, from, -1, SQLITE_STATIC);
-  sqlite3_step(stmt);
+  char full_path_to[PATH_MAX];
+  abs_path(full_path_to, to);
 
-  if (res != SQLITE_OK && res != SQLITE_DONE) {
-    FILE_LOG(LOG_ERROR) << "ndnfs_rename: update file_system error. " << res << endl;
-    return res;
-  }
-  sqlite3_finalize (stmt);
+  struct stat st;
+  bool is_dir = (lstat(full_path_from, &st) == 0 && S_ISDIR(st.st_mode));
 
-  sqlite3_prepare_v2(db, "UPDATE file_versions SET PATH = ? WHERE path = ?;", -1, &stmt, 0);
-  sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
-  sqlite3_bind_text(stmt, 2, from, -1, SQLITE_STATIC);
-  sqlite3_step(stmt);
+  lock_rename(from, to, is_dir);
 
-  if (res != SQLITE_OK && res != SQLITE_DONE) {
-    FILE_LOG(LOG_ERROR) << "ndnfs_rename: update file_versions error. " << res << endl;
-    return res;
+  int ret = 0;
+  if (rename(full_path_from, full_path_to) == -1) {
+    ret = -errno;
+  } else {
+    // A replaced target goes as with unlink
+    cancel_publish(to);
+    discard_inflight(to);
+    rename_entries(from, to);
+    rename_publish(from, to);
+    // Segments signed in flight carry the old name
+    discard_inflight(from);
   }
-  sqlite3_finalize (stmt);
 
-  sqlite3_prepare_v2(db, "UPDATE file_segments SET PATH = ? WHERE path = ?;", -1, &stmt, 0);
-  sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
-  sqlite3_bind_text(stmt, 2, from, -1, SQLITE_STATIC);
-  sqlite3_step(stmt);
+  // A release of from got in before the rename; its content is under to now
+  if (unlock_rename(from, to, is_dir) && ret == 0)
+    schedule_publish(to);
 
-  if (res != SQLITE_OK && res != SQLITE_DONE) {
-    FILE_LOG(LOG_ERROR) << "ndnfs_rename: update file_segments error. " << res << endl;
-    return res;
-  }
-  sqlite3_finalize (stmt);
-    
-  // actual renaming
-  char full_path_from[PATH_MAX];
-  abs_path(full_path_from, from);
-  
-  char full_path_to[PATH_MAX];
-  abs_path(full_path_to, to);
-  
-  res = rename(full_path_from, full_path_to);
-  
-  FILE_LOG(LOG_ERROR) << "ndnfs_rename: rename should trigger resign of everything, which is not yet implemented" << endl;
-  if (res == -1)
-    return -errno;
-
-  return 0;
+  return ret;
 }
 
 int ndnfs_statfs(const char *path, struct statvfs *si)
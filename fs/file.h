@@ -32,6 +32,8 @@ int ndnfs_open(const char *path, struct fuse_file_info *fi);
 
 int ndnfs_mknod(const char *path, mode_t mode, dev_t dev);
 
+int ndnfs_create(const char *path, mode_t mode, struct fuse_file_info *fi);
+
 int ndnfs_read(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi);
 
 int ndnfs_write(const char *path, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi);
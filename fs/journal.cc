@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "journal.h"
+#include "publish.h"
+
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+
+using namespace std;
+
+void journal_begin(const char *path, int64_t version)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO publish_journal (path, version, next_segment) VALUES (?,?,0);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+void journal_progress(const char *path, int64_t version, int64_t next_segment)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "UPDATE publish_journal SET next_segment = ? WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, next_segment);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 3, version);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+void journal_end(const char *path, int64_t version)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "DELETE FROM publish_journal WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+void journal_supersede(const char *path, int64_t version)
+{
+  vector<int64_t> versions;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT version FROM publish_journal WHERE path = ? AND version < ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    versions.push_back(sqlite3_column_int64(stmt, 0));
+  sqlite3_finalize(stmt);
+
+  for (size_t i = 0; i < versions.size(); i ++) {
+    FILE_LOG(LOG_DEBUG) << "journal_supersede: removing incomplete version " << versions[i] << " of " << path << endl;
+    remove_version(path, versions[i]);
+    journal_end(path, versions[i]);
+  }
+}
+
+struct journal_entry {
+  string path;
+  int64_t version;
+  int64_t next_segment;
+  // Last access or modification of the file, whichever is later
+  time_t accessed;
+};
+
+static bool accessed_later(const journal_entry &a, const journal_entry &b)
+{
+  return a.accessed > b.accessed;
+}
+
+static pthread_t resume_thread;
+static bool resume_running = false;
+static volatile bool resume_stop = false;
+
+bool resume_stopping()
+{
+  return resume_stop;
+}
+
+static void *resume_worker(void *arg)
+{
+  vector<journal_entry> entries;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT path, version, next_segment FROM publish_journal;", -1, &stmt, 0);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    journal_entry entry;
+    entry.path = (const char *)sqlite3_column_text(stmt, 0);
+    entry.version = sqlite3_column_int64(stmt, 1);
+    entry.next_segment = sqlite3_column_int64(stmt, 2);
+    entry.accessed = 0;
+
+    char full_path[PATH_MAX];
+    abs_path(full_path, entry.path.c_str());
+    struct stat st;
+    if (stat(full_path, &st) == 0)
+      entry.accessed = max(st.st_atime, st.st_mtime);
+    entries.push_back(entry);
+  }
+  sqlite3_finalize(stmt);
+
+  if (entries.empty())
+    return NULL;
+
+  FILE_LOG(LOG_DEBUG) << "resume_worker: " << entries.size() << " incomplete publishes" << endl;
+  stable_sort(entries.begin(), entries.end(), accessed_later);
+
+  size_t resumed = 0;
+  for (; resumed < entries.size() && !resume_stop; resumed ++)
+    resume_publish(entries[resumed].path.c_str(), entries[resumed].version, entries[resumed].next_segment);
+
+  FILE_LOG(LOG_DEBUG) << "resume_worker: resumed " << resumed << " of " << entries.size() << " publishes" << endl;
+  return NULL;
+}
+
+void start_resume()
+{
+  resume_stop = false;
+  if (pthread_create(&resume_thread, NULL, resume_worker, NULL) != 0) {
+    FILE_LOG(LOG_ERROR) << "start_resume: pthread_create error. Errno: " << errno << endl;
+    return;
+  }
+  resume_running = true;
+}
+
+void stop_resume()
+{
+  if (!resume_running)
+    return;
+
+  resume_stop = true;
+  pthread_join(resume_thread, NULL);
+  resume_running = false;
+}
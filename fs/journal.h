@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_JOURNAL_H
+#define NDNFS_JOURNAL_H
+
+#include "ndnfs.h"
+
+/**
+ * Publish journal: publish_file records a version in publish_journal before making it
+ * current, moves next_segment forward every JOURNAL_INTERVAL segments (to the first one
+ * the signing pool hasn't signed yet, without waiting for it), and removes the entry once
+ * every segment is signed.
+ *
+ * Entries left behind by a crash are resumed in the background after the next mount,
+ * most recently accessed files first: signing continues from next_segment, skipping
+ * segments that have a signature. A version whose content is gone (the file changed
+ * size or modification time, or a newer version is current) can't be finished; it is
+ * removed, and if it was current, the file is published again. A resumed publish and a
+ * publish of the same path never run at once; writing to the file, or a publish waiting
+ * for it, stops the resumed publish, and the publish then supersedes the incomplete version.
+ */
+#define JOURNAL_INTERVAL 1024
+
+void journal_begin(const char *path, int64_t version);
+
+void journal_progress(const char *path, int64_t version, int64_t next_segment);
+
+void journal_end(const char *path, int64_t version);
+
+/**
+ * journal_supersede removes the versions of path older than version that are still
+ * in the journal, once version is completely signed.
+ */
+void journal_supersede(const char *path, int64_t version);
+
+/**
+ * Like the publisher thread, the resume thread has to be started after fuse_main forks.
+ */
+void start_resume();
+
+void stop_resume();
+
+/**
+ * resume_stopping tells a resumed publish to return early (and leave its entry), at unmount.
+ */
+bool resume_stopping();
+
+#endif
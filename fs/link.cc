@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "link.h"
+#include "version.h"
+#include "dir-changes.h"
+#include "feed.h"
+#include "tree-digest.h"
+#include "segment.h"
+#include "signer.h"
+
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+
+using namespace std;
+
+string link_target(const char *path)
+{
+  string target = "";
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT v.target FROM file_versions v JOIN file_system f ON f.path = v.path AND f.current_version = v.version \
+                          WHERE v.path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+    target = (const char *)sqlite3_column_text(stmt, 0);
+  sqlite3_finalize(stmt);
+  return target;
+}
+
+/**
+ * copy_holes gives version of path the hole ranges of target_version of target, converted from
+ * segments of target_seg_size bytes to segments of seg_size bytes: the segments that lie
+ * entirely in a hole, the partial last one included if the hole reaches the end of the file.
+ */
+static void copy_holes(const char *path, int64_t version, int seg_size,
+                       const char *target, int64_t target_version, int target_seg_size, int64_t size)
+{
+  vector<pair<int64_t, int64_t> > holes;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT start_segment, end_segment FROM file_holes WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, target, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, target_version);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    holes.push_back(make_pair(sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 1)));
+  sqlite3_finalize(stmt);
+
+  sqlite3_prepare_v2(db, "INSERT INTO file_holes (path, version, start_segment, end_segment) VALUES (?,?,?,?);", -1, &stmt, 0);
+  for (size_t i = 0; i < holes.size(); i ++) {
+    int64_t start = segment_to_size(holes[i].first, target_seg_size);
+    int64_t end = min((int64_t)segment_to_size(holes[i].second, target_seg_size), size);
+    int64_t start_segment = (start + seg_size - 1) / seg_size;
+    int64_t end_segment = (end == size) ? (size + seg_size - 1) / seg_size : end / seg_size;
+    if (end_segment <= start_segment)
+      continue;
+    sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, version);
+    sqlite3_bind_int64(stmt, 3, start_segment);
+    sqlite3_bind_int64(stmt, 4, end_segment);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+}
+
+int link_version(const char *path, const char *target, enum FileType type)
+{
+  // Links of links reference the file with content of its own
+  string resolved = link_target(target);
+  if (resolved.empty())
+    resolved = target;
+  if (resolved == path)
+    return -EINVAL;
+
+  // The server checks the size and mtime of a lazy version against the file
+  int64_t target_version = -1;
+  int64_t size = 0;
+  int target_seg_size = DEFAULT_SEG_SIZE;
+  int signature_type = SIGNATURE_RSA;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT v.version, v.size, v.seg_size, v.signature_type FROM file_versions v \
+                          JOIN file_system f ON f.path = v.path AND f.current_version = v.version \
+                          WHERE v.path = ? AND v.size IS NOT NULL AND v.mtime IS NOT NULL;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, target, -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    target_version = sqlite3_column_int64(stmt, 0);
+    size = sqlite3_column_int64(stmt, 1);
+    if (sqlite3_column_int(stmt, 2) > 0)
+      target_seg_size = sqlite3_column_int(stmt, 2);
+    if (sqlite3_column_type(stmt, 3) != SQLITE_NULL)
+      signature_type = sqlite3_column_int(stmt, 3);
+  }
+  sqlite3_finalize(stmt);
+  if (target_version == -1)
+    return -ENOENT;
+
+  add_file_entry(path, type);
+  int64_t version = new_version(path);
+
+  // The server signs the link's segments under its own name, which may be longer than the
+  // target's; the link then gets smaller segments
+  int seg_size = min(target_seg_size, max_content_size(version_name(path, version), signature_type == SIGNATURE_DIGEST));
+
+  sqlite3_prepare_v2(db, "INSERT INTO file_versions (path, version, size, content_digest, seg_size, signature_type, mtime, lazy, target) \
+                          SELECT ?1, ?2, size, content_digest, ?6, signature_type, mtime, 1, ?3 FROM file_versions \
+                          WHERE path = ?4 AND version = ?5;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  sqlite3_bind_text(stmt, 3, resolved.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 4, target, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 5, target_version);
+  sqlite3_bind_int(stmt, 6, seg_size);
+  int res = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (res != SQLITE_DONE) {
+    FILE_LOG(LOG_ERROR) << "link_version: insert file_versions error. " << sqlite3_errmsg(db) << endl;
+    return -EIO;
+  }
+
+  if (seg_size == target_seg_size) {
+    sqlite3_prepare_v2(db, "INSERT INTO file_holes (path, version, start_segment, end_segment) \
+                            SELECT ?1, ?2, start_segment, end_segment FROM file_holes WHERE path = ?3 AND version = ?4;", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, version);
+    sqlite3_bind_text(stmt, 3, target, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, target_version);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  } else {
+    copy_holes(path, version, seg_size, target, target_version, target_seg_size, size);
+  }
+
+  sqlite3_prepare_v2(db, "UPDATE file_system SET current_version = ? WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, version);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  log_dir_change(path, DIR_CHANGE_MODIFIED);
+  feed_append(path, version);
+  tree_entry_changed(path);
+
+  FILE_LOG(LOG_DEBUG) << "link_version: path=" << path << ", version=" << version << ", target=" << resolved << endl;
+
+  // Symlinks to path waited for it
+  link_pending(path);
+  return 0;
+}
+
+void add_pending_link(const char *path, const char *target)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO pending_links (path, target) VALUES (?, ?);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, target, -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+void remove_pending_link(const char *path)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "DELETE FROM pending_links WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+void link_pending(const char *path)
+{
+  vector<pair<string, string> > pending;
+  string under = string(path) + "/";
+  string after = string(path) + "0";
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT path, target FROM pending_links WHERE target = ?1 OR (target > ?2 AND target < ?3);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, under.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 3, after.c_str(), -1, SQLITE_STATIC);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    pending.push_back(make_pair(string((const char *)sqlite3_column_text(stmt, 0)), string((const char *)sqlite3_column_text(stmt, 1))));
+  sqlite3_finalize(stmt);
+
+  // Directories, and files without a version yet, keep waiting
+  for (size_t i = 0; i < pending.size(); i ++) {
+    remove_pending_link(pending[i].first.c_str());
+    if (link_version(pending[i].first.c_str(), pending[i].second.c_str(), SYMBOLIC_LINK) != 0)
+      add_pending_link(pending[i].first.c_str(), pending[i].second.c_str());
+  }
+}
+
+// Returns the rest of path below dir (from its '/'), or NULL if path is not below dir
+static const char *below(const char *path, const string &dir)
+{
+  if (dir.empty() || strncmp(path, dir.c_str(), dir.size()) != 0 || path[dir.size()] != '/')
+    return NULL;
+  return path + dir.size();
+}
+
+string resolve_symlink(const char *path, const char *link)
+{
+  string target;
+  if (link[0] == '/') {
+    // Absolute links reach the mount through the mount point or the actual folder
+    const char *rest = below(link, ndnfs::mount_path);
+    if (rest == NULL)
+      rest = below(link, ndnfs::root_path);
+    if (rest == NULL)
+      return "";
+    target = rest;
+  } else {
+    string dir, name;
+    split_last_component(path, dir, name);
+    target = dir + "/" + link;
+  }
+
+  vector<string> components;
+  size_t start = 0;
+  while (start <= target.size()) {
+    size_t end = target.find('/', start);
+    if (end == string::npos)
+      end = target.size();
+    string component = target.substr(start, end - start);
+    start = end + 1;
+
+    if (component.empty() || component == ".")
+      continue;
+    if (component == "..") {
+      if (components.empty())
+        return "";
+      components.pop_back();
+      continue;
+    }
+    components.push_back(component);
+  }
+
+  string resolved;
+  for (size_t i = 0; i < components.size(); i ++)
+    resolved += "/" + components[i];
+  return resolved;
+}
+
+static bool same_inode(const char *path, const struct stat &st)
+{
+  char full_path[PATH_MAX];
+  abs_path(full_path, path);
+  struct stat other;
+  return (stat(full_path, &other) == 0 && other.st_dev == st.st_dev && other.st_ino == st.st_ino);
+}
+
+bool link_same_inode(const char *path, const struct stat &st)
+{
+  if (!S_ISREG(st.st_mode) || st.st_nlink < 2)
+    return false;
+
+  vector<string> candidates;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT v.path FROM file_versions v JOIN file_system f ON f.path = v.path AND f.current_version = v.version \
+                          WHERE v.mtime = ? AND v.size = ? AND v.path != ?;", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, mtime_ns(st));
+  sqlite3_bind_int64(stmt, 2, st.st_size);
+  sqlite3_bind_text(stmt, 3, path, -1, SQLITE_STATIC);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    candidates.push_back((const char *)sqlite3_column_text(stmt, 0));
+  sqlite3_finalize(stmt);
+
+  for (size_t i = 0; i < candidates.size(); i ++) {
+    if (same_inode(candidates[i].c_str(), st) && link_version(path, candidates[i].c_str(), REGULAR) == 0)
+      return true;
+  }
+  return false;
+}
+
+struct linked_entry {
+  string path;
+  int type;
+  bool signed_copy;  // has signatures of its own for the same content as the published version
+};
+
+void refresh_links(const char *path, const string &old_target, const struct stat &st)
+{
+  vector<linked_entry> entries;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT f.path, f.type, IFNULL(v.lazy, 0) = 0 AND v.content_digest = \
+                            (SELECT content_digest FROM file_versions WHERE path = ?1 AND version = \
+                              (SELECT current_version FROM file_system WHERE path = ?1)) \
+                          FROM file_system f JOIN file_versions v ON v.path = f.path AND v.version = f.current_version \
+                          WHERE (v.target = ?1 OR v.target = ?2 OR f.path = ?2) AND f.path != ?1;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, old_target.c_str(), -1, SQLITE_STATIC);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    linked_entry entry;
+    entry.path = (const char *)sqlite3_column_text(stmt, 0);
+    entry.type = sqlite3_column_int(stmt, 1);
+    entry.signed_copy = (sqlite3_column_int(stmt, 2) != 0);
+    entries.push_back(entry);
+  }
+  sqlite3_finalize(stmt);
+
+  int relinked = 0;
+  for (size_t i = 0; i < entries.size(); i ++) {
+    const char *entry_path = entries[i].path.c_str();
+    if (!same_inode(entry_path, st))
+      continue;
+
+    if (entries[i].signed_copy) {
+      // Its signatures still hold, only the mtime moved
+      sqlite3_prepare_v2(db, "UPDATE file_versions SET mtime = ? WHERE path = ? AND version = \
+                              (SELECT current_version FROM file_system WHERE path = ?);", -1, &stmt, 0);
+      sqlite3_bind_int64(stmt, 1, mtime_ns(st));
+      sqlite3_bind_text(stmt, 2, entry_path, -1, SQLITE_STATIC);
+      sqlite3_bind_text(stmt, 3, entry_path, -1, SQLITE_STATIC);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+      continue;
+    }
+    if (link_version(entry_path, path, static_cast<FileType>(entries[i].type)) == 0)
+      relinked ++;
+  }
+
+  if (relinked > 0) {
+    FILE_LOG(LOG_DEBUG) << "refresh_links: " << relinked << " links of " << path << " follow its new content" << endl;
+  }
+
+  link_pending(path);
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_LINK_H
+#define NDNFS_LINK_H
+
+#include "ndnfs.h"
+#include "file-type.h"
+
+/**
+ * Links: a hard link, or a symlink to a file inside the mount, gets a file_system entry
+ * whose version references the content of its target (file_versions.target) instead of
+ * signing it again. link_version copies the size, digest, segment size, mtime and hole
+ * ranges of the target's current version into a lazy version of the link (see publish.h),
+ * so ndnfs-server signs each segment under the name of the link when it is first requested.
+ * If the name of the link leaves no room for the segment size of the target (see
+ * max_content_size in signer.h), the link gets smaller segments, and its hole ranges are
+ * converted to them.
+ * A link thus costs two rows, whatever the size of the file; targets are always resolved
+ * to a file with content of its own, so links of links reference the same file.
+ *
+ * Content shared by hard links (or seen through symlinks) changes under every name at
+ * once: when one of them is published, refresh_links gives the others that still share
+ * its inode a version that references the new one. A symlink created before its target is
+ * published waits in pending_links, and is linked once the target gets a version (by a
+ * publish, a link or a rename). publish_file also turns files with
+ * more than one hard link into links to an entry of the same inode, so mirrors made of
+ * hard links outside of the mount are signed once as well.
+ */
+
+/**
+ * link_version makes a new version of path that references the current version of target.
+ * @return 0 on success, -ENOENT if target has no published content to reference
+ */
+int link_version(const char *path, const char *target, enum FileType type);
+
+/**
+ * resolve_symlink returns the path inside the mount that a symlink at path with the given
+ * content points to, or an empty string if it points outside of the mount. Absolute links
+ * reach the mount through the mount point or the actual folder.
+ */
+std::string resolve_symlink(const char *path, const char *link);
+
+/**
+ * add_pending_link records that the symlink at path is linked to target once target is
+ * published.
+ */
+void add_pending_link(const char *path, const char *target);
+
+/**
+ * link_pending links the pending symlinks whose target is path, or below path.
+ */
+void link_pending(const char *path);
+
+/**
+ * remove_pending_link forgets the pending symlink at path, if there's one.
+ */
+void remove_pending_link(const char *path);
+
+/**
+ * link_same_inode links path (of which st is the stat) to another entry of the same inode
+ * whose current version has the same size and mtime, if there's one.
+ * @return whether path was linked
+ */
+bool link_same_inode(const char *path, const struct stat &st);
+
+/**
+ * link_target returns the target of the current version of path, or an empty string if it
+ * has content of its own.
+ */
+std::string link_target(const char *path);
+
+/**
+ * refresh_links is called once path is published (st is the stat of the published content),
+ * with the target path was linked to before; see above.
+ */
+void refresh_links(const char *path, const std::string &old_target, const struct stat &st);
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "name.h"
+
+#include <cstring>
+
+ndn::Name build_file_name(const ndn::Name &prefix, const char *path)
+{
+  ndn::Name name(prefix);
+
+  const char *begin = path;
+  while (*begin != '\0') {
+    const char *end = strchr(begin, '/');
+    if (end == NULL)
+      end = begin + strlen(begin);
+    size_t length = end - begin;
+    size_t periods = 0;
+    while (periods < length && begin[periods] == '.')
+      periods ++;
+    // Empty components (leading or doubled '/'), "." and ".." are skipped, and three
+    // periods are dropped from longer components of only periods, as the URI parser does
+    if (periods == length && length >= 3)
+      name.append((const uint8_t *)begin + 3, length - 3);
+    else if (periods < length)
+      name.append((const uint8_t *)begin, length);
+    begin = (*end == '/') ? end + 1 : end;
+  }
+
+  return name;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_NAME_H
+#define NDNFS_NAME_H
+
+#include <ndn-cpp/name.hpp>
+
+/**
+ * build_file_name returns prefix followed by one component per component of path,
+ * taken as raw bytes, which is the name ndnfs-server parses back into path; it is the
+ * name that escaping path into a URI and parsing it again yields, at a much lower cost.
+ * Like the URI parser, it drops three periods from a component of only periods ("..."
+ * is the empty component, "...." is "."), and skips "." and "..": ndnfs-server turns
+ * components back into path with toEscapedString, which adds the three periods again.
+ * Signing computes it once per version, and appends only the segment number per segment.
+ */
+ndn::Name build_file_name(const ndn::Name &prefix, const char *path);
+
+#endif
@@ -30,6 +30,17 @@
 #include "directory.h"
 #include "file.h"
 #include "attribute.h"
+#include "publish.h"
+#include "sign-pool.h"
+#include "sha256.h"
+#include "signer.h"
+#include "scan.h"
+#include "watch.h"
+#include "rename.h"
+#include "dir-changes.h"
+#include "feed.h"
+#include "tree-digest.h"
+#include "schema.h"
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -145,16 +156,57 @@ ndn::ptr_lib::shared_ptr<ndn::KeyChain> ndnfs::keyChain;
 ndn::Name ndnfs::certificateName;
 string ndnfs::global_prefix = "/ndn/broadcast/ndnfs";
 string ndnfs::root_path;
+string ndnfs::mount_path;  // absolute symlinks through the mount point are resolved like those through root_path
 string ndnfs::logging_path = "";
 
-const int ndnfs::seg_size = 8192;  // size of the content in each content object segment counted in bytes
-const int ndnfs::seg_size_shift = 13;
+int ndnfs::seg_size = DEFAULT_SEG_SIZE;  // size of the content in each content object segment counted in bytes
+int ndnfs::max_seg_size = DEFAULT_SEG_SIZE;  // segments of large files may grow up to this size; each version records its own
+
+int ndnfs::publish_delay = 0;  // releases of the same file within this window (in ms) are signed once
+
+string ndnfs::reader = "pread";  // how the signing pass reads files: pread, mmap or uring
+int ndnfs::sign_threads = 1;  // with more than one, segments are signed on a pool of worker threads
+int ndnfs::signature_type = SIGNATURE_RSA;  // SIGNATURE_DIGEST signs segments with a SHA-256 digest only
+string ndnfs::signer_shm = "";  // shared memory ring for ndnfs-signer processes, none by default
+int ndnfs::scan_threads = 0;  // threads of the startup scan, one per core unless set; 0 disables the scan
+int ndnfs::watch_delay = 0;  // quiet period (in ms) before changes outside the mount are published; 0 disables watching
+int64_t ndnfs::lazy_sign_size = 0;  // files of at least this size are signed by ndnfs-server on request; 0 signs all at release
+
+vector<string> ndnfs::stream_dirs;  // files under these directories are published in streaming mode
 
 int ndnfs::user_id = 0;
 int ndnfs::group_id = 0;
 
+// Threads have to be started here, since fuse_main forks when not running in foreground
+static void *ndnfs_init(struct fuse_conn_info *conn)
+{
+  // open(O_TRUNC) comes to ndnfs_open with the flag, rather than as a truncate before it
+  if (conn->capable & FUSE_CAP_ATOMIC_O_TRUNC)
+    conn->want |= FUSE_CAP_ATOMIC_O_TRUNC;
+
+  start_sign_pool();
+  start_publisher();
+  start_resume();
+  start_scan();
+  start_watch();
+  start_resign();
+  return NULL;
+}
+
+static void ndnfs_destroy(void *private_data)
+{
+  stop_resign();
+  stop_watch();
+  stop_scan();
+  stop_resume();
+  stop_publisher();
+  stop_sign_pool();
+}
+
 static void create_fuse_operations(struct fuse_operations *fuse_op)
 {
+  fuse_op->init     = ndnfs_init;
+  fuse_op->destroy  = ndnfs_destroy;
   fuse_op->getattr  = ndnfs_getattr;
   fuse_op->chmod    = ndnfs_chmod;
   fuse_op->setxattr = ndnfs_setxattr;
@@ -162,6 +214,7 @@ static void create_fuse_operations(struct fuse_operations *fuse_op)
   fuse_op->read     = ndnfs_read;
   fuse_op->readdir  = ndnfs_readdir;
   fuse_op->mknod    = ndnfs_mknod;
+  fuse_op->create   = ndnfs_create;
   fuse_op->write    = ndnfs_write;
   fuse_op->truncate = ndnfs_truncate;
   fuse_op->release  = ndnfs_release;
@@ -183,6 +236,19 @@ struct ndnfs_config {
   char *prefix;
   char *log_path;
   char *db_path;
+  int publish_delay;
+  char *stream_dirs;
+  int seg_size;
+  int max_seg_size;
+  char *reader;
+  int sign_threads;
+  char *signature;
+  char *signer;
+  int scan_threads;
+  int noscan;
+  int watch;
+  int watch_delay;
+  int lazy_sign;
 };
 
 #define NDNFS_OPT(t, p, v) { t, offsetof(struct ndnfs_config, p), v }
@@ -191,6 +257,19 @@ static struct fuse_opt ndnfs_opts[] = {
   NDNFS_OPT("prefix=%s", prefix, 0),
   NDNFS_OPT("log=%s", log_path, 1),
   NDNFS_OPT("db=%s", db_path, 2),
+  NDNFS_OPT("publish_delay=%d", publish_delay, 3),
+  NDNFS_OPT("stream_dirs=%s", stream_dirs, 4),
+  NDNFS_OPT("seg_size=%d", seg_size, 5),
+  NDNFS_OPT("max_seg_size=%d", max_seg_size, 6),
+  NDNFS_OPT("reader=%s", reader, 7),
+  NDNFS_OPT("sign_threads=%d", sign_threads, 8),
+  NDNFS_OPT("signature=%s", signature, 9),
+  NDNFS_OPT("signer=%s", signer, 10),
+  NDNFS_OPT("scan_threads=%d", scan_threads, 11),
+  NDNFS_OPT("noscan", noscan, 1),
+  NDNFS_OPT("watch", watch, 1),
+  NDNFS_OPT("watch_delay=%d", watch_delay, 12),
+  NDNFS_OPT("lazy_sign=%d", lazy_sign, 13),
   FUSE_OPT_END
 };
 
@@ -202,7 +281,7 @@ void abs_path(char *dest, const char *path)
 
 void usage()
 {
-  cout << "Usage: ./ndnfs -s [actual folder directory (where files are stored in local file system)] [mount point directory] [-o prefix=\"prefix\"] [-o log=\"log file path\"] [-o db=\"database file path\"]" << endl;
+  cout << "Usage: ./ndnfs -s [actual folder directory (where files are stored in local file system)] [mount point directory] [-o prefix=\"prefix\"] [-o log=\"log file path\"] [-o db=\"database file path\"] [-o publish_delay=\"milliseconds\"] [-o stream_dirs=\"dir1:dir2\"] [-o seg_size=\"bytes\"] [-o max_seg_size=\"bytes\"] [-o reader=\"pread|mmap|uring\"] [-o sign_threads=\"number\"] [-o signature=\"rsa|digest\"] [-o signer=\"shared memory name\"] [-o scan_threads=\"number\"] [-o noscan] [-o watch] [-o watch_delay=\"milliseconds\"] [-o lazy_sign=\"KB\"]" << endl;
   return;
 }
 
@@ -219,14 +298,16 @@ int main(int argc, char **argv)
         (identityStorage, privateKeyStorage), ndn::ptr_lib::shared_ptr<ndn::NoVerifyPolicyManager>
           (new ndn::NoVerifyPolicyManager())));
   
-  ndn::Name keyName("/testname/DSK-123");
-  ndnfs::certificateName = keyName.getSubName(0, keyName.size() - 1).append("KEY").append
-         (keyName.get(keyName.size() - 1)).append("ID-CERT").append("0");
+  ndn::Name keyName(DEFAULT_KEY_NAME);
+  ndnfs::certificateName = certificate_name(keyName);
   identityStorage->addKey(keyName, ndn::KEY_TYPE_RSA, ndn::Blob(DEFAULT_RSA_PUBLIC_KEY_DER, sizeof(DEFAULT_RSA_PUBLIC_KEY_DER)));
   privateKeyStorage->setKeyPairForKeyName
     (keyName, ndn::KEY_TYPE_RSA, DEFAULT_RSA_PUBLIC_KEY_DER,
      sizeof(DEFAULT_RSA_PUBLIC_KEY_DER), DEFAULT_RSA_PRIVATE_KEY_DER,
      sizeof(DEFAULT_RSA_PRIVATE_KEY_DER));
+  // Segments are signed with the key parsed once, the KeyChain only signs if that fails
+  if (load_signer(DEFAULT_RSA_PRIVATE_KEY_DER, sizeof(DEFAULT_RSA_PRIVATE_KEY_DER), ndnfs::certificateName) != 0)
+    cerr << "Warning: cannot load the signing key, segments are signed through the KeyChain." << endl;
   
   cout << "NDNFS: version 0.3" << endl;
   
@@ -269,6 +350,21 @@ int main(int argc, char **argv)
   if (ndnfs::root_path.back() == '/') {
     ndnfs::root_path = ndnfs::root_path.substr(0, ndnfs::root_path.size() - 1);
   }
+
+  // The mount point is the first parameter left that is neither an option nor the value of -o
+  for (int j = 1; j < argc; j++) {
+    if (strcmp(argv[j], "-o") == 0) {
+      j++;
+      continue;
+    }
+    if (argv[j][0] != '-') {
+      char *mount_path = realpath(argv[j], NULL);
+      if (mount_path != NULL && strcmp(mount_path, "/") != 0)
+        ndnfs::mount_path = mount_path;
+      free(mount_path);
+      break;
+    }
+  }
   
   // uid and gid will be set to that of the user who starts the fuse process
   ndnfs::user_id = getuid();
@@ -288,6 +384,105 @@ int main(int argc, char **argv)
     db_name = conf.db_path;
   }
   
+  if (conf.publish_delay > 0) {
+    ndnfs::publish_delay = conf.publish_delay;
+    cout << "NDNFS: publish delay " << ndnfs::publish_delay << " ms" << endl;
+  }
+  
+  if (conf.stream_dirs != NULL) {
+    istringstream dirs(conf.stream_dirs);
+    string dir;
+    while (getline(dirs, dir, ':')) {
+      if (dir.size() > 1 && dir.back() == '/')
+        dir = dir.substr(0, dir.size() - 1);
+      if (!dir.empty()) {
+        ndnfs::stream_dirs.push_back(dir);
+        cout << "NDNFS: streaming directory " << dir << endl;
+      }
+    }
+  }
+  
+  if (conf.seg_size > 0) {
+    ndnfs::seg_size = conf.seg_size;
+  }
+  
+  if (conf.max_seg_size > ndnfs::seg_size) {
+    ndnfs::max_seg_size = conf.max_seg_size;
+  } else {
+    ndnfs::max_seg_size = ndnfs::seg_size;
+  }
+  
+  cout << "NDNFS: segment size " << ndnfs::seg_size;
+  if (ndnfs::max_seg_size > ndnfs::seg_size)
+    cout << ", up to " << ndnfs::max_seg_size << " for large files";
+  cout << endl;
+  
+  if (conf.reader != NULL) {
+    ndnfs::reader = conf.reader;
+#ifndef NDNFS_HAVE_LIBURING
+    if (ndnfs::reader == "uring")
+      cerr << "Warning: built without liburing, reading with pread instead." << endl;
+#endif
+  }
+  
+  if (conf.sign_threads > 0) {
+    ndnfs::sign_threads = conf.sign_threads;
+  }
+  
+  cout << "NDNFS: reader " << ndnfs::reader << ", " << ndnfs::sign_threads << " signing thread(s)" << endl;
+  
+  if (conf.signature != NULL) {
+    if (strcmp(conf.signature, "digest") == 0) {
+      ndnfs::signature_type = SIGNATURE_DIGEST;
+    } else if (strcmp(conf.signature, "rsa") != 0) {
+      cerr << "Unknown signature type " << conf.signature << ", signing with rsa instead." << endl;
+    }
+  }
+  
+  if (ndnfs::signature_type == SIGNATURE_DIGEST)
+    cout << "NDNFS: digest signatures, sha256 " << sha256_impl_name() << endl;
+  else
+    cout << "NDNFS: rsa signatures" << endl;
+  
+  // A segment has to fit in one Data packet; long paths leave less room still (see choose_seg_size)
+  int fitting = max_content_size(ndn::Name(ndnfs::global_prefix).appendVersion(version_now()),
+                                 ndnfs::signature_type == SIGNATURE_DIGEST);
+  if (ndnfs::max_seg_size > fitting) {
+    cerr << "Error: segments of " << ndnfs::max_seg_size << " bytes do not fit in one Data packet of "
+         << MAX_NDN_PACKET_SIZE << " bytes, the largest seg_size and max_seg_size is " << fitting << "." << endl;
+    return -1;
+  }
+  
+  if (conf.signer != NULL) {
+    // shm_open names start with a single slash
+    ndnfs::signer_shm = conf.signer;
+    if (ndnfs::signer_shm[0] != '/')
+      ndnfs::signer_shm = "/" + ndnfs::signer_shm;
+    cout << "NDNFS: signing with ndnfs-signer processes on " << ndnfs::signer_shm << endl;
+  }
+  
+  if (conf.lazy_sign > 0) {
+    ndnfs::lazy_sign_size = (int64_t)conf.lazy_sign * 1024;
+    cout << "NDNFS: files of " << conf.lazy_sign << " KB or more are signed lazily by ndnfs-server" << endl;
+  }
+  
+  if (conf.noscan) {
+    cout << "NDNFS: startup scan disabled" << endl;
+  } else {
+    ndnfs::scan_threads = (conf.scan_threads > 0) ? conf.scan_threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (ndnfs::scan_threads < 1)
+      ndnfs::scan_threads = 1;
+    cout << "NDNFS: startup scan with " << ndnfs::scan_threads << " thread(s)" << endl;
+  }
+  
+  if (conf.watch_delay > 0) {
+    ndnfs::watch_delay = conf.watch_delay;
+  } else if (conf.watch) {
+    ndnfs::watch_delay = 500;
+  }
+  if (ndnfs::watch_delay > 0)
+    cout << "NDNFS: watching the actual folder, publishing changes after " << ndnfs::watch_delay << " ms without events" << endl;
+  
   cout << "NDNFS: prefix " << ndnfs::global_prefix << endl;
   cout << "NDNFS: database file " << db_name << endl;
   
@@ -308,64 +503,26 @@ int main(int argc, char **argv)
 
   if (sqlite3_open(db_name, &db) == SQLITE_OK) {
     FILE_LOG(LOG_DEBUG) << "main: sqlite db open ok" << endl;
+    // ndnfs-signer processes write to the database as well
+    sqlite3_busy_timeout(db, 5000);
   } else {
     FILE_LOG(LOG_DEBUG) << "main: cannot connect to sqlite db, quit" << endl;
     sqlite3_close(db);
     return -1;
   }
   
-  // Init tables in database
-  const char* INIT_FS_TABLE = "\
-CREATE TABLE IF NOT EXISTS                        \n\
-  file_system(                                    \n\
-    path                 TEXT NOT NULL,           \n\
-    current_version      INTEGER,                 \n\
-    mime_type            TEXT,                    \n\
-    ready_signed         INTEGER,                 \n\
-    type                 INTEGER,                 \n\
-    PRIMARY KEY (path)                            \n\
-  );                                              \n\
-CREATE INDEX id_path ON file_system (path);       \n\
-CREATE INDEX id_parent ON file_system (parent);   \n\
-";
-
-  sqlite3_exec(db, INIT_FS_TABLE, NULL, NULL, NULL);
-  
-  // In our new implementation, we store the latest version of the file, and version history in database,
-  // and when opening with write permission, nothing is copied, and there's no notion of a temp_version while writing.
-  //
-  // TODO: figure out how multiple write access is handled by system calls.
-  const char* INIT_VER_TABLE = "\
-CREATE TABLE IF NOT EXISTS                                   \n\
-  file_versions(                                             \n\
-    path          TEXT NOT NULL,                             \n\
-    version       INTEGER,                                   \n\
-    size          INTEGER,                                   \n\
-    PRIMARY KEY (path, version)                              \n\
-  );                                                         \n\
-CREATE INDEX id_ver ON file_versions (path, version);        \n\
-";
-
-  sqlite3_exec(db, INIT_VER_TABLE, NULL, NULL, NULL);
-  
-  // Segment table still stores the version, and does not assume that the signature
-  // always belong to the latest version.
-  const char* INIT_SEG_TABLE = "\
-CREATE TABLE IF NOT EXISTS                                        \n\
-  file_segments(                                                  \n\
-    path        TEXT NOT NULL,                                    \n\
-    version     INTEGER,                                          \n\
-    segment     INTEGER,                                          \n\
-    signature   BLOB NOT NULL,                                    \n\
-    PRIMARY KEY (path, version, segment)                          \n\
-  );                                                              \n\
-CREATE INDEX id_seg ON file_segments (path, version, segment);    \n\
-";
-
-  sqlite3_exec(db, INIT_SEG_TABLE, NULL, NULL, NULL);
+  if (init_schema(db) != 0) {
+    FILE_LOG(LOG_DEBUG) << "main: cannot create the tables, quit" << endl;
+    sqlite3_close(db);
+    return -1;
+  }
+  prune_dir_changes();
+  prune_feed();
 
   FILE_LOG(LOG_DEBUG) << "main: table creation ok" << endl;
 
+  init_tree_digests();
+
   FILE_LOG(LOG_DEBUG) << "main: initializing file mime_type inference..." << endl;
   initialize_ext_mime_map();
 
@@ -31,10 +31,12 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <dirent.h>
 
 #include <time.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include <utime.h>
 
 #include <pthread.h>
@@ -51,21 +53,36 @@
 
 #include "config.h"
 #include "logger.h"
+#include "mtime.h"
 
 extern const char *db_name;
 extern sqlite3 *db;
 
+// Segment size of versions that do not record one
+#define DEFAULT_SEG_SIZE 8192
+
 namespace ndnfs {
     extern ndn::Name certificateName;
     extern ndn::ptr_lib::shared_ptr<ndn::KeyChain> keyChain;
     extern std::string global_prefix;
     extern std::string root_path;
+    extern std::string mount_path;
     extern std::string logging_path;
 
     extern const int version_type;
     extern const int segment_type;
-    extern const int seg_size;
-    extern const int seg_size_shift;
+    extern int seg_size;
+    extern int max_seg_size;
+
+    extern int publish_delay;
+    extern std::string reader;
+    extern int sign_threads;
+    extern int signature_type;
+    extern std::string signer_shm;
+    extern int scan_threads;
+    extern int watch_delay;
+    extern int64_t lazy_sign_size;
+    extern std::vector<std::string> stream_dirs;
 
     extern int user_id;
     extern int group_id;
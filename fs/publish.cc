@@ -0,0 +1,1063 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "publish.h"
+
+#include <map>
+#include <set>
+#include <vector>
+#include <atomic>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <openssl/sha.h>
+
+using namespace std;
+
+struct write_state {
+  int writers;
+  bool modified;
+};
+
+static map<string, write_state> write_states;
+static pthread_mutex_t write_states_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void begin_write(const char *path)
+{
+  pthread_mutex_lock(&write_states_lock);
+  write_states[path].writers ++;
+  pthread_mutex_unlock(&write_states_lock);
+}
+
+bool mark_modified(const char *path)
+{
+  // Without a writer, nothing would consume the entry; open(O_TRUNC) reaches ndnfs_open
+  // with the flag (FUSE_CAP_ATOMIC_O_TRUNC), so it does not truncate before the open
+  pthread_mutex_lock(&write_states_lock);
+  map<string, write_state>::iterator it = write_states.find(path);
+  bool open_for_write = (it != write_states.end() && it->second.writers > 0);
+  if (open_for_write)
+    it->second.modified = true;
+  pthread_mutex_unlock(&write_states_lock);
+
+  return open_for_write;
+}
+
+static void store_mtime(const char *path, int64_t mtime)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "UPDATE file_versions SET mtime = ? WHERE path = ? AND version = \
+                          (SELECT current_version FROM file_system WHERE path = ?);", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, mtime);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 3, path, -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+void touch_current_version(const char *path)
+{
+  char full_path[PATH_MAX];
+  abs_path(full_path, path);
+  struct stat st;
+  if (lstat(full_path, &st) == 0)
+    store_mtime(path, mtime_ns(st));
+}
+
+bool is_open_for_write(const string &path)
+{
+  pthread_mutex_lock(&write_states_lock);
+  map<string, write_state>::iterator it = write_states.find(path);
+  bool open_for_write = (it != write_states.end() && it->second.writers > 0);
+  pthread_mutex_unlock(&write_states_lock);
+
+  return open_for_write;
+}
+
+bool end_write(const char *path)
+{
+  bool modified = false;
+
+  pthread_mutex_lock(&write_states_lock);
+  map<string, write_state>::iterator it = write_states.find(path);
+  if (it != write_states.end()) {
+    modified = it->second.modified;
+    // The release publishes whatever is on disk at this point, so later writers
+    // only need to publish again if they modify the content after this.
+    it->second.modified = false;
+    if (it->second.writers > 0)
+      it->second.writers --;
+    if (it->second.writers == 0)
+      write_states.erase(it);
+  }
+  pthread_mutex_unlock(&write_states_lock);
+
+  return modified;
+}
+
+struct inflight_state {
+  int64_t version;
+  ndn::Name name;
+  int seg_size;
+  // Every write so far continued where the last one ended
+  bool sequential;
+  off_t next_offset;
+  // Segments [0, signed_segments) are signed, from the written buffers
+  int64_t signed_segments;
+  // Written bytes of segment signed_segments, while sequential
+  string partial;
+  // Signed segments that were overwritten afterwards
+  set<int64_t> dirty;
+  // Digest of bytes [0, next_offset), while sequential
+  SHA256_CTX ctx;
+};
+
+static map<string, inflight_state> inflight_states;
+static pthread_mutex_t inflight_states_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Size of the current version of path, or 0 if it has none
+static off_t current_size(const char *path)
+{
+  off_t size = 0;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT size FROM file_versions WHERE path = ? AND version = \
+                          (SELECT current_version FROM file_system WHERE path = ?);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    size = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  return size;
+}
+
+static void reset_inflight(inflight_state &state)
+{
+  state.sequential = true;
+  state.next_offset = 0;
+  state.signed_segments = 0;
+  state.partial.clear();
+  state.dirty.clear();
+  SHA256_Init(&state.ctx);
+}
+
+void inflight_write(const char *path, const char *buf, size_t size, off_t offset)
+{
+  pthread_mutex_lock(&inflight_states_lock);
+  map<string, inflight_state>::iterator it = inflight_states.find(path);
+  if (it == inflight_states.end()) {
+    // Only writers that start from the beginning are signed in flight
+    if (offset != 0) {
+      pthread_mutex_unlock(&inflight_states_lock);
+      return;
+    }
+    it = inflight_states.insert(make_pair(string(path), inflight_state())).first;
+    reset_inflight(it->second);
+    it->second.version = new_version(path);
+    it->second.name = version_name(path, it->second.version);
+    // The final size is not known yet; files are usually rewritten with a similar size
+    it->second.seg_size = choose_seg_size(current_size(path), it->second.name);
+  }
+  inflight_state &state = it->second;
+
+  if (!state.sequential || offset != state.next_offset) {
+    int64_t last = seek_segment(offset + size - 1, state.seg_size);
+    for (int64_t seg = seek_segment(offset, state.seg_size); seg <= last && seg < state.signed_segments; seg ++) {
+      state.dirty.insert(seg);
+    }
+    state.sequential = false;
+    state.partial.clear();
+    pthread_mutex_unlock(&inflight_states_lock);
+    return;
+  }
+
+  SHA256_Update(&state.ctx, buf, size);
+  state.next_offset += size;
+
+  const char *data = buf;
+  size_t left = size;
+
+  if (!state.partial.empty()) {
+    size_t take = min(left, (size_t)state.seg_size - state.partial.size());
+    state.partial.append(data, take);
+    data += take;
+    left -= take;
+    if (state.partial.size() == (size_t)state.seg_size) {
+      sign_segment(state.name, path, state.version, state.signed_segments, state.partial.data(), state.seg_size);
+      state.signed_segments ++;
+      state.partial.clear();
+    }
+  }
+
+  // Complete segments are signed directly from the caller's buffer
+  while (left >= (size_t)state.seg_size) {
+    sign_segment(state.name, path, state.version, state.signed_segments, data, state.seg_size);
+    state.signed_segments ++;
+    data += state.seg_size;
+    left -= state.seg_size;
+  }
+
+  if (left > 0)
+    state.partial.assign(data, left);
+
+  pthread_mutex_unlock(&inflight_states_lock);
+}
+
+void inflight_truncate(const char *path, off_t length)
+{
+  pthread_mutex_lock(&inflight_states_lock);
+  map<string, inflight_state>::iterator it = inflight_states.find(path);
+  if (it != inflight_states.end()) {
+    if (length == 0) {
+      // The whole file is going to be rewritten, e.g. open with O_TRUNC;
+      // segments are signed again under the same version.
+      reset_inflight(it->second);
+    } else {
+      int64_t complete = seek_segment(length, it->second.seg_size);
+      if (it->second.signed_segments > complete)
+        it->second.signed_segments = complete;
+      it->second.sequential = false;
+      it->second.partial.clear();
+    }
+  }
+  pthread_mutex_unlock(&inflight_states_lock);
+}
+
+static bool take_inflight(const char *path, inflight_state &state)
+{
+  pthread_mutex_lock(&inflight_states_lock);
+  map<string, inflight_state>::iterator it = inflight_states.find(path);
+  bool found = (it != inflight_states.end());
+  if (found) {
+    state = it->second;
+    inflight_states.erase(it);
+  }
+  pthread_mutex_unlock(&inflight_states_lock);
+  return found;
+}
+
+void discard_inflight(const char *path)
+{
+  inflight_state state;
+  if (take_inflight(path, state))
+    remove_segments(path, state.version);
+}
+
+// Returns the end of the run of segments (starting at seg) that lie entirely in a hole,
+// or seg if seg is not in a hole. next is a cursor into holes, for segments in increasing order.
+static int64_t hole_segments_end(const hole_list &holes, size_t &next, int64_t seg, int seg_size, off_t file_size)
+{
+  off_t begin = segment_to_size(seg, seg_size);
+  while (next < holes.size() && holes[next].second <= begin)
+    next ++;
+  if (next == holes.size() || holes[next].first > begin)
+    return seg;
+
+  // The last segment may be partial
+  if (holes[next].second >= file_size)
+    return (file_size + seg_size - 1) / seg_size;
+  return holes[next].second / seg_size;
+}
+
+bool is_lazy_size(off_t file_size)
+{
+  return ndnfs::lazy_sign_size > 0 && file_size >= ndnfs::lazy_sign_size;
+}
+
+// Paths that a publish or a resumed publish is working on; the two never run on
+// the same path at once
+struct path_state {
+  bool busy;
+  int waiting;
+};
+
+static map<string, path_state> busy_paths;
+// Directories being renamed; nothing below them is published meanwhile
+static set<string> busy_subtrees;
+static pthread_mutex_t busy_paths_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t busy_paths_cond = PTHREAD_COND_INITIALIZER;
+
+// Whether path is dir or below it
+static bool in_subtree(const string &path, const string &dir)
+{
+  if (dir == "/")
+    return true;
+  return path.compare(0, dir.size(), dir) == 0 && (path.size() == dir.size() || path[dir.size()] == '/');
+}
+
+// Called with busy_paths_lock held
+static bool in_busy_subtree(const string &path)
+{
+  for (set<string>::iterator it = busy_subtrees.begin(); it != busy_subtrees.end(); it ++) {
+    if (in_subtree(path, *it))
+      return true;
+  }
+  return false;
+}
+
+// Called with busy_paths_lock held; whether a path in the subtree of dir is busy, or
+// a subtree overlapping it
+static bool subtree_busy(const string &dir)
+{
+  for (map<string, path_state>::iterator it = busy_paths.begin(); it != busy_paths.end(); it ++) {
+    if (it->second.busy && in_subtree(it->first, dir))
+      return true;
+  }
+  for (set<string>::iterator it = busy_subtrees.begin(); it != busy_subtrees.end(); it ++) {
+    if (in_subtree(*it, dir) || in_subtree(dir, *it))
+      return true;
+  }
+  return false;
+}
+
+static void lock_path(const char *path)
+{
+  pthread_mutex_lock(&busy_paths_lock);
+  map<string, path_state>::iterator it = busy_paths.find(path);
+  if (it == busy_paths.end()) {
+    path_state state = {false, 0};
+    it = busy_paths.insert(make_pair(string(path), state)).first;
+  }
+  it->second.waiting ++;
+  while (it->second.busy || in_busy_subtree(it->first))
+    pthread_cond_wait(&busy_paths_cond, &busy_paths_lock);
+  it->second.waiting --;
+  it->second.busy = true;
+  pthread_mutex_unlock(&busy_paths_lock);
+}
+
+static void unlock_path(const char *path)
+{
+  pthread_mutex_lock(&busy_paths_lock);
+  map<string, path_state>::iterator it = busy_paths.find(path);
+  if (it != busy_paths.end()) {
+    it->second.busy = false;
+    if (it->second.waiting == 0)
+      busy_paths.erase(it);
+    // A subtree lock may be waiting for it too
+    pthread_cond_broadcast(&busy_paths_cond);
+  }
+  pthread_mutex_unlock(&busy_paths_lock);
+}
+
+static void lock_subtree(const char *dir)
+{
+  pthread_mutex_lock(&busy_paths_lock);
+  while (subtree_busy(dir))
+    pthread_cond_wait(&busy_paths_cond, &busy_paths_lock);
+  busy_subtrees.insert(dir);
+  pthread_mutex_unlock(&busy_paths_lock);
+}
+
+static void unlock_subtree(const char *dir)
+{
+  pthread_mutex_lock(&busy_paths_lock);
+  busy_subtrees.erase(dir);
+  pthread_cond_broadcast(&busy_paths_cond);
+  pthread_mutex_unlock(&busy_paths_lock);
+}
+
+// Whether a publish is waiting for path
+static bool path_wanted(const char *path)
+{
+  pthread_mutex_lock(&busy_paths_lock);
+  map<string, path_state>::iterator it = busy_paths.find(path);
+  bool wanted = (it != busy_paths.end() && it->second.waiting > 0);
+  pthread_mutex_unlock(&busy_paths_lock);
+  return wanted;
+}
+
+// Renames take two locks; one at a time, so that two of them can't wait for each other
+static pthread_mutex_t rename_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void lock_rename(const char *from, const char *to, bool is_dir)
+{
+  pthread_mutex_lock(&rename_lock);
+  if (!is_dir) {
+    lock_path(from);
+    if (strcmp(from, to) != 0)
+      lock_path(to);
+  } else if (in_subtree(to, from)) {
+    lock_subtree(from);
+  } else if (in_subtree(from, to)) {
+    lock_subtree(to);
+  } else {
+    lock_subtree(from);
+    lock_subtree(to);
+  }
+}
+
+bool unlock_rename(const char *from, const char *to, bool is_dir)
+{
+  bool wanted = false;
+  if (!is_dir) {
+    wanted = (strcmp(from, to) != 0 && path_wanted(from));
+    if (strcmp(from, to) != 0)
+      unlock_path(to);
+    unlock_path(from);
+  } else if (in_subtree(to, from)) {
+    unlock_subtree(from);
+  } else if (in_subtree(from, to)) {
+    unlock_subtree(to);
+  } else {
+    unlock_subtree(to);
+    unlock_subtree(from);
+  }
+  pthread_mutex_unlock(&rename_lock);
+  return wanted;
+}
+
+static int publish_locked(const char *path)
+{
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  char full_path[PATH_MAX];
+  abs_path(full_path, path);
+
+  inflight_state inflight;
+  bool has_inflight = take_inflight(path, inflight);
+
+  // Another version got published since in-flight signing started
+  if (has_inflight && inflight.version <= latest_version(path)) {
+    remove_segments(path, inflight.version);
+    has_inflight = false;
+  }
+
+  int fd = open(full_path, O_RDONLY);
+  if (fd == -1) {
+    FILE_LOG(LOG_ERROR) << "publish_file: open error. Errno: " << errno << endl;
+    if (has_inflight)
+      remove_segments(path, inflight.version);
+    return -errno;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    FILE_LOG(LOG_ERROR) << "publish_file: stat error. Errno: " << errno << endl;
+    close(fd);
+    if (has_inflight)
+      remove_segments(path, inflight.version);
+    return -errno;
+  }
+
+  // Another name of the same file may be published already; the version then references it
+  if (!has_inflight && link_same_inode(path, st)) {
+    close(fd);
+    return 0;
+  }
+  string old_target = link_target(path);
+
+  hole_list holes;
+  find_holes(fd, st.st_size, holes);
+
+  uint8_t digest[CONTENT_DIGEST_SIZE];
+  bool has_digest = false;
+
+  // For a sequential writer, the digest and the tail are already in memory
+  bool tail_in_memory = has_inflight && inflight.sequential && inflight.next_offset == st.st_size;
+  if (tail_in_memory && holes.empty()) {
+    SHA256_Final(digest, &inflight.ctx);
+    has_digest = true;
+  }
+
+  // If the size did not change, hashing the file is much cheaper than signing
+  // every segment of a version that has the same content as the current one.
+  bool same_size = false;
+  uint8_t curr_digest[CONTENT_DIGEST_SIZE];
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT size, content_digest FROM file_versions WHERE path = ? AND version = \
+                          (SELECT current_version FROM file_system WHERE path = ?);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+
+  if (sqlite3_step(stmt) == SQLITE_ROW &&
+      sqlite3_column_type(stmt, 0) != SQLITE_NULL &&
+      sqlite3_column_int64(stmt, 0) == st.st_size &&
+      sqlite3_column_bytes(stmt, 1) == CONTENT_DIGEST_SIZE) {
+    memcpy(curr_digest, sqlite3_column_blob(stmt, 1), CONTENT_DIGEST_SIZE);
+    same_size = true;
+  }
+  sqlite3_finalize(stmt);
+
+  bool lazy = is_lazy_size(st.st_size);
+
+  // Segments signed in flight and holes are skipped below, so the digest can't be computed along with signing;
+  // a lazy version is not read below at all, but hashing is still much cheaper than signing
+  if (!has_digest && (same_size || has_inflight || !holes.empty() || lazy)) {
+    int ret = compute_file_digest(fd, digest);
+    if (ret < 0) {
+      close(fd);
+      if (has_inflight)
+        remove_segments(path, inflight.version);
+      return ret;
+    }
+    has_digest = true;
+  }
+
+  if (same_size && memcmp(digest, curr_digest, CONTENT_DIGEST_SIZE) == 0) {
+    FILE_LOG(LOG_DEBUG) << "publish_file: content of " << path << " is unchanged, keeping current version" << endl;
+    close(fd);
+
+    // So that the next startup scan does not hash the file again
+    store_mtime(path, mtime_ns(st));
+
+    if (has_inflight)
+      remove_segments(path, inflight.version);
+    refresh_links(path, old_target, st);
+    return 0;
+  }
+
+  int64_t version = has_inflight ? inflight.version : new_version(path);
+  int seg_size = has_inflight ? inflight.seg_size : choose_seg_size(st.st_size, version_name(path, version));
+
+  // The new version is recorded at once
+  begin_transaction();
+
+  // Until the entry is removed below, a crash leaves the version to be resumed at the next mount
+  journal_begin(path, version);
+
+  // The version goes in before it's made current; the shared connection can't roll back only
+  // this transaction, so a failure undoes what's done so far, and the current version stays
+  sqlite3_prepare_v2(db, "INSERT INTO file_versions (path, version, size, seg_size, signature_type, mtime, lazy) VALUES (?,?,?,?,?,?,?);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  sqlite3_bind_int64(stmt, 3, st.st_size);
+  sqlite3_bind_int(stmt, 4, seg_size);
+  sqlite3_bind_int(stmt, 5, ndnfs::signature_type);
+  sqlite3_bind_int64(stmt, 6, mtime_ns(st));
+  sqlite3_bind_int(stmt, 7, lazy ? 1 : 0);
+  int res = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (res != SQLITE_DONE) {
+    FILE_LOG(LOG_ERROR) << "publish_file: insert file_versions error. " << sqlite3_errmsg(db) << endl;
+    journal_end(path, version);
+    end_transaction();
+    close(fd);
+    if (has_inflight)
+      remove_segments(path, version);
+    return -EIO;
+  }
+
+  sqlite3_prepare_v2(db, "UPDATE file_system SET current_version = ? WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, version);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+  res = sqlite3_step(stmt);
+  bool updated = (sqlite3_changes(db) > 0);
+  sqlite3_finalize(stmt);
+  if (res != SQLITE_DONE) {
+    FILE_LOG(LOG_ERROR) << "publish_file: update file_system error. " << sqlite3_errmsg(db) << endl;
+    sqlite3_prepare_v2(db, "DELETE FROM file_versions WHERE path = ? AND version = ?;", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, version);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    journal_end(path, version);
+    end_transaction();
+    close(fd);
+    if (has_inflight)
+      remove_segments(path, version);
+    return -EIO;
+  }
+  if (updated)
+    log_dir_change(path, DIR_CHANGE_MODIFIED);
+  end_transaction();
+
+  // The digest of the new content is computed along with signing, unless
+  // it's already computed above.
+  SHA256_CTX ctx;
+  SHA256_Init(&ctx);
+
+  segment_reader *reader = open_segment_reader(fd, st.st_size, seg_size);
+  sign_batch batch(path, version, seg_size);
+  int size = seg_size;
+  int64_t seg = 0;
+  int64_t signed_now = 0;
+  int64_t hole_segments = 0;
+  size_t next_hole = 0;
+
+  // ndnfs-server signs the segments of a lazy version when they are first requested;
+  // segments signed in flight are removed below along with the rest
+  if (lazy)
+    size = 0;
+
+  while (size == seg_size) {
+    if (has_inflight && seg < inflight.signed_segments && inflight.dirty.count(seg) == 0) {
+      // Signed while being written
+      seg ++;
+      continue;
+    }
+
+    int64_t hole_end = hole_segments_end(holes, next_hole, seg, seg_size, st.st_size);
+    if (hole_end > seg) {
+      // Nothing to read or hash, and the server signs these when they are requested
+      add_hole_segments(path, version, seg, hole_end);
+      hole_segments += hole_end - seg;
+      size = (segment_to_size(hole_end, seg_size) <= st.st_size) ? seg_size : 0;
+      seg = hole_end;
+      continue;
+    }
+
+    const char *data;
+    if (tail_in_memory && seg == inflight.signed_segments) {
+      size = inflight.partial.size();
+      data = inflight.partial.data();
+    } else {
+      size = reader->read_segment(seg, data);
+    }
+    if (size < 0) {
+      FILE_LOG(LOG_ERROR) << "publish_file: read error. Errno: " << -size << endl;
+      wait_batch(batch);
+      delete reader;
+      close(fd);
+      return size;
+    }
+    if (!has_digest)
+      SHA256_Update(&ctx, data, size);
+    queue_segment(batch, seg, data, size);
+    signed_now ++;
+    seg ++;
+
+    // Recorded as far as the pool got, without waiting for it
+    if (seg % JOURNAL_INTERVAL == 0)
+      journal_progress(path, version, signed_before(batch, seg));
+  }
+
+  wait_batch(batch);
+  delete reader;
+  close(fd);
+
+  // Left over from in-flight signing of a longer content
+  if (has_inflight)
+    remove_segments(path, version, seg);
+
+  if (!has_digest)
+    SHA256_Final(digest, &ctx);
+
+  begin_transaction();
+  sqlite3_prepare_v2(db, "UPDATE file_versions SET content_digest = ? WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_blob(stmt, 1, digest, CONTENT_DIGEST_SIZE, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 3, version);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  journal_end(path, version);
+  journal_supersede(path, version);
+  feed_append(path, version);
+  tree_entry_changed(path);
+  refresh_links(path, old_target, st);
+  end_transaction();
+
+  struct timeval stop;
+  gettimeofday(&stop, NULL);
+  int64_t elapsed_us = (int64_t)(stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+
+  FILE_LOG(LOG_DEBUG) << "publish_file: path=" << path << ", version=" << version << ", seg_size=" << seg_size << ", segments=" << seg
+                      << ", signed at release=" << signed_now << ", in holes=" << hole_segments << endl;
+  FILE_LOG(LOG_DEBUG) << "publish_file: timing: " << path << " " << st.st_size << " bytes in " << elapsed_us / 1000 << " ms, "
+                      << signed_now * 1000000.0 / max(elapsed_us, (int64_t)1) << " segments/s (reader " << ndnfs::reader
+                      << ", " << ndnfs::sign_threads << " signing threads, "
+                      << (ndnfs::signature_type == SIGNATURE_DIGEST ? "digest" : "rsa") << " signatures"
+                      << (lazy ? ", signed lazily" : "") << ")" << endl;
+  return 0;
+}
+
+int publish_file(const char *path)
+{
+  lock_path(path);
+  int ret = publish_locked(path);
+  unlock_path(path);
+  return ret;
+}
+
+static int resume_locked(const char *path, int64_t version, int64_t next_segment)
+{
+  off_t size = -1;
+  int seg_size = DEFAULT_SEG_SIZE;
+  bool lazy = false;
+  int64_t mtime = -1;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT size, seg_size, lazy, mtime FROM file_versions WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    size = sqlite3_column_int64(stmt, 0);
+    if (sqlite3_column_int(stmt, 1) > 0)
+      seg_size = sqlite3_column_int(stmt, 1);
+    lazy = (sqlite3_column_int(stmt, 2) != 0);
+    if (sqlite3_column_type(stmt, 3) != SQLITE_NULL)
+      mtime = sqlite3_column_int64(stmt, 3);
+  }
+  sqlite3_finalize(stmt);
+
+  bool current = false;
+  sqlite3_prepare_v2(db, "SELECT current_version FROM file_system WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    current = (sqlite3_column_int64(stmt, 0) == version);
+  sqlite3_finalize(stmt);
+
+  char full_path[PATH_MAX];
+  abs_path(full_path, path);
+  int fd = open(full_path, O_RDONLY);
+  struct stat st;
+  if (fd != -1 && fstat(fd, &st) == -1) {
+    close(fd);
+    fd = -1;
+  }
+
+  // A write of the same size leaves the size alone, but not the modification time
+  if (size < 0 || !current || fd == -1 || st.st_size != size || (mtime != -1 && mtime_ns(st) != mtime)) {
+    // The content the version was published with is gone
+    FILE_LOG(LOG_DEBUG) << "resume_publish: cannot finish " << path << " version " << version << ", removing it" << endl;
+    if (fd != -1)
+      close(fd);
+    if (current && fd != -1)
+      publish_locked(path);
+    remove_version(path, version);
+    journal_end(path, version);
+    return 0;
+  }
+
+  if (lazy) {
+    // Nothing to sign here, ndnfs-server signs its segments on request; the digest
+    // may not have been stored yet
+    uint8_t digest[CONTENT_DIGEST_SIZE];
+    if (compute_file_digest(fd, digest) == 0) {
+      sqlite3_prepare_v2(db, "UPDATE file_versions SET content_digest = ? WHERE path = ? AND version = ? AND content_digest IS NULL;", -1, &stmt, 0);
+      sqlite3_bind_blob(stmt, 1, digest, CONTENT_DIGEST_SIZE, SQLITE_STATIC);
+      sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+      sqlite3_bind_int64(stmt, 3, version);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+    }
+    close(fd);
+    journal_end(path, version);
+    feed_append(path, version);
+    tree_entry_changed(path);
+    return 0;
+  }
+
+  FILE_LOG(LOG_DEBUG) << "resume_publish: path=" << path << ", version=" << version << ", from segment " << next_segment << endl;
+
+  set<int64_t> signed_segments;
+  sqlite3_prepare_v2(db, "SELECT segment FROM file_segments WHERE path = ? AND version = ? AND segment >= ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  sqlite3_bind_int64(stmt, 3, next_segment);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    signed_segments.insert(sqlite3_column_int64(stmt, 0));
+  sqlite3_finalize(stmt);
+
+  hole_list holes;
+  find_holes(fd, size, holes);
+
+  segment_reader *reader = open_segment_reader(fd, size, seg_size);
+  sign_batch batch(path, version, seg_size);
+  int len = seg_size;
+  int64_t seg = next_segment;
+  int64_t signed_now = 0;
+  size_t next_hole = 0;
+  int ret = 0;
+
+  // Same segments as the loop of publish_file
+  while (len == seg_size) {
+    if (resume_stopping()) {
+      ret = -EINTR;
+      break;
+    }
+    if (is_open_for_write(path) || path_wanted(path)) {
+      // The content is changing; the next release publishes it as a new version
+      ret = -EBUSY;
+      break;
+    }
+
+    int64_t hole_end = hole_segments_end(holes, next_hole, seg, seg_size, size);
+    if (hole_end > seg) {
+      add_hole_segments(path, version, seg, hole_end);
+      len = (segment_to_size(hole_end, seg_size) <= size) ? seg_size : 0;
+      seg = hole_end;
+      continue;
+    }
+
+    if (signed_segments.count(seg) > 0) {
+      len = (segment_to_size(seg + 1, seg_size) <= size) ? seg_size : 0;
+      seg ++;
+      continue;
+    }
+
+    const char *data;
+    len = reader->read_segment(seg, data);
+    if (len < 0) {
+      FILE_LOG(LOG_ERROR) << "resume_publish: read error. Errno: " << -len << endl;
+      ret = len;
+      break;
+    }
+    queue_segment(batch, seg, data, len);
+    signed_now ++;
+    seg ++;
+
+    if (seg % JOURNAL_INTERVAL == 0)
+      journal_progress(path, version, signed_before(batch, seg));
+  }
+
+  wait_batch(batch);
+  delete reader;
+
+  if (ret == 0) {
+    uint8_t digest[CONTENT_DIGEST_SIZE];
+    ret = compute_file_digest(fd, digest);
+    if (ret == 0) {
+      sqlite3_prepare_v2(db, "UPDATE file_versions SET content_digest = ? WHERE path = ? AND version = ?;", -1, &stmt, 0);
+      sqlite3_bind_blob(stmt, 1, digest, CONTENT_DIGEST_SIZE, SQLITE_STATIC);
+      sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+      sqlite3_bind_int64(stmt, 3, version);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+      journal_end(path, version);
+      feed_append(path, version);
+      tree_entry_changed(path);
+    }
+  } else {
+    // Everything before seg is signed by now; picked up from there at the next mount
+    journal_progress(path, version, seg);
+  }
+  close(fd);
+
+  FILE_LOG(LOG_DEBUG) << "resume_publish: path=" << path << ", version=" << version << ", signed " << signed_now
+                      << " segments, " << (ret == 0 ? "done" : "interrupted") << endl;
+  return ret;
+}
+
+int resume_publish(const char *path, int64_t version, int64_t next_segment)
+{
+  lock_path(path);
+  int ret = resume_locked(path, version, next_segment);
+  unlock_path(path);
+  return ret;
+}
+
+struct path_batch {
+  const vector<string> *paths;
+  atomic<size_t> next;
+  atomic<int> published;
+};
+
+static void *publish_paths_worker(void *arg)
+{
+  path_batch *batch = (path_batch *)arg;
+  size_t i;
+  while ((i = batch->next ++) < batch->paths->size()) {
+    if (publish_file((*batch->paths)[i].c_str()) == 0)
+      batch->published ++;
+  }
+  return NULL;
+}
+
+int publish_paths(const vector<string> &paths, int threads)
+{
+  path_batch batch;
+  batch.paths = &paths;
+  batch.next = 0;
+  batch.published = 0;
+
+  vector<pthread_t> workers;
+  for (int i = 1; i < threads && (size_t)i < paths.size(); i ++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, publish_paths_worker, &batch) == 0)
+      workers.push_back(thread);
+  }
+  // The calling thread publishes too
+  publish_paths_worker(&batch);
+  for (size_t i = 0; i < workers.size(); i ++)
+    pthread_join(workers[i], NULL);
+
+  return batch.published;
+}
+
+// Pending publishes, keyed by path, with the deadline after which they are signed
+static map<string, struct timespec> pending_publishes;
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t publisher_thread;
+static bool publisher_running = false;
+
+static unsigned long publishes_requested = 0;
+static unsigned long publishes_saved = 0;
+
+static struct timespec deadline_after(int ms)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  struct timespec deadline;
+  deadline.tv_sec = now.tv_sec + ms / 1000;
+  deadline.tv_nsec = now.tv_usec * 1000 + (ms % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec ++;
+    deadline.tv_nsec -= 1000000000;
+  }
+  return deadline;
+}
+
+static bool before(const struct timespec &a, const struct timespec &b)
+{
+  return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+static void *publisher_loop(void *arg)
+{
+  pthread_mutex_lock(&pending_lock);
+  while (publisher_running) {
+    if (pending_publishes.empty()) {
+      pthread_cond_wait(&pending_cond, &pending_lock);
+      continue;
+    }
+
+    map<string, struct timespec>::iterator next = pending_publishes.begin();
+    for (map<string, struct timespec>::iterator it = pending_publishes.begin(); it != pending_publishes.end(); ++it) {
+      if (before(it->second, next->second))
+        next = it;
+    }
+
+    struct timespec now = deadline_after(0);
+    if (before(now, next->second)) {
+      struct timespec deadline = next->second;
+      pthread_cond_timedwait(&pending_cond, &pending_lock, &deadline);
+      continue;
+    }
+
+    string path = next->first;
+    if (is_open_for_write(path)) {
+      // Someone is still writing; wait for another window instead of signing a state
+      // that is about to change. If the writer does not modify the file, this publish still goes out.
+      next->second = deadline_after(ndnfs::publish_delay);
+      continue;
+    }
+    pending_publishes.erase(next);
+
+    pthread_mutex_unlock(&pending_lock);
+    publish_file(path.c_str());
+    pthread_mutex_lock(&pending_lock);
+  }
+  pthread_mutex_unlock(&pending_lock);
+
+  return NULL;
+}
+
+int schedule_publish(const char *path)
+{
+  pthread_mutex_lock(&pending_lock);
+  if (!publisher_running) {
+    pthread_mutex_unlock(&pending_lock);
+    return publish_file(path);
+  }
+
+  publishes_requested ++;
+  pair<map<string, struct timespec>::iterator, bool> inserted =
+    pending_publishes.insert(make_pair(string(path), deadline_after(ndnfs::publish_delay)));
+  if (!inserted.second) {
+    // Supersede the pending publish, and restart its window
+    inserted.first->second = deadline_after(ndnfs::publish_delay);
+    publishes_saved ++;
+    FILE_LOG(LOG_DEBUG) << "schedule_publish: superseded pending publish of " << path
+                        << ", saved " << publishes_saved << " of " << publishes_requested << " publishes" << endl;
+  }
+  pthread_cond_signal(&pending_cond);
+  pthread_mutex_unlock(&pending_lock);
+
+  return 0;
+}
+
+void cancel_publish(const char *path)
+{
+  pthread_mutex_lock(&pending_lock);
+  if (pending_publishes.erase(path) > 0)
+    publishes_saved ++;
+  pthread_mutex_unlock(&pending_lock);
+}
+
+bool is_publish_pending(const char *path)
+{
+  pthread_mutex_lock(&pending_lock);
+  bool pending = (pending_publishes.count(path) > 0);
+  pthread_mutex_unlock(&pending_lock);
+  return pending;
+}
+
+void rename_publish(const char *from, const char *to)
+{
+  string from_path(from);
+  string from_dir = from_path + "/";
+  pthread_mutex_lock(&pending_lock);
+  // from itself, then the paths below it, which sort between "from/" and "from0"
+  map<string, struct timespec>::iterator it = pending_publishes.lower_bound(from_path);
+  while (it != pending_publishes.end() && it->first < from_path + "0") {
+    if (it->first != from_path && it->first.compare(0, from_dir.size(), from_dir) != 0) {
+      ++ it;
+      continue;
+    }
+    string moved = to + it->first.substr(from_path.size());
+    struct timespec deadline = it->second;
+    pending_publishes.erase(it ++);
+    pending_publishes[moved] = deadline;
+  }
+  pthread_mutex_unlock(&pending_lock);
+}
+
+void start_publisher()
+{
+  if (ndnfs::publish_delay <= 0)
+    return;
+
+  pthread_mutex_lock(&pending_lock);
+  publisher_running = true;
+  pthread_mutex_unlock(&pending_lock);
+
+  if (pthread_create(&publisher_thread, NULL, publisher_loop, NULL) != 0) {
+    FILE_LOG(LOG_ERROR) << "start_publisher: cannot create publisher thread, publishing synchronously" << endl;
+    publisher_running = false;
+    return;
+  }
+  FILE_LOG(LOG_DEBUG) << "start_publisher: publish delay " << ndnfs::publish_delay << " ms" << endl;
+}
+
+void stop_publisher()
+{
+  pthread_mutex_lock(&pending_lock);
+  if (!publisher_running) {
+    pthread_mutex_unlock(&pending_lock);
+    return;
+  }
+  publisher_running = false;
+  pthread_cond_signal(&pending_cond);
+  pthread_mutex_unlock(&pending_lock);
+
+  pthread_join(publisher_thread, NULL);
+
+  // Flush everything that's still waiting for its window
+  for (map<string, struct timespec>::iterator it = pending_publishes.begin(); it != pending_publishes.end(); ++it) {
+    publish_file(it->first.c_str());
+  }
+  pending_publishes.clear();
+
+  FILE_LOG(LOG_DEBUG) << "stop_publisher: debouncing saved " << publishes_saved << " of "
+                      << publishes_requested << " publishes" << endl;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_PUBLISH_H
+#define NDNFS_PUBLISH_H
+
+#include "ndnfs.h"
+#include "segment.h"
+#include "version.h"
+#include "reader.h"
+#include "sign-pool.h"
+#include "journal.h"
+#include "link.h"
+#include "dir-changes.h"
+#include "feed.h"
+#include "tree-digest.h"
+#include "content-digest.h"
+#include "transaction.h"
+
+/**
+ * Write tracking: ndnfs_open registers a writer for the path, and ndnfs_write,
+ * ndnfs_truncate and ndnfs_utimens mark the path as modified. ndnfs_release
+ * only publishes a new version if something marked the path in between.
+ * ndnfs_create marks the file it creates, so that it's published even if
+ * nothing is written to it.
+ *
+ * Paths are used as keys (instead of fuse_file_info) because truncate and
+ * utimens do not come with a file handle.
+ */
+void begin_write(const char *path);
+
+/**
+ * mark_modified marks path as modified for the release of its writers, and returns false
+ * without recording anything if path is not open for write: ndnfs_truncate then publishes
+ * on its own, and ndnfs_utimens calls touch_current_version.
+ */
+bool mark_modified(const char *path);
+
+/**
+ * touch_current_version records the modification time of path with its current version,
+ * after a change of its times alone, so that the content is not taken as changed later.
+ */
+void touch_current_version(const char *path);
+
+bool is_open_for_write(const std::string &path);
+
+/**
+ * end_write drops one writer of the path, and returns whether the content was
+ * (possibly) modified since the writer was registered.
+ */
+bool end_write(const char *path);
+
+/**
+ * In-flight signing: a writer that starts at offset 0 and keeps writing sequentially
+ * gets each segment signed as soon as it's complete, from the written buffer, under
+ * the version the next publish of the path is going to use. publish_file then only
+ * signs the tail, and the segments that were overwritten after being signed.
+ */
+void inflight_write(const char *path, const char *buf, size_t size, off_t offset);
+
+void inflight_truncate(const char *path, off_t length);
+
+/**
+ * discard_inflight drops the in-flight state of path, along with what it signed.
+ */
+void discard_inflight(const char *path);
+
+/**
+ * Lazy signing: with ndnfs::lazy_sign_size > 0, publish_file only records the version
+ * of files of at least that many bytes (file_versions.lazy), with its content digest,
+ * which is much cheaper to compute than the signatures; ndnfs-server signs each
+ * segment of such a version when it's first requested, and stores the signature.
+ * Smaller files are signed at release as usual.
+ */
+bool is_lazy_size(off_t file_size);
+
+/**
+ * publish_file creates a new version of path and signs all its segments.
+ * If the content digest equals the digest of the current version, the
+ * current version is kept and nothing is signed.
+ * @return 0 on success (or when skipped), -errno on failure
+ */
+int publish_file(const char *path);
+
+/**
+ * resume_publish signs the segments of version (the current version of path) that
+ * a crash left unsigned, starting at next_segment; see journal.h.
+ * @return 0 when done (or when the version can't be finished and is removed),
+ *         -EINTR if stopped at unmount, -EBUSY if the file is being written or published,
+ *         -errno on failure
+ */
+int resume_publish(const char *path, int64_t version, int64_t next_segment);
+
+/**
+ * Publish debouncing: with ndnfs::publish_delay > 0, schedule_publish only records
+ * the path with a deadline; a release within the window supersedes the pending
+ * publish, and the publisher thread signs the final state once the window passes.
+ * With publish_delay == 0, schedule_publish publishes synchronously.
+ */
+int schedule_publish(const char *path);
+
+void cancel_publish(const char *path);
+
+bool is_publish_pending(const char *path);
+
+/**
+ * lock_rename keeps publishes and resumed publishes of from and to (of every path below
+ * them, for a directory) from running until unlock_rename, and waits for the ones that
+ * are running, so that none writes rows under a name that a rename moves.
+ * @return (unlock_rename) whether a publish of the file from was waiting for the rename;
+ *         it finds from gone, so to has to be published instead
+ */
+void lock_rename(const char *from, const char *to, bool is_dir);
+
+bool unlock_rename(const char *from, const char *to, bool is_dir);
+
+/**
+ * rename_publish moves the pending publishes of from, and of the paths below it, to to.
+ */
+void rename_publish(const char *from, const char *to);
+
+/**
+ * publish_paths publishes each of paths with publish_file, on up to threads threads,
+ * and returns the number of paths published without error.
+ */
+int publish_paths(const std::vector<std::string> &paths, int threads);
+
+/**
+ * The publisher thread has to be started after fuse_main forks (in fuse init),
+ * stop_publisher flushes all pending publishes before returning.
+ */
+void start_publisher();
+
+void stop_publisher();
+
+#endif
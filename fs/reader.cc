@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "reader.h"
+
+#include <vector>
+#include <sys/mman.h>
+#ifdef NDNFS_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+using namespace std;
+
+class pread_reader : public segment_reader {
+public:
+  pread_reader(int fd, int seg_size)
+    : fd_(fd), seg_size_(seg_size), buf_(seg_size)
+  {
+  }
+
+  virtual int read_segment(int64_t seg, const char *&data)
+  {
+    int size = pread(fd_, &buf_[0], seg_size_, segment_to_size(seg, seg_size_));
+    if (size == -1)
+      return -errno;
+    data = &buf_[0];
+    return size;
+  }
+
+private:
+  int fd_;
+  int seg_size_;
+  vector<char> buf_;
+};
+
+class mmap_reader : public segment_reader {
+public:
+  mmap_reader(const char *map, off_t file_size, int seg_size)
+    : map_(map), file_size_(file_size), seg_size_(seg_size)
+  {
+  }
+
+  virtual ~mmap_reader()
+  {
+    if (map_ != NULL)
+      munmap((void *)map_, file_size_);
+  }
+
+  virtual int read_segment(int64_t seg, const char *&data)
+  {
+    off_t begin = segment_to_size(seg, seg_size_);
+    if (begin >= file_size_) {
+      data = map_;
+      return 0;
+    }
+    data = map_ + begin;
+    return (int)min((off_t)seg_size_, file_size_ - begin);
+  }
+
+  static segment_reader *open(int fd, off_t file_size, int seg_size)
+  {
+    // Nothing to map; an empty file has just the one empty segment
+    if (file_size == 0)
+      return new mmap_reader(NULL, 0, seg_size);
+
+    void *map = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+      FILE_LOG(LOG_ERROR) << "mmap_reader: mmap error. Errno: " << errno << endl;
+      return NULL;
+    }
+    madvise(map, file_size, MADV_SEQUENTIAL);
+    return new mmap_reader((const char *)map, file_size, seg_size);
+  }
+
+private:
+  const char *map_;
+  off_t file_size_;
+  int seg_size_;
+};
+
+#ifdef NDNFS_HAVE_LIBURING
+class uring_reader : public segment_reader {
+public:
+  virtual ~uring_reader()
+  {
+    if (depth_ == 0)
+      return;
+    // Reads still in flight write into the registered buffers
+    while (inflight_ > 0 && reap() == 0);
+    io_uring_unregister_buffers(&ring_);
+    io_uring_queue_exit(&ring_);
+  }
+
+  virtual int read_segment(int64_t seg, const char *&data)
+  {
+    // The slot handed out by the previous call can be reused now
+    if (returned_ >= 0) {
+      slot_seg_[returned_] = -1;
+      returned_ = -1;
+    }
+
+    if (seg > seek_segment(file_size_, seg_size_)) {
+      data = &buffers_[0];
+      return 0;
+    }
+
+    // Not read ahead: segments were skipped (or requested out of order)
+    if (find_slot(seg) < 0)
+      next_submit_ = seg;
+
+    int slot;
+    while (true) {
+      release_skipped(seg);
+      fill();
+      slot = find_slot(seg);
+      if (slot >= 0)
+        break;
+      // Every slot holds a skipped segment that's still being read
+      if (inflight_ == 0)
+        return -EIO;
+      int ret = reap();
+      if (ret < 0)
+        return ret;
+    }
+
+    while (slot_res_[slot] == PENDING) {
+      int ret = reap();
+      if (ret < 0)
+        return ret;
+    }
+
+    if (slot_res_[slot] < 0)
+      return slot_res_[slot];
+    data = &buffers_[(size_t)slot * seg_size_];
+    returned_ = slot;
+    return slot_res_[slot];
+  }
+
+  static segment_reader *open(int fd, off_t file_size, int seg_size)
+  {
+    uring_reader *reader = new uring_reader(fd, file_size, seg_size);
+    int ret = io_uring_queue_init(reader->depth_, &reader->ring_, 0);
+    if (ret < 0) {
+      FILE_LOG(LOG_ERROR) << "uring_reader: io_uring_queue_init error. Errno: " << -ret << endl;
+      reader->depth_ = 0;
+      delete reader;
+      return NULL;
+    }
+
+    vector<struct iovec> iovecs(reader->depth_);
+    for (int i = 0; i < reader->depth_; i ++) {
+      iovecs[i].iov_base = &reader->buffers_[(size_t)i * seg_size];
+      iovecs[i].iov_len = seg_size;
+    }
+    ret = io_uring_register_buffers(&reader->ring_, &iovecs[0], reader->depth_);
+    if (ret < 0) {
+      FILE_LOG(LOG_ERROR) << "uring_reader: io_uring_register_buffers error. Errno: " << -ret << endl;
+      io_uring_queue_exit(&reader->ring_);
+      reader->depth_ = 0;
+      delete reader;
+      return NULL;
+    }
+    return reader;
+  }
+
+private:
+  static const int PENDING = -0x7fffffff;
+
+  uring_reader(int fd, off_t file_size, int seg_size)
+    : fd_(fd), file_size_(file_size), seg_size_(seg_size), depth_(READER_QUEUE_DEPTH),
+      buffers_((size_t)READER_QUEUE_DEPTH * seg_size), slot_seg_(READER_QUEUE_DEPTH, -1),
+      slot_res_(READER_QUEUE_DEPTH, 0), next_submit_(0), returned_(-1), inflight_(0)
+  {
+  }
+
+  void release_skipped(int64_t seg)
+  {
+    for (int i = 0; i < depth_; i ++) {
+      if (slot_seg_[i] >= 0 && slot_seg_[i] < seg && slot_res_[i] != PENDING)
+        slot_seg_[i] = -1;
+    }
+  }
+
+  int find_slot(int64_t seg)
+  {
+    for (int i = 0; i < depth_; i ++) {
+      if (slot_seg_[i] == seg)
+        return i;
+    }
+    return -1;
+  }
+
+  // Queues reads of the following segments into every free slot, up to the one
+  // that starts at the end of the file.
+  void fill()
+  {
+    int queued = 0;
+    for (int i = 0; i < depth_ && next_submit_ <= seek_segment(file_size_, seg_size_); i ++) {
+      if (slot_seg_[i] >= 0)
+        continue;
+      struct io_uring_sqe *sqe = io_uring_get_sqe(&ring_);
+      if (sqe == NULL)
+        break;
+      io_uring_prep_read_fixed(sqe, fd_, &buffers_[(size_t)i * seg_size_], seg_size_,
+                               segment_to_size(next_submit_, seg_size_), i);
+      io_uring_sqe_set_data(sqe, (void *)(intptr_t)i);
+      slot_seg_[i] = next_submit_ ++;
+      slot_res_[i] = PENDING;
+      queued ++;
+    }
+    if (queued > 0) {
+      io_uring_submit(&ring_);
+      inflight_ += queued;
+    }
+  }
+
+  int reap()
+  {
+    struct io_uring_cqe *cqe;
+    int ret = io_uring_wait_cqe(&ring_, &cqe);
+    if (ret < 0)
+      return ret;
+    int slot = (int)(intptr_t)io_uring_cqe_get_data(cqe);
+    slot_res_[slot] = cqe->res;
+    io_uring_cqe_seen(&ring_, cqe);
+    inflight_ --;
+    return 0;
+  }
+
+  struct io_uring ring_;
+  int fd_;
+  off_t file_size_;
+  int seg_size_;
+  int depth_;
+  vector<char> buffers_;
+  // Segment read into each slot (-1 if the slot is free), and the result of the read
+  vector<int64_t> slot_seg_;
+  vector<int> slot_res_;
+  int64_t next_submit_;
+  int returned_;
+  int inflight_;
+};
+#endif
+
+segment_reader *open_segment_reader(int fd, off_t file_size, int seg_size)
+{
+  segment_reader *reader = NULL;
+
+  if (ndnfs::reader == "mmap") {
+    reader = mmap_reader::open(fd, file_size, seg_size);
+  }
+#ifdef NDNFS_HAVE_LIBURING
+  else if (ndnfs::reader == "uring") {
+    reader = uring_reader::open(fd, file_size, seg_size);
+  }
+#endif
+
+  if (reader == NULL)
+    reader = new pread_reader(fd, seg_size);
+  return reader;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_READER_H
+#define NDNFS_READER_H
+
+#include "ndnfs.h"
+#include "segment.h"
+
+/**
+ * A segment reader hands the content of a file out segment by segment to the signing
+ * pass of publish_file. Segments are requested in increasing order (some may be
+ * skipped), and the returned data stays valid until the next call.
+ *
+ * ndnfs::reader selects the implementation:
+ *  - "pread": one pread per segment, into a single buffer (default);
+ *  - "mmap": the whole file is mapped with MADV_SEQUENTIAL, no syscall per segment;
+ *  - "uring": io_uring with registered buffers, keeping up to READER_QUEUE_DEPTH
+ *    segment reads in flight (only if ndnfs is built with liburing).
+ */
+class segment_reader {
+public:
+  virtual ~segment_reader() {}
+
+  /**
+   * read_segment points data at the content of segment seg.
+   * @return the length of the segment (less than seg_size at the end of the file),
+   *         -errno on read error
+   */
+  virtual int read_segment(int64_t seg, const char *&data) = 0;
+};
+
+#define READER_QUEUE_DEPTH 64
+
+/**
+ * open_segment_reader returns the reader selected by ndnfs::reader for fd, falling
+ * back to pread if it can't be set up. The caller deletes it; fd is not closed.
+ */
+segment_reader *open_segment_reader(int fd, off_t file_size, int seg_size);
+
+#endif
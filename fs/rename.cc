@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "rename.h"
+#include "publish.h"
+#include "transaction.h"
+#include "link.h"
+
+#include <set>
+#include <map>
+#include <sys/stat.h>
+
+using namespace std;
+
+struct renamed_version {
+  string old_path;
+  string path;
+  int64_t version;
+};
+
+static pthread_t resign_thread;
+static bool resign_running = false;
+static volatile bool resign_stop = false;
+// Set by rename_entries, so that the resign thread looks at renamed_versions again
+static bool resign_pending = false;
+static pthread_mutex_t resign_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resign_cond = PTHREAD_COND_INITIALIZER;
+
+// Selects from and everything below it, with from, "from/" and "from0" bound to ?1, ?2 and ?3
+#define SUBTREE "path >= ?1 AND path < ?3 AND (path = ?1 OR path > ?2)"
+// The path below to (bound to ?4) that a path below from moves to
+#define MOVED_PATH "?4 || substr(path, length(?1) + 1)"
+
+static void bind_subtree(sqlite3_stmt *stmt, const string &from, const string &to)
+{
+  sqlite3_bind_text(stmt, 1, from.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(stmt, 2, (from + "/").c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(stmt, 3, (from + "0").c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(stmt, 4, to.c_str(), -1, SQLITE_TRANSIENT);
+}
+
+static void run_subtree(const string &sql, const string &from, const string &to)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
+  bind_subtree(stmt, from, to);
+  int res = sqlite3_step(stmt);
+  if (res != SQLITE_DONE) {
+    FILE_LOG(LOG_ERROR) << "rename_entries: " << sqlite3_errmsg(db) << ". " << sql << endl;
+  }
+  sqlite3_finalize(stmt);
+}
+
+static void move_rows(const char *table, const string &from, const string &to)
+{
+  // A stale row under the target is replaced, like the target of rename(2)
+  run_subtree(string("UPDATE OR REPLACE ") + table + " SET path = " MOVED_PATH " WHERE " SUBTREE ";", from, to);
+}
+
+// Drops the versions of a target that rename replaces, with their segments, and the old
+// names that were served from its content
+static void remove_target(const char *to)
+{
+  vector<int64_t> versions;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT version FROM file_versions WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    versions.push_back(sqlite3_column_int64(stmt, 0));
+  sqlite3_finalize(stmt);
+  for (size_t i = 0; i < versions.size(); i++)
+    remove_version(to, versions[i]);
+
+  vector<renamed_version> old_names;
+  sqlite3_prepare_v2(db, "SELECT old_path, version FROM renamed_versions WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    renamed_version entry;
+    entry.old_path = (const char *)sqlite3_column_text(stmt, 0);
+    entry.path = to;
+    entry.version = sqlite3_column_int64(stmt, 1);
+    old_names.push_back(entry);
+  }
+  sqlite3_finalize(stmt);
+  for (size_t i = 0; i < old_names.size(); i++)
+    remove_segments(old_names[i].old_path.c_str(), old_names[i].version);
+
+  const char *sql[] = {"DELETE FROM renamed_versions WHERE path = ?;",
+                       "DELETE FROM file_holes WHERE path = ?;",
+                       "DELETE FROM publish_journal WHERE path = ?;"};
+  for (size_t i = 0; i < sizeof(sql) / sizeof(sql[0]); i++) {
+    sqlite3_prepare_v2(db, sql[i], -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
+
+  if (!versions.empty() || !old_names.empty()) {
+    FILE_LOG(LOG_DEBUG) << "remove_target: " << to << ", " << versions.size() << " versions, "
+                        << old_names.size() << " old names" << endl;
+  }
+}
+
+void rename_entries(const char *from, const char *to)
+{
+  string from_path(from);
+  string to_path(to);
+  string to_parent, to_name;
+  split_last_component(to_path, to_parent, to_name);
+  if (from_path == to_path)
+    return;
+
+  // Readers of the database see the rename as a whole
+  begin_transaction();
+
+  remove_target(to);
+  remove_pending_link(to);
+
+  // Versions that were still waiting to be signed under from now wait for the new name;
+  // a path moved back to an old name of its version has its signatures already
+  move_rows("renamed_versions", from_path, to_path);
+  sqlite3_exec(db, "DELETE FROM renamed_versions WHERE old_path = path;", NULL, NULL, NULL);
+
+  // Every published version keeps its segments under the old name, not only the current one
+  run_subtree("INSERT OR REPLACE INTO renamed_versions (old_path, path, version) \
+               SELECT path, " MOVED_PATH ", version FROM file_versions \
+               WHERE " SUBTREE ";", from_path, to_path);
+
+  // The entry is summed up again under its new parent below; a replaced target is dropped from its parent
+  tree_entry_removed(to);
+  tree_entry_removed(from);
+
+  // Feed consumers drop the replaced target and the old names
+  feed_remove(to);
+  run_subtree("INSERT INTO publish_feed (path, version, removed) \
+               SELECT path, current_version, 1 FROM file_system \
+               WHERE " SUBTREE " AND current_version IS NOT NULL;", from_path, to_path);
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "UPDATE OR REPLACE file_system SET path = " MOVED_PATH ", \
+                          parent = CASE WHEN path = ?1 THEN ?5 ELSE ?4 || substr(parent, length(?1) + 1) END \
+                          WHERE " SUBTREE ";", -1, &stmt, 0);
+  bind_subtree(stmt, from_path, to_path);
+  sqlite3_bind_text(stmt, 5, to_parent.c_str(), -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) != SQLITE_DONE) {
+    FILE_LOG(LOG_ERROR) << "rename_entries: update file_system error. " << sqlite3_errmsg(db) << endl;
+  }
+  int moved = sqlite3_changes(db);
+  sqlite3_finalize(stmt);
+  if (moved > 0) {
+    log_dir_change(from, DIR_CHANGE_REMOVED);
+    log_dir_change(to, DIR_CHANGE_ADDED);
+  }
+
+  // Segments stay under the old name, which they are signed with
+  move_rows("file_versions", from_path, to_path);
+  move_rows("file_holes", from_path, to_path);
+  move_rows("publish_journal", from_path, to_path);
+  move_rows("tree_buckets", from_path, to_path);
+  // Links reference their target by path
+  run_subtree("UPDATE file_versions SET target = ?4 || substr(target, length(?1) + 1) \
+               WHERE target >= ?1 AND target < ?3 AND (target = ?1 OR target > ?2);", from_path, to_path);
+  move_rows("pending_links", from_path, to_path);
+  run_subtree("UPDATE pending_links SET target = ?4 || substr(target, length(?1) + 1) \
+               WHERE target >= ?1 AND target < ?3 AND (target = ?1 OR target > ?2);", from_path, to_path);
+  // With its versions in place, for the digest of a file
+  tree_entry_changed(to);
+
+  // The current versions under the new names are served from here on (signed on request until resigned)
+  run_subtree("INSERT INTO publish_feed (path, version, size) \
+               SELECT path, version, size FROM file_versions \
+               WHERE " SUBTREE " AND version = (SELECT current_version FROM file_system f WHERE f.path = file_versions.path);",
+              to_path, to_path);
+
+  // Symlinks waiting for the new names, like a file written aside and renamed into place
+  link_pending(to);
+
+  end_transaction();
+
+  FILE_LOG(LOG_DEBUG) << "rename_entries: " << from << " -> " << to << ", " << moved << " entries" << endl;
+
+  pthread_mutex_lock(&resign_lock);
+  resign_pending = true;
+  pthread_cond_signal(&resign_cond);
+  pthread_mutex_unlock(&resign_lock);
+}
+
+// Removes the old name of entry, unless entry moved again in between
+static void drop_old_name(const renamed_version &entry)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "DELETE FROM renamed_versions WHERE old_path = ? AND version = ? AND path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, entry.old_path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, entry.version);
+  sqlite3_bind_text(stmt, 3, entry.path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  if (sqlite3_changes(db) > 0)
+    remove_segments(entry.old_path.c_str(), entry.version);
+}
+
+/**
+ * resign_version signs the segments of entry.version under entry.path that do not have
+ * a signature yet (ndnfs-server may have signed some on request), then drops the old name.
+ * @return 0 when done, -EINTR if stopped at unmount, -EBUSY if the file is being written,
+ *         -errno on failure
+ */
+static int resign_version(const renamed_version &entry)
+{
+  const char *path = entry.path.c_str();
+  int64_t version = entry.version;
+  off_t size = -1;
+  int seg_size = DEFAULT_SEG_SIZE;
+  bool lazy = false;
+  int64_t mtime = -1;
+  bool current = false;
+  int signature_type = SIGNATURE_RSA;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT v.size, v.seg_size, v.lazy, v.mtime, f.current_version, v.signature_type FROM file_versions v \
+                          JOIN file_system f ON f.path = v.path WHERE v.path = ? AND v.version = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    if (sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+      size = sqlite3_column_int64(stmt, 0);
+    if (sqlite3_column_int(stmt, 1) > 0)
+      seg_size = sqlite3_column_int(stmt, 1);
+    lazy = (sqlite3_column_int(stmt, 2) != 0);
+    if (sqlite3_column_type(stmt, 3) != SQLITE_NULL)
+      mtime = sqlite3_column_int64(stmt, 3);
+    current = (sqlite3_column_int64(stmt, 4) == version);
+    if (sqlite3_column_type(stmt, 5) != SQLITE_NULL)
+      signature_type = sqlite3_column_int(stmt, 5);
+  }
+  sqlite3_finalize(stmt);
+
+  char full_path[PATH_MAX];
+  abs_path(full_path, path);
+  int fd = open(full_path, O_RDONLY);
+  struct stat st;
+  if (fd != -1 && fstat(fd, &st) == -1) {
+    close(fd);
+    fd = -1;
+  }
+
+  if (size < 0 || !current || fd == -1 || st.st_size != size || (mtime != -1 && mtime_ns(st) != mtime)) {
+    // The content the version was published with is gone, and with it what the old name served
+    FILE_LOG(LOG_DEBUG) << "resign_version: " << path << " changed since version " << version
+                        << " was published, dropping " << entry.old_path << endl;
+    if (fd != -1)
+      close(fd);
+    drop_old_name(entry);
+    return 0;
+  }
+
+  if (!seg_size_fits(seg_size, version_name(path, version), signature_type)) {
+    // Segments of seg_size bytes do not fit in a packet under the longer name; the content
+    // is published again under it, with a segment size that fits
+    FILE_LOG(LOG_DEBUG) << "resign_version: segments of " << seg_size << " bytes do not fit under " << path
+                        << ", dropping " << entry.old_path << " and publishing again" << endl;
+    close(fd);
+    drop_old_name(entry);
+    remove_version(path, version);
+    schedule_publish(path);
+    return 0;
+  }
+
+  if (lazy) {
+    // ndnfs-server signs the segments under the new name on request
+    close(fd);
+    drop_old_name(entry);
+    return 0;
+  }
+
+  if (is_open_for_write(entry.path)) {
+    close(fd);
+    return -EBUSY;
+  }
+
+  set<int64_t> signed_segments;
+  sqlite3_prepare_v2(db, "SELECT segment FROM file_segments WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    signed_segments.insert(sqlite3_column_int64(stmt, 0));
+  sqlite3_finalize(stmt);
+
+  // Hole ranges moved with the version; the server signs those segments under any name
+  map<int64_t, int64_t> holes;
+  sqlite3_prepare_v2(db, "SELECT start_segment, end_segment FROM file_holes WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    holes[sqlite3_column_int64(stmt, 0)] = sqlite3_column_int64(stmt, 1);
+  sqlite3_finalize(stmt);
+
+  FILE_LOG(LOG_DEBUG) << "resign_version: " << entry.old_path << " -> " << path << ", version=" << version << endl;
+
+  segment_reader *reader = open_segment_reader(fd, size, seg_size);
+  sign_batch batch(path, version, seg_size);
+  map<int64_t, int64_t>::const_iterator hole = holes.begin();
+  int len = seg_size;
+  int64_t seg = 0;
+  int64_t signed_now = 0;
+  int ret = 0;
+
+  // Same segments as the loop of publish_file
+  while (len == seg_size) {
+    if (resign_stop) {
+      ret = -EINTR;
+      break;
+    }
+    if (is_open_for_write(entry.path)) {
+      ret = -EBUSY;
+      break;
+    }
+
+    while (hole != holes.end() && hole->second <= seg)
+      ++ hole;
+    if (hole != holes.end() && hole->first <= seg) {
+      seg = hole->second;
+      len = (segment_to_size(seg, seg_size) <= size) ? seg_size : 0;
+      continue;
+    }
+
+    if (signed_segments.count(seg) > 0) {
+      len = (segment_to_size(seg + 1, seg_size) <= size) ? seg_size : 0;
+      seg ++;
+      continue;
+    }
+
+    const char *data;
+    len = reader->read_segment(seg, data);
+    if (len < 0) {
+      FILE_LOG(LOG_ERROR) << "resign_version: read error. Errno: " << -len << endl;
+      ret = len;
+      break;
+    }
+    queue_segment(batch, seg, data, len);
+    signed_now ++;
+    seg ++;
+  }
+
+  wait_batch(batch);
+  delete reader;
+  close(fd);
+
+  FILE_LOG(LOG_DEBUG) << "resign_version: path=" << path << ", version=" << version << ", signed " << signed_now
+                      << " segments" << (ret == 0 ? "" : ", stopped") << endl;
+
+  // What was signed is kept, and skipped when the version is picked up again
+  if (ret == 0)
+    drop_old_name(entry);
+  return ret;
+}
+
+static void *resign_worker(void *arg)
+{
+  while (!resign_stop) {
+    vector<renamed_version> entries;
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db, "SELECT old_path, path, version FROM renamed_versions;", -1, &stmt, 0);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      renamed_version entry;
+      entry.old_path = (const char *)sqlite3_column_text(stmt, 0);
+      entry.path = (const char *)sqlite3_column_text(stmt, 1);
+      entry.version = sqlite3_column_int64(stmt, 2);
+      entries.push_back(entry);
+    }
+    sqlite3_finalize(stmt);
+
+    bool busy = false;
+    for (size_t i = 0; i < entries.size() && !resign_stop; i ++) {
+      int ret = resign_version(entries[i]);
+      if (ret == -EBUSY)
+        busy = true;
+    }
+
+    pthread_mutex_lock(&resign_lock);
+    if (!resign_pending && !resign_stop) {
+      if (busy) {
+        // Files being written are tried again after a while
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += RESIGN_RETRY_MS / 1000;
+        deadline.tv_nsec += (RESIGN_RETRY_MS % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+          deadline.tv_sec ++;
+          deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&resign_cond, &resign_lock, &deadline);
+      } else {
+        pthread_cond_wait(&resign_cond, &resign_lock);
+      }
+    }
+    resign_pending = false;
+    pthread_mutex_unlock(&resign_lock);
+  }
+  return NULL;
+}
+
+void start_resign()
+{
+  resign_stop = false;
+  if (pthread_create(&resign_thread, NULL, resign_worker, NULL) != 0) {
+    FILE_LOG(LOG_ERROR) << "start_resign: pthread_create error. Errno: " << errno << endl;
+    return;
+  }
+  resign_running = true;
+}
+
+void stop_resign()
+{
+  if (!resign_running)
+    return;
+
+  pthread_mutex_lock(&resign_lock);
+  resign_stop = true;
+  pthread_cond_signal(&resign_cond);
+  pthread_mutex_unlock(&resign_lock);
+
+  pthread_join(resign_thread, NULL);
+  resign_running = false;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_RENAME_H
+#define NDNFS_RENAME_H
+
+#include "ndnfs.h"
+
+/**
+ * Rename: file_system keeps the parent directory of each entry (file_system.parent), and
+ * rename_entries moves a path together with everything below it: the rows of from and of
+ * its descendants ("from/..." sorts between "from/" and "from0") are rewritten with one
+ * range UPDATE per table, instead of one statement per file.
+ *
+ * Signatures cover the name, so the segments of the moved versions stay signed under the
+ * old names: renamed_versions maps each old name (and version) to the path that now holds
+ * its content, and ndnfs-server keeps serving the old name from there. The resign thread
+ * signs those versions under the new name in the background, keeping the version number,
+ * and drops the old segments and the mapping once done. Until then, ndnfs-server signs
+ * segments of the new name on request, as for lazily signed versions.
+ *
+ * All published versions are recorded, so that older versions stay servable under the old
+ * name too; only the current version is signed again, the segments of the others are
+ * dropped with their old name. A version whose content changed in the meantime is not
+ * signed again either; the publish at release creates a new version under the new name.
+ * Nor is a version whose segment size does not fit in a packet under the longer new name
+ * (see max_content_size in signer.h): its old name is dropped, and the content is published
+ * again under the new name, with a segment size that fits.
+ *
+ * A replaced target loses its versions and segments, as with unlink. The rename runs in
+ * one transaction, so ndnfs-server never sees it half done.
+ */
+#define RESIGN_RETRY_MS 1000
+
+void rename_entries(const char *from, const char *to);
+
+/**
+ * Like the publisher thread, the resign thread has to be started after fuse_main forks.
+ * Versions left in renamed_versions by an unmount are signed after the next mount.
+ */
+void start_resign();
+
+void stop_resign();
+
+#endif
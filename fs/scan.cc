@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "scan.h"
+#include "publish.h"
+#include "stream.h"
+#include "file-type.h"
+#include "transaction.h"
+
+#include <map>
+#include <set>
+#include <deque>
+#include <atomic>
+#include <algorithm>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Progress is logged every this many published files
+#define SCAN_PROGRESS_INTERVAL 1000
+// Removals of missing entries are committed this many at a time
+#define SCAN_COMMIT_INTERVAL 1000
+
+struct scan_entry {
+  int type;
+  int64_t size;   // -1 if the current version has no size
+  int64_t mtime;  // -1 if the current version has no mtime
+  bool seen;
+};
+
+struct scan_job {
+  string path;
+  int64_t size;
+};
+
+// Loaded before walking; walkers only set seen (each path is walked once), so both are read without locking
+static map<string, scan_entry> entries;
+static set<string> journaled;
+
+static deque<string> dirs;  // relative to root_path, "" is the root
+static int walking = 0;     // directories being walked
+static deque<scan_job> jobs;
+static bool walk_done = false;
+static pthread_mutex_t scan_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dirs_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_t scan_thread;
+static bool scan_running = false;
+static volatile bool scan_stop = false;
+// Threads of each pass, set when the scan starts
+static int scan_threads = 0;
+// A pass is running, and another one is wanted after it; guarded by scan_lock
+static bool scan_active = false;
+static bool scan_again = false;
+
+static atomic<int64_t> dirs_walked(0);
+static atomic<int64_t> files_seen(0);
+static atomic<int64_t> files_queued(0);
+static atomic<int64_t> bytes_queued(0);
+static atomic<int64_t> files_published(0);
+static atomic<int64_t> bytes_published(0);
+static atomic<int64_t> publish_errors(0);
+
+static void load_entries()
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT f.path, f.type, v.size, v.mtime FROM file_system f LEFT JOIN file_versions v \
+                          ON v.path = f.path AND v.version = f.current_version;", -1, &stmt, 0);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    scan_entry &entry = entries[(const char *)sqlite3_column_text(stmt, 0)];
+    entry.type = sqlite3_column_int(stmt, 1);
+    entry.size = (sqlite3_column_type(stmt, 2) == SQLITE_NULL) ? -1 : sqlite3_column_int64(stmt, 2);
+    entry.mtime = (sqlite3_column_type(stmt, 3) == SQLITE_NULL) ? -1 : sqlite3_column_int64(stmt, 3);
+    entry.seen = false;
+  }
+  sqlite3_finalize(stmt);
+
+  sqlite3_prepare_v2(db, "SELECT DISTINCT path FROM publish_journal;", -1, &stmt, 0);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    journaled.insert((const char *)sqlite3_column_text(stmt, 0));
+  sqlite3_finalize(stmt);
+}
+
+static void walk_dir(const string &dir)
+{
+  char full_path[PATH_MAX];
+  abs_path(full_path, dir.c_str());
+
+  DIR *dp = opendir(full_path);
+  if (dp == NULL) {
+    FILE_LOG(LOG_ERROR) << "walk_dir: opendir error. Errno: " << errno << endl;
+    return;
+  }
+
+  // Entries are added once the directory is read, in one transaction, and only then walked or published
+  vector<pair<string, FileType> > added;
+  vector<string> subdirs;
+  vector<scan_job> scanned;
+
+  struct dirent *de;
+  while (!scan_stop && (de = readdir(dp)) != NULL) {
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+      continue;
+
+    struct stat st;
+    if (fstatat(dirfd(dp), de->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+      continue;
+
+    string path = dir + "/" + de->d_name;
+    if (S_ISDIR(st.st_mode)) {
+      map<string, scan_entry>::iterator it = entries.find(path);
+      if (it != entries.end())
+        it->second.seen = true;
+      else
+        added.push_back(make_pair(path, DIRECTORY));
+      subdirs.push_back(path);
+      continue;
+    }
+
+    files_seen ++;
+    map<string, scan_entry>::iterator it = entries.find(path);
+    bool is_new = (it == entries.end());
+    if (!is_new) {
+      it->second.seen = true;
+      if (it->second.type != REGULAR)
+        continue;
+      if (it->second.size == st.st_size && it->second.mtime == mtime_ns(st))
+        continue;
+    }
+    if (!S_ISREG(st.st_mode) || journaled.count(path) > 0)
+      continue;
+    if (is_new)
+      added.push_back(make_pair(path, REGULAR));
+
+    scan_job job;
+    job.path = path;
+    job.size = st.st_size;
+    scanned.push_back(job);
+
+    files_queued ++;
+    bytes_queued += st.st_size;
+  }
+
+  closedir(dp);
+
+  if (!added.empty()) {
+    begin_transaction();
+    for (size_t i = 0; i < added.size(); i ++)
+      add_file_entry(added[i].first.c_str(), added[i].second);
+    end_transaction();
+  }
+
+  pthread_mutex_lock(&scan_lock);
+  dirs.insert(dirs.end(), subdirs.begin(), subdirs.end());
+  jobs.insert(jobs.end(), scanned.begin(), scanned.end());
+  pthread_cond_broadcast(&dirs_cond);
+  pthread_cond_broadcast(&jobs_cond);
+  pthread_mutex_unlock(&scan_lock);
+}
+
+static void *walk_worker(void *arg)
+{
+  pthread_mutex_lock(&scan_lock);
+  while (true) {
+    while (dirs.empty() && walking > 0 && !scan_stop)
+      pthread_cond_wait(&dirs_cond, &scan_lock);
+    // Nothing left to walk, and nobody walking who could add more
+    if (dirs.empty() || scan_stop)
+      break;
+
+    string dir = dirs.front();
+    dirs.pop_front();
+    walking ++;
+    pthread_mutex_unlock(&scan_lock);
+
+    walk_dir(dir);
+    dirs_walked ++;
+
+    pthread_mutex_lock(&scan_lock);
+    walking --;
+    if (walking == 0 && dirs.empty())
+      pthread_cond_broadcast(&dirs_cond);
+  }
+  pthread_mutex_unlock(&scan_lock);
+  return NULL;
+}
+
+static void publish_scanned(const scan_job &job)
+{
+  const char *path = job.path.c_str();
+
+  // Written through the mount since the walk; the release publishes it
+  if (is_open_for_write(job.path) || is_streaming(path))
+    return;
+
+  if (publish_file(path) < 0) {
+    publish_errors ++;
+    return;
+  }
+
+  bytes_published += job.size;
+  int64_t published = ++ files_published;
+  if (published % SCAN_PROGRESS_INTERVAL == 0) {
+    FILE_LOG(LOG_DEBUG) << "publish_scanned: published " << published << " of " << files_queued << " files ("
+                        << bytes_published / 1000000 << " of " << bytes_queued / 1000000 << " MB)" << endl;
+  }
+}
+
+static void *publish_worker(void *arg)
+{
+  while (true) {
+    pthread_mutex_lock(&scan_lock);
+    while (jobs.empty() && !walk_done && !scan_stop)
+      pthread_cond_wait(&jobs_cond, &scan_lock);
+    if (jobs.empty() || scan_stop) {
+      pthread_mutex_unlock(&scan_lock);
+      break;
+    }
+    scan_job job = jobs.front();
+    jobs.pop_front();
+    pthread_mutex_unlock(&scan_lock);
+
+    publish_scanned(job);
+  }
+  return NULL;
+}
+
+static void remove_missing()
+{
+  vector<string> gone;
+  for (map<string, scan_entry>::iterator it = entries.begin(); it != entries.end() && !scan_stop; it ++) {
+    if (it->second.seen)
+      continue;
+
+    // Not seen could also mean its directory couldn't be read
+    char full_path[PATH_MAX];
+    abs_path(full_path, it->first.c_str());
+    struct stat st;
+    if (lstat(full_path, &st) == 0 || errno != ENOENT || is_open_for_write(it->first))
+      continue;
+
+    FILE_LOG(LOG_DEBUG) << "remove_missing: " << it->first << " is gone, removing its entry" << endl;
+    gone.push_back(it->first);
+  }
+
+  for (size_t i = 0; i < gone.size(); i += SCAN_COMMIT_INTERVAL) {
+    begin_transaction();
+    for (size_t j = i; j < gone.size() && j < i + SCAN_COMMIT_INTERVAL; j ++)
+      remove_file_entry(gone[j].c_str());
+    end_transaction();
+  }
+
+  if (!gone.empty()) {
+    FILE_LOG(LOG_DEBUG) << "remove_missing: removed " << gone.size() << " entries" << endl;
+  }
+}
+
+static void scan_pass()
+{
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  dirs_walked = 0;
+  files_seen = 0;
+  files_queued = 0;
+  bytes_queued = 0;
+  files_published = 0;
+  bytes_published = 0;
+  publish_errors = 0;
+  walk_done = false;
+
+  load_entries();
+  dirs.push_back("");
+
+  vector<pthread_t> walkers;
+  vector<pthread_t> publishers;
+  for (int i = 0; i < scan_threads; i ++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, walk_worker, NULL) == 0)
+      walkers.push_back(thread);
+    if (pthread_create(&thread, NULL, publish_worker, NULL) == 0)
+      publishers.push_back(thread);
+  }
+  if (walkers.empty() || publishers.empty()) {
+    FILE_LOG(LOG_ERROR) << "scan_worker: pthread_create error. Errno: " << errno << endl;
+  }
+
+  for (size_t i = 0; i < walkers.size(); i ++)
+    pthread_join(walkers[i], NULL);
+
+  pthread_mutex_lock(&scan_lock);
+  walk_done = true;
+  pthread_cond_broadcast(&jobs_cond);
+  pthread_mutex_unlock(&scan_lock);
+
+  FILE_LOG(LOG_DEBUG) << "scan_worker: walked " << dirs_walked << " directories, " << files_seen << " files, "
+                      << files_queued << " new or changed (" << bytes_queued / 1000000 << " MB)" << endl;
+
+  if (!walkers.empty() && !scan_stop)
+    remove_missing();
+
+  for (size_t i = 0; i < publishers.size(); i ++)
+    pthread_join(publishers[i], NULL);
+
+  struct timeval stop;
+  gettimeofday(&stop, NULL);
+  int64_t elapsed_us = (int64_t)(stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+
+  FILE_LOG(LOG_DEBUG) << "scan_worker: published " << files_published << " of " << files_queued << " files, "
+                      << publish_errors << " errors, in " << elapsed_us / 1000 << " ms, "
+                      << bytes_published * 1.0 / max(elapsed_us, (int64_t)1) << " MB/s ("
+                      << scan_threads << " scan threads)" << endl;
+
+  entries.clear();
+  journaled.clear();
+  dirs.clear();
+  jobs.clear();
+}
+
+static void *scan_worker(void *arg)
+{
+  while (true) {
+    scan_pass();
+
+    pthread_mutex_lock(&scan_lock);
+    bool again = scan_again && !scan_stop;
+    scan_again = false;
+    if (!again)
+      scan_active = false;
+    pthread_mutex_unlock(&scan_lock);
+    if (!again)
+      break;
+    FILE_LOG(LOG_DEBUG) << "scan_worker: scanning again" << endl;
+  }
+  return NULL;
+}
+
+static void launch_scan(int threads)
+{
+  scan_threads = threads;
+  scan_stop = false;
+  scan_active = true;
+  if (pthread_create(&scan_thread, NULL, scan_worker, NULL) != 0) {
+    FILE_LOG(LOG_ERROR) << "launch_scan: pthread_create error. Errno: " << errno << endl;
+    scan_active = false;
+    return;
+  }
+  scan_running = true;
+}
+
+void start_scan()
+{
+  if (ndnfs::scan_threads <= 0)
+    return;
+
+  launch_scan(ndnfs::scan_threads);
+}
+
+void rescan()
+{
+  pthread_mutex_lock(&scan_lock);
+  if (scan_active) {
+    // Picked up by the running scan once its pass is over
+    scan_again = true;
+    pthread_mutex_unlock(&scan_lock);
+    return;
+  }
+  pthread_mutex_unlock(&scan_lock);
+
+  // The previous scan is over, or there was none
+  if (scan_running) {
+    pthread_join(scan_thread, NULL);
+    scan_running = false;
+  }
+  // Without the startup scan, one thread per core as it would have had
+  launch_scan(ndnfs::scan_threads > 0 ? ndnfs::scan_threads : max(1, (int)sysconf(_SC_NPROCESSORS_ONLN)));
+}
+
+void stop_scan()
+{
+  if (!scan_running)
+    return;
+
+  pthread_mutex_lock(&scan_lock);
+  scan_stop = true;
+  pthread_cond_broadcast(&dirs_cond);
+  pthread_cond_broadcast(&jobs_cond);
+  pthread_mutex_unlock(&scan_lock);
+
+  pthread_join(scan_thread, NULL);
+  scan_running = false;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_SCAN_H
+#define NDNFS_SCAN_H
+
+#include "ndnfs.h"
+
+/**
+ * Startup scan: files put into the actual folder while ndnfs was not mounted are
+ * published in the background after the mount comes up. The scan walks root_path on
+ * ndnfs::scan_threads threads and compares each regular file with the current version
+ * of its path: a file without an entry, or whose size or mtime differs from the ones
+ * recorded with the version, is queued, and the same number of threads publish the
+ * queue with publish_file (which still keeps the version if only the mtime changed).
+ * Entries whose file is gone are removed.
+ *
+ * The threads share the connection of ndnfs, so its writes are batched in transactions
+ * (see transaction.h): the new entries of a directory are added at once, before its
+ * files are queued, and removals are committed SCAN_COMMIT_INTERVAL at a time.
+ *
+ * Files with an incomplete publish are left to the resume thread (see journal.h), and
+ * files that are open for writing are left to their release.
+ */
+void start_scan();
+
+/**
+ * stop_scan stops walking and publishing, and waits for the publishes in progress.
+ * The files left are found again by the scan at the next mount.
+ */
+void stop_scan();
+
+/**
+ * rescan runs the scan again, even with the startup scan disabled, to catch up with changes
+ * missed in the actual folder (see watch.h). While a scan is running, it scans once more
+ * after it; rescan and stop_scan are not called at once.
+ */
+void rescan();
+
+#endif
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string>
+#include <sstream>
+
+#include "schema.h"
+#include "file-type.h"
+#include "logger.h"
+
+using namespace std;
+
+// Directories have entries too (type DIRECTORY, without versions), and every entry but the root
+// records its parent, so that listings are index range scans.
+// tree_digest, tree_sum, tree_version and tree_bucket are kept by tree-digest.h.
+static const char *FS_TABLE = "\
+CREATE TABLE IF NOT EXISTS                        \n\
+  file_system(                                    \n\
+    path                 TEXT NOT NULL,           \n\
+    current_version      INTEGER,                 \n\
+    mime_type            TEXT,                    \n\
+    ready_signed         INTEGER,                 \n\
+    type                 INTEGER,                 \n\
+    streaming            INTEGER,                 \n\
+    parent               TEXT,                    \n\
+    tree_digest          BLOB,                    \n\
+    tree_sum             BLOB,                    \n\
+    tree_version         INTEGER,                 \n\
+    tree_bucket          INTEGER,                 \n\
+    PRIMARY KEY (path)                            \n\
+  );";
+
+// In our new implementation, we store the latest version of the file, and version history in database,
+// and when opening with write permission, nothing is copied, and there's no notion of a temp_version while writing.
+//
+// TODO: figure out how multiple write access is handled by system calls.
+static const char *VER_TABLE = "\
+CREATE TABLE IF NOT EXISTS                                   \n\
+  file_versions(                                             \n\
+    path          TEXT NOT NULL,                             \n\
+    version       INTEGER,                                   \n\
+    size          INTEGER,                                   \n\
+    content_digest BLOB,                                     \n\
+    seg_size      INTEGER,                                   \n\
+    signature_type INTEGER,                                  \n\
+    mtime         INTEGER,                                   \n\
+    lazy          INTEGER,                                   \n\
+    target        TEXT,                                      \n\
+    PRIMARY KEY (path, version)                              \n\
+  );";
+
+// Segment table still stores the version, and does not assume that the signature
+// always belong to the latest version.
+static const char *SEG_TABLE = "\
+CREATE TABLE IF NOT EXISTS                                        \n\
+  file_segments(                                                  \n\
+    path        TEXT NOT NULL,                                    \n\
+    version     INTEGER,                                          \n\
+    segment     INTEGER,                                          \n\
+    signature   BLOB NOT NULL,                                    \n\
+    PRIMARY KEY (path, version, segment)                          \n\
+  );";
+
+// Runs of all-zero segments in holes of sparse files are not signed one by one;
+// only the range is stored, and ndnfs-server signs them when they are requested.
+static const char *HOLE_TABLE = "\
+CREATE TABLE IF NOT EXISTS                                        \n\
+  file_holes(                                                     \n\
+    path          TEXT NOT NULL,                                  \n\
+    version       INTEGER,                                        \n\
+    start_segment INTEGER,                                        \n\
+    end_segment   INTEGER,                                        \n\
+    PRIMARY KEY (path, version, start_segment)                    \n\
+  );";
+
+// Versions whose segments are not all signed yet, see journal.h
+static const char *JOURNAL_TABLE = "\
+CREATE TABLE IF NOT EXISTS                                        \n\
+  publish_journal(                                                \n\
+    path          TEXT NOT NULL,                                  \n\
+    version       INTEGER,                                        \n\
+    next_segment  INTEGER,                                        \n\
+    PRIMARY KEY (path, version)                                   \n\
+  );";
+
+// Old names of renamed versions, served from path until signed under it; see rename.h
+static const char *RENAME_TABLE = "\
+CREATE TABLE IF NOT EXISTS                                        \n\
+  renamed_versions(                                               \n\
+    old_path      TEXT NOT NULL,                                  \n\
+    path          TEXT NOT NULL,                                  \n\
+    version       INTEGER,                                        \n\
+    PRIMARY KEY (old_path, version)                               \n\
+  );";
+
+// Latest change of each entry of each directory, see dir-changes.h
+static const char *DIR_CHANGES_TABLE = "\
+CREATE TABLE IF NOT EXISTS                                        \n\
+  dir_changes(                                                    \n\
+    parent        TEXT NOT NULL,                                  \n\
+    name          TEXT NOT NULL,                                  \n\
+    version       INTEGER,                                        \n\
+    change        INTEGER,                                        \n\
+    PRIMARY KEY (parent, name)                                    \n\
+  );";
+
+// Published versions, and removals, in order; see feed.h
+static const char *FEED_TABLE = "\
+CREATE TABLE IF NOT EXISTS                                        \n\
+  publish_feed(                                                   \n\
+    seq           INTEGER PRIMARY KEY AUTOINCREMENT,              \n\
+    path          TEXT NOT NULL,                                  \n\
+    version       INTEGER,                                        \n\
+    size          INTEGER,                                        \n\
+    removed       INTEGER                                         \n\
+  );";
+
+// Symlinks whose target was not published yet when they were created, see link.h
+static const char *PENDING_LINK_TABLE = "\
+CREATE TABLE IF NOT EXISTS                                        \n\
+  pending_links(                                                  \n\
+    path          TEXT NOT NULL,                                  \n\
+    target        TEXT NOT NULL,                                  \n\
+    PRIMARY KEY (path)                                            \n\
+  );";
+
+// Buckets of the entries of each directory in the digest tree, see tree-digest.h
+static const char *TREE_BUCKET_TABLE = "\
+CREATE TABLE IF NOT EXISTS                                        \n\
+  tree_buckets(                                                   \n\
+    path          TEXT NOT NULL,                                  \n\
+    bucket        INTEGER,                                        \n\
+    sum           BLOB,                                           \n\
+    digest        BLOB,                                           \n\
+    count         INTEGER,                                        \n\
+    tree_version  INTEGER,                                        \n\
+    PRIMARY KEY (path, bucket)                                    \n\
+  );";
+
+static const char *TABLES[] = {
+  FS_TABLE, VER_TABLE, SEG_TABLE, HOLE_TABLE, JOURNAL_TABLE, RENAME_TABLE, DIR_CHANGES_TABLE, FEED_TABLE,
+  PENDING_LINK_TABLE, TREE_BUCKET_TABLE
+};
+
+static const char *INDEXES[] = {
+  "CREATE INDEX IF NOT EXISTS id_path ON file_system (path);",
+  "CREATE INDEX IF NOT EXISTS id_parent ON file_system (parent, path);",
+  "CREATE INDEX IF NOT EXISTS id_ver ON file_versions (path, version);",
+  "CREATE INDEX IF NOT EXISTS id_mtime ON file_versions (mtime);",
+  "CREATE INDEX IF NOT EXISTS id_target ON file_versions (target);",
+  "CREATE INDEX IF NOT EXISTS id_seg ON file_segments (path, version, segment);",
+  "CREATE INDEX IF NOT EXISTS id_renamed ON renamed_versions (path, version);",
+  "CREATE INDEX IF NOT EXISTS id_dir_changes ON dir_changes (parent, version);",
+  "CREATE INDEX IF NOT EXISTS id_pending_target ON pending_links (target);",
+  "CREATE INDEX IF NOT EXISTS id_bucket ON file_system (parent, tree_bucket, path);"
+};
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+struct added_column {
+  const char *table;
+  const char *name;
+  const char *type;
+};
+
+// Columns the tables did not have when they were first created, in the order they were added
+static const added_column ADDED_COLUMNS[] = {
+  {"file_versions", "content_digest", "BLOB"},
+  {"file_system", "streaming", "INTEGER"},
+  {"file_versions", "seg_size", "INTEGER"},
+  {"file_versions", "signature_type", "INTEGER"},
+  {"file_versions", "mtime", "INTEGER"},
+  {"file_versions", "lazy", "INTEGER"},
+  {"file_system", "parent", "TEXT"},
+  {"file_versions", "target", "TEXT"},
+  {"file_system", "tree_digest", "BLOB"},
+  {"file_system", "tree_sum", "BLOB"},
+  {"file_system", "tree_version", "INTEGER"},
+  {"file_system", "tree_bucket", "INTEGER"},
+  {"publish_feed", "removed", "INTEGER"}
+};
+
+static int run(sqlite3 *db, const string &sql)
+{
+  char *error = NULL;
+  if (sqlite3_exec(db, sql.c_str(), NULL, NULL, &error) != SQLITE_OK) {
+    FILE_LOG(LOG_ERROR) << "schema: " << (error ? error : "unknown error") << ". " << sql << endl;
+    sqlite3_free(error);
+    return -1;
+  }
+  return 0;
+}
+
+static bool has_column(sqlite3 *db, const char *table, const char *column)
+{
+  bool found = false;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, (string("PRAGMA table_info(") + table + ");").c_str(), -1, &stmt, 0);
+  while (!found && sqlite3_step(stmt) == SQLITE_ROW)
+    found = (string((const char *)sqlite3_column_text(stmt, 1)) == column);
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+static int schema_version(sqlite3 *db)
+{
+  int version = 0;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, 0);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    version = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  return version;
+}
+
+static int add_columns(sqlite3 *db)
+{
+  for (size_t i = 0; i < COUNT(ADDED_COLUMNS); i ++) {
+    const added_column &column = ADDED_COLUMNS[i];
+    if (has_column(db, column.table, column.name))
+      continue;
+    FILE_LOG(LOG_DEBUG) << "add_columns: adding " << column.table << "." << column.name << endl;
+    if (run(db, string("ALTER TABLE ") + column.table + " ADD COLUMN " + column.name + " " + column.type + ";") != 0)
+      return -1;
+  }
+  return 0;
+}
+
+/**
+ * migrate_to_1 brings databases from before schema versions up to date: they may lack any
+ * of the added columns, entries without parent, and the first index on parent. The digests
+ * of the tree, added without a value, are all computed by init_tree_digests at mount.
+ */
+static int migrate_to_1(sqlite3 *db)
+{
+  if (add_columns(db) != 0)
+    return -1;
+
+  // rtrim of all the characters but '/' leaves the parent with a trailing '/'
+  if (run(db, "UPDATE file_system SET parent = \
+                 CASE WHEN rtrim(path, replace(path, '/', '')) = '/' THEN '/' \
+                 ELSE substr(rtrim(path, replace(path, '/', '')), 1, length(rtrim(path, replace(path, '/', ''))) - 1) END \
+               WHERE parent IS NULL AND path != '/';") != 0)
+    return -1;
+  // Was on parent alone, created again on (parent, path) by create_indexes
+  return run(db, "DROP INDEX IF EXISTS id_parent;");
+}
+
+int create_tables(sqlite3 *db)
+{
+  for (size_t i = 0; i < COUNT(TABLES); i ++) {
+    if (run(db, TABLES[i]) != 0)
+      return -1;
+  }
+
+  int version = schema_version(db);
+  if (version >= SCHEMA_VERSION)
+    return 0;
+
+  FILE_LOG(LOG_DEBUG) << "create_tables: migrating the database from schema version " << version << " to " << SCHEMA_VERSION << endl;
+  if (run(db, "BEGIN;") != 0)
+    return -1;
+  if (version < 1 && migrate_to_1(db) != 0) {
+    run(db, "ROLLBACK;");
+    return -1;
+  }
+  ostringstream pragma;
+  pragma << "PRAGMA user_version = " << SCHEMA_VERSION << ";";
+  if (run(db, pragma.str()) != 0 || run(db, "COMMIT;") != 0) {
+    run(db, "ROLLBACK;");
+    return -1;
+  }
+  return 0;
+}
+
+int create_indexes(sqlite3 *db)
+{
+  for (size_t i = 0; i < COUNT(INDEXES); i ++) {
+    if (run(db, INDEXES[i]) != 0)
+      return -1;
+  }
+  return 0;
+}
+
+void drop_indexes(sqlite3 *db)
+{
+  const char *names[] = {"id_path", "id_parent", "id_ver", "id_mtime", "id_target", "id_seg", "id_renamed", "id_dir_changes", "id_pending_target", "id_bucket"};
+  for (size_t i = 0; i < COUNT(names); i ++)
+    run(db, string("DROP INDEX IF EXISTS ") + names[i] + ";");
+}
+
+int init_schema(sqlite3 *db)
+{
+  if (create_tables(db) != 0 || create_indexes(db) != 0)
+    return -1;
+
+  ostringstream root;
+  root << "INSERT OR IGNORE INTO file_system (path, type) VALUES ('/', " << DIRECTORY << ");";
+  return run(db, root.str());
+}
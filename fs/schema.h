@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_SCHEMA_H
+#define NDNFS_SCHEMA_H
+
+#include <sqlite3.h>
+
+/**
+ * The database schema, shared by ndnfs and ndnfs-import. Databases record the schema version
+ * they were last opened with in PRAGMA user_version; older ones get the columns added since
+ * with ALTER TABLE, and the data those columns derive from, when they are opened.
+ */
+#define SCHEMA_VERSION 1
+
+/**
+ * create_tables creates the tables that do not exist yet, and migrates older databases.
+ * @return 0 on success, -1 on error (logged)
+ */
+int create_tables(sqlite3 *db);
+
+/**
+ * create_indexes creates the secondary indexes that do not exist yet.
+ * @return 0 on success, -1 on error (logged)
+ */
+int create_indexes(sqlite3 *db);
+
+/**
+ * drop_indexes drops the secondary indexes, for bulk loads.
+ */
+void drop_indexes(sqlite3 *db);
+
+/**
+ * init_schema creates the tables and the indexes, and the entry of the root directory.
+ * @return 0 on success, -1 on error (logged)
+ */
+int init_schema(sqlite3 *db);
+
+#endif
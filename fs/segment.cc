@@ -20,116 +20,213 @@
  */
 
 #include "segment.h"
+#include "version.h"
+#include "sha256.h"
+#include "signer.h"
+#include "transaction.h"
 
 #include <ndn-cpp/data.hpp>
 #include <ndn-cpp/common.hpp>
+#include <ndn-cpp/digest-sha256-signature.hpp>
 #include <ndn-cpp/security/security-exception.hpp>
 
 #include <iostream>
 #include <cstdio>
+#include <vector>
+#include <algorithm>
 
 #define INT2STRLEN 100
 
 using namespace std;
 using namespace ndn;
 
-/**
- * version parameter is not used right now, as duplicate_version is now a stub, 
- * and write does not create/write to a new file by the name of the version.
- */
-int sign_segment(const char* path, int ver, int seg, const char *data, int len)
+int choose_seg_size(off_t file_size, const ndn::Name &ver_name)
 {
-  FILE_LOG(LOG_DEBUG) << "sign_segment: path=" << path << std::dec << ", ver=" << ver << ", seg=" << seg << ", len=" << len << endl;
+  int size = ndnfs::seg_size;
+  while (file_size / size > ADAPTIVE_SEGMENT_COUNT && size * 2 <= ndnfs::max_seg_size)
+    size *= 2;
+  return min(size, max_content_size(ver_name, ndnfs::signature_type == SIGNATURE_DIGEST));
+}
 
-  string file_path(path);
-  string full_name = ndnfs::global_prefix + file_path;
-  // We want the Name(uri) constructor to split the path into components between "/", but we first need
-  // to escape the characters in full_name which the Name(uri) constructor will unescape.  So, create a component
-  // from the raw string and use its toEscapedString.
-  
-  string escapedString = Name::Component((uint8_t*)&full_name[0], full_name.size()).toEscapedString();
-  // The "/" was escaped, so unescape.
-  while(1) {
-    size_t found = escapedString.find("%2F");
-    if (found == string::npos) 
-      break;
-    escapedString.replace(found, 3, "/");
-  }
-  Name seg_name(escapedString);
-  
-  seg_name.appendVersion(ver);
-  seg_name.appendSegment(seg);
-  FILE_LOG(LOG_DEBUG) << "sign_segment: segment name is " << seg_name.toUri() << endl;
+bool seg_size_fits(int seg_size, const ndn::Name &ver_name, int signature_type)
+{
+  return seg_size <= max_content_size(ver_name, signature_type == SIGNATURE_DIGEST);
+}
+
+ndn::Name version_name(const char* path, int64_t ver)
+{
+  Name name = build_file_name(Name(ndnfs::global_prefix), path);
+  name.appendVersion(ver);
+  return name;
+}
 
+void sign_segment(const ndn::Name &ver_name, const char* path, int64_t ver, int64_t seg, const char *data, int len)
+{
+  segment_job job;
+  job.segment = seg;
+  job.data = data;
+  job.len = len;
+  sign_segments(ver_name, path, ver, &job, 1);
+}
+
+// The KeyChain is not safe to use from several threads at once
+static pthread_mutex_t keychain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static Blob keychain_signature(const ndn::Name &ver_name, const segment_job &job)
+{
   Data data0;
-  data0.setName(seg_name);
-  data0.setContent((const uint8_t*)data, len);
-  
-  // instead of putting the whole content object into sqlite, we put only the signature field.
+  data0.setName(ver_name);
+  data0.getName().appendSegment(job.segment);
+  data0.setContent((const uint8_t*)job.data, job.len);
+
+  pthread_mutex_lock(&keychain_lock);
   ndnfs::keyChain->sign(data0, ndnfs::certificateName);
-  Blob signature = data0.getSignature()->getSignature();
-  
-  const char* sig_raw = (const char*)signature.buf();
-  int sig_size = signature.size();
+  pthread_mutex_unlock(&keychain_lock);
+  return data0.getSignature()->getSignature();
+}
+
+void compute_signatures(const ndn::Name &ver_name, const segment_job *jobs, int count, Blob *signatures)
+{
+  bool digest_only = (ndnfs::signature_type == SIGNATURE_DIGEST);
+  if (!digest_only && !signer_loaded()) {
+    for (int i = 0; i < count; i ++)
+      signatures[i] = keychain_signature(ver_name, jobs[i]);
+    return;
+  }
+
+  for (int i = 0; i < count; i += SHA256_MAX_LANES) {
+    int n = min(count - i, SHA256_MAX_LANES);
+    SignedBlob encodings[SHA256_MAX_LANES];
+    const uint8_t *portions[SHA256_MAX_LANES];
+    size_t portion_sizes[SHA256_MAX_LANES];
+    uint8_t digests[SHA256_MAX_LANES * SHA256_DIGEST_SIZE];
+
+    for (int j = 0; j < n; j ++) {
+      Data data0;
+      data0.setName(ver_name);
+      data0.getName().appendSegment(jobs[i + j].segment);
+      data0.setContent((const uint8_t*)jobs[i + j].data, jobs[i + j].len);
+      if (digest_only)
+        data0.setSignature(DigestSha256Signature());
+      else
+        prepare_packet(data0);
+
+      encodings[j] = data0.wireEncode();
+      portions[j] = encodings[j].signedBuf();
+      portion_sizes[j] = encodings[j].signedSize();
+    }
+
+    sha256_multi(portions, portion_sizes, digests, n);
+    for (int j = 0; j < n; j ++) {
+      const uint8_t *digest = digests + j * SHA256_DIGEST_SIZE;
+      signatures[i + j] = digest_only ? Blob(digest, SHA256_DIGEST_SIZE) : sign_digest(digest);
+    }
+  }
+
+  // RSA_sign failed (sign_digest logged it): sign those segments through the KeyChain
+  for (int i = 0; i < count; i ++) {
+    if (signatures[i].size() == 0)
+      signatures[i] = keychain_signature(ver_name, jobs[i]);
+  }
+}
 
+void store_signatures(const signed_segment *segments, int count)
+{
+  // One commit for all of them, not one per segment
+  begin_transaction();
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO file_segments (path,version,segment,signature) VALUES (?,?,?,?);", -1, &stmt, 0);
-  sqlite3_bind_text(stmt,1,path,-1,SQLITE_STATIC);
-  sqlite3_bind_int(stmt,2,ver);
-  sqlite3_bind_int(stmt,3,seg);
-  sqlite3_bind_blob(stmt,4,sig_raw,sig_size,SQLITE_STATIC);
-  
-  sqlite3_step(stmt);
+  for (int i = 0; i < count; i ++) {
+    sqlite3_bind_text(stmt,1,segments[i].path,-1,SQLITE_STATIC);
+    sqlite3_bind_int64(stmt,2,segments[i].version);
+    sqlite3_bind_int64(stmt,3,segments[i].segment);
+    sqlite3_bind_blob(stmt,4,segments[i].signature.buf(),segments[i].signature.size(),SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
   sqlite3_finalize(stmt);
+  end_transaction();
+}
+
+void sign_segments(const ndn::Name &ver_name, const char* path, int64_t ver, const segment_job *jobs, int count)
+{
+  FILE_LOG(LOG_DEBUG) << "sign_segments: path=" << path << std::dec << ", ver=" << ver << ", seg=" << jobs[0].segment << ", count=" << count << endl;
+
+  // instead of putting the whole content object into sqlite, we put only the signature field.
+  vector<Blob> signatures(count);
+  compute_signatures(ver_name, jobs, count, &signatures[0]);
 
-  return sig_size;
+  vector<signed_segment> segments(count);
+  for (int i = 0; i < count; i ++) {
+    segments[i].path = path;
+    segments[i].version = ver;
+    segments[i].segment = jobs[i].segment;
+    segments[i].signature = signatures[i];
+  }
+  store_signatures(&segments[0], count);
 }
 
-void remove_segments(const char* path, const int ver, const int start/* = 0 */)
+void remove_segments(const char* path, const int64_t ver, const int64_t start/* = 0 */)
 {
   FILE_LOG(LOG_DEBUG) << "remove_segments: path=" << path << std::dec << ", ver=" << ver << ", starting from segment #" << start << endl;
-  /*
-    sqlite3_stmt *stmt;
-    sqlite3_prepare_v2(db, "SELECT totalSegments FROM file_versions WHERE path = ? AND version = ?;", -1, &stmt, 0);
-    sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 2, ver);
-    int res = sqlite3_step(stmt);
-    if (res != SQLITE_ROW) {
-        sqlite3_finalize(stmt);
-        return;
-    }
-    int segs = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-
-    for (int i = start; i < segs; i++) {
-        sqlite3_prepare_v2(db, "DELETE FROM file_segments WHERE path = ? AND version = ? AND segment = ?;", -1, &stmt, 0);
-        sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 2, ver);
-        sqlite3_bind_int(stmt, 3, i);
-        sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
-    }
-  */
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "DELETE FROM file_segments WHERE path = ? AND version = ? AND segment >= ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, ver);
+  sqlite3_bind_int64(stmt, 3, start);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  sqlite3_prepare_v2(db, "DELETE FROM file_holes WHERE path = ? AND version = ? AND start_segment >= ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, ver);
+  sqlite3_bind_int64(stmt, 3, start);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  // A hole that spans start is cut short
+  sqlite3_prepare_v2(db, "UPDATE file_holes SET end_segment = ? WHERE path = ? AND version = ? AND end_segment > ?;", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, start);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 3, ver);
+  sqlite3_bind_int64(stmt, 4, start);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+void add_hole_segments(const char* path, const int64_t ver, const int64_t start, const int64_t end)
+{
+  FILE_LOG(LOG_DEBUG) << "add_hole_segments: path=" << path << std::dec << ", ver=" << ver << ", segments [" << start << ", " << end << ")" << endl;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO file_holes (path, version, start_segment, end_segment) VALUES (?,?,?,?);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, ver);
+  sqlite3_bind_int64(stmt, 3, start);
+  sqlite3_bind_int64(stmt, 4, end);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
 }
 
 // truncate is not tested in current implementation
-void truncate_segment(const char* path, const int ver, const int seg, const off_t length)
+void truncate_segment(const char* path, const int64_t ver, const int64_t seg, const off_t length)
 {
   FILE_LOG(LOG_DEBUG) << "truncate_segment: path=" << path << std::dec << ", ver=" << ver << ", seg=" << seg << ", length=" << length << endl;
 
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2(db, "SELECT * FROM file_segments WHERE path = ? AND version = ? AND segment = ?;", -1, &stmt, 0);
   sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
-  sqlite3_bind_int(stmt, 2, ver);
-  sqlite3_bind_int(stmt, 3, seg);
+  sqlite3_bind_int64(stmt, 2, ver);
+  sqlite3_bind_int64(stmt, 3, seg);
   
   if(sqlite3_step(stmt) == SQLITE_ROW) {
     if (length == 0) {
       sqlite3_finalize(stmt);
       sqlite3_prepare_v2(db, "DELETE FROM file_segments WHERE path = ? AND version = ? AND segment = ?;", -1, &stmt, 0);
       sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
-      sqlite3_bind_int(stmt, 2, ver);
-      sqlite3_bind_int(stmt, 3, seg);
+      sqlite3_bind_int64(stmt, 2, ver);
+      sqlite3_bind_int64(stmt, 3, seg);
       sqlite3_step(stmt);
       sqlite3_finalize(stmt);
     } else {
@@ -142,48 +239,15 @@ void truncate_segment(const char* path, const int ver, const int seg, const off_
         return;
       }
       
-      char *data = new char[ndnfs::seg_size];
-      int read_len = pread(fd, data, length, segment_to_size(seg));
+      char *data = new char[length];
+      int read_len = pread(fd, data, length, segment_to_size(seg, version_seg_size(path, ver)));
       if (read_len < 0) {
         FILE_LOG(LOG_ERROR) << "truncate_segment: write error. Errno: " << errno << endl;
         return;
       }
   
-      string file_path(path);
-      string full_name = ndnfs::global_prefix + file_path;
-      // We want the Name(uri) constructor to split the path into components between "/", but we first need
-      // to escape the characters in full_name which the Name(uri) constructor will unescape.  So, create a component
-      // from the raw string and use its toEscapedString.
-  
-      string escapedString = Name::Component((uint8_t*)&full_name[0], full_name.size()).toEscapedString();
-      // The "/" was escaped, so unescape.
-      while(1) {
-        size_t found = escapedString.find("%2F");
-        if (found == string::npos) break;
-        escapedString.replace(found, 3, "/");
-      }
-      Name seg_name(escapedString);
-  
-      seg_name.appendVersion(ver);
-      seg_name.appendSegment(seg);
-      
-      Data trunc_data;
-      trunc_data.setContent((const uint8_t*)data, length);
-  
-      ndnfs::keyChain->sign(trunc_data, ndnfs::certificateName);
-      Blob signature = trunc_data.getSignature()->getSignature();
-  
-      const char* sig_raw = (const char*)signature.buf();
-      int sig_size = signature.size();
-      
-      sqlite3_finalize(stmt);    
-      sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO file_segments (path,version,segment,signature) VALUES (?,?,?,?);", -1, &stmt, 0);
-      sqlite3_bind_text(stmt,1,path,-1,SQLITE_STATIC);
-      sqlite3_bind_int(stmt,2,ver);
-      sqlite3_bind_int(stmt,3,seg);
-      sqlite3_bind_blob(stmt,4,sig_raw,sig_size,SQLITE_STATIC);
-      sqlite3_step(stmt);
       sqlite3_finalize(stmt);
+      sign_segment(version_name(path, ver), path, ver, seg, data, length);
   
       delete data;
       close(fd);
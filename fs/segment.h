@@ -22,21 +22,92 @@
 #define NDNFS_SEGMENT_H
 
 #include "ndnfs.h"
+#include "name.h"
+#include "signature-types.h"
 
-inline int seek_segment(int doff)
+/**
+ * Segment size is a property of each version (file_versions.seg_size),
+ * so offsets are always converted with the segment size of the version.
+ */
+inline int64_t seek_segment(off_t doff, int seg_size)
 {
-    return (doff >> ndnfs::seg_size_shift);
+    return (doff / seg_size);
 }
 
-inline int segment_to_size(int seg)
+inline off_t segment_to_size(int64_t seg, int seg_size)
 {
-    return (seg << ndnfs::seg_size_shift);
+    return ((off_t)seg * seg_size);
 }
 
-int sign_segment(const char* path, int ver, int seg, const char *data, int len);
+#define ADAPTIVE_SEGMENT_COUNT 1024
+
+/**
+ * choose_seg_size picks the segment size of a new version of file_size bytes named
+ * ver_name: ndnfs::seg_size, doubled while the file would take more than
+ * ADAPTIVE_SEGMENT_COUNT segments, up to ndnfs::max_seg_size; and cut down to the
+ * max_content_size of ver_name (see signer.h), which only long paths get below.
+ */
+int choose_seg_size(off_t file_size, const ndn::Name &ver_name);
+
+/**
+ * seg_size_fits tells whether segments of seg_size bytes of a version named ver_name, with
+ * signatures of signature_type, fit in one Data packet. A version keeps its segment size
+ * when it's renamed or linked, and a longer name may leave no room for it.
+ */
+bool seg_size_fits(int seg_size, const ndn::Name &ver_name, int signature_type);
+
+/**
+ * version_name returns the name of version ver of path; it's computed once per version,
+ * and sign_segment only appends the segment number to it.
+ */
+ndn::Name version_name(const char* path, int64_t ver);
+
+void sign_segment(const ndn::Name &ver_name, const char* path, int64_t ver, int64_t seg, const char *data, int len);
+
+struct segment_job {
+  int64_t segment;
+  const char *data;
+  int len;
+};
+
+struct signed_segment {
+  const char *path;
+  int64_t version;
+  int64_t segment;
+  ndn::Blob signature;
+};
 
-void remove_segments(const char* path, const int ver, const int start = 0);
+/**
+ * compute_signatures signs count segments of the version named ver_name in one pass.
+ * The encoded packets are hashed together with sha256_multi, so that up to
+ * SHA256_MAX_LANES segments share one pass of the SIMD kernel; with SIGNATURE_RSA,
+ * each digest is then signed with the key loaded in the signer (or by the KeyChain,
+ * if none could be loaded or RSA_sign fails). It is safe to call from several threads:
+ * the KeyChain, which is not, is used by one thread at a time.
+ */
+void compute_signatures(const ndn::Name &ver_name, const segment_job *jobs, int count, ndn::Blob *signatures);
+
+/**
+ * store_signatures stores count signatures in one transaction.
+ */
+void store_signatures(const signed_segment *segments, int count);
+
+/**
+ * sign_segments signs count segments of ver (compute_signatures), and stores them.
+ */
+void sign_segments(const ndn::Name &ver_name, const char* path, int64_t ver, const segment_job *jobs, int count);
+
+/**
+ * remove_segments removes segments [start, ...) of ver, signed or in holes.
+ */
+void remove_segments(const char* path, const int64_t ver, const int64_t start = 0);
+
+/**
+ * add_hole_segments records that segments [start, end) of ver are all zeros, in a hole
+ * of the file. They are not signed by ndnfs; ndnfs-server signs them when requested.
+ */
+void add_hole_segments(const char* path, const int64_t ver, const int64_t start, const int64_t end);
 
-void truncate_segment(const char* path, const int ver, const int seg, const off_t length);
+void truncate_segment(const char* path, const int64_t ver, const int64_t seg, const off_t length);
 
 #endif
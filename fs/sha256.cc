@@ -0,0 +1,466 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sha256.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <openssl/sha.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NDNFS_SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+static const uint32_t K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t H0[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/**
+ * The padded form of a message, as a sequence of 64-byte blocks: all but the last
+ * one or two blocks are read in place, the tail is copied and padded.
+ */
+struct padded_message {
+  void init(const uint8_t *data, size_t len)
+  {
+    data_ = data;
+    in_place_ = len / 64;
+    size_t rest = len % 64;
+    blocks_ = in_place_ + (rest + 9 > 64 ? 2 : 1);
+
+    memset(tail_, 0, sizeof(tail_));
+    memcpy(tail_, data + in_place_ * 64, rest);
+    tail_[rest] = 0x80;
+    uint64_t bits = (uint64_t)len * 8;
+    uint8_t *end = tail_ + (blocks_ - in_place_) * 64;
+    for (int i = 1; i <= 8; i ++) {
+      end[-i] = (uint8_t)bits;
+      bits >>= 8;
+    }
+  }
+
+  const uint8_t *block(size_t i) const
+  {
+    return i < in_place_ ? data_ + i * 64 : tail_ + (i - in_place_) * 64;
+  }
+
+  size_t blocks_;
+
+private:
+  const uint8_t *data_;
+  size_t in_place_;
+  uint8_t tail_[128];
+};
+
+static void store_digest(const uint32_t *state, uint8_t *digest)
+{
+  for (int i = 0; i < 8; i ++) {
+    digest[i * 4] = (uint8_t)(state[i] >> 24);
+    digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+    digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+    digest[i * 4 + 3] = (uint8_t)state[i];
+  }
+}
+
+static void sha256_scalar(const uint8_t *const *data, const size_t *len, uint8_t *digests, int count)
+{
+  for (int i = 0; i < count; i ++)
+    SHA256(data[i], len[i], digests + i * SHA256_DIGEST_SIZE);
+}
+
+#ifdef NDNFS_SHA256_X86
+
+__attribute__((target("sha,sse4.1")))
+static void shani_blocks(uint32_t *state, const padded_message &msg)
+{
+  const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);  // CDAB
+  __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);  // EFGH
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);  // CDGH
+
+  for (size_t b = 0; b < msg.blocks_; b ++) {
+    const uint8_t *block = msg.block(b);
+    __m128i abef = state0;
+    __m128i cdgh = state1;
+    // Message words in groups of four, W[4g .. 4g + 3] in w[g % 4]
+    __m128i w[4];
+
+#pragma GCC unroll 16
+    for (int g = 0; g < 16; g ++) {
+      if (g < 4) {
+        w[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + g * 16)), MASK);
+      } else {
+        __m128i t = _mm_sha256msg1_epu32(w[g % 4], w[(g - 3) % 4]);
+        t = _mm_add_epi32(t, _mm_alignr_epi8(w[(g - 1) % 4], w[(g - 2) % 4], 4));
+        w[g % 4] = _mm_sha256msg2_epu32(t, w[(g - 1) % 4]);
+      }
+      __m128i m = _mm_add_epi32(w[g % 4], _mm_loadu_si128((const __m128i *)&K[g * 4]));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(m, 0x0E));
+    }
+
+    state0 = _mm_add_epi32(state0, abef);
+    state1 = _mm_add_epi32(state1, cdgh);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);  // FEBA
+  state1 = _mm_shuffle_epi32(state1, 0xB1);  // DCHG
+  _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));  // DCBA
+  _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, tmp, 8));  // ABEF
+}
+
+static void sha256_shani(const uint8_t *const *data, const size_t *len, uint8_t *digests, int count)
+{
+  padded_message msg;
+  for (int i = 0; i < count; i ++) {
+    uint32_t state[8];
+    memcpy(state, H0, sizeof(state));
+    msg.init(data[i], len[i]);
+    shani_blocks(state, msg);
+    store_digest(state, digests + i * SHA256_DIGEST_SIZE);
+  }
+}
+
+/**
+ * Multi-buffer kernels: lane i of every vector belongs to message i. Messages with
+ * fewer blocks leave the state of their lane unchanged in the remaining rounds.
+ */
+#define MB_ROUNDS(V, ADD, XOR, AND, ANDNOT, ROTR, SHR, SET1)                             \
+  V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];     \
+  for (int t = 0; t < 64; t ++) {                                                        \
+    if (t >= 16) {                                                                       \
+      V w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];                                    \
+      V s0 = XOR(XOR(ROTR(w15, 7), ROTR(w15, 18)), SHR(w15, 3));                         \
+      V s1 = XOR(XOR(ROTR(w2, 17), ROTR(w2, 19)), SHR(w2, 10));                          \
+      w[t & 15] = ADD(ADD(w[t & 15], s0), ADD(w[(t - 7) & 15], s1));                     \
+    }                                                                                    \
+    V S1 = XOR(XOR(ROTR(e, 6), ROTR(e, 11)), ROTR(e, 25));                               \
+    V ch = XOR(AND(e, f), ANDNOT(e, g));                                                 \
+    V t1 = ADD(ADD(ADD(h, S1), ADD(ch, SET1(K[t]))), w[t & 15]);                         \
+    V S0 = XOR(XOR(ROTR(a, 2), ROTR(a, 13)), ROTR(a, 22));                               \
+    V maj = XOR(XOR(AND(a, b), AND(a, c)), AND(b, c));                                   \
+    V t2 = ADD(S0, maj);                                                                 \
+    h = g; g = f; f = e; e = ADD(d, t1); d = c; c = b; b = a; a = ADD(t1, t2);           \
+  }
+
+// Read by lanes without a block left
+static const uint8_t zero_block[64] = { 0 };
+
+/**
+ * avx2_load_words loads 8 big-endian words at offset of each of the 8 blocks,
+ * transposed: w[i] holds word i of every block.
+ */
+__attribute__((target("avx2")))
+static inline void avx2_load_words(const uint8_t *const *blocks, int offset, __m256i *w)
+{
+  const __m256i BSWAP = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  __m256i r[8];
+  for (int l = 0; l < 8; l ++)
+    r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(blocks[l] + offset)), BSWAP);
+
+  // 8x8 transpose of 32-bit words
+  __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]), t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+  __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]), t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+  __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]), t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+  __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]), t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+  __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+  __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+  __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+  __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+  w[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  w[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  w[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  w[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  w[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  w[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  w[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  w[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+#define AVX2_ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+__attribute__((target("avx2")))
+static void avx2_lanes(const padded_message *msgs, int lanes, uint8_t *digests)
+{
+  __m256i s[8];
+  for (int i = 0; i < 8; i ++)
+    s[i] = _mm256_set1_epi32(H0[i]);
+
+  size_t max_blocks = 0;
+  for (int l = 0; l < lanes; l ++) {
+    if (msgs[l].blocks_ > max_blocks)
+      max_blocks = msgs[l].blocks_;
+  }
+
+  for (size_t blk = 0; blk < max_blocks; blk ++) {
+    const uint8_t *blocks[8];
+    uint32_t active[8] __attribute__((aligned(32)));
+    for (int l = 0; l < 8; l ++) {
+      active[l] = (l < lanes && blk < msgs[l].blocks_) ? 0xffffffff : 0;
+      blocks[l] = active[l] ? msgs[l].block(blk) : zero_block;
+    }
+
+    __m256i w[16];
+    avx2_load_words(blocks, 0, w);
+    avx2_load_words(blocks, 32, w + 8);
+
+    MB_ROUNDS(__m256i, _mm256_add_epi32, _mm256_xor_si256, _mm256_and_si256, _mm256_andnot_si256,
+              AVX2_ROTR, _mm256_srli_epi32, _mm256_set1_epi32)
+
+    __m256i mask = _mm256_load_si256((const __m256i *)active);
+    __m256i out[8] = { a, b, c, d, e, f, g, h };
+    for (int i = 0; i < 8; i ++)
+      s[i] = _mm256_blendv_epi8(s[i], _mm256_add_epi32(s[i], out[i]), mask);
+  }
+
+  uint32_t state[8][8] __attribute__((aligned(32)));
+  for (int i = 0; i < 8; i ++)
+    _mm256_store_si256((__m256i *)state[i], s[i]);
+  for (int l = 0; l < lanes; l ++) {
+    uint32_t lane_state[8];
+    for (int i = 0; i < 8; i ++)
+      lane_state[i] = state[i][l];
+    store_digest(lane_state, digests + l * SHA256_DIGEST_SIZE);
+  }
+}
+
+__attribute__((target("avx512f,avx2")))
+static void avx512_lanes(const padded_message *msgs, int lanes, uint8_t *digests)
+{
+  __m512i s[8];
+  for (int i = 0; i < 8; i ++)
+    s[i] = _mm512_set1_epi32(H0[i]);
+
+  size_t max_blocks = 0;
+  for (int l = 0; l < lanes; l ++) {
+    if (msgs[l].blocks_ > max_blocks)
+      max_blocks = msgs[l].blocks_;
+  }
+
+  for (size_t blk = 0; blk < max_blocks; blk ++) {
+    const uint8_t *blocks[16];
+    __mmask16 active = 0;
+    for (int l = 0; l < 16; l ++) {
+      if (l < lanes && blk < msgs[l].blocks_) {
+        active |= (__mmask16)(1 << l);
+        blocks[l] = msgs[l].block(blk);
+      } else {
+        blocks[l] = zero_block;
+      }
+    }
+
+    // Lanes 0-7 and 8-15 are transposed separately, into the two halves of each vector
+    __m256i lo[16], hi[16];
+    avx2_load_words(blocks, 0, lo);
+    avx2_load_words(blocks, 32, lo + 8);
+    avx2_load_words(blocks + 8, 0, hi);
+    avx2_load_words(blocks + 8, 32, hi + 8);
+    __m512i w[16];
+    for (int i = 0; i < 16; i ++)
+      w[i] = _mm512_inserti64x4(_mm512_castsi256_si512(lo[i]), hi[i], 1);
+
+    MB_ROUNDS(__m512i, _mm512_add_epi32, _mm512_xor_si512, _mm512_and_si512, _mm512_andnot_si512,
+              _mm512_ror_epi32, _mm512_srli_epi32, _mm512_set1_epi32)
+
+    __m512i out[8] = { a, b, c, d, e, f, g, h };
+    for (int i = 0; i < 8; i ++)
+      s[i] = _mm512_mask_add_epi32(s[i], active, s[i], out[i]);
+  }
+
+  uint32_t state[8][16] __attribute__((aligned(64)));
+  for (int i = 0; i < 8; i ++)
+    _mm512_store_si512((void *)state[i], s[i]);
+  for (int l = 0; l < lanes; l ++) {
+    uint32_t lane_state[8];
+    for (int i = 0; i < 8; i ++)
+      lane_state[i] = state[i][l];
+    store_digest(lane_state, digests + l * SHA256_DIGEST_SIZE);
+  }
+}
+
+template<int LANES, void (*KERNEL)(const padded_message *, int, uint8_t *)>
+static void sha256_multi_buffer(const uint8_t *const *data, const size_t *len, uint8_t *digests, int count)
+{
+  padded_message msgs[LANES];
+  for (int i = 0; i < count; i += LANES) {
+    int lanes = (count - i < LANES) ? count - i : LANES;
+    for (int l = 0; l < lanes; l ++)
+      msgs[l].init(data[i + l], len[i + l]);
+    KERNEL(msgs, lanes, digests + i * SHA256_DIGEST_SIZE);
+  }
+}
+
+static bool cpu_supports(Sha256Impl impl)
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  bool sse41 = (ecx & bit_SSE4_1) != 0;
+  // AVX state has to be enabled by the OS as well
+  bool osxsave = (ecx & bit_OSXSAVE) != 0;
+  uint64_t xcr0 = 0;
+  if (osxsave) {
+    uint32_t lo, hi;
+    __asm__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+    xcr0 = ((uint64_t)hi << 32) | lo;
+  }
+
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return false;
+
+  switch (impl) {
+  case SHA256_SCALAR:
+    return true;
+  case SHA256_SHANI:
+    return sse41 && (ebx & bit_SHA) != 0;
+  case SHA256_AVX2:
+    return (xcr0 & 0x6) == 0x6 && (ebx & bit_AVX2) != 0;
+  case SHA256_AVX512:
+    return (xcr0 & 0xe6) == 0xe6 && (ebx & bit_AVX512F) != 0;
+  default:
+    return false;
+  }
+}
+
+#else
+
+static bool cpu_supports(Sha256Impl impl)
+{
+  return impl == SHA256_SCALAR;
+}
+
+#endif
+
+typedef void (*sha256_func)(const uint8_t *const *, const size_t *, uint8_t *, int);
+
+struct sha256_kernel {
+  sha256_func func;
+  // Messages hashed together; batches of less than half of it go to the one-message kernel
+  int lanes;
+  const char *name;
+};
+
+static bool kernel_for(Sha256Impl impl, sha256_kernel &kernel)
+{
+  if (!cpu_supports(impl))
+    return false;
+
+  switch (impl) {
+#ifdef NDNFS_SHA256_X86
+  case SHA256_SHANI:
+    kernel.func = sha256_shani;
+    kernel.lanes = 1;
+    kernel.name = "sha-ni";
+    return true;
+  case SHA256_AVX2:
+    kernel.func = sha256_multi_buffer<8, avx2_lanes>;
+    kernel.lanes = 8;
+    kernel.name = "avx2 x8";
+    return true;
+  case SHA256_AVX512:
+    kernel.func = sha256_multi_buffer<16, avx512_lanes>;
+    kernel.lanes = 16;
+    kernel.name = "avx512 x16";
+    return true;
+#endif
+  case SHA256_SCALAR:
+    kernel.func = sha256_scalar;
+    kernel.lanes = 1;
+    kernel.name = "openssl";
+    return true;
+  default:
+    return false;
+  }
+}
+
+static sha256_kernel single_kernel;
+static sha256_kernel wide_kernel;
+static char sha256_name[64];
+// Auto-selection runs once, before the first hash of any thread
+static pthread_once_t sha256_once = PTHREAD_ONCE_INIT;
+
+static void select_auto()
+{
+#ifndef __OPTIMIZE__
+  // Unoptimized, the intrinsics kernels are several times slower than OpenSSL; the build
+  // compiles this file with -O2 even in debug mode, this is for builds that don't
+  kernel_for(SHA256_SCALAR, single_kernel);
+  wide_kernel = single_kernel;
+  strcpy(sha256_name, single_kernel.name);
+  return;
+#endif
+
+  // SHA extensions hash one message faster than OpenSSL (which may use them as well), and
+  // 16-lane AVX-512 beats both when its lanes are filled. 8-lane AVX2 measured slower than
+  // OpenSSL alone (0.67 against 1.09 GB/s, and 1.16 with SHA extensions), so it's never picked.
+  if (!kernel_for(SHA256_SHANI, single_kernel))
+    kernel_for(SHA256_SCALAR, single_kernel);
+  if (!kernel_for(SHA256_AVX512, wide_kernel))
+    wide_kernel = single_kernel;
+
+  if (wide_kernel.func == single_kernel.func)
+    strcpy(sha256_name, single_kernel.name);
+  else
+    snprintf(sha256_name, sizeof(sha256_name), "%s, %s", wide_kernel.name, single_kernel.name);
+}
+
+bool sha256_select(Sha256Impl impl)
+{
+  pthread_once(&sha256_once, select_auto);
+  if (impl == SHA256_AUTO) {
+    select_auto();
+    return true;
+  }
+
+  sha256_kernel kernel;
+  if (!kernel_for(impl, kernel))
+    return false;
+  single_kernel = wide_kernel = kernel;
+  strcpy(sha256_name, kernel.name);
+  return true;
+}
+
+void sha256_multi(const uint8_t *const *data, const size_t *len, uint8_t *digests, int count)
+{
+  pthread_once(&sha256_once, select_auto);
+  if (count * 2 >= wide_kernel.lanes)
+    wide_kernel.func(data, len, digests, count);
+  else
+    single_kernel.func(data, len, digests, count);
+}
+
+const char *sha256_impl_name()
+{
+  pthread_once(&sha256_once, select_auto);
+  return sha256_name;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_SHA256_H
+#define NDNFS_SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+// Messages hashed together by the widest kernel
+#define SHA256_MAX_LANES 16
+
+enum Sha256Impl {
+  SHA256_AUTO = 0,
+  // OpenSSL, one message at a time
+  SHA256_SCALAR,
+  // SHA extensions, one message at a time
+  SHA256_SHANI,
+  // Multi-buffer, 8 and 16 messages at a time
+  SHA256_AVX2,
+  SHA256_AVX512
+};
+
+/**
+ * sha256_multi hashes count independent messages, writing count digests of
+ * SHA256_DIGEST_SIZE bytes to digests. Kernels are chosen once (pthread_once, so
+ * threads may start hashing concurrently), by CPU feature detection: batches that
+ * fill at least half of the 16 AVX-512 lanes go to the multi-buffer kernel; smaller
+ * ones are hashed one message at a time, with the SHA extensions, or OpenSSL.
+ * AVX2 (8 lanes) is slower than both, and only used when selected explicitly.
+ */
+void sha256_multi(const uint8_t *const *data, const size_t *len, uint8_t *digests, int count);
+
+/**
+ * sha256_select forces one implementation for all batches (for benchmarks, before other
+ * threads hash); it returns false, and keeps the current one, if the CPU does not support it.
+ */
+bool sha256_select(Sha256Impl impl);
+
+const char *sha256_impl_name();
+
+#endif
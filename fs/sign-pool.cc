@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sign-pool.h"
+#include "signer-ring.h"
+
+#include <deque>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+using namespace std;
+
+struct sign_job {
+  sign_batch *batch;
+  int64_t segment;
+  string data;
+};
+
+static deque<sign_job> sign_queue;
+static pthread_mutex_t sign_lock = PTHREAD_MUTEX_INITIALIZER;
+// Signalled when a job is queued, or the pool is stopping
+static pthread_cond_t sign_queued = PTHREAD_COND_INITIALIZER;
+// Signalled when a job is done, or taken off a full queue
+static pthread_cond_t sign_done = PTHREAD_COND_INITIALIZER;
+static vector<pthread_t> sign_workers;
+static bool sign_pool_running = false;
+
+// Queued segments per worker, before queue_segment blocks; two batches, so that
+// a worker finds a full one when it's done with the last
+#define SIGN_QUEUE_PER_WORKER (2 * SIGN_BATCH_SIZE)
+// Signatures a worker stores in one transaction, unless the queue runs dry first
+#define SIGN_STORE_SIZE (16 * SIGN_BATCH_SIZE)
+
+static signer_ring *ring = NULL;
+// Counters of the ring in use by a batch, guarded by sign_lock
+static bool ring_batch_used[SIGNER_MAX_BATCHES];
+
+static int64_t elapsed_ms(const struct timespec &since)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)(now.tv_sec - since.tv_sec) * 1000 + (now.tv_nsec - since.tv_nsec) / 1000000;
+}
+
+static bool take_ring_batch(sign_batch &batch)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT rowid FROM file_system WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, batch.path.c_str(), -1, SQLITE_STATIC);
+  bool found = (sqlite3_step(stmt) == SQLITE_ROW);
+  if (found)
+    batch.path_id = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  if (!found)
+    return false;
+
+  pthread_mutex_lock(&sign_lock);
+  for (int i = 0; i < SIGNER_MAX_BATCHES; i ++) {
+    if (!ring_batch_used[i]) {
+      ring_batch_used[i] = true;
+      batch.ring_batch = i;
+      batch.generation = start_counter(ring, i);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&sign_lock);
+  return batch.ring_batch >= 0;
+}
+
+static bool queue_external(sign_batch &batch, int64_t seg, const char *data, int len)
+{
+  if (len > SIGNER_DATA_MAX || live_signers(ring) <= 0)
+    return false;
+  if (batch.ring_batch < 0 && !take_ring_batch(batch))
+    return false;
+
+  signer_job job;
+  job.path_id = batch.path_id;
+  job.version = batch.version;
+  job.segment = seg;
+  job.length = len;
+  memcpy(job.data, data, len);
+  job.batch = batch.ring_batch;
+  job.generation = batch.generation;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (!ring_push(ring, job)) {
+    if (elapsed_ms(start) > SIGNER_PUSH_TIMEOUT_MS) {
+      FILE_LOG(LOG_DEBUG) << "queue_external: signer ring full, signing " << batch.path << " segment " << seg << " locally" << endl;
+      return false;
+    }
+    usleep(100);
+  }
+  batch.external.push_back(make_pair(seg, len));
+  return true;
+}
+
+/**
+ * sign_missing signs the segments handed to signers that have no signature in the
+ * database yet, reading them from the file.
+ */
+static void sign_missing(sign_batch &batch)
+{
+  set<int64_t> stored;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT segment FROM file_segments WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, batch.path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, batch.version);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    stored.insert(sqlite3_column_int64(stmt, 0));
+  sqlite3_finalize(stmt);
+
+  char fullPath[PATH_MAX];
+  abs_path(fullPath, batch.path.c_str());
+  int fd = open(fullPath, O_RDONLY);
+  if (fd == -1) {
+    FILE_LOG(LOG_ERROR) << "sign_missing: open error. Errno: " << errno << endl;
+    return;
+  }
+
+  vector<char> buf(batch.seg_size);
+  for (size_t i = 0; i < batch.external.size(); i ++) {
+    int64_t seg = batch.external[i].first;
+    if (stored.count(seg) > 0)
+      continue;
+    int len = pread(fd, &buf[0], batch.external[i].second, segment_to_size(seg, batch.seg_size));
+    if (len < 0) {
+      FILE_LOG(LOG_ERROR) << "sign_missing: read error. Errno: " << errno << endl;
+      break;
+    }
+    sign_segment(batch.name, batch.path.c_str(), batch.version, seg, &buf[0], len);
+  }
+  close(fd);
+}
+
+/**
+ * drain_ring discards the segments left on the ring once no signer is alive; every
+ * batch they belong to signs them in sign_missing.
+ */
+static void drain_ring()
+{
+  signer_job job;
+  int drained = 0;
+  while (ring_pop(ring, job))
+    drained ++;
+  if (drained > 0)
+    FILE_LOG(LOG_DEBUG) << "drain_ring: " << drained << " segments left by dead signers" << endl;
+}
+
+static void wait_external(sign_batch &batch)
+{
+  int64_t target = batch.external.size();
+  int64_t done = 0;
+  struct timespec progress;
+  clock_gettime(CLOCK_MONOTONIC, &progress);
+  while (true) {
+    int64_t now_done = signed_count(ring, batch.ring_batch, batch.generation);
+    if (now_done >= target)
+      break;
+    if (live_signers(ring) <= 0) {
+      FILE_LOG(LOG_ERROR) << "wait_external: no signer alive at " << now_done << " of " << target
+                          << " segments of " << batch.path << ", signing the rest locally" << endl;
+      drain_ring();
+      sign_missing(batch);
+      break;
+    }
+    if (now_done > done) {
+      done = now_done;
+      clock_gettime(CLOCK_MONOTONIC, &progress);
+    } else if (elapsed_ms(progress) > SIGNER_TIMEOUT_MS) {
+      FILE_LOG(LOG_ERROR) << "wait_external: signers stalled at " << now_done << " of " << target
+                          << " segments of " << batch.path << ", signing the rest locally" << endl;
+      sign_missing(batch);
+      break;
+    }
+    usleep(1000);
+  }
+
+  // A signer that's still working on the batch no longer counts
+  pthread_mutex_lock(&sign_lock);
+  start_counter(ring, batch.ring_batch);
+  ring_batch_used[batch.ring_batch] = false;
+  pthread_mutex_unlock(&sign_lock);
+  batch.ring_batch = -1;
+  batch.external.clear();
+}
+
+static void sign_jobs(sign_batch &batch, const vector<sign_job> &jobs, vector<signed_segment> &signed_segments)
+{
+  segment_job segments[SIGN_BATCH_SIZE];
+  ndn::Blob signatures[SIGN_BATCH_SIZE];
+  for (size_t i = 0; i < jobs.size(); i ++) {
+    segments[i].segment = jobs[i].segment;
+    segments[i].data = jobs[i].data.data();
+    segments[i].len = jobs[i].data.size();
+  }
+  compute_signatures(batch.name, segments, jobs.size(), signatures);
+
+  for (size_t i = 0; i < jobs.size(); i ++) {
+    signed_segment segment;
+    segment.path = batch.path.c_str();
+    segment.version = batch.version;
+    segment.segment = jobs[i].segment;
+    segment.signature = signatures[i];
+    signed_segments.push_back(segment);
+  }
+}
+
+static void *sign_worker(void *arg)
+{
+  vector<sign_job> jobs;
+  // Signed but not stored yet, and the batch of each; a batch is done only once stored
+  vector<signed_segment> signed_segments;
+  vector<sign_batch *> signed_batches;
+
+  pthread_mutex_lock(&sign_lock);
+  while (true) {
+    while (sign_pool_running && sign_queue.empty())
+      pthread_cond_wait(&sign_queued, &sign_lock);
+    if (sign_queue.empty())
+      break;
+
+    // Consecutive segments of the same batch are signed together
+    sign_batch *batch = sign_queue.front().batch;
+    jobs.clear();
+    while (!sign_queue.empty() && sign_queue.front().batch == batch && jobs.size() < SIGN_BATCH_SIZE) {
+      jobs.push_back(sign_queue.front());
+      sign_queue.pop_front();
+    }
+    pthread_cond_broadcast(&sign_done);
+    pthread_mutex_unlock(&sign_lock);
+
+    sign_jobs(*batch, jobs, signed_segments);
+    signed_batches.insert(signed_batches.end(), jobs.size(), batch);
+
+    pthread_mutex_lock(&sign_lock);
+    if (signed_segments.size() < SIGN_STORE_SIZE && !sign_queue.empty())
+      continue;
+    pthread_mutex_unlock(&sign_lock);
+
+    store_signatures(&signed_segments[0], signed_segments.size());
+
+    pthread_mutex_lock(&sign_lock);
+    for (size_t i = 0; i < signed_segments.size(); i ++) {
+      signed_batches[i]->pending --;
+      signed_batches[i]->unsigned_segments.erase(signed_segments[i].segment);
+    }
+    signed_segments.clear();
+    signed_batches.clear();
+    pthread_cond_broadcast(&sign_done);
+  }
+  pthread_mutex_unlock(&sign_lock);
+  return NULL;
+}
+
+static void flush_held(sign_batch &batch)
+{
+  if (batch.held.empty())
+    return;
+
+  segment_job segments[SIGN_BATCH_SIZE];
+  for (size_t i = 0; i < batch.held.size(); i ++) {
+    segments[i].segment = batch.held[i].segment;
+    segments[i].data = batch.held[i].data.data();
+    segments[i].len = batch.held[i].data.size();
+  }
+  sign_segments(batch.name, batch.path.c_str(), batch.version, segments, batch.held.size());
+  batch.held.clear();
+}
+
+void queue_segment(sign_batch &batch, int64_t seg, const char *data, int len)
+{
+  if (ring != NULL && queue_external(batch, seg, data, len))
+    return;
+
+  pthread_mutex_lock(&sign_lock);
+  if (!sign_pool_running) {
+    pthread_mutex_unlock(&sign_lock);
+    if (ndnfs::signature_type != SIGNATURE_DIGEST) {
+      // RSA dominates the cost of a segment, nothing to gain from holding it
+      sign_segment(batch.name, batch.path.c_str(), batch.version, seg, data, len);
+      return;
+    }
+    held_segment held;
+    held.segment = seg;
+    batch.held.push_back(held);
+    batch.held.back().data.assign(data, len);
+    if (batch.held.size() >= SIGN_BATCH_SIZE)
+      flush_held(batch);
+    return;
+  }
+
+  while (sign_queue.size() >= sign_workers.size() * SIGN_QUEUE_PER_WORKER)
+    pthread_cond_wait(&sign_done, &sign_lock);
+
+  sign_job job;
+  job.batch = &batch;
+  job.segment = seg;
+  job.data.assign(data, len);
+  sign_queue.push_back(job);
+  batch.pending ++;
+  batch.unsigned_segments.insert(seg);
+  pthread_cond_signal(&sign_queued);
+  pthread_mutex_unlock(&sign_lock);
+}
+
+int64_t signed_before(sign_batch &batch, int64_t next)
+{
+  // Segments are queued in order, so the first held or handed over one is the lowest
+  int64_t first = next;
+  if (!batch.held.empty())
+    first = min(first, batch.held.front().segment);
+  if (!batch.external.empty())
+    first = min(first, batch.external.front().first);
+
+  pthread_mutex_lock(&sign_lock);
+  if (!batch.unsigned_segments.empty())
+    first = min(first, *batch.unsigned_segments.begin());
+  pthread_mutex_unlock(&sign_lock);
+  return first;
+}
+
+void wait_batch(sign_batch &batch)
+{
+  flush_held(batch);
+  if (batch.ring_batch >= 0)
+    wait_external(batch);
+
+  pthread_mutex_lock(&sign_lock);
+  while (batch.pending > 0)
+    pthread_cond_wait(&sign_done, &sign_lock);
+  pthread_mutex_unlock(&sign_lock);
+}
+
+void start_sign_pool()
+{
+  if (!ndnfs::signer_shm.empty()) {
+    ring = create_signer_ring(ndnfs::signer_shm.c_str(), ndnfs::signature_type, ndnfs::global_prefix.c_str(),
+                              ndnfs::root_path.c_str(), db_name);
+    if (ring == NULL)
+      FILE_LOG(LOG_ERROR) << "start_sign_pool: cannot create signer ring " << ndnfs::signer_shm << ". Errno: " << errno << endl;
+    else
+      FILE_LOG(LOG_DEBUG) << "start_sign_pool: signer ring " << ndnfs::signer_shm << endl;
+  }
+
+  if (ndnfs::sign_threads <= 1)
+    return;
+
+  pthread_mutex_lock(&sign_lock);
+  sign_pool_running = true;
+  for (int i = 0; i < ndnfs::sign_threads; i ++) {
+    pthread_t worker;
+    if (pthread_create(&worker, NULL, sign_worker, NULL) != 0) {
+      FILE_LOG(LOG_ERROR) << "start_sign_pool: pthread_create error. Errno: " << errno << endl;
+      break;
+    }
+    sign_workers.push_back(worker);
+  }
+  if (sign_workers.empty())
+    sign_pool_running = false;
+  pthread_mutex_unlock(&sign_lock);
+
+  FILE_LOG(LOG_DEBUG) << "start_sign_pool: " << sign_workers.size() << " signing threads" << endl;
+}
+
+void stop_sign_pool()
+{
+  if (ring != NULL) {
+    // Publishes are flushed by now; signers exit
+    ring->closed.store(1);
+    unmap_signer_ring(ring, ndnfs::signer_shm.c_str(), true);
+    ring = NULL;
+  }
+
+  pthread_mutex_lock(&sign_lock);
+  if (!sign_pool_running) {
+    pthread_mutex_unlock(&sign_lock);
+    return;
+  }
+  // Workers drain the queue before they exit
+  sign_pool_running = false;
+  pthread_cond_broadcast(&sign_queued);
+  pthread_mutex_unlock(&sign_lock);
+
+  for (size_t i = 0; i < sign_workers.size(); i ++)
+    pthread_join(sign_workers[i], NULL);
+  sign_workers.clear();
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_SIGN_POOL_H
+#define NDNFS_SIGN_POOL_H
+
+#include "ndnfs.h"
+#include "segment.h"
+#include "sha256.h"
+
+#include <set>
+
+/**
+ * The signing pool runs sign_segments on ndnfs::sign_threads worker threads, so that
+ * the signing pass of a publish is not bound to one core. With sign_threads <= 1
+ * segments are signed on the calling thread, as before.
+ *
+ * A sign_batch is the segments of one version that one publish queued; the name
+ * of the version is computed once for the whole batch. queue_segment copies the data,
+ * so readers may reuse their buffers right away.
+ *
+ * Workers take up to SIGN_BATCH_SIZE consecutive segments of the same batch at once,
+ * so that digest signatures are hashed a SIMD pass at a time. Without the pool,
+ * digest-signed segments are held in the batch until SIGN_BATCH_SIZE of them are queued.
+ * A worker keeps the signatures until it has SIGN_STORE_SIZE of them or the queue is
+ * empty, and stores them in one transaction on the shared connection (see transaction.h);
+ * the segments of a batch count as signed once stored. The KeyChain is only used by one
+ * worker at a time (see compute_signatures).
+ *
+ * With ndnfs::signer_shm set, segments are handed to ndnfs-signer processes instead,
+ * content included, on a signer_ring: the signers sign them and store the signatures
+ * themselves. Segments are signed in ndnfs as above when no signer is alive, when the
+ * ring stays full for SIGNER_PUSH_TIMEOUT_MS, and (in wait_batch) when the signers
+ * die or make no progress for SIGNER_TIMEOUT_MS.
+ */
+#define SIGNER_PUSH_TIMEOUT_MS 1000
+#define SIGNER_TIMEOUT_MS 5000
+
+#define SIGN_BATCH_SIZE SHA256_MAX_LANES
+
+struct held_segment {
+  int64_t segment;
+  std::string data;
+};
+
+struct sign_batch {
+  sign_batch(const char *path, int64_t version, int seg_size)
+    : path(path), version(version), seg_size(seg_size), name(version_name(path, version)), pending(0),
+      ring_batch(-1), generation(0), path_id(0)
+  {
+  }
+
+  std::string path;
+  int64_t version;
+  int seg_size;
+  ndn::Name name;
+  int pending;
+  std::vector<held_segment> held;
+
+  // Counter of the batch on the signer ring, -1 if nothing was handed to signers
+  int ring_batch;
+  uint32_t generation;
+  int64_t path_id;
+  // Segments handed to signers, with their length
+  std::vector<std::pair<int64_t, int> > external;
+  // Segments queued on the pool and not signed yet, guarded by the pool's lock
+  std::set<int64_t> unsigned_segments;
+};
+
+void queue_segment(sign_batch &batch, int64_t seg, const char *data, int len);
+
+/**
+ * signed_before returns the first segment of batch, at most next, that may not be signed yet,
+ * without waiting for the pool; segments handed to signers count as unsigned until wait_batch.
+ */
+int64_t signed_before(sign_batch &batch, int64_t next);
+
+/**
+ * wait_batch returns once every segment queued in batch is signed, held ones included.
+ */
+void wait_batch(sign_batch &batch);
+
+/**
+ * Like the publisher thread, workers have to be started after fuse_main forks.
+ */
+void start_sign_pool();
+
+void stop_sign_pool();
+
+#endif
@@ -6,7 +6,8 @@
  * Ready: the most recent version of the file is already signed;
  * Not_ready: no versions of the file is ready;
  * Ready_old: the most recent version of the file is not ready, while an older version is.
+ * Streaming: the most recent version is still being written, and its segments are signed as they are completed.
  */
-enum SignatureState {READY, NOT_READY, READY_OLD};
+enum SignatureState {READY, NOT_READY, READY_OLD, STREAMING};
 
 #endif
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef SIGNATURE_TYPE_H
+#define SIGNATURE_TYPE_H
+
+/**
+ * SignatureTypes are stored into the database, per version (file_versions.signature_type)
+ * Rsa: segments carry a Sha256WithRsa signature by the certificate of ndnfs;
+ * Digest: segments carry a DigestSha256 "signature", integrity only.
+ */
+enum SignatureType {SIGNATURE_RSA, SIGNATURE_DIGEST};
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "signer-ring.h"
+
+#include <new>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static signer_ring *map_ring(int fd)
+{
+  void *addr = mmap(NULL, sizeof(signer_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    return NULL;
+  return (signer_ring *)addr;
+}
+
+static int64_t monotonic_ms()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+signer_ring *create_signer_ring(const char *name, int signature_type, const char *prefix,
+                                const char *root_path, const char *db_path)
+{
+  if (strlen(prefix) >= SIGNER_PATH_MAX || strlen(root_path) >= SIGNER_PATH_MAX || strlen(db_path) >= SIGNER_PATH_MAX) {
+    errno = ENAMETOOLONG;
+    return NULL;
+  }
+
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1)
+    return NULL;
+  if (ftruncate(fd, sizeof(signer_ring)) == -1) {
+    int err = errno;
+    close(fd);
+    shm_unlink(name);
+    errno = err;
+    return NULL;
+  }
+
+  signer_ring *ring = map_ring(fd);
+  if (ring == NULL) {
+    shm_unlink(name);
+    return NULL;
+  }
+
+  // The object is zero-filled; the atomics still have to be constructed
+  ring = new (ring) signer_ring;
+  ring->signature_type = signature_type;
+  strcpy(ring->prefix, prefix);
+  strcpy(ring->root_path, root_path);
+  strcpy(ring->db_path, db_path);
+  ring->closed.store(0);
+  for (int i = 0; i < SIGNER_MAX_SIGNERS; i ++) {
+    ring->signers[i].pid.store(0);
+    ring->signers[i].heartbeat.store(0);
+  }
+  ring->enqueue_pos.store(0);
+  ring->dequeue_pos.store(0);
+  for (int i = 0; i < SIGNER_MAX_BATCHES; i ++)
+    ring->batches[i].state.store(0);
+  for (uint64_t i = 0; i < SIGNER_RING_SIZE; i ++)
+    ring->slots[i].sequence.store(i);
+
+  // Signers check the magic last
+  std::atomic_thread_fence(std::memory_order_release);
+  ring->magic = SIGNER_RING_MAGIC;
+  return ring;
+}
+
+signer_ring *attach_signer_ring(const char *name)
+{
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd == -1)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size != (off_t)sizeof(signer_ring)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  signer_ring *ring = map_ring(fd);
+  if (ring != NULL && ring->magic != SIGNER_RING_MAGIC) {
+    munmap(ring, sizeof(signer_ring));
+    errno = EINVAL;
+    return NULL;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return ring;
+}
+
+void unmap_signer_ring(signer_ring *ring, const char *name, bool unlink)
+{
+  munmap(ring, sizeof(signer_ring));
+  if (unlink)
+    shm_unlink(name);
+}
+
+int register_signer(signer_ring *ring, int32_t pid)
+{
+  // Frees the slots of dead signers first
+  live_signers(ring);
+  for (int i = 0; i < SIGNER_MAX_SIGNERS; i ++) {
+    int32_t free_pid = 0;
+    if (ring->signers[i].pid.compare_exchange_strong(free_pid, pid)) {
+      signer_heartbeat(ring, i, pid);
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool signer_heartbeat(signer_ring *ring, int slot, int32_t pid)
+{
+  if (ring->signers[slot].pid.load() != pid)
+    return false;
+  ring->signers[slot].heartbeat.store(monotonic_ms());
+  return true;
+}
+
+void unregister_signer(signer_ring *ring, int slot)
+{
+  ring->signers[slot].heartbeat.store(0);
+  ring->signers[slot].pid.store(0);
+}
+
+int live_signers(signer_ring *ring)
+{
+  int64_t now = monotonic_ms();
+  int live = 0;
+  for (int i = 0; i < SIGNER_MAX_SIGNERS; i ++) {
+    signer_process &signer = ring->signers[i];
+    int32_t pid = signer.pid.load();
+    if (pid == 0)
+      continue;
+    // A heartbeat of 0 is a signer between taking the slot and its first heartbeat
+    int64_t heartbeat = signer.heartbeat.load();
+    bool gone = (kill(pid, 0) == -1 && errno == ESRCH);
+    if (!gone && (heartbeat == 0 || now - heartbeat <= SIGNER_HEARTBEAT_TIMEOUT_MS)) {
+      live ++;
+      continue;
+    }
+    if (signer.pid.compare_exchange_strong(pid, 0))
+      signer.heartbeat.store(0);
+  }
+  return live;
+}
+
+bool ring_push(signer_ring *ring, const signer_job &job)
+{
+  uint64_t pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+  signer_slot *slot;
+  while (true) {
+    slot = &ring->slots[pos % SIGNER_RING_SIZE];
+    uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+    int64_t diff = (int64_t)seq - (int64_t)pos;
+    if (diff == 0) {
+      if (ring->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->job = job;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool ring_pop(signer_ring *ring, signer_job &job)
+{
+  uint64_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+  signer_slot *slot;
+  while (true) {
+    slot = &ring->slots[pos % SIGNER_RING_SIZE];
+    uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+    int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+    if (diff == 0) {
+      if (ring->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  job = slot->job;
+  slot->sequence.store(pos + SIGNER_RING_SIZE, std::memory_order_release);
+  return true;
+}
+
+uint32_t start_counter(signer_ring *ring, int batch)
+{
+  uint32_t generation = (uint32_t)(ring->batches[batch].state.load() >> 32) + 1;
+  ring->batches[batch].state.store((uint64_t)generation << 32);
+  return generation;
+}
+
+void count_signed(signer_ring *ring, const signer_job &job)
+{
+  std::atomic<uint64_t> &state = ring->batches[job.batch].state;
+  uint64_t current = state.load();
+  while ((uint32_t)(current >> 32) == job.generation) {
+    if (state.compare_exchange_weak(current, current + 1))
+      break;
+  }
+}
+
+int64_t signed_count(signer_ring *ring, int batch, uint32_t generation)
+{
+  uint64_t current = ring->batches[batch].state.load();
+  if ((uint32_t)(current >> 32) != generation)
+    return 0;
+  return (int64_t)(current & 0xffffffffu);
+}
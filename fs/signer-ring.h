@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_SIGNER_RING_H
+#define NDNFS_SIGNER_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/**
+ * The signer ring is a bounded multi-producer, multi-consumer queue of segments in
+ * POSIX shared memory, shared by ndnfs (which creates it and pushes the segments it
+ * publishes, content included) and any number of ndnfs-signer processes (which attach,
+ * pop, sign the content they were handed and store the signature in the database).
+ * Signers never read the file, so what they sign is what ndnfs published.
+ *
+ * Slots carry a sequence number (Vyukov's bounded queue), so pushing and popping take
+ * one compare-and-swap and no lock; nothing a crashed process leaves behind can block
+ * the others. Waiting is done by polling, there is no process-shared lock to recover.
+ *
+ * Completion is counted per batch: ndnfs takes one of SIGNER_MAX_BATCHES counters for
+ * the segments of one publish, and signers increment it as signatures are stored.
+ * Each use of a counter has a new generation, kept in the same word as the count, so
+ * that a late signer (one ndnfs gave up on) cannot count towards the next batch.
+ *
+ * Each signer registers its pid in one of SIGNER_MAX_SIGNERS slots, and keeps a
+ * heartbeat there while it runs. A signer whose process is gone, or whose heartbeat
+ * is older than SIGNER_HEARTBEAT_TIMEOUT_MS, is dead: live_signers frees its slot,
+ * and once none is alive ndnfs drains the ring and signs the segments itself.
+ */
+
+#define SIGNER_RING_MAGIC 0x4e53524eu
+#define SIGNER_RING_SIZE 1024
+#define SIGNER_MAX_BATCHES 64
+#define SIGNER_MAX_SIGNERS 64
+#define SIGNER_HEARTBEAT_TIMEOUT_MS 2000
+// Largest segment content a job carries; a segment fits in one packet (MAX_NDN_PACKET_SIZE)
+#define SIGNER_DATA_MAX 8800
+
+struct signer_job {
+  // rowid of the path in file_system
+  int64_t path_id;
+  int64_t version;
+  int64_t segment;
+  int32_t length;
+  int32_t batch;
+  uint32_t generation;
+  uint8_t data[SIGNER_DATA_MAX];
+};
+
+struct signer_slot {
+  std::atomic<uint64_t> sequence;
+  signer_job job;
+};
+
+// Generation in the upper 32 bits, signed segments in the lower 32 bits
+struct signer_batch_counter {
+  std::atomic<uint64_t> state;
+};
+
+// pid 0 if the slot is free; heartbeat in ms of CLOCK_MONOTONIC, which all processes share
+struct signer_process {
+  std::atomic<int32_t> pid;
+  std::atomic<int64_t> heartbeat;
+};
+
+#define SIGNER_PATH_MAX 4096
+
+struct signer_ring {
+  uint32_t magic;
+  // SignatureType of the segments
+  int32_t signature_type;
+  // What signers need to name, read and store segments the way ndnfs does
+  char prefix[SIGNER_PATH_MAX];
+  char root_path[SIGNER_PATH_MAX];
+  char db_path[SIGNER_PATH_MAX];
+  // Set by ndnfs when it unmounts; signers exit
+  std::atomic<int> closed;
+  // Attached signers
+  signer_process signers[SIGNER_MAX_SIGNERS];
+  std::atomic<uint64_t> enqueue_pos;
+  std::atomic<uint64_t> dequeue_pos;
+  signer_batch_counter batches[SIGNER_MAX_BATCHES];
+  signer_slot slots[SIGNER_RING_SIZE];
+};
+
+/**
+ * create_signer_ring creates (or replaces) the shared memory object name, and maps
+ * an empty ring in it, for segments of the files under root_path, named under prefix,
+ * whose signatures are stored in the database at db_path.
+ * @return the ring, NULL on error (errno is set, ENAMETOOLONG if a path does not fit)
+ */
+signer_ring *create_signer_ring(const char *name, int signature_type, const char *prefix,
+                                const char *root_path, const char *db_path);
+
+/**
+ * attach_signer_ring maps the ring ndnfs created under name.
+ * @return the ring, NULL on error, or if name is not a ring
+ */
+signer_ring *attach_signer_ring(const char *name);
+
+/**
+ * unmap_signer_ring unmaps ring; with unlink, the shared memory object is removed too.
+ */
+void unmap_signer_ring(signer_ring *ring, const char *name, bool unlink);
+
+/**
+ * register_signer takes a slot for the signer process pid, with a fresh heartbeat.
+ * @return the slot, -1 if every slot is taken by a live signer
+ */
+int register_signer(signer_ring *ring, int32_t pid);
+
+/**
+ * signer_heartbeat marks the signer in slot as alive.
+ * @return false if the slot is no longer pid's (it was taken for dead), pid has to register again
+ */
+bool signer_heartbeat(signer_ring *ring, int slot, int32_t pid);
+
+void unregister_signer(signer_ring *ring, int slot);
+
+/**
+ * live_signers counts the registered signers that are alive, and frees the slots of
+ * the dead ones.
+ */
+int live_signers(signer_ring *ring);
+
+/**
+ * ring_push and ring_pop never block.
+ * @return false if the ring is full (empty), or the slot at the head is still being
+ *         filled (emptied) by another process
+ */
+bool ring_push(signer_ring *ring, const signer_job &job);
+
+bool ring_pop(signer_ring *ring, signer_job &job);
+
+/**
+ * start_counter starts a new generation of counter batch.
+ * @return the generation, to put in the jobs of the batch
+ */
+uint32_t start_counter(signer_ring *ring, int batch);
+
+/**
+ * count_signed counts one signed segment of job, unless its batch is done with.
+ */
+void count_signed(signer_ring *ring, const signer_job &job);
+
+int64_t signed_count(signer_ring *ring, int batch, uint32_t generation);
+
+#endif
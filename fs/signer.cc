@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <sstream>
+
+#include "signer.h"
+#include "sha256.h"
+#include "logger.h"
+
+#include <ndn-cpp/sha256-with-rsa-signature.hpp>
+#include <ndn-cpp/digest-sha256-signature.hpp>
+#include <ndn-cpp/key-locator.hpp>
+
+#include <openssl/rsa.h>
+#include <openssl/objects.h>
+#include <openssl/err.h>
+
+using namespace std;
+using namespace ndn;
+
+static RSA *signer_key = NULL;
+static Sha256WithRsaSignature signer_signature;
+
+Name certificate_name(const Name &key_name)
+{
+  return key_name.getSubName(0, key_name.size() - 1).append("KEY").append
+    (key_name.get(key_name.size() - 1)).append("ID-CERT").append("0");
+}
+
+int load_signer(const uint8_t *private_key_der, size_t key_size, const Name &certificate_name)
+{
+  const unsigned char *der = private_key_der;
+  RSA *key = d2i_RSAPrivateKey(NULL, &der, key_size);
+  if (key == NULL)
+    return -1;
+
+  if (signer_key != NULL)
+    RSA_free(signer_key);
+  signer_key = key;
+
+  // Same KeyLocator as IdentityManager::signByCertificate: the certificate name without version
+  signer_signature.getKeyLocator().setType(ndn_KeyLocatorType_KEYNAME);
+  signer_signature.getKeyLocator().setKeyName(certificate_name.getPrefix(-1));
+  return 0;
+}
+
+bool signer_loaded()
+{
+  return signer_key != NULL;
+}
+
+void prepare_packet(Data &data)
+{
+  data.setSignature(signer_signature);
+}
+
+int max_content_size(const Name &version_name, bool digest_only)
+{
+  // The longest segment number, and a signature value of the right size
+  Data data(version_name);
+  data.getName().appendSegment(~(uint64_t)0);
+  size_t signature_size;
+  if (digest_only) {
+    data.setSignature(DigestSha256Signature());
+    signature_size = SHA256_DIGEST_SIZE;
+  } else {
+    prepare_packet(data);
+    signature_size = (signer_key != NULL) ? RSA_size(signer_key) : DEFAULT_RSA_SIGNATURE_SIZE;
+  }
+  data.getSignature()->setSignature(Blob(vector<uint8_t>(signature_size)));
+
+  // With content, the lengths of Content and of Data take up to two bytes more each
+  int overhead = data.wireEncode().size() + 4;
+  return MAX_NDN_PACKET_SIZE - overhead;
+}
+
+Blob sign_digest(const uint8_t *digest)
+{
+  vector<uint8_t> signature(RSA_size(signer_key));
+  unsigned int signature_size = 0;
+  if (RSA_sign(NID_sha256, digest, SHA256_DIGEST_SIZE, &signature[0], &signature_size, signer_key) != 1) {
+    FILE_LOG(LOG_ERROR) << "sign_digest: RSA_sign error. " << ERR_error_string(ERR_get_error(), NULL) << endl;
+    return Blob();
+  }
+  return Blob(&signature[0], signature_size);
+}
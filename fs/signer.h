@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_SIGNER_H
+#define NDNFS_SIGNER_H
+
+#include <ndn-cpp/data.hpp>
+#include <ndn-cpp/name.hpp>
+
+/**
+ * The signer holds the signing key of ndnfs, parsed once, and a Sha256WithRsaSignature
+ * whose KeyLocator already names the key of the certificate. keyChain->sign resolves
+ * the certificate to a key, finds the key in the private key storage and parses its DER
+ * encoding again for every packet; with the signer, signing a packet is: set the
+ * prepared signature, encode, hash (with sha256_multi, for many packets at once), RSA.
+ *
+ * The key is only read after load_signer, and RSA_sign is safe to call on it from
+ * several threads.
+ */
+
+// The key ndnfs, ndnfs-server and the tools sign with
+#define DEFAULT_KEY_NAME "/testname/DSK-123"
+
+// The largest Data packet forwarders take (getMaxNdnPacketSize of ndn-cpp)
+#define MAX_NDN_PACKET_SIZE 8800
+// Size of an RSA signature by the default (2048-bit) key, for when the signer is not loaded
+#define DEFAULT_RSA_SIGNATURE_SIZE 256
+
+/**
+ * certificate_name returns the name of the certificate of key_name, the way ndnfs names it:
+ * /testname/DSK-123 becomes /testname/KEY/DSK-123/ID-CERT/0.
+ */
+ndn::Name certificate_name(const ndn::Name &key_name);
+
+/**
+ * load_signer parses private_key_der (PKCS #1 RSAPrivateKey) and prepares the signature
+ * of certificate_name.
+ * @return 0 on success, -1 if the key cannot be parsed
+ */
+int load_signer(const uint8_t *private_key_der, size_t key_size, const ndn::Name &certificate_name);
+
+bool signer_loaded();
+
+/**
+ * prepare_packet sets the prepared signature on data, before data is encoded.
+ */
+void prepare_packet(ndn::Data &data);
+
+/**
+ * max_content_size returns the largest content that fits in one Data packet of at most
+ * MAX_NDN_PACKET_SIZE bytes, named version_name followed by a segment number, and signed
+ * by the signer (or with a SHA-256 digest, if digest_only). Segment sizes are capped by it.
+ */
+int max_content_size(const ndn::Name &version_name, bool digest_only);
+
+/**
+ * sign_digest returns the RSA signature of the SHA-256 digest of a signed portion, or
+ * an empty Blob (after logging the error) if RSA_sign fails; the caller then signs the
+ * packet another way or leaves it unsigned, never stores the empty signature.
+ */
+ndn::Blob sign_digest(const uint8_t *digest);
+
+#endif
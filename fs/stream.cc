@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "stream.h"
+#include "publish.h"
+#include "signature-states.h"
+
+#include <map>
+#include <vector>
+#include <atomic>
+#include <sys/stat.h>
+
+using namespace std;
+
+struct stream_state {
+  stream_state() : ready(false)
+  {
+    pthread_mutex_init(&lock, NULL);
+  }
+
+  ~stream_state()
+  {
+    pthread_mutex_destroy(&lock);
+  }
+
+  // Held while the version is created, while segments are signed, and while the stream ends;
+  // writes to other files never wait for it
+  pthread_mutex_t lock;
+  // Whether begin_stream created the version; the fields below are only set then
+  bool ready;
+  int64_t version;
+  ndn::Name name;
+  // The final size of a stream is unknown, so it always uses ndnfs::seg_size (if its name leaves room)
+  int seg_size;
+  // Segments [0, signed_segments) are full, and signed in this version
+  int64_t signed_segments;
+};
+
+typedef ndn::ptr_lib::shared_ptr<stream_state> stream_ptr;
+
+// Only looked up and changed under stream_states_lock, along with the writers of each stream
+static map<string, pair<stream_ptr, int> > stream_states;
+static pthread_mutex_t stream_states_lock = PTHREAD_MUTEX_INITIALIZER;
+// Size of stream_states; writes skip the lock while no file is being streamed
+static atomic<int> stream_count(0);
+
+static stream_ptr find_stream(const char *path)
+{
+  if (stream_count.load() == 0)
+    return stream_ptr();
+
+  pthread_mutex_lock(&stream_states_lock);
+  map<string, pair<stream_ptr, int> >::iterator it = stream_states.find(path);
+  stream_ptr state;
+  if (it != stream_states.end())
+    state = it->second.first;
+  pthread_mutex_unlock(&stream_states_lock);
+  return state;
+}
+
+static void drop_stream(const char *path, const stream_ptr &state)
+{
+  pthread_mutex_lock(&stream_states_lock);
+  map<string, pair<stream_ptr, int> >::iterator it = stream_states.find(path);
+  if (it != stream_states.end() && it->second.first == state) {
+    stream_states.erase(it);
+    stream_count --;
+  }
+  pthread_mutex_unlock(&stream_states_lock);
+}
+
+bool is_stream_path(const char *path)
+{
+  string file_path(path);
+  for (vector<string>::iterator it = ndnfs::stream_dirs.begin(); it != ndnfs::stream_dirs.end(); ++it) {
+    if (*it == "/" ||
+        (file_path.compare(0, it->size(), *it) == 0 && file_path.size() > it->size() && file_path[it->size()] == '/'))
+      return true;
+  }
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT streaming FROM file_system WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  bool streaming = (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) != 0);
+  sqlite3_finalize(stmt);
+
+  return streaming;
+}
+
+int set_stream_flag(const char *path, bool streaming)
+{
+  FILE_LOG(LOG_DEBUG) << "set_stream_flag: path=" << path << ", streaming=" << streaming << endl;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "UPDATE file_system SET streaming = ? WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_int(stmt, 1, streaming ? 1 : 0);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  return sqlite3_changes(db) > 0 ? 0 : -ENOENT;
+}
+
+static int sign_stream_segment(const ndn::Name &name, const char *path, int64_t version, int seg_size, int fd, int64_t seg)
+{
+  vector<char> buf(seg_size);
+  int size = pread(fd, &buf[0], seg_size, segment_to_size(seg, seg_size));
+  if (size == -1) {
+    FILE_LOG(LOG_ERROR) << "sign_stream_segment: read error. Errno: " << errno << endl;
+    return -errno;
+  }
+  sign_segment(name, path, version, seg, &buf[0], size);
+  return size;
+}
+
+int begin_stream(const char *path)
+{
+  pthread_mutex_lock(&stream_states_lock);
+  map<string, pair<stream_ptr, int> >::iterator it = stream_states.find(path);
+  if (it != stream_states.end()) {
+    it->second.second ++;
+    pthread_mutex_unlock(&stream_states_lock);
+    return 0;
+  }
+  // Writes of path wait for the version below
+  stream_ptr state(new stream_state());
+  pthread_mutex_lock(&state->lock);
+  stream_states[path] = make_pair(state, 1);
+  stream_count ++;
+  pthread_mutex_unlock(&stream_states_lock);
+
+  // A stream supersedes whatever publish of the path is pending
+  cancel_publish(path);
+
+  int64_t version = new_version(path);
+  ndn::Name name = version_name(path, version);
+  int seg_size = choose_seg_size(0, name);
+
+  begin_transaction();
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT INTO file_versions (path, version, seg_size, signature_type) VALUES (?,?,?,?);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  sqlite3_bind_int(stmt, 3, seg_size);
+  sqlite3_bind_int(stmt, 4, ndnfs::signature_type);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  sqlite3_prepare_v2(db, "UPDATE file_system SET current_version = ?, ready_signed = ? WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, version);
+  sqlite3_bind_int(stmt, 2, STREAMING);
+  sqlite3_bind_text(stmt, 3, path, -1, SQLITE_STATIC);
+  int res = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (res != SQLITE_OK && res != SQLITE_DONE) {
+    FILE_LOG(LOG_ERROR) << "begin_stream: update file_system error. " << res << endl;
+    end_transaction();
+    // Writers that joined meanwhile write as to any other file
+    drop_stream(path, state);
+    pthread_mutex_unlock(&state->lock);
+    return -EIO;
+  }
+  log_dir_change(path, DIR_CHANGE_MODIFIED);
+  end_transaction();
+
+  state->version = version;
+  state->name = name;
+  state->seg_size = seg_size;
+  state->signed_segments = 0;
+  state->ready = true;
+  pthread_mutex_unlock(&state->lock);
+
+  FILE_LOG(LOG_DEBUG) << "begin_stream: path=" << path << ", version=" << version << endl;
+  return 0;
+}
+
+bool stream_write(const char *path, int fd, off_t offset, size_t size)
+{
+  stream_ptr ptr = find_stream(path);
+  if (!ptr)
+    return false;
+  stream_state &state = *ptr;
+
+  pthread_mutex_lock(&state.lock);
+  struct stat st;
+  if (!state.ready || size == 0 || fstat(fd, &st) == -1) {
+    pthread_mutex_unlock(&state.lock);
+    return true;
+  }
+
+  // Overwritten segments that are already signed get signed again
+  int64_t first = seek_segment(offset, state.seg_size);
+  int64_t last = seek_segment(offset + size - 1, state.seg_size);
+  for (int64_t seg = first; seg <= last && seg < state.signed_segments; seg ++) {
+    sign_stream_segment(state.name, path, state.version, state.seg_size, fd, seg);
+  }
+
+  // Then every segment that's now complete
+  int64_t complete = seek_segment(st.st_size, state.seg_size);
+  for (int64_t seg = state.signed_segments; seg < complete; seg ++) {
+    if (sign_stream_segment(state.name, path, state.version, state.seg_size, fd, seg) < 0)
+      break;
+    state.signed_segments = seg + 1;
+  }
+
+  pthread_mutex_unlock(&state.lock);
+  return true;
+}
+
+bool stream_truncate(const char *path, off_t length)
+{
+  stream_ptr state = find_stream(path);
+  if (!state)
+    return false;
+
+  pthread_mutex_lock(&state->lock);
+  if (state->ready) {
+    int64_t complete = seek_segment(length, state->seg_size);
+    if (state->signed_segments > complete)
+      state->signed_segments = complete;
+  }
+  pthread_mutex_unlock(&state->lock);
+  return true;
+}
+
+bool is_streaming(const char *path)
+{
+  return (bool)find_stream(path);
+}
+
+int end_stream(const char *path)
+{
+  if (stream_count.load() == 0)
+    return 0;
+
+  pthread_mutex_lock(&stream_states_lock);
+  map<string, pair<stream_ptr, int> >::iterator it = stream_states.find(path);
+  if (it == stream_states.end()) {
+    pthread_mutex_unlock(&stream_states_lock);
+    return 0;
+  }
+  if (-- it->second.second > 0) {
+    pthread_mutex_unlock(&stream_states_lock);
+    return 0;
+  }
+  stream_ptr ptr = it->second.first;
+  stream_states.erase(it);
+  stream_count --;
+  pthread_mutex_unlock(&stream_states_lock);
+
+  // The last writes may still be signing
+  pthread_mutex_lock(&ptr->lock);
+  bool ready = ptr->ready;
+  int64_t version = ptr->version;
+  ndn::Name name = ptr->name;
+  int seg_size = ptr->seg_size;
+  int64_t seg = ptr->signed_segments;
+  pthread_mutex_unlock(&ptr->lock);
+  if (!ready)
+    return 0;
+
+  char full_path[PATH_MAX];
+  abs_path(full_path, path);
+
+  int fd = open(full_path, O_RDONLY);
+  if (fd == -1) {
+    FILE_LOG(LOG_ERROR) << "end_stream: open error. Errno: " << errno << endl;
+    return -errno;
+  }
+
+  // Sign the tail, the same way publish_file ends a version
+  int size = seg_size;
+  while (size == seg_size) {
+    size = sign_stream_segment(name, path, version, seg_size, fd, seg);
+    if (size < 0) {
+      close(fd);
+      return size;
+    }
+    seg ++;
+  }
+
+  struct stat st;
+  fstat(fd, &st);
+  uint8_t digest[CONTENT_DIGEST_SIZE];
+  int ret = compute_file_digest(fd, digest);
+  close(fd);
+
+  // Segments left over from a truncate
+  remove_segments(path, version, seg);
+
+  begin_transaction();
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "UPDATE file_versions SET size = ?, content_digest = ?, mtime = ? WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, st.st_size);
+  if (ret == 0)
+    sqlite3_bind_blob(stmt, 2, digest, CONTENT_DIGEST_SIZE, SQLITE_STATIC);
+  else
+    sqlite3_bind_null(stmt, 2);
+  sqlite3_bind_int64(stmt, 3, mtime_ns(st));
+  sqlite3_bind_text(stmt, 4, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 5, version);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  sqlite3_prepare_v2(db, "UPDATE file_system SET ready_signed = ? WHERE path = ? AND current_version = ?;", -1, &stmt, 0);
+  sqlite3_bind_int(stmt, 1, READY);
+  sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 3, version);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  feed_append(path, version);
+  tree_entry_changed(path);
+  end_transaction();
+
+  FILE_LOG(LOG_DEBUG) << "end_stream: path=" << path << ", version=" << version << ", segments=" << seg << endl;
+  return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_STREAM_H
+#define NDNFS_STREAM_H
+
+#include "ndnfs.h"
+#include "segment.h"
+#include "version.h"
+
+#define STREAM_XATTR_NAME "user.ndnfs.stream"
+
+/**
+ * Streaming mode is for files that keep growing while being written (logs, recordings).
+ * Opening such a file for write publishes a new version right away, every segment is
+ * signed as soon as ndnfs_write completes it, and the version is finalized on release.
+ * A file is in streaming mode if it's under one of ndnfs::stream_dirs, or if
+ * STREAM_XATTR_NAME is set to "1" on it.
+ *
+ * Each stream has its own lock, held while its segments are signed and while it ends;
+ * the map of streams is only locked to look one up, and not at all while nothing is
+ * streamed, so signing a stream does not hold up writes to other files.
+ */
+bool is_stream_path(const char *path);
+
+int set_stream_flag(const char *path, bool streaming);
+
+/**
+ * begin_stream starts (or joins) the stream of path, and makes its new version current.
+ */
+int begin_stream(const char *path);
+
+/**
+ * stream_write signs the segments completed or overwritten by a write of size bytes at offset.
+ * @param fd Descriptor of the actual file, which the write has already gone to
+ * @return false if path is not being streamed
+ */
+bool stream_write(const char *path, int fd, off_t offset, size_t size);
+
+/**
+ * stream_truncate makes segments after length be signed again.
+ * @return false if path is not being streamed
+ */
+bool stream_truncate(const char *path, off_t length);
+
+bool is_streaming(const char *path);
+
+/**
+ * end_stream drops one writer, and signs the tail and marks the version as ready when the last writer is gone.
+ */
+int end_stream(const char *path);
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "transaction.h"
+
+using namespace std;
+
+static pthread_mutex_t transaction_lock = PTHREAD_MUTEX_INITIALIZER;
+// Depth of the transactions the thread is in
+static __thread int transaction_depth = 0;
+
+void begin_transaction()
+{
+  if (transaction_depth ++ > 0)
+    return;
+
+  pthread_mutex_lock(&transaction_lock);
+  if (sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK) {
+    FILE_LOG(LOG_ERROR) << "begin_transaction: " << sqlite3_errmsg(db) << endl;
+  }
+}
+
+void end_transaction()
+{
+  if (-- transaction_depth > 0)
+    return;
+
+  if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+    FILE_LOG(LOG_ERROR) << "end_transaction: " << sqlite3_errmsg(db) << endl;
+  }
+  pthread_mutex_unlock(&transaction_lock);
+}
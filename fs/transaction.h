@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_TRANSACTION_H
+#define NDNFS_TRANSACTION_H
+
+#include "ndnfs.h"
+
+/**
+ * Transactions on the shared connection: sqlite keeps one transaction per connection, which the
+ * statements of every thread take part in. The statements a thread runs between begin_transaction
+ * and end_transaction are committed at once, and the transactions of different threads run one
+ * after the other; pairs nest within a thread, and the outermost one commits. Statements that
+ * other threads run outside a transaction meanwhile are committed along with it.
+ *
+ * A thread must not begin a transaction while holding a lock that is taken inside transactions
+ * (tree_lock of tree-digest.cc, say): locks are taken after the transaction.
+ */
+void begin_transaction();
+
+void end_transaction();
+
+#endif
@@ -0,0 +1,424 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tree-digest.h"
+#include "version.h"
+#include "file-type.h"
+#include "transaction.h"
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <openssl/sha.h>
+
+using namespace std;
+
+// Sums are read, adjusted and written back; one update at a time, taken inside a transaction
+static pthread_mutex_t tree_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct tree_row {
+  int type;
+  bool has_digest;
+  uint8_t digest[TREE_DIGEST_SIZE];
+  // Only for directories; no entries sum up to zero
+  uint8_t sum[TREE_DIGEST_SIZE];
+};
+
+// Sums are big-endian, modulo 2^256
+static void add_hash(uint8_t *sum, const uint8_t *hash)
+{
+  int carry = 0;
+  for (int i = TREE_DIGEST_SIZE - 1; i >= 0; i --) {
+    int v = sum[i] + hash[i] + carry;
+    sum[i] = v & 0xff;
+    carry = v >> 8;
+  }
+}
+
+static void subtract_hash(uint8_t *sum, const uint8_t *hash)
+{
+  int borrow = 0;
+  for (int i = TREE_DIGEST_SIZE - 1; i >= 0; i --) {
+    int v = sum[i] - hash[i] - borrow;
+    borrow = (v < 0);
+    sum[i] = v & 0xff;
+  }
+}
+
+static void entry_hash(const string &name, int type, const uint8_t *digest, uint8_t *hash)
+{
+  uint8_t type_byte = type;
+  SHA256_CTX ctx;
+  SHA256_Init(&ctx);
+  // With the terminating 0, so that the name ends before the type
+  SHA256_Update(&ctx, name.c_str(), name.size() + 1);
+  SHA256_Update(&ctx, &type_byte, 1);
+  SHA256_Update(&ctx, digest, TREE_DIGEST_SIZE);
+  SHA256_Final(hash, &ctx);
+}
+
+int tree_bucket(const string &name)
+{
+  uint8_t hash[SHA256_DIGEST_LENGTH];
+  SHA256((const uint8_t *)name.c_str(), name.size(), hash);
+  return hash[0] % TREE_BUCKETS;
+}
+
+/**
+ * version_digest reads the digest of a version from the content_digest, version and size
+ * columns of stmt, starting at first_column; versions without a content digest hash the other two.
+ */
+static void version_digest(sqlite3_stmt *stmt, int first_column, uint8_t *digest)
+{
+  if (sqlite3_column_bytes(stmt, first_column) == TREE_DIGEST_SIZE) {
+    memcpy(digest, sqlite3_column_blob(stmt, first_column), TREE_DIGEST_SIZE);
+    return;
+  }
+
+  uint8_t buf[16];
+  int64_t version = sqlite3_column_int64(stmt, first_column + 1);
+  int64_t size = sqlite3_column_int64(stmt, first_column + 2);
+  for (int i = 0; i < 8; i ++) {
+    buf[i] = (version >> (56 - 8 * i)) & 0xff;
+    buf[8 + i] = (size >> (56 - 8 * i)) & 0xff;
+  }
+  SHA256(buf, sizeof(buf), digest);
+}
+
+static void file_digest(const string &path, uint8_t *digest)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT v.content_digest, v.version, v.size FROM file_system f \
+                          JOIN file_versions v ON v.path = f.path AND v.version = f.current_version WHERE f.path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    version_digest(stmt, 0, digest);
+  else
+    memset(digest, 0, TREE_DIGEST_SIZE);
+  sqlite3_finalize(stmt);
+}
+
+static bool read_tree_row(const string &path, tree_row &row)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT type, tree_digest, tree_sum FROM file_system WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  bool found = (sqlite3_step(stmt) == SQLITE_ROW);
+  if (found) {
+    row.type = sqlite3_column_int(stmt, 0);
+    row.has_digest = (sqlite3_column_bytes(stmt, 1) == TREE_DIGEST_SIZE);
+    if (row.has_digest)
+      memcpy(row.digest, sqlite3_column_blob(stmt, 1), TREE_DIGEST_SIZE);
+    if (sqlite3_column_bytes(stmt, 2) == TREE_DIGEST_SIZE)
+      memcpy(row.sum, sqlite3_column_blob(stmt, 2), TREE_DIGEST_SIZE);
+    else
+      memset(row.sum, 0, TREE_DIGEST_SIZE);
+  }
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+// A NULL digest marks an entry that is not part of the sum of its parent; the root has no bucket (-1)
+static void write_digest(const string &path, const uint8_t *digest, int bucket)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "UPDATE file_system SET tree_digest = ?, tree_version = ?, tree_bucket = ? WHERE path = ?;", -1, &stmt, 0);
+  if (digest != NULL)
+    sqlite3_bind_blob(stmt, 1, digest, TREE_DIGEST_SIZE, SQLITE_STATIC);
+  else
+    sqlite3_bind_null(stmt, 1);
+  if (digest != NULL && bucket >= 0)
+    sqlite3_bind_int(stmt, 3, bucket);
+  else
+    sqlite3_bind_null(stmt, 3);
+  sqlite3_bind_int64(stmt, 2, version_now());
+  sqlite3_bind_text(stmt, 4, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+static void write_sum(const string &path, const uint8_t *sum)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "UPDATE file_system SET tree_sum = ? WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_blob(stmt, 1, sum, TREE_DIGEST_SIZE, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+static void write_bucket(const string &dir, int bucket, const uint8_t *sum, int64_t count, int64_t version)
+{
+  sqlite3_stmt *stmt;
+  // Empty buckets have no row
+  if (count <= 0) {
+    sqlite3_prepare_v2(db, "DELETE FROM tree_buckets WHERE path = ? AND bucket = ?;", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, dir.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, bucket);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    return;
+  }
+
+  uint8_t digest[TREE_DIGEST_SIZE];
+  SHA256(sum, TREE_DIGEST_SIZE, digest);
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO tree_buckets (path, bucket, sum, digest, count, tree_version) VALUES (?,?,?,?,?,?);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, dir.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, bucket);
+  sqlite3_bind_blob(stmt, 3, sum, TREE_DIGEST_SIZE, SQLITE_STATIC);
+  sqlite3_bind_blob(stmt, 4, digest, TREE_DIGEST_SIZE, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 5, count);
+  sqlite3_bind_int64(stmt, 6, version);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+/**
+ * update_bucket takes removed (if not NULL) out of the sum of the bucket of dir, and adds added (if not NULL).
+ */
+static void update_bucket(const string &dir, int bucket, const uint8_t *removed, const uint8_t *added)
+{
+  uint8_t sum[TREE_DIGEST_SIZE];
+  int64_t count = 0;
+  memset(sum, 0, TREE_DIGEST_SIZE);
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT sum, count FROM tree_buckets WHERE path = ? AND bucket = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, dir.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, bucket);
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_bytes(stmt, 0) == TREE_DIGEST_SIZE) {
+    memcpy(sum, sqlite3_column_blob(stmt, 0), TREE_DIGEST_SIZE);
+    count = sqlite3_column_int64(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+
+  if (removed != NULL) {
+    subtract_hash(sum, removed);
+    count --;
+  }
+  if (added != NULL) {
+    add_hash(sum, added);
+    count ++;
+  }
+  write_bucket(dir, bucket, sum, count, version_now());
+}
+
+/**
+ * update_digests recomputes the digest of path, replaces it in the sum of the parent,
+ * and goes on with the parent until a digest is unchanged, or the root is reached.
+ */
+static void update_digests(const string &path)
+{
+  string current = path;
+  int updated = 0;
+  while (true) {
+    tree_row row;
+    if (!read_tree_row(current, row))
+      break;
+
+    uint8_t digest[TREE_DIGEST_SIZE];
+    if (row.type == DIRECTORY)
+      SHA256(row.sum, TREE_DIGEST_SIZE, digest);
+    else
+      file_digest(current, digest);
+    if (row.has_digest && memcmp(row.digest, digest, TREE_DIGEST_SIZE) == 0)
+      break;
+
+    string parent, name;
+    bool root = (split_last_component(current, parent, name) == -1 || name.empty());
+    tree_row parent_row;
+    if (!root && !read_tree_row(parent, parent_row)) {
+      // Not summed anywhere, so no digest either, like init_tree_digests leaves it
+      if (row.has_digest)
+        write_digest(current, NULL, -1);
+      break;
+    }
+    int bucket = root ? -1 : tree_bucket(name);
+    write_digest(current, digest, bucket);
+    updated ++;
+    if (root)
+      break;
+
+    // A digest is only ever written along with its hash in the sum of the parent
+    uint8_t old_hash[TREE_DIGEST_SIZE], hash[TREE_DIGEST_SIZE];
+    if (row.has_digest) {
+      entry_hash(name, row.type, row.digest, old_hash);
+      subtract_hash(parent_row.sum, old_hash);
+    }
+    entry_hash(name, row.type, digest, hash);
+    add_hash(parent_row.sum, hash);
+    write_sum(parent, parent_row.sum);
+    update_bucket(parent, bucket, row.has_digest ? old_hash : NULL, hash);
+    current = parent;
+  }
+
+  FILE_LOG(LOG_DEBUG) << "update_digests: " << path << ", " << updated << " digests updated" << endl;
+}
+
+void tree_entry_changed(const char *path)
+{
+  // The few statements per directory above path are committed at once
+  begin_transaction();
+  pthread_mutex_lock(&tree_lock);
+  update_digests(path);
+  pthread_mutex_unlock(&tree_lock);
+  end_transaction();
+}
+
+void tree_entry_removed(const char *path)
+{
+  string parent, name;
+  if (split_last_component(path, parent, name) == -1 || name.empty())
+    return;
+
+  begin_transaction();
+  pthread_mutex_lock(&tree_lock);
+  tree_row row, parent_row;
+  if (read_tree_row(path, row) && row.has_digest && read_tree_row(parent, parent_row)) {
+    uint8_t hash[TREE_DIGEST_SIZE];
+    entry_hash(name, row.type, row.digest, hash);
+    subtract_hash(parent_row.sum, hash);
+    write_sum(parent, parent_row.sum);
+    update_bucket(parent, tree_bucket(name), hash, NULL);
+    write_digest(path, NULL, -1);
+    update_digests(parent);
+  }
+  pthread_mutex_unlock(&tree_lock);
+  end_transaction();
+}
+
+struct tree_node {
+  string path;
+  string parent;
+  int type;
+  int depth;
+  uint8_t digest[TREE_DIGEST_SIZE];
+  uint8_t sum[TREE_DIGEST_SIZE];
+};
+
+struct bucket_sum {
+  uint8_t sum[TREE_DIGEST_SIZE];
+  int64_t count;
+};
+
+static bool deeper(const tree_node *a, const tree_node *b)
+{
+  return a->depth > b->depth;
+}
+
+void init_tree_digests()
+{
+  tree_row root;
+  if (!read_tree_row("/", root) || root.has_digest)
+    return;
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  begin_transaction();
+  pthread_mutex_lock(&tree_lock);
+
+  vector<tree_node> nodes;
+  map<string, size_t> dirs;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT f.path, f.parent, f.type, v.content_digest, v.version, v.size FROM file_system f \
+                          LEFT JOIN file_versions v ON v.path = f.path AND v.version = f.current_version;", -1, &stmt, 0);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    tree_node node;
+    node.path = (const char *)sqlite3_column_text(stmt, 0);
+    if (sqlite3_column_type(stmt, 1) != SQLITE_NULL)
+      node.parent = (const char *)sqlite3_column_text(stmt, 1);
+    node.type = sqlite3_column_int(stmt, 2);
+    // The root comes after everything else
+    node.depth = (node.path == "/") ? 0 : count(node.path.begin(), node.path.end(), '/');
+    memset(node.sum, 0, TREE_DIGEST_SIZE);
+    if (node.type == DIRECTORY)
+      dirs[node.path] = nodes.size();
+    else if (sqlite3_column_type(stmt, 4) != SQLITE_NULL)
+      version_digest(stmt, 3, node.digest);
+    else
+      memset(node.digest, 0, TREE_DIGEST_SIZE);
+    nodes.push_back(node);
+  }
+  sqlite3_finalize(stmt);
+
+  // Entries below a directory are summed up before it
+  vector<tree_node *> order;
+  for (size_t i = 0; i < nodes.size(); i ++)
+    order.push_back(&nodes[i]);
+  stable_sort(order.begin(), order.end(), deeper);
+
+  sqlite3_stmt *update;
+  sqlite3_prepare_v2(db, "UPDATE file_system SET tree_digest = ?, tree_sum = ?, tree_version = ?, tree_bucket = ? WHERE path = ?;", -1, &update, 0);
+  int64_t version = version_now();
+  // By directory (index in nodes) and bucket
+  map<pair<size_t, int>, bucket_sum> buckets;
+  for (size_t i = 0; i < order.size(); i ++) {
+    tree_node &node = *order[i];
+    if (node.type == DIRECTORY)
+      SHA256(node.sum, TREE_DIGEST_SIZE, node.digest);
+
+    string parent, name;
+    split_last_component(node.path, parent, name);
+    map<string, size_t>::iterator it = dirs.find(node.parent);
+    bool in_parent = (it != dirs.end() && node.path != "/");
+    int bucket = tree_bucket(name);
+    if (in_parent) {
+      uint8_t hash[TREE_DIGEST_SIZE];
+      entry_hash(name, node.type, node.digest, hash);
+      add_hash(nodes[it->second].sum, hash);
+
+      map<pair<size_t, int>, bucket_sum>::iterator b = buckets.find(make_pair(it->second, bucket));
+      if (b == buckets.end()) {
+        b = buckets.insert(make_pair(make_pair(it->second, bucket), bucket_sum())).first;
+        memset(b->second.sum, 0, TREE_DIGEST_SIZE);
+        b->second.count = 0;
+      }
+      add_hash(b->second.sum, hash);
+      b->second.count ++;
+    }
+
+    // Entries without a parent directory are left out, as tree_entry_removed leaves them
+    if (in_parent || node.path == "/")
+      sqlite3_bind_blob(update, 1, node.digest, TREE_DIGEST_SIZE, SQLITE_STATIC);
+    else
+      sqlite3_bind_null(update, 1);
+    if (node.type == DIRECTORY)
+      sqlite3_bind_blob(update, 2, node.sum, TREE_DIGEST_SIZE, SQLITE_STATIC);
+    else
+      sqlite3_bind_null(update, 2);
+    sqlite3_bind_int64(update, 3, version);
+    if (in_parent)
+      sqlite3_bind_int(update, 4, bucket);
+    else
+      sqlite3_bind_null(update, 4);
+    sqlite3_bind_text(update, 5, node.path.c_str(), -1, SQLITE_STATIC);
+    sqlite3_step(update);
+    sqlite3_reset(update);
+  }
+  sqlite3_finalize(update);
+
+  sqlite3_exec(db, "DELETE FROM tree_buckets;", NULL, NULL, NULL);
+  for (map<pair<size_t, int>, bucket_sum>::iterator b = buckets.begin(); b != buckets.end(); ++b)
+    write_bucket(nodes[b->first.first].path, b->first.second, b->second.sum, b->second.count, version);
+
+  pthread_mutex_unlock(&tree_lock);
+  end_transaction();
+  struct timeval stop;
+  gettimeofday(&stop, NULL);
+  int64_t elapsed_us = (int64_t)(stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+  FILE_LOG(LOG_DEBUG) << "init_tree_digests: " << nodes.size() << " entries in " << elapsed_us / 1000 << " ms" << endl;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_TREE_DIGEST_H
+#define NDNFS_TREE_DIGEST_H
+
+#include "ndnfs.h"
+#include "tree-buckets.h"
+
+#define TREE_DIGEST_SIZE 32
+
+/**
+ * Tree digests: every entry of file_system carries a digest of what it holds, so that two trees
+ * can be compared from the root down, only descending into directories whose digests differ.
+ * The digest of a file is the content digest of its current version; a directory keeps in
+ * tree_sum the sum (mod 2^256) of SHA-256(name, type, digest) over its entries, and its digest
+ * is the SHA-256 of that sum. Adding, removing or changing an entry thus updates its parent in
+ * constant time, and the update goes up to the root.
+ *
+ * Versions are left out, as they are the local publish time: a mirror of the same content has the
+ * same digests. Versions without a content digest (streamed versions, until they are complete)
+ * are hashed with their version and size instead.
+ *
+ * tree_version is the time (in microseconds) the digest of the entry last changed; ndnfs-server
+ * serves the node of each directory under <dir>/%C1.FS.tree/<tree_version>.
+ *
+ * The entries of a directory are also spread over TREE_BUCKETS buckets by a hash of their names
+ * (file_system.tree_bucket), and the tree_buckets table keeps the sum, digest, number of entries
+ * and tree_version of each bucket that is not empty. A large directory is served as the digests of
+ * its buckets, and each bucket as its entries, so a change in it only rebuilds the bucket it's in.
+ *
+ * An entry has a digest only while it is summed up in its parent; all the updates of one change
+ * are made in one transaction.
+ */
+
+/**
+ * tree_bucket returns the bucket of the entry with the given name in its directory.
+ */
+int tree_bucket(const std::string &name);
+
+/**
+ * tree_entry_changed recomputes the digest of path after its current version changed, or after
+ * it was added, and updates the directories above it.
+ */
+void tree_entry_changed(const char *path);
+
+/**
+ * tree_entry_removed takes path out of the digest of its parent, before its entry is deleted
+ * or moved; the entry keeps its own sum, so that a moved directory is added back as it is.
+ */
+void tree_entry_removed(const char *path);
+
+/**
+ * init_tree_digests computes all the digests at mount, if the root has none yet (databases
+ * created before tree digests, or loaded by ndnfs-import).
+ */
+void init_tree_digests();
+
+#endif
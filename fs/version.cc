@@ -20,6 +20,13 @@
  */
 
 #include "version.h"
+#include "mime-inference.h"
+#include "dir-changes.h"
+#include "tree-digest.h"
+#include "feed.h"
+#include "file-type.h"
+#include "signature-states.h"
+#include "link.h"
 
 #include <ndn-cpp/data.hpp>
 #include <ndn-cpp/common.hpp>
@@ -27,28 +34,76 @@
 using namespace std;
 using namespace ndn;
 
+int64_t version_now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+int64_t latest_version(const char *path)
+{
+  int64_t ver = -1;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (db, "SELECT MAX(version) FROM file_versions WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text (stmt, 1, path, -1, SQLITE_STATIC);
+  if (sqlite3_step (stmt) == SQLITE_ROW && sqlite3_column_type (stmt, 0) != SQLITE_NULL)
+    ver = sqlite3_column_int64 (stmt, 0);
+  sqlite3_finalize (stmt);
+
+  return ver;
+}
+
+int64_t new_version(const char *path)
+{
+  int64_t ver = version_now();
+
+  // Clock going backwards, or two versions within the same microsecond
+  int64_t last_ver = latest_version(path);
+  if (ver <= last_ver)
+    ver = last_ver + 1;
+
+  return ver;
+}
+
+int version_seg_size(const char *path, const int64_t ver)
+{
+  int seg_size = DEFAULT_SEG_SIZE;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2 (db, "SELECT seg_size FROM file_versions WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_bind_text (stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64 (stmt, 2, ver);
+  if (sqlite3_step (stmt) == SQLITE_ROW && sqlite3_column_int (stmt, 0) > 0)
+    seg_size = sqlite3_column_int (stmt, 0);
+  sqlite3_finalize (stmt);
+
+  return seg_size;
+}
+
 // duplicate_version right now is a stub
-int duplicate_version (const char *path, const int from_ver, const int to_ver)
+int duplicate_version (const char *path, const int64_t from_ver, const int64_t to_ver)
 {
   FILE_LOG(LOG_DEBUG) << "duplicate_version need to be reimplemented." << endl;
   return 0;
 }
 
 // write_version's function will be redefined
-int write_version(const char* path, int ver, const char *buf, size_t size, off_t offset)
+int write_version(const char* path, int64_t ver, const char *buf, size_t size, off_t offset)
 {
   FILE_LOG(LOG_ERROR) << "write_version need to be reimplemented." << endl;
   return 0;
 }
 
-int truncate_version(const char* path, const int ver, off_t length)
+int truncate_version(const char* path, const int64_t ver, off_t length)
 {
   FILE_LOG(LOG_DEBUG) << "truncate_version: path=" << path << std::dec << ", ver=" << ver << ", length=" << length << endl;
 
   sqlite3_stmt *stmt;
-  sqlite3_prepare_v2 (db, "SELECT * FROM file_versions WHERE path = ? AND version = ?;", -1, &stmt, 0);
+  sqlite3_prepare_v2 (db, "SELECT size FROM file_versions WHERE path = ? AND version = ?;", -1, &stmt, 0);
   sqlite3_bind_text (stmt, 1, path, -1, SQLITE_STATIC);
-  sqlite3_bind_int (stmt, 2, ver);
+  sqlite3_bind_int64 (stmt, 2, ver);
 
   if (sqlite3_step (stmt) != SQLITE_ROW) {
     // Should not happen
@@ -56,28 +111,28 @@ int truncate_version(const char* path, const int ver, off_t length)
     return -1;
   }
   
-  int size = sqlite3_column_int (stmt, 2);
+  off_t size = sqlite3_column_int64 (stmt, 0);
   sqlite3_finalize (stmt);
+  int seg_size = version_seg_size (path, ver);
   
-  if ((size_t) length == size) {
+  if (length == size) {
     return 0;
   }
-  else if ((size_t) length < size) {
+  else if (length < size) {
     // Truncate to length
-    int seg_end = seek_segment (length);
+    int64_t seg_end = seek_segment (length, seg_size);
 
-    sqlite3_prepare_v2 (db, "UPDATE file_versions SET size = ?, totalSegments = ? WHERE path = ? and version = ?;", -1, &stmt, 0);
-    sqlite3_bind_int (stmt, 1, (int) length);
-    sqlite3_bind_int (stmt, 2, seg_end);
-    sqlite3_bind_text (stmt, 3, path, -1, SQLITE_STATIC);
-    sqlite3_bind_int (stmt, 4, ver);
+    sqlite3_prepare_v2 (db, "UPDATE file_versions SET size = ? WHERE path = ? and version = ?;", -1, &stmt, 0);
+    sqlite3_bind_int64 (stmt, 1, length);
+    sqlite3_bind_text (stmt, 2, path, -1, SQLITE_STATIC);
+    sqlite3_bind_int64 (stmt, 3, ver);
     int res = sqlite3_step (stmt);
     sqlite3_finalize (stmt);
     if (res != SQLITE_OK && res != SQLITE_DONE)
       return -1;
 
     // Update version size and segment list
-    int tail = length - segment_to_size (seg_end);
+    off_t tail = length - segment_to_size (seg_end, seg_size);
     
     truncate_segment (path, ver, seg_end, tail);
     remove_segments (path, ver, seg_end + 1);
@@ -90,7 +145,7 @@ int truncate_version(const char* path, const int ver, off_t length)
   }
 }
 
-void remove_version(const char* path, const int ver)
+void remove_version(const char* path, const int64_t ver)
 {
   FILE_LOG(LOG_DEBUG) << "remove_version: path=" << path << ", ver=" << std::dec << ver << endl;
 
@@ -98,16 +153,54 @@ void remove_version(const char* path, const int ver)
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2(db, "DELETE FROM file_versions WHERE path = ? and version = ?;", -1, &stmt, 0);
   sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
-  sqlite3_bind_int(stmt, 2, ver);
+  sqlite3_bind_int64(stmt, 2, ver);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 }
 
 void remove_file_entry(const char* path)
 {
+  tree_entry_removed(path);
+  feed_remove(path);
+  remove_pending_link(path);
+
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2(db, "DELETE FROM file_system WHERE path = ?;", -1, &stmt, 0);
   sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
   sqlite3_step(stmt);
+  bool removed = (sqlite3_changes(db) > 0);
   sqlite3_finalize(stmt);
+  // The buckets of a directory go with it
+  sqlite3_prepare_v2(db, "DELETE FROM tree_buckets WHERE path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (removed)
+    log_dir_change(path, DIR_CHANGE_REMOVED);
+}
+
+void add_file_entry(const char* path, enum FileType type)
+{
+  char mime_type[100] = "";
+  if (type != DIRECTORY)
+    mime_infer(mime_type, path);
+
+  string parent, name;
+  split_last_component(path, parent, name);
+
+  // Same entry as ndnfs_mknod, publish_file sets the current version
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO file_system (path, mime_type, ready_signed, type, parent) VALUES (?, ?, ?, ?, ?);", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, mime_type, -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 3, NOT_READY);
+  sqlite3_bind_int(stmt, 4, type);
+  sqlite3_bind_text(stmt, 5, parent.c_str(), -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  bool added = (sqlite3_changes(db) > 0);
+  sqlite3_finalize(stmt);
+  if (added) {
+    log_dir_change(path, DIR_CHANGE_ADDED);
+    tree_entry_changed(path);
+  }
 }
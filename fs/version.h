@@ -23,14 +23,37 @@
 
 #include "ndnfs.h"
 #include "segment.h"
+#include "file-type.h"
 
-int duplicate_version (const char *path, const int from_ver, const int to_ver);
+/**
+ * Versions are microseconds since epoch, and are strictly increasing per path,
+ * so that a file can be published more than once within a second.
+ */
+int64_t version_now();
 
-int write_version(const char* path, int ver, const char *buf, size_t size, off_t offset);
+/**
+ * latest_version returns the greatest version of path, or -1 if it has none.
+ */
+int64_t latest_version(const char *path);
 
-int truncate_version(const char* path, const int ver, off_t length);
+/**
+ * new_version returns a version of path that is greater than all its existing versions.
+ */
+int64_t new_version(const char *path);
 
-void remove_version(const char* path, const int ver);
+/**
+ * version_seg_size returns the segment size ver of path was signed with.
+ * Versions without one were created before it was configurable.
+ */
+int version_seg_size(const char *path, const int64_t ver);
+
+int duplicate_version (const char *path, const int64_t from_ver, const int64_t to_ver);
+
+int write_version(const char* path, int64_t ver, const char *buf, size_t size, off_t offset);
+
+int truncate_version(const char* path, const int64_t ver, off_t length);
+
+void remove_version(const char* path, const int64_t ver);
 
 /**
  * Remove file entry removes the file entry from file_system table, 
@@ -39,4 +62,11 @@ void remove_version(const char* path, const int ver);
  */
 void remove_file_entry(const char* path);
 
+/**
+ * add_file_entry adds a file_system entry for a file or directory that was created
+ * outside of the mount (see scan.h and watch.h), for a link (see link.h), or for a
+ * directory made through the mount, unless path has one already.
+ */
+void add_file_entry(const char* path, enum FileType type = REGULAR);
+
 #endif
@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "watch.h"
+#include "publish.h"
+#include "stream.h"
+#include "file-type.h"
+#include "scan.h"
+
+#include <map>
+#include <set>
+#include <vector>
+#include <poll.h>
+#include <sys/stat.h>
+
+#ifndef NDNFS_OSXFUSE
+#include <sys/inotify.h>
+#endif
+
+using namespace std;
+
+#ifndef NDNFS_OSXFUSE
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+static int inotify_fd = -1;
+// Watch descriptors and the directories they watch, relative to root_path ("" is the root)
+static map<int, string> watched_dirs;
+static set<string> changed_paths;
+
+static pthread_t watch_thread;
+static bool watch_running = false;
+static volatile bool watch_stop = false;
+
+static int64_t events_seen = 0;
+
+static int64_t now_ms()
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+/**
+ * watch_tree adds a watch on dir and the directories under it. With mark_files,
+ * dir and everything under it are marked as changed as well (dir was created or moved in).
+ */
+static void watch_tree(const string &dir, bool mark_files)
+{
+  char full_path[PATH_MAX];
+  abs_path(full_path, dir.c_str());
+
+  int wd = inotify_add_watch(inotify_fd, full_path, WATCH_EVENTS | IN_ONLYDIR);
+  if (wd == -1) {
+    FILE_LOG(LOG_ERROR) << "watch_tree: inotify_add_watch error. Path: " << full_path << ", errno: " << errno << endl;
+    return;
+  }
+  watched_dirs[wd] = dir;
+  // So that the directory gets its entry
+  if (mark_files)
+    changed_paths.insert(dir);
+
+  DIR *dp = opendir(full_path);
+  if (dp == NULL)
+    return;
+
+  struct dirent *de;
+  while ((de = readdir(dp)) != NULL) {
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+      continue;
+
+    bool is_dir = (de->d_type == DT_DIR);
+    if (de->d_type == DT_UNKNOWN) {
+      struct stat st;
+      is_dir = (fstatat(dirfd(dp), de->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode));
+    }
+
+    string path = dir + "/" + de->d_name;
+    if (is_dir)
+      watch_tree(path, mark_files);
+    else if (mark_files)
+      changed_paths.insert(path);
+  }
+  closedir(dp);
+}
+
+/**
+ * unwatch_tree drops the watches of dir and the directories under it, and marks the
+ * entries under dir as changed, so that the ones whose file is gone get removed.
+ */
+static void unwatch_tree(const string &dir)
+{
+  string prefix = dir + "/";
+  for (map<int, string>::iterator it = watched_dirs.begin(); it != watched_dirs.end(); ) {
+    if (it->second == dir || it->second.compare(0, prefix.size(), prefix) == 0) {
+      inotify_rm_watch(inotify_fd, it->first);
+      watched_dirs.erase(it ++);
+    } else {
+      it ++;
+    }
+  }
+
+  changed_paths.insert(dir);
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT path FROM file_system WHERE path > ? AND path < ?;", -1, &stmt, 0);
+  // Paths under dir sort between "dir/" and "dir0" ('0' follows '/')
+  string end = dir + "0";
+  sqlite3_bind_text(stmt, 1, prefix.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, end.c_str(), -1, SQLITE_STATIC);
+  while (sqlite3_step(stmt) == SQLITE_ROW)
+    changed_paths.insert((const char *)sqlite3_column_text(stmt, 0));
+  sqlite3_finalize(stmt);
+}
+
+static void handle_event(const struct inotify_event *event)
+{
+  events_seen ++;
+
+  if (event->mask & IN_Q_OVERFLOW) {
+    // Directories created meanwhile have no watch yet; adding a watch again keeps the same one
+    FILE_LOG(LOG_ERROR) << "handle_event: inotify queue overflow, scanning the actual folder for the changes missed" << endl;
+    watch_tree("", false);
+    rescan();
+    return;
+  }
+  if (event->mask & IN_IGNORED) {
+    // The directory was removed (or moved out, after unwatch_tree)
+    watched_dirs.erase(event->wd);
+    return;
+  }
+
+  map<int, string>::iterator it = watched_dirs.find(event->wd);
+  if (it == watched_dirs.end() || event->len == 0)
+    return;
+  string path = it->second + "/" + event->name;
+
+  if (event->mask & IN_ISDIR) {
+    if (event->mask & (IN_CREATE | IN_MOVED_TO))
+      watch_tree(path, true);
+    else if (event->mask & IN_MOVED_FROM)
+      unwatch_tree(path);
+    else if (event->mask & IN_DELETE)
+      changed_paths.insert(path);
+    return;
+  }
+
+  changed_paths.insert(path);
+}
+
+static bool current_version_matches(const char *path, const struct stat &st, bool &has_entry)
+{
+  has_entry = false;
+  bool matches = false;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "SELECT f.type, v.size, v.mtime FROM file_system f LEFT JOIN file_versions v \
+                          ON v.path = f.path AND v.version = f.current_version WHERE f.path = ?;", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    has_entry = true;
+    // Entries that are not regular files are never published
+    matches = (sqlite3_column_int(stmt, 0) != REGULAR) ||
+              (sqlite3_column_type(stmt, 1) != SQLITE_NULL && sqlite3_column_int64(stmt, 1) == st.st_size &&
+               sqlite3_column_type(stmt, 2) != SQLITE_NULL && sqlite3_column_int64(stmt, 2) == mtime_ns(st));
+  }
+  sqlite3_finalize(stmt);
+  return matches;
+}
+
+static void publish_changes()
+{
+  vector<string> paths;
+  int gone = 0;
+
+  for (set<string>::iterator it = changed_paths.begin(); it != changed_paths.end(); ++it) {
+    const char *path = it->c_str();
+    // Being written through the mount, which publishes it
+    if (is_open_for_write(*it) || is_publish_pending(path) || is_streaming(path))
+      continue;
+
+    char full_path[PATH_MAX];
+    abs_path(full_path, path);
+    struct stat st;
+    if (lstat(full_path, &st) == -1) {
+      if (errno == ENOENT) {
+        remove_file_entry(path);
+        gone ++;
+      }
+      continue;
+    }
+    bool has_entry;
+    bool matches = current_version_matches(path, st, has_entry);
+    if (S_ISDIR(st.st_mode) && !has_entry)
+      add_file_entry(path, DIRECTORY);
+    if (!S_ISREG(st.st_mode) || matches)
+      continue;
+
+    if (!has_entry)
+      add_file_entry(path);
+    paths.push_back(*it);
+  }
+
+  int published = 0;
+  if (!paths.empty())
+    published = publish_paths(paths, max(1, (int)sysconf(_SC_NPROCESSORS_ONLN)));
+
+  FILE_LOG(LOG_DEBUG) << "publish_changes: " << events_seen << " events on " << changed_paths.size() << " paths, published "
+                      << published << " of " << paths.size() << " changed files, " << gone << " gone" << endl;
+  changed_paths.clear();
+  events_seen = 0;
+}
+
+static void *watch_worker(void *arg)
+{
+  watch_tree("", false);
+  FILE_LOG(LOG_DEBUG) << "watch_worker: watching " << watched_dirs.size() << " directories" << endl;
+
+  // Enough for a few hundred events per read
+  char buf[64 * 1024] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  int64_t first_event = 0;
+  int64_t last_event = 0;
+
+  while (!watch_stop) {
+    int64_t now = now_ms();
+    if (!changed_paths.empty() &&
+        (now >= last_event + ndnfs::watch_delay || now >= first_event + (int64_t)ndnfs::watch_delay * WATCH_MAX_DELAY)) {
+      publish_changes();
+      continue;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = inotify_fd;
+    pfd.events = POLLIN;
+    // Wake up at least every 100 ms to check for unmount
+    int64_t timeout = 100;
+    if (!changed_paths.empty()) {
+      int64_t deadline = min(last_event + ndnfs::watch_delay, first_event + (int64_t)ndnfs::watch_delay * WATCH_MAX_DELAY);
+      timeout = max((int64_t)0, min(timeout, deadline - now));
+    }
+    if (poll(&pfd, 1, (int)timeout) <= 0)
+      continue;
+
+    ssize_t len = read(inotify_fd, buf, sizeof(buf));
+    for (char *p = buf; len > 0 && p < buf + len; ) {
+      const struct inotify_event *event = (const struct inotify_event *)p;
+      if (changed_paths.empty())
+        first_event = now_ms();
+      handle_event(event);
+      p += sizeof(struct inotify_event) + event->len;
+    }
+    last_event = now_ms();
+  }
+
+  return NULL;
+}
+
+void start_watch()
+{
+  if (ndnfs::watch_delay <= 0)
+    return;
+
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd == -1) {
+    FILE_LOG(LOG_ERROR) << "start_watch: inotify_init1 error. Errno: " << errno << endl;
+    return;
+  }
+
+  watch_stop = false;
+  if (pthread_create(&watch_thread, NULL, watch_worker, NULL) != 0) {
+    FILE_LOG(LOG_ERROR) << "start_watch: pthread_create error. Errno: " << errno << endl;
+    close(inotify_fd);
+    inotify_fd = -1;
+    return;
+  }
+  watch_running = true;
+}
+
+void stop_watch()
+{
+  if (!watch_running)
+    return;
+
+  watch_stop = true;
+  pthread_join(watch_thread, NULL);
+  watch_running = false;
+
+  // Changes seen but not published yet would otherwise wait for the next mount
+  if (!changed_paths.empty())
+    publish_changes();
+
+  close(inotify_fd);
+  inotify_fd = -1;
+  watched_dirs.clear();
+}
+
+#else
+
+void start_watch()
+{
+  if (ndnfs::watch_delay > 0) {
+    FILE_LOG(LOG_ERROR) << "start_watch: watching the actual folder is only supported on Linux" << endl;
+  }
+}
+
+void stop_watch()
+{
+}
+
+#endif
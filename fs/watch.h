@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NDNFS_WATCH_H
+#define NDNFS_WATCH_H
+
+#include "ndnfs.h"
+
+/**
+ * Watcher: with ndnfs::watch_delay > 0, a thread watches root_path with inotify for
+ * changes made directly in the actual folder, bypassing the mount. Changed paths are
+ * collected until no event arrived for watch_delay ms (or for at most WATCH_MAX_DELAY
+ * times that, under a steady stream of events), and then published as one batch on
+ * one thread per core, so a large checkout or copy turns into a single batch.
+ *
+ * Only directories are listed, to set up a watch on each; files are looked at only
+ * when an event names them. Changes made through the mount produce events too: they
+ * are skipped while the file is open for writing or waits for a debounced publish, and
+ * once published, the recorded size and mtime match and the event is ignored.
+ *
+ * If the kernel queue overflows, events are lost: the watches are set up again, and
+ * the scan (see scan.h) runs again to find the changes missed.
+ */
+#define WATCH_MAX_DELAY 10
+
+void start_watch();
+
+void stop_watch();
+
+#endif
@@ -0,0 +1,681 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * ndnfs-import signs the files under a folder into an ndnfs database without mounting
+ * ndnfs, so that ndnfs-server can serve the folder right away. Files are split into
+ * chunks of segments, and chunks are read and signed on one thread per core; a single
+ * writer thread loads the signatures, and each finished file's version and entry, in
+ * large transactions. The secondary indexes are dropped during the load and built at
+ * the end. A later mount of the folder publishes only files that changed since (see
+ * scan.h), since each version records the size and mtime it was imported from.
+ */
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <openssl/sha.h>
+
+#include <ndn-cpp/data.hpp>
+#include <ndn-cpp/digest-sha256-signature.hpp>
+
+#include "import.h"
+#include "signer.h"
+#include "signature-types.h"
+#include "signature-states.h"
+#include "file-type.h"
+#include "sha256.h"
+#include "name.h"
+#include "segment.h"
+#include "mime-inference.h"
+#include "schema.h"
+#include "content-digest.h"
+#include "dir-change-types.h"
+
+using namespace std;
+using namespace ndn;
+
+sqlite3 *ndnfs::import::db;
+
+string ndnfs::import::fs_path;
+string ndnfs::import::fs_prefix = "/ndn/broadcast/ndnfs";
+string ndnfs::import::db_name = "/tmp/ndnfs.db";
+string ndnfs::import::logging_path = "";
+
+int ndnfs::import::threads = 0;
+int ndnfs::import::seg_size = DEFAULT_SEG_SIZE;
+int ndnfs::import::max_seg_size = DEFAULT_SEG_SIZE;
+int ndnfs::import::signature_type = SIGNATURE_RSA;
+
+// Files are read and signed in chunks of about this many bytes
+#define CHUNK_BYTES (4 * 1024 * 1024)
+// Rows per transaction
+#define TRANSACTION_ROWS 100000
+// Signed chunks waiting for the writer; workers wait beyond this
+#define MAX_PENDING_CHUNKS 256
+
+struct import_file {
+  string path;
+  int64_t size;
+  int64_t mtime;
+  int seg_size;
+  int chunks;
+  // The content digest (the same as ndnfs computes, see fs/content-digest.h) is computed
+  // in chunk order, under the digest lock of the file; see importChunk
+  int next_digest_chunk;
+  SHA256_CTX ctx;
+  uint8_t digest[CONTENT_DIGEST_SIZE];
+  bool failed;
+};
+
+struct import_chunk {
+  size_t file;
+  int index;
+  int64_t first_segment;
+  int64_t segments;
+};
+
+struct signed_chunk {
+  size_t file;
+  vector<pair<int64_t, Blob> > signatures;
+};
+
+static vector<import_file> files;
+// Directories under the folder, which get file_system entries as in ndnfs
+static vector<string> folders;
+static vector<import_chunk> chunks;
+static atomic<size_t> next_chunk(0);
+static int64_t version;
+
+// Digests of different files are updated in parallel: file i uses digest lock i % DIGEST_LOCKS
+#define DIGEST_LOCKS 64
+
+static pthread_mutex_t digest_locks[DIGEST_LOCKS];
+static pthread_cond_t digest_conds[DIGEST_LOCKS];
+
+// Version of the last change logged into dir_changes; changes of the import are stamped after any already there
+static int64_t lastChange;
+
+static deque<signed_chunk *> pending;
+static int running_workers = 0;
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t drained_cond = PTHREAD_COND_INITIALIZER;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int sig)
+{
+  stopping = 1;
+}
+
+void usage() {
+  fprintf(stderr, "Usage: ./ndnfs-import -f [folder to import] [-p prefix][-d db file][-l logging file path][-t threads][-s seg_size][-m max_seg_size][-g rsa|digest]\n");
+  exit(1);
+}
+
+// Same as choose_seg_size of ndnfs
+static int chooseSegSize(const string &path, off_t fileSize)
+{
+  int size = ndnfs::import::seg_size;
+  while (fileSize / size > ADAPTIVE_SEGMENT_COUNT && size * 2 <= ndnfs::import::max_seg_size)
+    size *= 2;
+  Name versionName = build_file_name(Name(ndnfs::import::fs_prefix), path.c_str());
+  versionName.appendVersion(version);
+  return min(size, max_content_size(versionName, ndnfs::import::signature_type == SIGNATURE_DIGEST));
+}
+
+static void walkFolder(const string &dir)
+{
+  string fullPath = ndnfs::import::fs_path + dir;
+  DIR *dp = opendir(fullPath.c_str());
+  if (dp == NULL) {
+    FILE_LOG(LOG_ERROR) << "walkFolder: opendir error. Path: " << fullPath << ", errno: " << errno << endl;
+    return;
+  }
+
+  struct dirent *de;
+  while ((de = readdir(dp)) != NULL) {
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+      continue;
+
+    struct stat st;
+    if (fstatat(dirfd(dp), de->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+      continue;
+
+    string path = dir + "/" + de->d_name;
+    if (S_ISDIR(st.st_mode)) {
+      folders.push_back(path);
+      walkFolder(path);
+    } else if (S_ISREG(st.st_mode)) {
+      import_file file;
+      file.path = path;
+      file.size = st.st_size;
+      file.mtime = mtime_ns(st);
+      file.seg_size = chooseSegSize(path, st.st_size);
+      file.chunks = 0;
+      file.next_digest_chunk = 0;
+      SHA256_Init(&file.ctx);
+      file.failed = false;
+      files.push_back(file);
+    }
+  }
+  closedir(dp);
+}
+
+static void splitChunks()
+{
+  for (size_t i = 0; i < files.size(); i ++) {
+    import_file &file = files[i];
+    // Like publish_file, a size that is a multiple of seg_size ends with an empty segment
+    int64_t segments = file.size / file.seg_size + 1;
+    int64_t perChunk = max((int64_t)SHA256_MAX_LANES, (int64_t)(CHUNK_BYTES / file.seg_size));
+
+    for (int64_t first = 0; first < segments; first += perChunk) {
+      import_chunk chunk;
+      chunk.file = i;
+      chunk.index = file.chunks ++;
+      chunk.first_segment = first;
+      chunk.segments = min(perChunk, segments - first);
+      chunks.push_back(chunk);
+    }
+  }
+}
+
+/**
+ * signSegments signs up to SHA256_MAX_LANES consecutive segments of buf, the way
+ * sign_segments of ndnfs does.
+ * @return false if a segment could not be signed (the file is then not imported)
+ */
+static bool signSegments(const Name &versionName, const import_chunk &chunk, const char *buf, int64_t length,
+                         int64_t first, int count, signed_chunk *result)
+{
+  const import_file &file = files[chunk.file];
+  bool digestOnly = (ndnfs::import::signature_type == SIGNATURE_DIGEST);
+  SignedBlob encodings[SHA256_MAX_LANES];
+  const uint8_t *portions[SHA256_MAX_LANES];
+  size_t portionSizes[SHA256_MAX_LANES];
+  uint8_t digests[SHA256_MAX_LANES * SHA256_DIGEST_SIZE];
+
+  for (int i = 0; i < count; i ++) {
+    int64_t offset = (first - chunk.first_segment + i) * file.seg_size;
+    int64_t len = min((int64_t)file.seg_size, length - offset);
+
+    Data data(versionName);
+    data.getName().appendSegment(first + i);
+    data.setContent((const uint8_t *)buf + offset, len);
+    if (digestOnly)
+      data.setSignature(DigestSha256Signature());
+    else
+      prepare_packet(data);
+
+    encodings[i] = data.wireEncode();
+    portions[i] = encodings[i].signedBuf();
+    portionSizes[i] = encodings[i].signedSize();
+  }
+
+  sha256_multi(portions, portionSizes, digests, count);
+
+  for (int i = 0; i < count; i ++) {
+    const uint8_t *digest = digests + i * SHA256_DIGEST_SIZE;
+    Blob signature = digestOnly ? Blob(digest, SHA256_DIGEST_SIZE) : sign_digest(digest);
+    if (signature.size() == 0)
+      return false;
+    result->signatures.push_back(make_pair(first + i, signature));
+  }
+  return true;
+}
+
+static void importChunk(const import_chunk &chunk, vector<char> &buf)
+{
+  import_file &file = files[chunk.file];
+  signed_chunk *result = new signed_chunk();
+  result->file = chunk.file;
+
+  off_t start = (off_t)chunk.first_segment * file.seg_size;
+  int64_t length = max((int64_t)0, min((int64_t)chunk.segments * file.seg_size, file.size - start));
+  buf.resize(max(length, (int64_t)1));
+
+  bool ok = false;
+  string fullPath = ndnfs::import::fs_path + file.path;
+  int fd = open(fullPath.c_str(), O_RDONLY);
+  if (fd == -1) {
+    FILE_LOG(LOG_ERROR) << "importChunk: open error. Path: " << fullPath << ", errno: " << errno << endl;
+  } else {
+    int64_t done = 0;
+    ssize_t len = 0;
+    while (done < length && (len = pread(fd, &buf[done], length - done, start + done)) > 0)
+      done += len;
+    close(fd);
+    ok = (done == length);
+    if (!ok) {
+      FILE_LOG(LOG_ERROR) << "importChunk: short read of " << file.path << " at offset " << start + done << endl;
+    }
+  }
+
+  if (ok) {
+    Name versionName = build_file_name(Name(ndnfs::import::fs_prefix), file.path.c_str());
+    versionName.appendVersion(version);
+    for (int64_t seg = chunk.first_segment; ok && seg < chunk.first_segment + chunk.segments; seg += SHA256_MAX_LANES) {
+      int count = min((int64_t)SHA256_MAX_LANES, chunk.first_segment + chunk.segments - seg);
+      ok = signSegments(versionName, chunk, &buf[0], length, seg, count, result);
+      if (!ok) {
+        FILE_LOG(LOG_ERROR) << "importChunk: cannot sign " << file.path << " segments from " << seg << endl;
+      }
+    }
+  }
+
+  // Chunks are taken in order, so the one before this is already being imported
+  pthread_mutex_t *digest_lock = &digest_locks[chunk.file % DIGEST_LOCKS];
+  pthread_cond_t *digest_cond = &digest_conds[chunk.file % DIGEST_LOCKS];
+  pthread_mutex_lock(digest_lock);
+  while (file.next_digest_chunk != chunk.index)
+    pthread_cond_wait(digest_cond, digest_lock);
+  if (ok)
+    SHA256_Update(&file.ctx, &buf[0], length);
+  else
+    file.failed = true;
+  file.next_digest_chunk ++;
+  if (file.next_digest_chunk == file.chunks) {
+    SHA256_Final(file.digest, &file.ctx);
+  }
+  pthread_cond_broadcast(digest_cond);
+  pthread_mutex_unlock(digest_lock);
+
+  pthread_mutex_lock(&pending_lock);
+  while (pending.size() >= MAX_PENDING_CHUNKS)
+    pthread_cond_wait(&drained_cond, &pending_lock);
+  pending.push_back(result);
+  pthread_cond_signal(&pending_cond);
+  pthread_mutex_unlock(&pending_lock);
+}
+
+static void *importWorker(void *arg)
+{
+  vector<char> buf;
+  size_t c;
+  while (!stopping && (c = next_chunk ++) < chunks.size())
+    importChunk(chunks[c], buf);
+
+  pthread_mutex_lock(&pending_lock);
+  running_workers --;
+  pthread_cond_signal(&pending_cond);
+  pthread_mutex_unlock(&pending_lock);
+  return NULL;
+}
+
+/**
+ * logDirChange records the change of path in dir_changes under its parent, as log_dir_change
+ * does in ndnfs (see fs/dir-changes.h); insertChange is the prepared INSERT.
+ */
+static void logDirChange(sqlite3_stmt *insertChange, const string &path, enum DirChangeType change)
+{
+  string parent, name;
+  if (split_last_component(path, parent, name) == -1 || name.empty())
+    return;
+  lastChange ++;
+  sqlite3_bind_text(insertChange, 1, parent.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(insertChange, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_int64(insertChange, 3, lastChange);
+  sqlite3_bind_int(insertChange, 4, change);
+  sqlite3_step(insertChange);
+  sqlite3_reset(insertChange);
+}
+
+static void writeFolders()
+{
+  sqlite3 *db = ndnfs::import::db;
+  sqlite3_stmt *insertFolder;
+  sqlite3_stmt *insertChange;
+  sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO file_system (path, type, parent) VALUES (?,?,?);", -1, &insertFolder, 0);
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO dir_changes (parent, name, version, change) VALUES (?,?,?,?);", -1, &insertChange, 0);
+
+  sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+  sqlite3_stmt *stmt;
+  lastChange = version;
+  sqlite3_prepare_v2(db, "SELECT MAX(version) FROM dir_changes;", -1, &stmt, 0);
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+    lastChange = max(lastChange, (int64_t)sqlite3_column_int64(stmt, 0));
+  sqlite3_finalize(stmt);
+
+  sqlite3_bind_text(insertFolder, 1, "/", -1, SQLITE_STATIC);
+  sqlite3_bind_int(insertFolder, 2, DIRECTORY);
+  sqlite3_step(insertFolder);
+  sqlite3_reset(insertFolder);
+
+  for (size_t i = 0; i < folders.size(); i ++) {
+    string parent, name;
+    split_last_component(folders[i], parent, name);
+    sqlite3_bind_text(insertFolder, 1, folders[i].c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(insertFolder, 2, DIRECTORY);
+    sqlite3_bind_text(insertFolder, 3, parent.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(insertFolder);
+    sqlite3_reset(insertFolder);
+    if (sqlite3_changes(db) > 0)
+      logDirChange(insertChange, folders[i], DIR_CHANGE_ADDED);
+  }
+  sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+  sqlite3_finalize(insertFolder);
+  sqlite3_finalize(insertChange);
+}
+
+/**
+ * writeChunks runs on the main thread, and loads the signed chunks into the database
+ * until all workers are done. Each finished file gets its version, its entry, a feed
+ * entry and a change in its directory, like a publish in ndnfs. Files left unfinished
+ * by a stop lose the segments already loaded, so no segments are left without a version.
+ */
+static void writeChunks(int64_t &importedFiles, int64_t &importedBytes, int64_t &failedFiles)
+{
+  sqlite3 *db = ndnfs::import::db;
+  sqlite3_stmt *insertSegment;
+  sqlite3_stmt *insertVersion;
+  sqlite3_stmt *insertFile;
+  sqlite3_stmt *updateFile;
+  sqlite3_stmt *insertFeed;
+  sqlite3_stmt *insertChange;
+  sqlite3_stmt *removeSegments;
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO file_segments (path, version, segment, signature) VALUES (?,?,?,?);", -1, &insertSegment, 0);
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO file_versions (path, version, size, content_digest, seg_size, signature_type, mtime) \
+                          VALUES (?,?,?,?,?,?,?);", -1, &insertVersion, 0);
+  // Entries already there keep their other columns, as a publish in ndnfs only sets these
+  sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO file_system (path, current_version, mime_type, ready_signed, type, parent) \
+                          VALUES (?,?,?,?,?,?);", -1, &insertFile, 0);
+  sqlite3_prepare_v2(db, "UPDATE file_system SET current_version = ?, mime_type = ?, ready_signed = ? WHERE path = ?;", -1, &updateFile, 0);
+  sqlite3_prepare_v2(db, "INSERT INTO publish_feed (path, version, size) VALUES (?,?,?);", -1, &insertFeed, 0);
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO dir_changes (parent, name, version, change) VALUES (?,?,?,?);", -1, &insertChange, 0);
+  sqlite3_prepare_v2(db, "DELETE FROM file_segments WHERE path = ? AND version = ?;", -1, &removeSegments, 0);
+
+  // Chunks of each file loaded so far; chunks of a file may come in any order
+  vector<int> loaded(files.size(), 0);
+
+  int64_t rows = 0;
+  sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+
+  while (true) {
+    pthread_mutex_lock(&pending_lock);
+    while (pending.empty() && running_workers > 0)
+      pthread_cond_wait(&pending_cond, &pending_lock);
+    if (pending.empty()) {
+      pthread_mutex_unlock(&pending_lock);
+      break;
+    }
+    signed_chunk *result = pending.front();
+    pending.pop_front();
+    pthread_cond_signal(&drained_cond);
+    pthread_mutex_unlock(&pending_lock);
+
+    const import_file &file = files[result->file];
+    bool fileDone = (++ loaded[result->file] == file.chunks);
+    for (size_t i = 0; i < result->signatures.size(); i ++) {
+      sqlite3_bind_text(insertSegment, 1, file.path.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int64(insertSegment, 2, version);
+      sqlite3_bind_int64(insertSegment, 3, result->signatures[i].first);
+      sqlite3_bind_blob(insertSegment, 4, result->signatures[i].second.buf(), result->signatures[i].second.size(), SQLITE_STATIC);
+      sqlite3_step(insertSegment);
+      sqlite3_reset(insertSegment);
+    }
+    rows += result->signatures.size();
+
+    // file.digest and file.failed are final once every chunk of the file is signed
+    if (fileDone && file.failed) {
+      sqlite3_bind_text(removeSegments, 1, file.path.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int64(removeSegments, 2, version);
+      sqlite3_step(removeSegments);
+      sqlite3_reset(removeSegments);
+      failedFiles ++;
+    } else if (fileDone) {
+      sqlite3_bind_text(insertVersion, 1, file.path.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int64(insertVersion, 2, version);
+      sqlite3_bind_int64(insertVersion, 3, file.size);
+      sqlite3_bind_blob(insertVersion, 4, file.digest, CONTENT_DIGEST_SIZE, SQLITE_STATIC);
+      sqlite3_bind_int(insertVersion, 5, file.seg_size);
+      sqlite3_bind_int(insertVersion, 6, ndnfs::import::signature_type);
+      sqlite3_bind_int64(insertVersion, 7, file.mtime);
+      sqlite3_step(insertVersion);
+      sqlite3_reset(insertVersion);
+
+      char mimeType[100] = "";
+      mime_infer(mimeType, file.path.c_str());
+      sqlite3_bind_text(insertFile, 1, file.path.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int64(insertFile, 2, version);
+      sqlite3_bind_text(insertFile, 3, mimeType, -1, SQLITE_STATIC);
+      sqlite3_bind_int(insertFile, 4, READY);
+      sqlite3_bind_int(insertFile, 5, REGULAR);
+      string parent, name;
+      split_last_component(file.path, parent, name);
+      sqlite3_bind_text(insertFile, 6, parent.c_str(), -1, SQLITE_TRANSIENT);
+      sqlite3_step(insertFile);
+      sqlite3_reset(insertFile);
+      bool added = sqlite3_changes(db) > 0;
+      if (!added) {
+        sqlite3_bind_int64(updateFile, 1, version);
+        sqlite3_bind_text(updateFile, 2, mimeType, -1, SQLITE_STATIC);
+        sqlite3_bind_int(updateFile, 3, READY);
+        sqlite3_bind_text(updateFile, 4, file.path.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(updateFile);
+        sqlite3_reset(updateFile);
+      }
+
+      sqlite3_bind_text(insertFeed, 1, file.path.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int64(insertFeed, 2, version);
+      sqlite3_bind_int64(insertFeed, 3, file.size);
+      sqlite3_step(insertFeed);
+      sqlite3_reset(insertFeed);
+      logDirChange(insertChange, file.path, added ? DIR_CHANGE_ADDED : DIR_CHANGE_MODIFIED);
+
+      importedFiles ++;
+      importedBytes += file.size;
+      rows += 4;
+    }
+    delete result;
+
+    if (rows >= TRANSACTION_ROWS) {
+      if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+        FILE_LOG(LOG_ERROR) << "writeChunks: commit error. " << sqlite3_errmsg(db) << endl;
+      }
+      sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+      rows = 0;
+      FILE_LOG(LOG_DEBUG) << "writeChunks: imported " << importedFiles << " of " << files.size() << " files, "
+                          << importedBytes / 1000000 << " MB" << endl;
+    }
+  }
+
+  // Only after a stop: earlier transactions may have committed some of these segments
+  for (size_t i = 0; i < files.size(); i ++) {
+    if (loaded[i] == 0 || loaded[i] == files[i].chunks)
+      continue;
+    sqlite3_bind_text(removeSegments, 1, files[i].path.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(removeSegments, 2, version);
+    sqlite3_step(removeSegments);
+    sqlite3_reset(removeSegments);
+    FILE_LOG(LOG_DEBUG) << "writeChunks: " << files[i].path << " not finished, segments removed" << endl;
+  }
+
+  if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+    FILE_LOG(LOG_ERROR) << "writeChunks: commit error. " << sqlite3_errmsg(db) << endl;
+
+  }
+
+  sqlite3_finalize(insertSegment);
+  sqlite3_finalize(insertVersion);
+  sqlite3_finalize(insertFile);
+  sqlite3_finalize(updateFile);
+  sqlite3_finalize(insertFeed);
+  sqlite3_finalize(insertChange);
+  sqlite3_finalize(removeSegments);
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "f:p:d:l:t:s:m:g:")) != -1) {
+    switch (opt) {
+    case 'f':
+      ndnfs::import::fs_path.assign(optarg);
+      break;
+    case 'p':
+      ndnfs::import::fs_prefix.assign(optarg);
+      break;
+    case 'd':
+      ndnfs::import::db_name.assign(optarg);
+      break;
+    case 'l':
+      ndnfs::import::logging_path.assign(optarg);
+      break;
+    case 't':
+      ndnfs::import::threads = atoi(optarg);
+      break;
+    case 's':
+      ndnfs::import::seg_size = atoi(optarg);
+      break;
+    case 'm':
+      ndnfs::import::max_seg_size = atoi(optarg);
+      break;
+    case 'g':
+      if (strcmp(optarg, "digest") == 0)
+        ndnfs::import::signature_type = SIGNATURE_DIGEST;
+      else if (strcmp(optarg, "rsa") != 0)
+        usage();
+      break;
+    default:
+      usage();
+      break;
+    }
+  }
+
+  if (ndnfs::import::fs_path.empty() || ndnfs::import::seg_size <= 0)
+    usage();
+  while (ndnfs::import::fs_path.size() > 1 && ndnfs::import::fs_path[ndnfs::import::fs_path.size() - 1] == '/')
+    ndnfs::import::fs_path.erase(ndnfs::import::fs_path.size() - 1);
+  if (ndnfs::import::max_seg_size < ndnfs::import::seg_size)
+    ndnfs::import::max_seg_size = ndnfs::import::seg_size;
+  if (ndnfs::import::threads <= 0)
+    ndnfs::import::threads = max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+  // Same prefix as ndnfs uses for names
+  ndnfs::import::fs_prefix = Name(ndnfs::import::fs_prefix).toUri();
+
+  // Set up logging
+  Log<Output2FILE>::reportingLevel() = LOG_DEBUG;
+  FILE* log_fd = fopen(ndnfs::import::logging_path.c_str(), "w" );
+  if (ndnfs::import::logging_path == "" || log_fd == NULL) {
+    Output2FILE::stream() = stdout;
+  } else {
+    Output2FILE::stream() = log_fd;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  if (load_signer(DEFAULT_RSA_PRIVATE_KEY_DER, sizeof(DEFAULT_RSA_PRIVATE_KEY_DER), certificate_name(Name(DEFAULT_KEY_NAME))) != 0) {
+    FILE_LOG(LOG_ERROR) << "main: cannot load the signing key, quit" << endl;
+    return -1;
+  }
+  // Segments have to fit in one Data packet, like in ndnfs
+  int fitting = max_content_size(Name(ndnfs::import::fs_prefix).appendVersion((int64_t)time(NULL) * 1000000),
+                                 ndnfs::import::signature_type == SIGNATURE_DIGEST);
+  if (ndnfs::import::max_seg_size > fitting) {
+    FILE_LOG(LOG_ERROR) << "main: segments of " << ndnfs::import::max_seg_size << " bytes do not fit in one Data packet of "
+                        << MAX_NDN_PACKET_SIZE << " bytes, the largest seg_size and max_seg_size is " << fitting << ", quit" << endl;
+    return -1;
+  }
+  initialize_ext_mime_map();
+
+  if (sqlite3_open(ndnfs::import::db_name.c_str(), &ndnfs::import::db) != SQLITE_OK) {
+    FILE_LOG(LOG_DEBUG) << "main: cannot connect to sqlite db: " << ndnfs::import::db_name << ", quit" << endl;
+    sqlite3_close(ndnfs::import::db);
+    return -1;
+  }
+  // Room for the primary key indexes while loading
+  sqlite3_exec(ndnfs::import::db, "PRAGMA cache_size = -262144;", NULL, NULL, NULL);
+  // Same tables as ndnfs creates, without the secondary indexes while loading
+  if (create_tables(ndnfs::import::db) != 0) {
+    FILE_LOG(LOG_ERROR) << "main: cannot create the tables in " << ndnfs::import::db_name << ", quit" << endl;
+    sqlite3_close(ndnfs::import::db);
+    return -1;
+  }
+  drop_indexes(ndnfs::import::db);
+  for (int i = 0; i < DIGEST_LOCKS; i ++) {
+    pthread_mutex_init(&digest_locks[i], NULL);
+    pthread_cond_init(&digest_conds[i], NULL);
+  }
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  // One version for all the files
+  version = (int64_t)start.tv_sec * 1000000 + start.tv_usec;
+
+  walkFolder("");
+  writeFolders();
+  splitChunks();
+  FILE_LOG(LOG_DEBUG) << "main: importing " << files.size() << " files (" << chunks.size() << " chunks) from "
+                      << ndnfs::import::fs_path << " under " << ndnfs::import::fs_prefix << ", version " << version
+                      << ", " << ndnfs::import::threads << " threads, "
+                      << (ndnfs::import::signature_type == SIGNATURE_DIGEST ? "digest" : "rsa")
+                      << " signatures, sha256 " << sha256_impl_name() << endl;
+
+  vector<pthread_t> workers;
+  running_workers = ndnfs::import::threads;
+  for (int i = 0; i < ndnfs::import::threads; i ++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, importWorker, NULL) == 0) {
+      workers.push_back(thread);
+    } else {
+      FILE_LOG(LOG_ERROR) << "main: pthread_create error. Errno: " << errno << endl;
+      pthread_mutex_lock(&pending_lock);
+      running_workers --;
+      pthread_mutex_unlock(&pending_lock);
+    }
+  }
+
+  int64_t importedFiles = 0;
+  int64_t importedBytes = 0;
+  int64_t failedFiles = 0;
+  writeChunks(importedFiles, importedBytes, failedFiles);
+  for (size_t i = 0; i < workers.size(); i ++)
+    pthread_join(workers[i], NULL);
+
+  struct timeval loaded;
+  gettimeofday(&loaded, NULL);
+  if (create_indexes(ndnfs::import::db) != 0) {
+    FILE_LOG(LOG_ERROR) << "main: cannot create the indexes" << endl;
+  }
+  // Entries were replaced under the digests of their directories; ndnfs computes them all at the next mount
+  sqlite3_exec(ndnfs::import::db, "UPDATE file_system SET tree_digest = NULL WHERE path = '/';", NULL, NULL, NULL);
+
+  struct timeval stop;
+  gettimeofday(&stop, NULL);
+  int64_t elapsedUs = (int64_t)(stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+  int64_t indexUs = (int64_t)(stop.tv_sec - loaded.tv_sec) * 1000000 + (stop.tv_usec - loaded.tv_usec);
+
+  FILE_LOG(LOG_DEBUG) << "main: imported " << importedFiles << " of " << files.size() << " files, " << failedFiles << " failed, "
+                      << importedBytes / 1000000 << " MB in " << elapsedUs / 1000 << " ms ("
+                      << importedBytes * 1.0 / max(elapsedUs, (int64_t)1) << " MB/s), indexes built in "
+                      << indexUs / 1000 << " ms" << endl;
+
+  sqlite3_close(ndnfs::import::db);
+  return (stopping || failedFiles > 0) ? 1 : 0;
+}
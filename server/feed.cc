@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "feed.h"
+#include "feed.pb.h"
+
+#include <map>
+#include <algorithm>
+
+using namespace std;
+using namespace ndn;
+
+struct FeedBlockBuild : SegmentedContent {
+  // Last sequence number the build covers, the version in its name
+  int64_t lastSeq;
+};
+
+// A block, along with the build it replaced, so that fetches in progress can finish
+struct CachedFeedBlock {
+  FeedBlockBuild current;
+  FeedBlockBuild previous;
+  bool hasPrevious;
+  bool complete;
+  int64_t builtAt;
+  uint64_t lastUsed;
+};
+
+typedef map<int64_t, CachedFeedBlock> FeedCache;
+
+static FeedCache feedCache;
+static uint64_t feedUseCount = 0;
+
+static int64_t readLastSeq()
+{
+  int64_t lastSeq = 0;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT MAX(seq) FROM publish_feed", -1, &stmt, 0);
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+    lastSeq = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return lastSeq;
+}
+
+static void buildFeedBlock(int64_t block, int64_t lastSeq, CachedFeedBlock& cached)
+{
+  int64_t first = block * FEED_BLOCK_SIZE;
+  int64_t end = first + FEED_BLOCK_SIZE;
+
+  Ndnfs::FeedBlock feedBlock;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT seq, path, version, size, removed FROM publish_feed WHERE seq >= ? AND seq < ? ORDER BY seq", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, first);
+  sqlite3_bind_int64(stmt, 2, end);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    Ndnfs::FeedEntry *entry = feedBlock.add_entry();
+    entry->set_seq(sqlite3_column_int64(stmt, 0));
+    entry->set_path((const char *)sqlite3_column_text(stmt, 1));
+    entry->set_version(sqlite3_column_int64(stmt, 2));
+    if (sqlite3_column_type(stmt, 3) != SQLITE_NULL)
+      entry->set_size(sqlite3_column_int64(stmt, 3));
+    if (sqlite3_column_int(stmt, 4) != 0)
+      entry->set_removed(true);
+  }
+  sqlite3_finalize(stmt);
+
+  // Sequence numbers start at 1
+  int64_t expected = (end - max(first, (int64_t)1));
+  cached.complete = (lastSeq >= end - 1);
+  if (cached.complete)
+    feedBlock.set_complete(true);
+  if (cached.complete && feedBlock.entry_size() < expected)
+    feedBlock.set_pruned(true);
+
+  // Entries are only appended, so the block up to the same sequence number has the same content
+  int64_t buildSeq = min(lastSeq, end - 1);
+  cached.builtAt = nowMs();
+  if (cached.current.lastSeq == buildSeq)
+    return;
+  if (cached.current.lastSeq != -1) {
+    cached.previous = cached.current;
+    cached.hasPrevious = true;
+  }
+  string content;
+  feedBlock.SerializeToString(&content);
+  setSegmentedContent(cached.current, content);
+  cached.current.lastSeq = buildSeq;
+}
+
+int sendFeedBlock(int64_t block, int64_t version, int64_t seg, Face& face)
+{
+  FeedCache::iterator it = (block == -1) ? feedCache.end() : feedCache.find(block);
+
+  // A complete block never changes; the latest one is rebuilt when it's asked for without a version
+  // after the freshness period, and the segments of a build are served from it
+  if (it == feedCache.end() ||
+      (!it->second.complete && version == -1 && seg <= 0 &&
+       nowMs() - it->second.builtAt >= ndnfs::server::streaming_freshness_period)) {
+    int64_t lastSeq = readLastSeq();
+    if (block == -1)
+      block = lastSeq / FEED_BLOCK_SIZE;
+    if (block > lastSeq / FEED_BLOCK_SIZE) {
+      FILE_LOG(LOG_DEBUG) << "sendFeedBlock: block " << block << " has no entries yet" << endl;
+      return -1;
+    }
+
+    it = feedCache.find(block);
+    if (it == feedCache.end() ||
+        (!it->second.complete && nowMs() - it->second.builtAt >= ndnfs::server::streaming_freshness_period)) {
+      if (it == feedCache.end()) {
+        CachedFeedBlock& added = feedCache[block];
+        added.current.lastSeq = -1;
+        added.hasPrevious = false;
+      }
+      CachedFeedBlock& cached = feedCache[block];
+      buildFeedBlock(block, lastSeq, cached);
+      it = feedCache.find(block);
+      FILE_LOG(LOG_DEBUG) << "sendFeedBlock: built block " << block << (cached.complete ? ", complete" : "") << endl;
+    }
+  }
+  it->second.lastUsed = ++ feedUseCount;
+
+  // The same name always carries the same content, so the last sequence number of the build is part of it
+  FeedBlockBuild *build = &it->second.current;
+  if (version != -1 && version != build->lastSeq) {
+    if (!it->second.hasPrevious || it->second.previous.lastSeq != version) {
+      FILE_LOG(LOG_DEBUG) << "sendFeedBlock: build " << version << " of block " << block << " is gone" << endl;
+      return -1;
+    }
+    build = &it->second.previous;
+  }
+
+  Name prefix(ndnfs::server::fs_prefix);
+  prefix.append(Name::fromEscapedString(NdnfsNamespace::feedComponentName_));
+  prefix.appendSequenceNumber(block).appendVersion(build->lastSeq);
+  int freshnessPeriod = it->second.complete ? ndnfs::server::default_freshness_period : ndnfs::server::streaming_freshness_period;
+  int ret = sendSegment(*build, prefix, seg, freshnessPeriod, face);
+
+  while (feedCache.size() > FEED_CACHE_SIZE) {
+    FeedCache::iterator oldest = feedCache.begin();
+    for (FeedCache::iterator cit = feedCache.begin(); cit != feedCache.end(); ++cit) {
+      if (cit->second.lastUsed < oldest->second.lastUsed)
+        oldest = cit;
+    }
+    feedCache.erase(oldest);
+  }
+  return ret;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __FEED_H__
+#define __FEED_H__
+
+#include "listing.h"
+
+/**
+ * The change feed of ndnfs (publish_feed table, see fs/feed.h) is served in blocks of
+ * FEED_BLOCK_SIZE sequence numbers: block b holds the entries b * FEED_BLOCK_SIZE up to
+ * (b + 1) * FEED_BLOCK_SIZE - 1, named
+ *   <root>/%C1.FS.feed/<b>/<last-seq>/<segment>: feed.proto encoded, b as a sequence number
+ * where last-seq, a version, is the last sequence number the build of the block covers, so that
+ * a name never carries two contents. An Interest without block number gets the latest block,
+ * one without last-seq the current build. Complete blocks do not change, and the last
+ * FEED_CACHE_SIZE of them are kept in memory; the latest block is served with the streaming
+ * freshness period, and rebuilt when it's asked for again without last-seq, keeping the build
+ * it replaced for fetches in progress. A consumer fetches the latest block, then asks for the
+ * next block once the one it has is complete.
+ */
+#define FEED_BLOCK_SIZE 64
+#define FEED_CACHE_SIZE 64
+
+/**
+ * sendFeedBlock replies with segment seg of the build of block of the feed up to sequence number
+ * version; block -1 asks for the latest block, version -1 for its current build, seg -1 for the
+ * first segment.
+ * @return 0 on success, -1 if the block has no entries yet, or the build or segment is not available
+ */
+int
+sendFeedBlock(int64_t block, int64_t version, int64_t seg, ndn::Face& face);
+
+#endif // __FEED_H__
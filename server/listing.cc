@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "listing.h"
+
+#include <map>
+#include <vector>
+#include <time.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace ndn;
+
+struct DirListing : SegmentedContent {
+  int64_t version;
+  // mtime of the directory (in microseconds) when the listing was built
+  int64_t mtimeVersion;
+  int64_t builtAt;
+};
+
+struct CachedListing {
+  DirListing current;
+  DirListing previous;
+  bool hasPrevious;
+  uint64_t lastUsed;
+};
+
+typedef map<pair<string, int>, CachedListing> ListingCache;
+
+static ListingCache listingCache;
+static uint64_t listingUseCount = 0;
+
+int64_t nowMs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static string buildProtobufListing(const vector<DirEntry>& entries)
+{
+  // '.' and '..' first, as readdir used to list them
+  Ndnfs::DirInfoArray infoa;
+  const char *dots[] = {".", ".."};
+  for (int i = 0; i < 2; i ++) {
+    Ndnfs::DirInfo *infod = infoa.add_di();
+    infod->set_type(DIRECTORY);
+    infod->set_path(dots[i]);
+  }
+  for (vector<DirEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+    Ndnfs::DirInfo *infod = infoa.add_di();
+    infod->set_type(it->type);
+    infod->set_path(it->name);
+  }
+
+  string content;
+  infoa.SerializeToString(&content);
+  return content;
+}
+
+static string buildHtmlListing(const string& path, const vector<DirEntry>& entries)
+{
+  string content = "<html><body>";
+  if (path != "/") {
+    content += "<a href=\"../\">[Parent directory]</a><br>";
+  }
+
+  // Entries come sorted by name
+  for (vector<DirEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+    // Support for HTML5 <a> download attribute is assumed here.
+    content += "<a download=\"";
+    content += it->name;
+    content += "\" href=\"./";
+    content += it->name;
+    content += "\">" + it->name + "</a>";
+    content += "<br>";
+  }
+
+  content += "</body></html>";
+  return content;
+}
+
+void setSegmentedContent(SegmentedContent& object, const string& content)
+{
+  object.content = content;
+  int64_t count = (content.size() + ndnfs::server::seg_size - 1) / ndnfs::server::seg_size;
+  object.segments.assign(count > 0 ? count : 1, ptr_lib::shared_ptr<Data>());
+}
+
+static void evictListings()
+{
+  while (listingCache.size() > LISTING_CACHE_SIZE) {
+    ListingCache::iterator oldest = listingCache.begin();
+    for (ListingCache::iterator it = listingCache.begin(); it != listingCache.end(); ++it) {
+      if (it->second.lastUsed < oldest->second.lastUsed)
+        oldest = it;
+    }
+    listingCache.erase(oldest);
+  }
+}
+
+/**
+ * lastDirChange returns the version of the latest change ndnfs logged in directory path
+ * (see dir-changes.h), or -1 if there's none.
+ */
+static int64_t lastDirChange(const string& path)
+{
+  int64_t version = -1;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT MAX(version) FROM dir_changes WHERE parent = ? AND name != ''", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+    version = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return version;
+}
+
+/**
+ * currentListing returns the cached listing of path, after rebuilding it if the directory
+ * changed, or if it is older than the freshness period; NULL if path is not a directory.
+ * The version of a listing is the later of the mtime of the directory and its last logged
+ * change: both are kept outside of the server, so a restarted server does not name another
+ * listing with a version it served before (the change log covers changes of entries, such
+ * as a new version of a file, that leave the mtime of the directory as it was).
+ */
+static CachedListing *currentListing(const string& path, ListingFormat format)
+{
+  char dir_path[PATH_MAX] = "";
+  abs_path(dir_path, path.c_str());
+  struct stat st;
+  if (lstat(dir_path, &st) == -1 || !S_ISDIR(st.st_mode)) {
+    FILE_LOG(LOG_DEBUG) << "currentListing: no such folder found: " << path << endl;
+    return NULL;
+  }
+  int64_t mtimeVersion = mtime_ns(st) / 1000;
+  int64_t now = nowMs();
+
+  pair<string, int> key(path, format);
+  ListingCache::iterator it = listingCache.find(key);
+  if (it != listingCache.end()) {
+    it->second.lastUsed = ++ listingUseCount;
+    const DirListing& current = it->second.current;
+    if (current.mtimeVersion == mtimeVersion && now - current.builtAt < ndnfs::server::default_freshness_period)
+      return &it->second;
+  }
+
+  vector<DirEntry> entries;
+  if (!readDirEntries(path, entries)) {
+    FILE_LOG(LOG_DEBUG) << "currentListing: cannot list folder: " << path << endl;
+    return NULL;
+  }
+  string content = (format == LISTING_HTML) ? buildHtmlListing(path, entries) : buildProtobufListing(entries);
+  int64_t version = max(mtimeVersion, lastDirChange(path));
+
+  if (it != listingCache.end()) {
+    CachedListing& cached = it->second;
+    if (cached.current.content == content) {
+      cached.current.mtimeVersion = mtimeVersion;
+      cached.current.builtAt = now;
+      return &cached;
+    }
+    // Only changes within the same microsecond, or a clock going backwards, leave the version as it was
+    if (version <= cached.current.version)
+      version = cached.current.version + 1;
+    cached.previous = cached.current;
+    cached.hasPrevious = true;
+    cached.current.version = version;
+    cached.current.mtimeVersion = mtimeVersion;
+    cached.current.builtAt = now;
+    setSegmentedContent(cached.current, content);
+    FILE_LOG(LOG_DEBUG) << "currentListing: " << path << " changed, version " << version << endl;
+    return &cached;
+  }
+
+  CachedListing& cached = listingCache[key];
+  cached.current.version = version;
+  cached.current.mtimeVersion = mtimeVersion;
+  cached.current.builtAt = now;
+  setSegmentedContent(cached.current, content);
+  cached.hasPrevious = false;
+  cached.lastUsed = ++ listingUseCount;
+  FILE_LOG(LOG_DEBUG) << "currentListing: " << path << " listed, version " << version << ", " << entries.size() << " entries" << endl;
+
+  // Evicting may only drop another directory, since this one was used last
+  evictListings();
+  return &listingCache[key];
+}
+
+int sendSegment(SegmentedContent& object, const Name& prefix, int64_t seg, int freshnessPeriod, Face& face)
+{
+  if (seg == -1)
+    seg = 0;
+  int64_t total_seg = object.segments.size();
+  if (seg >= total_seg) {
+    FILE_LOG(LOG_DEBUG) << "sendSegment: segment " << seg << " beyond " << prefix.toUri() << endl;
+    return -1;
+  }
+
+  ptr_lib::shared_ptr<Data>& data = object.segments[seg];
+  if (!data) {
+    Name name(prefix);
+    name.appendSegment(seg);
+
+    data.reset(new Data(name));
+    size_t offset = (size_t)seg * ndnfs::server::seg_size;
+    size_t len = min(object.content.size() - offset, (size_t)ndnfs::server::seg_size);
+    data->setContent((const uint8_t *)object.content.data() + offset, len);
+    data->getMetaInfo().setFinalBlockId(Name::Component::fromNumberWithMarker(total_seg - 1, 0x00));
+    data->getMetaInfo().setFreshnessPeriod(freshnessPeriod);
+    ndnfs::server::keyChain->sign(*data, ndnfs::server::certificateName);
+  }
+
+  face.putData(*data);
+  FILE_LOG(LOG_DEBUG) << "sendSegment: Data returned with name: " << data->getName().toUri() << endl;
+  return 0;
+}
+
+static Name listingPrefix(const string& path, const string& component)
+{
+  Name name(ndnfs::server::fs_prefix);
+  name.append(Name(path));
+  name.append(Name::fromEscapedString(component));
+  return name;
+}
+
+int sendDirListing(const string& path, ListingFormat format, int64_t version, int64_t seg, Face& face)
+{
+  CachedListing *cached = currentListing(path, format);
+  if (cached == NULL)
+    return -1;
+
+  DirListing *listing = &cached->current;
+  if (version != -1 && version != listing->version) {
+    if (cached->hasPrevious && version == cached->previous.version) {
+      listing = &cached->previous;
+    } else {
+      FILE_LOG(LOG_DEBUG) << "sendDirListing: version " << version << " of the listing of " << path << " is not available" << endl;
+      return -1;
+    }
+  }
+
+  Name prefix = listingPrefix(path, (format == LISTING_HTML) ? NdnfsNamespace::contentMetaString_ : NdnfsNamespace::dirComponentName_);
+  prefix.appendVersion(listing->version);
+  return sendSegment(*listing, prefix, seg, ndnfs::server::default_freshness_period, face);
+}
+
+/**
+ * readDirDelta fills delta with the changes of directory path of version > since,
+ * and returns false if removals since then were pruned.
+ */
+static bool readDirDelta(const string& path, int64_t since, Ndnfs::DirDelta& delta)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT version FROM dir_changes WHERE parent = ? AND name = ''", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  bool expired = (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int64(stmt, 0) > since);
+  sqlite3_finalize(stmt);
+  if (expired)
+    return false;
+
+  // Each changed entry is joined with its current row, for the type of entries that exist
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT c.name, c.change, c.version, f.type FROM dir_changes c \
+                                         LEFT JOIN file_system f ON f.path = (CASE WHEN c.parent = '/' THEN '' ELSE c.parent END) || '/' || c.name \
+                                         WHERE c.parent = ? AND c.version > ? AND c.name != '' ORDER BY c.version", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, since);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    Ndnfs::DirChange *change = delta.add_dc();
+    change->set_path((const char *)sqlite3_column_text(stmt, 0));
+    change->set_change(sqlite3_column_int(stmt, 1));
+    change->set_version(sqlite3_column_int64(stmt, 2));
+    if (sqlite3_column_type(stmt, 3) != SQLITE_NULL)
+      change->set_type(sqlite3_column_int(stmt, 3));
+  }
+  sqlite3_finalize(stmt);
+  return true;
+}
+
+// The delta since a version, along with the one it replaced, so that fetches in progress can finish
+struct CachedDelta {
+  DirListing current;
+  DirListing previous;
+  bool hasPrevious;
+};
+
+typedef map<pair<string, int64_t>, CachedDelta> DeltaCache;
+
+static DeltaCache deltaCache;
+
+int sendDirDelta(const string& path, int64_t since, int64_t version, int64_t seg, Face& face)
+{
+  pair<string, int64_t> key(path, since);
+  DeltaCache::iterator it = deltaCache.find(key);
+  int64_t now = nowMs();
+
+  // A delta is rebuilt when it's asked for without a version after the freshness period;
+  // the segments of a version are served from the one being fetched
+  if (it == deltaCache.end() ||
+      (version == -1 && seg <= 0 && now - it->second.current.builtAt >= ndnfs::server::default_freshness_period)) {
+    CachedListing *cached = currentListing(path, LISTING_PROTOBUF);
+    if (cached == NULL)
+      return -1;
+
+    Ndnfs::DirDelta delta;
+    int64_t deltaVersion = cached->current.version;
+    if (readDirDelta(path, since, delta)) {
+      for (int i = 0; i < delta.dc_size(); i ++)
+        deltaVersion = max(deltaVersion, delta.dc(i).version());
+    } else {
+      FILE_LOG(LOG_DEBUG) << "sendDirDelta: changes of " << path << " since " << since << " were pruned" << endl;
+      delta.set_expired(true);
+    }
+    delta.set_version(deltaVersion);
+    string content;
+    delta.SerializeToString(&content);
+
+    if (it == deltaCache.end()) {
+      // Deltas are small and short-lived, any of them can make room
+      if (deltaCache.size() >= LISTING_CACHE_SIZE)
+        deltaCache.erase(deltaCache.begin());
+      it = deltaCache.insert(make_pair(key, CachedDelta())).first;
+      it->second.current.version = -1;
+      it->second.hasPrevious = false;
+    }
+    // No change logged since the version of the cached delta leaves its content as it was
+    DirListing& listing = it->second.current;
+    if (listing.version != deltaVersion) {
+      if (listing.version != -1) {
+        it->second.previous = listing;
+        it->second.hasPrevious = true;
+      }
+      listing.version = deltaVersion;
+      setSegmentedContent(listing, content);
+    }
+    listing.mtimeVersion = cached->current.mtimeVersion;
+    listing.builtAt = now;
+    FILE_LOG(LOG_DEBUG) << "sendDirDelta: " << path << " since " << since << ": " << delta.dc_size() << " changes, version " << deltaVersion << endl;
+  }
+
+  // The same name always carries the same content, so the version of the delta is part of it
+  DirListing *listing = &it->second.current;
+  if (version != -1 && version != listing->version) {
+    if (!it->second.hasPrevious || it->second.previous.version != version) {
+      FILE_LOG(LOG_DEBUG) << "sendDirDelta: version " << version << " of the delta of " << path << " since " << since << " is gone" << endl;
+      return -1;
+    }
+    listing = &it->second.previous;
+  }
+
+  Name prefix = listingPrefix(path, NdnfsNamespace::dirComponentName_);
+  prefix.appendVersion(since).append(Name::fromEscapedString(NdnfsNamespace::deltaComponentName_)).appendVersion(listing->version);
+  return sendSegment(*listing, prefix, seg, ndnfs::server::default_freshness_period, face);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LISTING_H__
+#define __LISTING_H__
+
+#include "servermodule.h"
+
+/**
+ * Directory listings are served as segmented, versioned objects, named like file content:
+ *   <root>/<path>/%C1.FS.dir/<version>/<segment>: dir.proto encoded
+ *   <root>/<path>/_list/<version>/<segment>: HTML, for browsers
+ * Every segment carries the FinalBlockId, so clients can fetch a listing with pipelined
+ * Interests, the same way as file content. The version is the mtime of the directory, in microseconds,
+ * or the version of the last change ndnfs logged in it (see dir-changes.h), whichever is later.
+ *
+ * A listing is built from the directory index once per version, and kept for the LISTING_CACHE_SIZE
+ * directories listed last, along with its previous version so fetches in progress can finish;
+ * segments are signed when they are first requested. The index of a directory can be updated
+ * after its mtime changed (by the watcher), so a listing older than the freshness period is
+ * rebuilt, and gets a new version if the entries changed.
+ */
+#define LISTING_CACHE_SIZE 64
+
+/**
+ * SegmentedContent is content built in memory and served in segments of seg_size bytes,
+ * each carrying the FinalBlockId; segments are signed when first requested, and kept.
+ */
+struct SegmentedContent {
+  std::string content;
+  std::vector<ndn::ptr_lib::shared_ptr<ndn::Data> > segments;
+};
+
+void
+setSegmentedContent(SegmentedContent& object, const std::string& content);
+
+/**
+ * sendSegment replies with segment seg (-1 for the first one) of object, named <prefix>/<seg>.
+ * @return 0 on success, -1 if seg is beyond the last segment
+ */
+int
+sendSegment(SegmentedContent& object, const ndn::Name& prefix, int64_t seg, int freshnessPeriod, ndn::Face& face);
+
+/**
+ * nowMs returns the time in milliseconds since an arbitrary point, to age cached content.
+ */
+int64_t
+nowMs();
+
+enum ListingFormat {
+  LISTING_PROTOBUF = 0,
+  LISTING_HTML = 1
+};
+
+/**
+ * sendDirListing replies with segment seg of the given version of the listing of directory path;
+ * version -1 asks for the current version, seg -1 for the first segment.
+ * @return 0 on success, -1 if path is not a directory, or the version or segment is not available
+ */
+int
+sendDirListing(const std::string& path, ListingFormat format, int64_t version, int64_t seg, ndn::Face& face);
+
+/**
+ * Listing deltas: <root>/<path>/%C1.FS.dir/<since-version>/delta/<version>/<segment> carries the changes
+ * of directory path after version since-version of its listing (dir.proto DirDelta), from the change
+ * log kept by ndnfs (see fs/dir-changes.h). A changed entry is listed once, with its latest change;
+ * applying a delta to a listing of since-version or later gives the listing of the version of the delta,
+ * which is also the since-version of the next delta. A name carries one content: a delta that brings
+ * the listing further gets a new version, and the one it replaced stays available, like listings.
+ * If the log does not reach back to since-version, the delta is marked as expired.
+ * version -1 asks for the current delta, seg -1 for the first segment.
+ * @return 0 on success, -1 if path is not a directory, or the version or segment is not available
+ */
+int
+sendDirDelta(const std::string& path, int64_t since, int64_t version, int64_t seg, ndn::Face& face);
+
+#endif // __LISTING_H__
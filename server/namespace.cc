@@ -4,4 +4,7 @@ const std::string NdnfsNamespace::mimeComponentName_ = "mime_type";
 
 const std::string NdnfsNamespace::fileComponentName_ = "%C1.FS.file";
 const std::string NdnfsNamespace::dirComponentName_ = "%C1.FS.dir";
-const std::string NdnfsNamespace::contentMetaString_ = "_list";
\ No newline at end of file
+const std::string NdnfsNamespace::contentMetaString_ = "_list";
+const std::string NdnfsNamespace::deltaComponentName_ = "delta";
+const std::string NdnfsNamespace::feedComponentName_ = "%C1.FS.feed";
+const std::string NdnfsNamespace::treeComponentName_ = "%C1.FS.tree";
\ No newline at end of file
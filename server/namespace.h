@@ -10,6 +10,9 @@ public:
   static const std::string fileComponentName_;
   static const std::string dirComponentName_;
   static const std::string contentMetaString_;
+  static const std::string deltaComponentName_;
+  static const std::string feedComponentName_;
+  static const std::string treeComponentName_;
 };
 
 #endif
\ No newline at end of file
@@ -37,8 +37,8 @@ string ndnfs::server::fs_prefix = "/ndn/broadcast/ndnfs";
 string ndnfs::server::logging_path = "";
 
 const int ndnfs::server::seg_size = 8192;
-const int ndnfs::server::seg_size_shift = 13;
 const int ndnfs::server::default_freshness_period = 5000;
+const int ndnfs::server::streaming_freshness_period = 500;
 
 sqlite3 *ndnfs::server::db;
 ndn::ptr_lib::shared_ptr<ndn::KeyChain> ndnfs::server::keyChain;
@@ -149,6 +149,8 @@ int main(int argc, char **argv) {
   
   if (sqlite3_open(ndnfs::server::db_name.c_str(), &ndnfs::server::db) == SQLITE_OK) {
     FILE_LOG(LOG_DEBUG) << "main: sqlite database open ok" << endl;
+    // Signatures of lazily signed versions are stored while ndnfs writes as well
+    sqlite3_busy_timeout(ndnfs::server::db, 5000);
   } else {
     FILE_LOG(LOG_DEBUG) << "main: cannot connect to sqlite db: " << ndnfs::server::db_name << ", quit" << endl;
     sqlite3_close(ndnfs::server::db);
@@ -22,6 +22,9 @@
 // logger and file-type headers are shared by server and fs;
 #include "logger.h"
 #include "file-type.h"
+#include "signature-states.h"
+#include "signature-types.h"
+#include "mtime.h"
 
 namespace ndnfs {
   namespace server {
@@ -34,9 +37,10 @@ namespace ndnfs {
     extern std::string fs_prefix;
     extern std::string logging_path;
     
+    // Segment size of versions that do not record their own, and of dir listings
     extern const int seg_size;
-    extern const int seg_size_shift;
     extern const int default_freshness_period;
+    extern const int streaming_freshness_period;
   }
 }
 
@@ -25,11 +25,16 @@
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <map>
 #include <algorithm>
 #include <fcntl.h>
 #include <dirent.h>
 
 #include "servermodule.h"
+#include "listing.h"
+#include "feed.h"
+#include "tree.h"
+#include "signer.h"
 #include <ndn-cpp/face.hpp>
 #include <ndn-cpp/interest.hpp>
 #include <ndn-cpp/security/key-chain.hpp>
@@ -44,7 +49,7 @@
 using namespace std;
 using namespace ndn;
 
-void readFileSize(string path, int& file_size, int& total_seg)
+void readFileSize(string path, int seg_size, int64_t& file_size, int64_t& total_seg)
 {
   char file_path[PATH_MAX] = "";
   abs_path(file_path, path.c_str());
@@ -52,21 +57,227 @@ void readFileSize(string path, int& file_size, int& total_seg)
   struct stat st;
   stat(file_path, &st);
   file_size = st.st_size;
-  total_seg = (file_size >> ndnfs::server::seg_size_shift) + 1;
+  total_seg = (file_size / seg_size) + 1;
   return;
 }
 
+int readSegmentSize(const string& path, int64_t version)
+{
+  int seg_size = ndnfs::server::seg_size;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT seg_size FROM file_versions WHERE path = ? AND version = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) > 0)
+    seg_size = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  return seg_size;
+}
+
+int64_t readVersionSize(const string& path, int64_t version)
+{
+  int64_t size = -1;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT size FROM file_versions WHERE path = ? AND version = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+    size = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  return size;
+}
+
+int readSignatureType(const string& path, int64_t version)
+{
+  int signature_type = SIGNATURE_RSA;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT signature_type FROM file_versions WHERE path = ? AND version = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    signature_type = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  return signature_type;
+}
+
+string readLinkTarget(const string& path, int64_t version)
+{
+  string target = "";
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT target FROM file_versions WHERE path = ? AND version = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+    target = (const char *)sqlite3_column_text(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  return target;
+}
+
+bool isStreaming(const string& path, int64_t version)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT ready_signed FROM file_system WHERE path = ? AND current_version = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  bool streaming = (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) == STREAMING);
+  sqlite3_finalize(stmt);
+  return streaming;
+}
+
+bool isHoleSegment(const string& path, int64_t version, int64_t seg)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT 1 FROM file_holes WHERE path = ? AND version = ? AND start_segment <= ? AND end_segment > ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  sqlite3_bind_int64(stmt, 3, seg);
+  sqlite3_bind_int64(stmt, 4, seg);
+  bool hole = (sqlite3_step(stmt) == SQLITE_ROW);
+  sqlite3_finalize(stmt);
+  return hole;
+}
+
+bool isLazyVersion(const string& path, int64_t version)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT v.lazy OR EXISTS (SELECT 1 FROM renamed_versions r WHERE r.path = v.path AND r.version = v.version), \
+                                         v.size, v.mtime FROM file_versions v JOIN file_system f ON f.path = v.path \
+                                         WHERE v.path = ? AND v.version = ? AND f.current_version = v.version", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  bool lazy = (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) != 0);
+  int64_t size = lazy ? sqlite3_column_int64(stmt, 1) : -1;
+  int64_t mtime = lazy ? sqlite3_column_int64(stmt, 2) : -1;
+  sqlite3_finalize(stmt);
+  if (!lazy)
+    return false;
+
+  char file_path[PATH_MAX] = "";
+  abs_path(file_path, path.c_str());
+  struct stat st;
+  if (stat(file_path, &st) == -1 || st.st_size != size || mtime_ns(st) != mtime) {
+    FILE_LOG(LOG_DEBUG) << "isLazyVersion: " << path << " changed since version " << version << " was published" << endl;
+    return false;
+  }
+  return true;
+}
+
+string renamedContentPath(const string& path, int64_t version)
+{
+  string contentPath = "";
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT path FROM renamed_versions WHERE old_path = ? AND version = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    contentPath = (const char *)sqlite3_column_text(stmt, 0);
+  sqlite3_finalize(stmt);
+  return contentPath;
+}
+
+static bool byName(const DirEntry& a, const DirEntry& b)
+{
+  return a.name < b.name;
+}
+
+/**
+ * readDirFolder lists directory path from the actual folder, as readdir used to.
+ */
+static bool readDirFolder(const string& path, vector<DirEntry>& entries)
+{
+  char dir_path[PATH_MAX] = "";
+  abs_path(dir_path, path.c_str());
+  DIR *dp = opendir(dir_path);
+  if (dp == NULL)
+    return false;
+
+  struct dirent *de;
+  while ((de = readdir(dp)) != NULL) {
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+      continue;
+    DirEntry entry;
+    entry.name = de->d_name;
+    switch (de->d_type) {
+    case DT_DIR:
+      entry.type = DIRECTORY;
+      break;
+    case DT_LNK:
+      entry.type = SYMBOLIC_LINK;
+      break;
+    case DT_FIFO:
+      entry.type = FIFO_SPECIAL;
+      break;
+    case DT_SOCK:
+      entry.type = UNIX_SOCKET;
+      break;
+    case DT_BLK:
+      entry.type = BLOCK_SPECIAL;
+      break;
+    case DT_CHR:
+      entry.type = CHARACTER_SPECIAL;
+      break;
+    default:
+      entry.type = REGULAR;
+      break;
+    }
+    entries.push_back(entry);
+  }
+  closedir(dp);
+
+  sort(entries.begin(), entries.end(), byName);
+  FILE_LOG(LOG_DEBUG) << "readDirFolder: " << path << " is not indexed, read " << entries.size() << " entries from the folder" << endl;
+  return true;
+}
+
+bool readDirEntries(const string& path, vector<DirEntry>& entries)
+{
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT type FROM file_system WHERE path = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  bool indexed = (sqlite3_step(stmt) == SQLITE_ROW);
+  bool isDir = indexed && (sqlite3_column_int(stmt, 0) == DIRECTORY);
+  sqlite3_finalize(stmt);
+  if (!indexed)
+    return readDirFolder(path, entries);
+  if (!isDir)
+    return false;
+
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT path, type FROM file_system WHERE parent = ? ORDER BY path", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    string childPath = (const char *)sqlite3_column_text(stmt, 0);
+    DirEntry entry;
+    entry.name = childPath.substr(childPath.rfind('/') + 1);
+    entry.type = static_cast<FileType>(sqlite3_column_int(stmt, 1));
+    entries.push_back(entry);
+  }
+  sqlite3_finalize(stmt);
+  return true;
+}
+
 void onRegisterFailed(const ptr_lib::shared_ptr<const Name>& prefix) 
 {
   FILE_LOG(LOG_ERROR) << "onRegisterFailed: Register failed for prefix: " << prefix->toUri() << endl;
 }
 
-int parseName(const ndn::Name& name, int &version, int &seg, string &path) 
+int parseName(const ndn::Name& name, int64_t &version, int64_t &seg, string &path, int64_t &extra) 
 {
   int ret = -1;
   version = -1;
   seg = -1;
+  extra = -1;
   int hasMeta = 0;
+  int isDir = 0;
+  int isDelta = 0;
+  int isFeed = 0;
+  int isTree = 0;
   
   // this should be changed to using toVersion, not using the the octets directly in case
   // of future changes in naming conventions...
@@ -77,10 +288,28 @@ int parseName(const ndn::Name& name, int &version, int &seg, string &path)
     const uint8_t marker = *(iter->getValue().buf());
     
     if (marker == 0xFD) {
-      // Right now, having two versions does not make sense.
       if (version == -1) {
         version = iter->toVersion();
       }
+      // A delta names the version it brings the listing to after the one it starts from,
+      // and a block of the feed the last sequence number of its build after the block number
+      else if ((isDelta || isFeed) && extra == -1 && seg == -1) {
+        extra = iter->toVersion();
+      }
+      // Otherwise, having two versions does not make sense.
+      else {
+        return -1;
+      }
+    }
+    else if (marker == 0xFE) {
+      // Only blocks of the feed and buckets of tree nodes are sequence-numbered;
+      // the block number is returned as version
+      if (isTree && version == -1 && extra == -1) {
+        extra = iter->toSequenceNumber();
+      }
+      else if (isFeed && version == -1) {
+        version = iter->toSequenceNumber();
+      }
       else {
         return -1;
       }
@@ -104,6 +333,9 @@ int parseName(const ndn::Name& name, int &version, int &seg, string &path)
         return -1;
       } else {
         hasMeta = 1;
+        isDir = (iter->toEscapedString() == NdnfsNamespace::dirComponentName_);
+        isFeed = (iter->toEscapedString() == NdnfsNamespace::feedComponentName_);
+        isTree = (iter->toEscapedString() == NdnfsNamespace::treeComponentName_);
       }
     }
     else {
@@ -114,6 +346,10 @@ int parseName(const ndn::Name& name, int &version, int &seg, string &path)
       if (version == -1 && seg == -1) {
         oss << "/" << component;
       }
+      // Listing deltas are named <path>/C1.FS.DIR/<since-version>/delta/<version>/<segment>
+      else if (isDir && !isDelta && seg == -1 && component == NdnfsNamespace::deltaComponentName_) {
+        isDelta = 1;
+      }
       // If the component comes after <version>/<segment>, it is considered invalid
       else {
         return -1;
@@ -128,8 +364,24 @@ int parseName(const ndn::Name& name, int &version, int &seg, string &path)
   if (path == "")
     path = string("/");
      
+  // the feed lives right under the root
+  if (isFeed) {
+    ret = (path == "/") ? 6 : -1;
+  }
+  // node of a directory in the digest tree, with or without <version>/<segment>
+  else if (isTree) {
+    ret = 7;
+  }
+  // delta of a directory listing
+  else if (isDelta) {
+    ret = 5;
+  }
+  // directory listing, with or without <version>/<segment>
+  else if (isDir) {
+    ret = 4;
+  }
   // has <version>/<segment> 
-  if (version != -1 && seg != -1) {
+  else if (version != -1 && seg != -1) {
     ret = 3;
   }
   // has <version>, but not meta component
@@ -143,16 +395,71 @@ int parseName(const ndn::Name& name, int &version, int &seg, string &path)
   return ret;
 }
 
+bool hasEnding(string const &fullString, string const &ending)
+{
+    if (fullString.length() >= ending.length()) {
+        return (0 == fullString.compare (fullString.length() - ending.length(), ending.length(), ending));
+    } else {
+        return false;
+    }
+}
+
+/**
+ * htmlListingPath checks if path names the HTML listing of a directory, <dir>/_list,
+ * rather than an entry of its own, and returns <dir> in dirPath if so.
+ */
+static bool htmlListingPath(const string& path, string& dirPath)
+{
+  string ending = "/" + NdnfsNamespace::contentMetaString_;
+  if (!hasEnding(path, ending))
+    return false;
+
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT 1 FROM file_system WHERE path = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  bool exists = (sqlite3_step(stmt) == SQLITE_ROW);
+  sqlite3_finalize(stmt);
+  if (exists)
+    return false;
+
+  dirPath = path.substr(0, path.size() - ending.size());
+  if (dirPath == "")
+    dirPath = "/";
+  return true;
+}
+
 void onInterestCallback(const ndn::ptr_lib::shared_ptr<const ndn::Name>& prefix, const ndn::ptr_lib::shared_ptr<const ndn::Interest>& interest, ndn::Face& face, uint64_t registeredPrefixId, const ndn::ptr_lib::shared_ptr<const ndn::InterestFilter>& filter)
 {
   string path;
-  int version;
-  int seg;
+  int64_t version;
+  int64_t seg;
+  int64_t extra;
   Name interest_name = interest->getName();
-  int ret = parseName(interest_name, version, seg, path);
+  int ret = parseName(interest_name, version, seg, path, extra);
+  string dirPath;
   
+  // The client is asking for (a segment of) the node of a directory in the digest tree.
+  if (ret == 7) {
+    ret = sendTreeNode(path, (int)extra, version, seg, face);
+  }
+  // The client is asking for (a segment of) a block of the change feed.
+  else if (ret == 6) {
+    ret = sendFeedBlock(version, extra, seg, face);
+  }
+  // The client is asking for (a segment of) the changes of a directory since a version of its listing.
+  else if (ret == 5) {
+    ret = sendDirDelta(path, version, extra, seg, face);
+  }
+  // The client is asking for (a segment of) a directory listing.
+  else if (ret == 4) {
+    ret = sendDirListing(path, LISTING_PROTOBUF, version, seg, face);
+  }
+  // The client is asking for (a segment of) the HTML listing of a directory.
+  else if ((ret == 2 || ret == 3) && htmlListingPath(path, dirPath)) {
+    ret = sendDirListing(dirPath, LISTING_HTML, version, seg, face);
+  }
   // The client is asking for a segment of a file.
-  if (ret == 3) {
+  else if (ret == 3) {
     ret = sendFileContent(interest_name, path, version, seg, face);
     if (ret == -1) {
       FILE_LOG(LOG_ERROR) << "onInterest: sendFileContent returned failure for interest name. " << interest_name.toUri() << endl;
@@ -162,9 +469,13 @@ void onInterestCallback(const ndn::ptr_lib::shared_ptr<const ndn::Name>& prefix,
   else if (ret == 2) {
     // even though client is only asking for a version of file, we still query if that file exists in file_system database,
     // and extracts mime-type and file-type from database.
+    // The old name of a renamed version is looked up where its content moved to
+    string contentPath = renamedContentPath(path, version);
+    if (contentPath.empty())
+      contentPath = path;
     sqlite3_stmt *stmt;
     sqlite3_prepare_v2(ndnfs::server::db, "SELECT mime_type, type FROM file_system WHERE path = ?", -1, &stmt, 0);
-    sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 1, contentPath.c_str(), -1, SQLITE_STATIC);
 
     if (sqlite3_step(stmt) != SQLITE_ROW) {
       FILE_LOG(LOG_DEBUG) << "onInterest: no such file found in ndnfs: " << path << endl;
@@ -191,16 +502,40 @@ void onInterestCallback(const ndn::ptr_lib::shared_ptr<const ndn::Name>& prefix,
     sqlite3_prepare_v2(ndnfs::server::db, "SELECT current_version, mime_type, type FROM file_system WHERE path = ?", -1, &stmt, 0);
     sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
     if (sqlite3_step(stmt) != SQLITE_ROW) {
-      FILE_LOG(LOG_DEBUG) << "onInterest: no such file found in ndnfs: " << path << endl;
       sqlite3_finalize(stmt);
       
-      // It may not be a file, but a folder instead, which is not stored in database
-      ret = sendDirMetaBrowserFriendly(path, face);
+      // The latest version that moved away from a renamed path is still served under it
+      sqlite3_prepare_v2(ndnfs::server::db, "SELECT r.version, f.mime_type, f.type FROM renamed_versions r \
+                                             JOIN file_system f ON f.path = r.path WHERE r.old_path = ? \
+                                             ORDER BY r.version DESC LIMIT 1", -1, &stmt, 0);
+      sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+      if (sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int64(stmt, 0);
+        string mimeType = "";
+        if (sqlite3_column_text(stmt, 1) != NULL) {
+          mimeType = string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        }
+        enum FileType fileType = static_cast<FileType>(sqlite3_column_int(stmt, 2));
+        sqlite3_finalize(stmt);
+        ret = sendFileMeta(path, mimeType, version, fileType, face);
+        return;
+      }
+      sqlite3_finalize(stmt);
+      FILE_LOG(LOG_DEBUG) << "onInterest: no such file found in ndnfs: " << path << endl;
+      
+      // The browser's "back" link names the folder with the listing component appended
+      if (htmlListingPath(path, dirPath)) {
+        ret = sendDirListing(dirPath, LISTING_HTML, -1, -1, face);
+      }
+    }
+    else if (sqlite3_column_int(stmt, 2) == DIRECTORY) {
+      sqlite3_finalize(stmt);
+      ret = sendDirListing(path, LISTING_HTML, -1, -1, face);
     }
     else {
-      version = sqlite3_column_int(stmt, 0);
+      version = sqlite3_column_int64(stmt, 0);
       string mimeType = "";
-      if (sqlite3_column_text(stmt, 3) != NULL) {
+      if (sqlite3_column_text(stmt, 1) != NULL) {
         mimeType = string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
       }
       enum FileType fileType = static_cast<FileType>(sqlite3_column_int(stmt, 2));
@@ -212,7 +547,30 @@ void onInterestCallback(const ndn::ptr_lib::shared_ptr<const ndn::Name>& prefix,
   }
 }
 
-int sendFileContent(Name interest_name, string path, int version, int seg, ndn::Face& face)
+// Signed hole segments, by name, kept for the HOLE_CACHE_SIZE segments requested last
+struct CachedHole {
+  ptr_lib::shared_ptr<Data> data;
+  int64_t lastUsed;
+};
+
+typedef map<string, CachedHole> HoleCache;
+
+static HoleCache holeCache;
+static int64_t holeUseCount = 0;
+
+static void evictHoles()
+{
+  while (holeCache.size() > HOLE_CACHE_SIZE) {
+    HoleCache::iterator oldest = holeCache.begin();
+    for (HoleCache::iterator it = holeCache.begin(); it != holeCache.end(); ++it) {
+      if (it->second.lastUsed < oldest->second.lastUsed)
+        oldest = it;
+    }
+    holeCache.erase(oldest);
+  }
+}
+
+int sendFileContent(Name interest_name, string path, int64_t version, int64_t seg, ndn::Face& face)
 {
   Data data(interest_name);
   
@@ -222,36 +580,62 @@ int sendFileContent(Name interest_name, string path, int version, int seg, ndn::
     seg = 0;
   }
   
+  // The old name of a renamed version is served from the path that now holds its content
+  string contentPath = renamedContentPath(path, version);
+  if (contentPath.empty())
+    contentPath = path;
+
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2(ndnfs::server::db, "SELECT path, version, segment, signature FROM file_segments WHERE path = ? AND version = ? AND segment = ?", -1, &stmt, 0);
   sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
-  sqlite3_bind_int(stmt, 2, version);
-  sqlite3_bind_int(stmt, 3, seg);
+  sqlite3_bind_int64(stmt, 2, version);
+  sqlite3_bind_int64(stmt, 3, seg);
+  bool hole = false;
+  bool lazy = false;
   if(sqlite3_step(stmt) != SQLITE_ROW){
-    FILE_LOG(LOG_DEBUG) << "sendFileContent: no such file/version/segment found in ndnfs: " << path << endl;
     sqlite3_finalize(stmt);
-    return -1;
-  }
-
-  const char * signatureBlob = (const char *)sqlite3_column_blob(stmt, 3);
-  int len = sqlite3_column_bytes(stmt, 3);
-  sqlite3_finalize(stmt);
+    if (isHoleSegment(contentPath, version, seg)) {
+      hole = true;
+    } else if (contentPath == path && isLazyVersion(path, version)) {
+      lazy = true;
+    } else {
+      FILE_LOG(LOG_DEBUG) << "sendFileContent: no such file/version/segment found in ndnfs: " << path << endl;
+      return -1;
+    }
+  } else {
+    const char * signatureBlob = (const char *)sqlite3_column_blob(stmt, 3);
+    int len = sqlite3_column_bytes(stmt, 3);
 
-  // For now, the signature type is assumed to be Sha256withRSA; should read
-  // signature type from database, which is not yet implemented in the database
-  Sha256WithRsaSignature signature;
-  
-  signature.setSignature(Blob((const uint8_t *)signatureBlob, len));
-  
-  data.setSignature(signature);
+    if (readSignatureType(contentPath, version) == SIGNATURE_DIGEST) {
+      DigestSha256Signature signature;
+      signature.setSignature(Blob((const uint8_t *)signatureBlob, len));
+      data.setSignature(signature);
+    } else {
+      Sha256WithRsaSignature signature;
+      signature.setSignature(Blob((const uint8_t *)signatureBlob, len));
+      data.setSignature(signature);
+    }
+    sqlite3_finalize(stmt);
+  }
 
   // When assembling the data packet, finalblockid should be put into each segment,
   // this means when reading each segment, file_version also needs to be consulted for the finalBlockId.
-  int total_seg = 0;
-  int file_size = 0;
-  readFileSize(path, file_size, total_seg);
+  int64_t total_seg = 0;
+  int64_t file_size = 0;
+  int seg_size = readSegmentSize(contentPath, version);
+  // The version is final, while the file may have outgrown or been truncated from it since
+  int64_t version_size = readVersionSize(contentPath, version);
+  if (version_size >= 0) {
+    total_seg = version_size / seg_size + 1;
+  } else {
+    readFileSize(contentPath, seg_size, file_size, total_seg);
+    version_size = file_size;
+  }
+
+  // A version that's still being streamed does not have a final block yet
+  bool streaming = isStreaming(contentPath, version);
 
-  if (total_seg > 0) {
+  if (total_seg > 0 && !streaming) {
     // in the JS plugin, finalBlockId component is parsed with toSegment
     // not sure if it's supposed to be like this in other ndn applications,
     // if so, should consider adding wrapper in library 'toSegment' (returns Component), instead of just 'appendSegment' (returns Name)
@@ -259,9 +643,42 @@ int sendFileContent(Name interest_name, string path, int version, int seg, ndn::
     data.getMetaInfo().setFinalBlockId(finalBlockId);
   }
   
+  if (hole) {
+    int64_t hole_len = min((int64_t)seg_size, version_size - (int64_t)seg * seg_size);
+    if (hole_len <= 0) {
+      FILE_LOG(LOG_DEBUG) << "sendFileContent: hole segment beyond end of file. Name: " << data.getName().toUri() << endl;
+      return -1;
+    }
+
+    string key = data.getName().toUri() + (streaming ? " streaming" : "");
+    HoleCache::iterator it = holeCache.find(key);
+    if (it == holeCache.end()) {
+      // Shared by all hole segments, grown to the largest segment size served so far
+      static vector<uint8_t> zeroSegment;
+      if ((int)zeroSegment.size() < seg_size)
+        zeroSegment.resize(seg_size, 0);
+
+      data.setContent(&zeroSegment[0], hole_len);
+      data.getMetaInfo().setFreshnessPeriod(ndnfs::server::default_freshness_period);
+
+      if (readSignatureType(contentPath, version) == SIGNATURE_DIGEST)
+        ndnfs::server::keyChain->signWithSha256(data);
+      else
+        ndnfs::server::keyChain->sign(data, ndnfs::server::certificateName);
+
+      it = holeCache.insert(make_pair(key, CachedHole())).first;
+      it->second.data.reset(new Data(data));
+    }
+    it->second.lastUsed = ++ holeUseCount;
+    face.putData(*it->second.data);
+    evictHoles();
+    FILE_LOG(LOG_DEBUG) << "sendFileContent: Hole segment returned with name: " << data.getName().toUri() << endl;
+    return hole_len;
+  }
+  
   int fd;
   char file_path[PATH_MAX] = "";
-  abs_path(file_path, path.c_str());
+  abs_path(file_path, contentPath.c_str());
   
   fd = open(file_path, O_RDONLY);
   
@@ -270,8 +687,8 @@ int sendFileContent(Name interest_name, string path, int version, int seg, ndn::
     return -1;
   }
   
-  char *output = new char[ndnfs::server::seg_size];
-  int actual_len = pread(fd, output, ndnfs::server::seg_size, seg << ndnfs::server::seg_size_shift);
+  char *output = new char[seg_size];
+  int actual_len = pread(fd, output, seg_size, (off_t)seg * seg_size);
   
   close(fd);
   
@@ -282,7 +699,34 @@ int sendFileContent(Name interest_name, string path, int version, int seg, ndn::
   
   if (actual_len > 0) {
     data.setContent((uint8_t*)output, actual_len);
-    data.getMetaInfo().setFreshnessPeriod(ndnfs::server::default_freshness_period);
+    data.getMetaInfo().setFreshnessPeriod
+      (streaming ? ndnfs::server::streaming_freshness_period : ndnfs::server::default_freshness_period);
+
+    if (lazy) {
+      // Interests are handled one at a time, so a later Interest for this segment finds the signature;
+      // if another server stored one in between, that one is kept
+      if (readSignatureType(contentPath, version) == SIGNATURE_DIGEST)
+        ndnfs::server::keyChain->signWithSha256(data);
+      else
+        ndnfs::server::keyChain->sign(data, ndnfs::server::certificateName);
+
+      // A version renamed to a longer name keeps its segment size until ndnfs publishes it again
+      if (data.wireEncode().size() > MAX_NDN_PACKET_SIZE) {
+        FILE_LOG(LOG_ERROR) << "sendFileContent: segment does not fit in a packet under its name: " << data.getName().toUri() << endl;
+        delete[] output;
+        return -1;
+      }
+
+      Blob signature = data.getSignature()->getSignature();
+      sqlite3_prepare_v2(ndnfs::server::db, "INSERT OR IGNORE INTO file_segments (path, version, segment, signature) VALUES (?,?,?,?)", -1, &stmt, 0);
+      sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int64(stmt, 2, version);
+      sqlite3_bind_int64(stmt, 3, seg);
+      sqlite3_bind_blob(stmt, 4, signature.buf(), signature.size(), SQLITE_STATIC);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+      FILE_LOG(LOG_DEBUG) << "sendFileContent: signed lazily: " << data.getName().toUri() << endl;
+    }
 
     face.putData(data);
     FILE_LOG(LOG_DEBUG) << "sendFileContent: Data returned with name: " << data.getName().toUri() << endl;
@@ -294,12 +738,17 @@ int sendFileContent(Name interest_name, string path, int version, int seg, ndn::
   return actual_len;
 }
 
-int sendFileMeta(const string& path, const string& mimeType, int version, FileType type, ndn::Face& face) 
+int sendFileMeta(const string& path, const string& mimeType, int64_t version, FileType type, ndn::Face& face) 
 {
+  // The meta of an old name describes the content under the path it moved to
+  string contentPath = renamedContentPath(path, version);
+  if (contentPath.empty())
+    contentPath = path;
+
   sqlite3_stmt *stmt;
   sqlite3_prepare_v2(ndnfs::server::db, "SELECT * FROM file_versions WHERE path = ? AND version = ? ", -1, &stmt, 0);
-  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
-  sqlite3_bind_int(stmt, 2, version);
+  sqlite3_bind_text(stmt, 1, contentPath.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, version);
   if (sqlite3_step(stmt) != SQLITE_ROW){
     sqlite3_finalize(stmt);
     return -1;
@@ -308,21 +757,34 @@ int sendFileMeta(const string& path, const string& mimeType, int version, FileTy
   
   Ndnfs::FileInfo infof;
   
-  int total_seg = 0;
-  int file_size = 0;
+  int64_t total_seg = 0;
+  int64_t file_size = 0;
   
   // only regular files will get size-read, 
   // types such as symlink would bring back a size of zero; 
   // TODO: right now, browser plugin still asks for the first segment, even if it's symlink
-  if (type == REGULAR) {
-    readFileSize(path, file_size, total_seg);
+  // Symlinks that reference a file are served with its content
+  int seg_size = readSegmentSize(contentPath, version);
+  string target = readLinkTarget(contentPath, version);
+  if (type == REGULAR || !target.empty()) {
+    readFileSize(contentPath, seg_size, file_size, total_seg);
+    // An older version, served under an old name, keeps the size it was published with
+    int64_t version_size = readVersionSize(contentPath, version);
+    if (version_size >= 0 && version_size != file_size) {
+      file_size = version_size;
+      total_seg = (file_size / seg_size) + 1;
+    }
   } else {
   
   }
   infof.set_type(type);
+  if (!target.empty()) {
+    infof.set_target(target);
+  }
   infof.set_size(file_size);
   infof.set_totalseg(total_seg);
   infof.set_version(version);
+  infof.set_segsize(seg_size);
   
   if (mimeType != "") {
     infof.set_mimetype(mimeType);
@@ -338,12 +800,16 @@ int sendFileMeta(const string& path, const string& mimeType, int version, FileTy
   Data data;
   data.setName(name);
   
-  Name::Component finalBlockId = Name::Component::fromNumberWithMarker(total_seg - 1, 0x00);
-  
-  data.getMetaInfo().setFinalBlockId(finalBlockId);
+  // Size and total segments of a version that's being streamed keep growing
+  bool streaming = isStreaming(contentPath, version);
+  if (!streaming) {
+    Name::Component finalBlockId = Name::Component::fromNumberWithMarker(total_seg - 1, 0x00);
+    data.getMetaInfo().setFinalBlockId(finalBlockId);
+  }
   data.setContent((uint8_t*)wireData, infof.ByteSize());
   
-  data.getMetaInfo().setFreshnessPeriod(ndnfs::server::default_freshness_period);
+  data.getMetaInfo().setFreshnessPeriod
+    (streaming ? ndnfs::server::streaming_freshness_period : ndnfs::server::default_freshness_period);
 
   ndnfs::server::keyChain->sign(data, ndnfs::server::certificateName);
   face.putData(data);
@@ -353,211 +819,3 @@ int sendFileMeta(const string& path, const string& mimeType, int version, FileTy
   delete[] wireData;
   return 0;
 }
-
-bool hasEnding(string const &fullString, string const &ending)
-{
-    if (fullString.length() >= ending.length()) {
-        return (0 == fullString.compare (fullString.length() - ending.length(), ending.length(), ending));
-    } else {
-        return false;
-    }
-}
-
-int sendDirMetaBrowserFriendly(string path, ndn::Face& face)
-{
-  string queryPath = path;
-  
-  // hack for "back" button, confusing when an actual contentMetaString_ is present.
-  if (hasEnding(path, NdnfsNamespace::contentMetaString_)) {
-    queryPath = path.substr(0, path.size() - NdnfsNamespace::contentMetaString_.size());
-  }
-  
-  char dir_path[PATH_MAX] = "";
-  abs_path(dir_path, queryPath.c_str());
-    
-  DIR *dp = opendir(dir_path);
-  if (dp == NULL) {
-    FILE_LOG(LOG_DEBUG) << "sendDirMeta: no such folder found: " << queryPath << endl;
-    return -1;
-  }
-  
-  int count = 0;
-  struct dirent *de;
-  
-  struct stat st;
-  lstat(dir_path, &st);
-  int mtime = st.st_mtime;
-  
-  string content = "<html><body>";
-  vector<string> dirContents;
-    
-  while ((de = readdir(dp)) != NULL) {
-    lstat(de->d_name, &st);
-    
-    enum FileType fileType = REGULAR; 
-    switch (S_IFMT & st.st_mode) 
-    {
-      case S_IFDIR: 
-        fileType = DIRECTORY;
-        break;
-      case S_IFCHR:
-        fileType = CHARACTER_SPECIAL;
-        break;
-      case S_IFREG: 
-        fileType = REGULAR;
-        break;
-      case S_IFLNK: 
-        fileType = SYMBOLIC_LINK;
-        break;
-      case S_IFSOCK: 
-        fileType = UNIX_SOCKET;
-        break;
-      case S_IFIFO: 
-        fileType = FIFO_SPECIAL;
-        break;
-      default:
-        fileType = REGULAR;
-        break;
-    }
-    
-    if (strcmp(de->d_name, ".")) {
-      if (strcmp(de->d_name, "..") == 0) {
-        if (queryPath != "/") {
-          content = "<br>" + content;
-          content = "../\">[Parent directory]</a>" + content;
-          content = "<a href=\"" + content;
-        }
-      } else {
-        dirContents.push_back(de->d_name);
-      }
-    }
-    count ++;
-  }
-  
-  std::sort(dirContents.begin(), dirContents.end());
-  
-  for(vector<string>::iterator it = dirContents.begin(); it != dirContents.end(); ++it) {
-    // Support for HTML5 <a> download attribute is assumed here.
-    // Theoretically content provider shouldn't specify how browser's going to handle the data?
-    // Processing for directories and file(mime) types.
-    content += "<a download=\"";
-    content += string(*it);
-    content += "\" href=\"./";
-    content += string(*it);
-    content += "\">" + string(*it) + "</a>";
-    content += "<br>";
-  }
-
-  content += "</body></html>";
-  closedir(dp);
-  
-  Name name(ndnfs::server::fs_prefix);
-  name.append(Name(path));
-
-  Blob ndnfsDirComponent = Name::fromEscapedString(NdnfsNamespace::dirComponentName_);
-  name.append(ndnfsDirComponent).appendVersion(mtime);
-
-  Data data(name);
-  data.getMetaInfo().setFreshnessPeriod(ndnfs::server::default_freshness_period);
-
-  data.setContent((const uint8_t *)&content[0], content.size());
-  ndnfs::server::keyChain->sign(data, ndnfs::server::certificateName);
-  face.putData(data);  
-  
-  FILE_LOG(LOG_DEBUG) << "sendDirMetaBrowserFriendly: Data returned with name: " << name.toUri() << endl;
-  
-  return 0;
-}
-
-int sendDirMeta(string path, ndn::Face& face) 
-{
-  char dir_path[PATH_MAX] = "";
-  abs_path(dir_path, path.c_str());
-    
-  DIR *dp = opendir(dir_path);
-  if (dp == NULL) {
-    FILE_LOG(LOG_DEBUG) << "sendDirMeta: no such folder found: " << path << endl;
-    return -1;
-  }
-  
-  int count = 0;
-  Ndnfs::DirInfoArray infoa;
-  struct dirent *de;
-  
-  struct stat st;
-  lstat(dir_path, &st);
-  int mtime = st.st_mtime;
-  
-  while ((de = readdir(dp)) != NULL) {
-    Ndnfs::DirInfo *infod = infoa.add_di();
-    
-    lstat(de->d_name, &st);
-    
-    enum FileType fileType = REGULAR; 
-    switch (S_IFMT & st.st_mode) 
-    {
-      case S_IFDIR: 
-        fileType = DIRECTORY;
-        break;
-      case S_IFCHR:
-        fileType = CHARACTER_SPECIAL;
-        break;
-      case S_IFREG: 
-        fileType = REGULAR;
-        break;
-      case S_IFLNK: 
-        fileType = SYMBOLIC_LINK;
-        break;
-      case S_IFSOCK: 
-        fileType = UNIX_SOCKET;
-        break;
-      case S_IFIFO: 
-        fileType = FIFO_SPECIAL;
-        break;
-      default:
-        fileType = REGULAR;
-        break;
-    }
-    infod->set_type(fileType);
-    infod->set_path(de->d_name);
-    count ++;
-  }
-  closedir(dp);
-  
-  Name name(ndnfs::server::fs_prefix);
-  name.append(Name(path));
-
-  Blob ndnfsDirComponent = Name::fromEscapedString(NdnfsNamespace::dirComponentName_);
-  name.append(ndnfsDirComponent).appendVersion(mtime);
-
-  Data data(name);
-  char *wireData;
-  int dataSize = 0;
-  
-  if (count > 0) {
-    dataSize = infoa.ByteSize();
-    if (dataSize > ndnfs::server::seg_size) {
-      FILE_LOG(LOG_ERROR) << "sendDirMeta: Dir attr is larger than a segment; support for this is not yet implemented." << endl;
-      return -1;
-    }
-    wireData = new char[dataSize];
-    infoa.SerializeToArray(wireData, dataSize);
-  }
-  else {
-    // Don't expect this to happen, there should always be . and ..
-    dataSize = strlen("Empty folder.\n") + 1;
-    wireData = new char[dataSize];
-    strcpy(wireData, "Empty folder.\n");
-  }
-  
-  data.setContent((uint8_t*)wireData, dataSize);
-  data.getMetaInfo().setFreshnessPeriod(ndnfs::server::default_freshness_period);
-  
-  ndnfs::server::keyChain->sign(data, ndnfs::server::certificateName);
-  face.putData(data);  
-  
-  FILE_LOG(LOG_DEBUG) << "sendDirMeta: Data returned with name: " << name.toUri() << ". Data size: " << dataSize << endl;
-  
-  delete wireData;
-  return 0;
-}
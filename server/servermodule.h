@@ -54,12 +54,20 @@ void onRegisterFailed(const ndn::ptr_lib::shared_ptr<const ndn::Name>& prefix);
  * Parse returns an integer, signifying the type of request.
  *
  * Proposed patterns:
- * <root>/<path>/[C1.FS.FILE | C1.FS.DIR]/[version]: 1, check if <path> exists either as a file, or a directory;
+ * <root>/<path>/[C1.FS.FILE]/[version]: 1, check if <path> exists either as a file, or a directory;
  *   return name: <root>/<path>/C1.FS.FILE/<version>, content: file.proto encoded; if file
- *   return name: <root>/<path>/C1.FS.DIR/<version>, content: dir.proto encoded; if folder
+ *   return name: <root>/<path>/_list/<version>/<segment>, content: HTML listing; if folder
  * <root>/<path>/<version>: 2, check if <path>/<version> exists in db, should it work only with file, or file/folder both?
  * <root>/<path>/<version>/<segment>: 3, check if <path>/<version>/<segment> exists as a segment of a file
  *   return name: same, content: actual file content assembled with signature
+ * <root>/<path>/C1.FS.DIR/[<version>/[<segment>]]: 4, segment of the listing of directory <path>, see listing.h
+ * <root>/<path>/C1.FS.DIR/<since-version>/delta/[<version>/[<segment>]]: 5, changes of directory <path> since
+ *   <since-version>, bringing its listing to <version> (returned in extra; -1 otherwise)
+ * <root>/C1.FS.FEED/[<block>/[<last-seq>/[<segment>]]]: 6, a block of the change feed, see feed.h; the block number
+ *   is returned as version, the last sequence number of its build (a version) in extra
+ * <root>/<path>/C1.FS.TREE/[<bucket>/][<version>/[<segment>]]: 7, the node of directory <path> in the digest tree,
+ *   or of one of its buckets (a sequence number, returned in extra; -1 otherwise), see tree.h
+ * <root>/<path>/_list/<version>/[<segment>] is served as the HTML listing of directory <path>.
  * 
  * Otherwise return -1, we received a name that does not fit in any of these patterns.
  *
@@ -70,41 +78,105 @@ void onRegisterFailed(const ndn::ptr_lib::shared_ptr<const ndn::Name>& prefix);
  * may both be valid. And wrong sequence in received name should not fetch back stuff.
  */
 int 
-parseName(const ndn::Name& name, int &version, int &seg, std::string &path);
+parseName(const ndn::Name& name, int64_t &version, int64_t &seg, std::string &path, int64_t &extra);
 
 /**
  * readFileSize reads a file from path, and extracts its size and number of segments.
  * @param path String path to the file
+ * @param seg_size Segment size of the version being served
  * @param file_size Overwritten with number of bytes of the file
  * @param total_seg Overwritten with number of segments of the file
  */
 void 
-readFileSize(std::string path, int& file_size, int& total_seg);
+readFileSize(std::string path, int seg_size, int64_t& file_size, int64_t& total_seg);
 
 /**
- * sendDirMeta tries to decide if path is a directory, if so, it reads the directory, 
- * and replies with everything in it, formatted with dir.proto, through transport.
- * (Including '.' and '..')
- *  TODO: right now, directory size if assumed to be within one segment, which should not be the case.
- * @param path String path of the directory
- * @param transport The transport from which to send the dir info
+ * readSegmentSize returns the segment size the given version of path was signed with.
  */
-int 
-sendDirMeta(std::string path, ndn::Face& face);
+int
+readSegmentSize(const std::string& path, int64_t version);
 
-int 
-sendDirMetaBrowserFriendly(std::string path, ndn::Face& face);
+/**
+ * readVersionSize returns the size recorded with the given version of path, or -1 if there is none.
+ */
+int64_t
+readVersionSize(const std::string& path, int64_t version);
+
+/**
+ * readSignatureType returns the SignatureType the given version of path was signed with;
+ * versions that do not record one are RSA-signed.
+ */
+int
+readSignatureType(const std::string& path, int64_t version);
+
+/**
+ * readLinkTarget returns the path whose content the given version of path references,
+ * if path is a hard link or a symlink (file_versions.target), or an empty string otherwise.
+ */
+std::string
+readLinkTarget(const std::string& path, int64_t version);
+
+/**
+ * isStreaming checks if the given version of path is still being written in streaming mode;
+ * such versions are served without FinalBlockId, and with a short freshness period.
+ */
+bool
+isStreaming(const std::string& path, int64_t version);
+
+/**
+ * isHoleSegment checks if seg of the given version lies in a hole of the file
+ * (file_holes table); ndnfs does not sign such segments, so the server signs
+ * them on request, with content from a shared zero buffer, and keeps the signed
+ * segments for the HOLE_CACHE_SIZE hole segments requested last.
+ */
+#define HOLE_CACHE_SIZE 256
+
+bool
+isHoleSegment(const std::string& path, int64_t version, int64_t seg);
+
+/**
+ * isLazyVersion checks if the given version of path is signed lazily (file_versions.lazy),
+ * or still has to be signed under path after a rename, and the file still holds its content: the version is current, and the size and mtime
+ * of the file are the ones recorded with it. Segments of such a version are signed when
+ * they are first requested.
+ */
+bool
+isLazyVersion(const std::string& path, int64_t version);
+
+/**
+ * renamedContentPath returns the path that holds the content of the given version of path,
+ * if path is the old name of a renamed version that is not signed under its new name yet
+ * (renamed_versions table), or an empty string otherwise. Old names stay servable from the
+ * signatures made with them.
+ */
+std::string
+renamedContentPath(const std::string& path, int64_t version);
+
+struct DirEntry {
+  std::string name;
+  FileType type;
+};
+
+/**
+ * readDirEntries lists the entries of directory path from the file_system table, with one
+ * range scan of the parent index, sorted by name; it returns false if path is not a directory.
+ * Directories without an entry (made outside the mount while it was not watched, or not scanned
+ * with -o noscan) are read from the folder instead.
+ */
+bool
+readDirEntries(const std::string& path, std::vector<DirEntry>& entries);
 
 /**
  * sendFileMeta checks if entry exists in file_versions table, and returns the protobuf encoded attributes if so.
  */
 int 
-sendFileMeta(const std::string& path, const std::string& mimeType, int version, FileType fileType, ndn::Face& face);
+sendFileMeta(const std::string& path, const std::string& mimeType, int64_t version, FileType fileType, ndn::Face& face);
 
 /**
  * sendFileContent checks if entry exists in file_segments table, and returns the assembled data packet if so.
+ * Segments in holes are signed on request instead, without reading the file.
  */
 int 
-sendFileContent(ndn::Name interest_name, std::string path, int version, int seg, ndn::Face& face);
+sendFileContent(ndn::Name interest_name, std::string path, int64_t version, int64_t seg, ndn::Face& face);
 
 #endif // __SERVER_MODULE_H__
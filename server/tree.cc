@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "tree.h"
+#include "tree-buckets.h"
+
+#include <map>
+
+using namespace std;
+using namespace ndn;
+
+struct TreeNodeVersion : SegmentedContent {
+  int64_t version;
+};
+
+struct CachedTreeNode {
+  TreeNodeVersion current;
+  TreeNodeVersion previous;
+  bool hasPrevious;
+  uint64_t lastUsed;
+};
+
+// By directory and bucket, -1 for the node of the directory
+typedef map<pair<string, int>, CachedTreeNode> TreeCache;
+
+static TreeCache treeCache;
+static uint64_t treeUseCount = 0;
+
+/**
+ * readTreeVersion returns the tree_version of directory path, or -1 if it's not a directory
+ * or has no digest yet.
+ */
+static int64_t readTreeVersion(const string& path)
+{
+  int64_t version = -1;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT type, tree_version, tree_digest FROM file_system WHERE path = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) == DIRECTORY &&
+      sqlite3_column_type(stmt, 1) != SQLITE_NULL && sqlite3_column_type(stmt, 2) != SQLITE_NULL)
+    version = sqlite3_column_int64(stmt, 1);
+  sqlite3_finalize(stmt);
+  return version;
+}
+
+/**
+ * readBucketVersion returns the tree_version of bucket of directory path, 0 if the bucket is empty,
+ * or -1 if path is not a directory with a digest.
+ */
+static int64_t readBucketVersion(const string& path, int bucket)
+{
+  if (readTreeVersion(path) == -1)
+    return -1;
+
+  int64_t version = 0;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT tree_version FROM tree_buckets WHERE path = ? AND bucket = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, bucket);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    version = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return version;
+}
+
+static void addEntries(sqlite3_stmt *stmt, Ndnfs::TreeNode& treeNode)
+{
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    string childPath = (const char *)sqlite3_column_text(stmt, 0);
+    Ndnfs::TreeEntry *entry = treeNode.add_entry();
+    entry->set_name(childPath.substr(childPath.rfind('/') + 1));
+    entry->set_type(sqlite3_column_int(stmt, 1));
+    entry->set_digest(sqlite3_column_blob(stmt, 2), sqlite3_column_bytes(stmt, 2));
+  }
+  sqlite3_finalize(stmt);
+}
+
+static void buildTreeNode(const string& path, TreeNodeVersion& node)
+{
+  Ndnfs::TreeNode treeNode;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT tree_digest FROM file_system WHERE path = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    treeNode.set_digest(sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+  sqlite3_finalize(stmt);
+
+  // The size of the directory is known from its buckets, without counting its entries
+  int64_t entries = 0;
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT bucket, digest, count FROM tree_buckets WHERE path = ? ORDER BY bucket", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    Ndnfs::TreeBucket *bucket = treeNode.add_bucket();
+    bucket->set_index(sqlite3_column_int(stmt, 0));
+    bucket->set_digest(sqlite3_column_blob(stmt, 1), sqlite3_column_bytes(stmt, 1));
+    bucket->set_count(sqlite3_column_int64(stmt, 2));
+    entries += bucket->count();
+  }
+  sqlite3_finalize(stmt);
+
+  if (entries > TREE_SPLIT_ENTRIES) {
+    treeNode.set_buckets(TREE_BUCKETS);
+  }
+  else {
+    treeNode.clear_bucket();
+    // Entries that are not summed up in the directory yet have no digest, and are left out
+    sqlite3_prepare_v2(ndnfs::server::db, "SELECT path, type, tree_digest FROM file_system WHERE parent = ? AND tree_digest IS NOT NULL ORDER BY path", -1, &stmt, 0);
+    sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+    addEntries(stmt, treeNode);
+  }
+
+  string content;
+  treeNode.SerializeToString(&content);
+  setSegmentedContent(node, content);
+  FILE_LOG(LOG_DEBUG) << "buildTreeNode: " << path << ", version " << node.version << ", " << treeNode.entry_size()
+                      << " entries, " << treeNode.bucket_size() << " buckets" << endl;
+}
+
+static void buildBucketNode(const string& path, int bucket, TreeNodeVersion& node)
+{
+  Ndnfs::TreeNode treeNode;
+  sqlite3_stmt *stmt;
+  // An empty bucket has an empty digest
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT digest FROM tree_buckets WHERE path = ? AND bucket = ?", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, bucket);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    treeNode.set_digest(sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+  else
+    treeNode.set_digest("");
+  sqlite3_finalize(stmt);
+
+  sqlite3_prepare_v2(ndnfs::server::db, "SELECT path, type, tree_digest FROM file_system \
+                                         WHERE parent = ? AND tree_bucket = ? AND tree_digest IS NOT NULL ORDER BY path", -1, &stmt, 0);
+  sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, bucket);
+  addEntries(stmt, treeNode);
+
+  string content;
+  treeNode.SerializeToString(&content);
+  setSegmentedContent(node, content);
+  FILE_LOG(LOG_DEBUG) << "buildBucketNode: " << path << ", bucket " << bucket << ", version " << node.version << ", "
+                      << treeNode.entry_size() << " entries" << endl;
+}
+
+static void buildNode(const string& path, int bucket, TreeNodeVersion& node)
+{
+  if (bucket == -1)
+    buildTreeNode(path, node);
+  else
+    buildBucketNode(path, bucket, node);
+}
+
+static TreeNodeVersion *findVersion(CachedTreeNode& cached, int64_t version)
+{
+  if (version == -1 || version == cached.current.version)
+    return &cached.current;
+  if (cached.hasPrevious && version == cached.previous.version)
+    return &cached.previous;
+  return NULL;
+}
+
+static void evictTreeNodes()
+{
+  while (treeCache.size() > TREE_CACHE_SIZE) {
+    TreeCache::iterator oldest = treeCache.begin();
+    for (TreeCache::iterator it = treeCache.begin(); it != treeCache.end(); ++it) {
+      if (it->second.lastUsed < oldest->second.lastUsed)
+        oldest = it;
+    }
+    treeCache.erase(oldest);
+  }
+}
+
+int sendTreeNode(const string& path, int bucket, int64_t version, int64_t seg, Face& face)
+{
+  if (bucket < -1 || bucket >= TREE_BUCKETS) {
+    FILE_LOG(LOG_DEBUG) << "sendTreeNode: no bucket " << bucket << " in the tree" << endl;
+    return -1;
+  }
+
+  pair<string, int> key(path, bucket);
+  TreeCache::iterator it = treeCache.find(key);
+
+  // The directory is only looked up for its current version; segments of a cached version
+  // are served without touching the database
+  if (version == -1 || it == treeCache.end() || findVersion(it->second, version) == NULL) {
+    int64_t treeVersion = (bucket == -1) ? readTreeVersion(path) : readBucketVersion(path, bucket);
+    if (treeVersion == -1) {
+      FILE_LOG(LOG_DEBUG) << "sendTreeNode: no digest for folder: " << path << endl;
+      return -1;
+    }
+
+    if (it == treeCache.end()) {
+      it = treeCache.insert(make_pair(key, CachedTreeNode())).first;
+      it->second.current.version = treeVersion;
+      it->second.hasPrevious = false;
+      buildNode(path, bucket, it->second.current);
+    }
+    else if (it->second.current.version != treeVersion) {
+      it->second.previous = it->second.current;
+      it->second.hasPrevious = true;
+      it->second.current.version = treeVersion;
+      buildNode(path, bucket, it->second.current);
+    }
+  }
+  it->second.lastUsed = ++ treeUseCount;
+
+  TreeNodeVersion *node = findVersion(it->second, version);
+  if (node == NULL) {
+    FILE_LOG(LOG_DEBUG) << "sendTreeNode: version " << version << " of the node of " << path << " is not available" << endl;
+    return -1;
+  }
+
+  Name prefix(ndnfs::server::fs_prefix);
+  prefix.append(Name(path));
+  prefix.append(Name::fromEscapedString(NdnfsNamespace::treeComponentName_));
+  if (bucket != -1)
+    prefix.appendSequenceNumber(bucket);
+  prefix.appendVersion(node->version);
+  int ret = sendSegment(*node, prefix, seg, ndnfs::server::default_freshness_period, face);
+
+  // Evicting may only drop another node, since this one was used last
+  evictTreeNodes();
+  return ret;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __TREE_H__
+#define __TREE_H__
+
+#include "listing.h"
+
+/**
+ * The digest tree kept by ndnfs (see fs/tree-digest.h) is served one directory at a time:
+ *   <root>/<path>/%C1.FS.tree/<version>/<segment>: dir.proto TreeNode encoded
+ * with the digest of directory path and of each of its entries. The version is the tree_version
+ * of the directory, which changes with its digest. Two trees are compared by fetching the nodes
+ * of their roots, and going down only into the entries whose digests differ.
+ *
+ * A directory of more than TREE_SPLIT_ENTRIES entries lists the digests of its buckets instead
+ * (see fs/tree-digest.h), and each bucket is served as a node of its own:
+ *   <root>/<path>/%C1.FS.tree/<bucket>/<version>/<segment>
+ * with the bucket as a sequence number, and the tree_version of the bucket as version. A change
+ * in a large directory thus rebuilds its list of buckets and the bucket of the entry, and a
+ * comparison only fetches the buckets whose digests differ. Any directory can be asked for its
+ * buckets, which ndnfs-diff does when a directory is split on one side only.
+ *
+ * Nodes of the TREE_CACHE_SIZE directories or buckets asked for last are kept, along with their
+ * previous version so fetches in progress can finish.
+ */
+#define TREE_SPLIT_ENTRIES 1024
+#define TREE_CACHE_SIZE 64
+
+/**
+ * sendTreeNode replies with segment seg of the given version of the node of directory path,
+ * or of its bucket if bucket is not -1; version -1 asks for the current version, seg -1 for the first segment.
+ * @return 0 on success, -1 if path is not a directory with a digest, or the version or segment is not available
+ */
+int
+sendTreeNode(const std::string& path, int bucket, int64_t version, int64_t seg, ndn::Face& face);
+
+#endif // __TREE_H__
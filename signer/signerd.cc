@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * ndnfs-signer signs segments for an ndnfs mount started with '-o signer=<name>'.
+ * It attaches to the signer ring in shared memory <name>, takes segments off it,
+ * signs the content ndnfs handed over with them and stores the signatures in the ndnfs
+ * database. Any number of signers may attach to the same ring; a signer that crashes
+ * only delays the segments it had taken, which ndnfs signs itself once it finds the
+ * signer dead, or after a timeout.
+ */
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+
+#include <ndn-cpp/data.hpp>
+#include <ndn-cpp/digest-sha256-signature.hpp>
+
+#include "signerd.h"
+#include "signer.h"
+#include "signer-ring.h"
+#include "signature-types.h"
+#include "sha256.h"
+#include "name.h"
+
+using namespace std;
+using namespace ndn;
+
+sqlite3 *ndnfs::signer::db;
+
+string ndnfs::signer::shm_name = "/ndnfs-signer";
+string ndnfs::signer::logging_path = "";
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int sig)
+{
+  stopping = 1;
+}
+
+void usage() {
+  fprintf(stderr, "Usage: ./ndnfs-signer [-s shared memory name][-l logging file path]\n");
+  exit(1);
+}
+
+static string lookupPath(int64_t path_id)
+{
+  string path;
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::signer::db, "SELECT path FROM file_system WHERE rowid = ?", -1, &stmt, 0);
+  sqlite3_bind_int64(stmt, 1, path_id);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    path = (const char *)sqlite3_column_text(stmt, 0);
+  sqlite3_finalize(stmt);
+  return path;
+}
+
+/**
+ * signJobs signs up to SHA256_MAX_LANES segments, and stores their signatures in
+ * one transaction. Segments whose path is gone are not counted as signed.
+ */
+static void signJobs(signer_ring *ring, const vector<signer_job> &jobs)
+{
+  bool digest_only = (ring->signature_type == SIGNATURE_DIGEST);
+  int n = jobs.size();
+
+  map<int64_t, string> paths;
+  vector<bool> ok(n, false);
+  SignedBlob encodings[SHA256_MAX_LANES];
+  const uint8_t *portions[SHA256_MAX_LANES];
+  size_t portion_sizes[SHA256_MAX_LANES];
+  uint8_t digests[SHA256_MAX_LANES * SHA256_DIGEST_SIZE];
+  int hashed = 0;
+  int index[SHA256_MAX_LANES];
+
+  for (int i = 0; i < n; i ++) {
+    const signer_job &job = jobs[i];
+    if (paths.count(job.path_id) == 0)
+      paths[job.path_id] = lookupPath(job.path_id);
+    const string &path = paths[job.path_id];
+    if (path.empty()) {
+      FILE_LOG(LOG_ERROR) << "signJobs: no path with id " << job.path_id << endl;
+      continue;
+    }
+
+
+    Data data(build_file_name(Name(ring->prefix), path.c_str()));
+    data.getName().appendVersion(job.version);
+    data.getName().appendSegment(job.segment);
+    data.setContent(job.data, job.length);
+    if (digest_only)
+      data.setSignature(DigestSha256Signature());
+    else
+      prepare_packet(data);
+
+    encodings[hashed] = data.wireEncode();
+    portions[hashed] = encodings[hashed].signedBuf();
+    portion_sizes[hashed] = encodings[hashed].signedSize();
+    index[hashed] = i;
+    hashed ++;
+  }
+
+  sha256_multi(portions, portion_sizes, digests, hashed);
+
+  sqlite3_exec(ndnfs::signer::db, "BEGIN;", NULL, NULL, NULL);
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(ndnfs::signer::db, "INSERT OR REPLACE INTO file_segments (path,version,segment,signature) VALUES (?,?,?,?);", -1, &stmt, 0);
+  for (int h = 0; h < hashed; h ++) {
+    const signer_job &job = jobs[index[h]];
+    const uint8_t *digest = digests + h * SHA256_DIGEST_SIZE;
+    Blob signature = digest_only ? Blob(digest, SHA256_DIGEST_SIZE) : sign_digest(digest);
+    // Not counted: ndnfs signs it through its KeyChain once the signers stall
+    if (signature.size() == 0)
+      continue;
+
+    sqlite3_bind_text(stmt, 1, paths[job.path_id].c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, job.version);
+    sqlite3_bind_int64(stmt, 3, job.segment);
+    sqlite3_bind_blob(stmt, 4, signature.buf(), signature.size(), SQLITE_STATIC);
+    ok[index[h]] = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  if (sqlite3_exec(ndnfs::signer::db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+    FILE_LOG(LOG_ERROR) << "signJobs: commit error. " << sqlite3_errmsg(ndnfs::signer::db) << endl;
+    sqlite3_exec(ndnfs::signer::db, "ROLLBACK;", NULL, NULL, NULL);
+    return;
+  }
+
+  // Only once the signatures are in the database
+  for (int i = 0; i < n; i ++) {
+    if (ok[i])
+      count_signed(ring, jobs[i]);
+  }
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "s:l:")) != -1) {
+    switch (opt) {
+    case 's':
+      ndnfs::signer::shm_name.assign(optarg);
+      if (ndnfs::signer::shm_name[0] != '/')
+        ndnfs::signer::shm_name = "/" + ndnfs::signer::shm_name;
+      break;
+    case 'l':
+      ndnfs::signer::logging_path.assign(optarg);
+      break;
+    default:
+      usage();
+      break;
+    }
+  }
+
+  // Set up logging
+  Log<Output2FILE>::reportingLevel() = LOG_DEBUG;
+  FILE* log_fd = fopen(ndnfs::signer::logging_path.c_str(), "w" );
+  if (ndnfs::signer::logging_path == "" || log_fd == NULL) {
+    Output2FILE::stream() = stdout;
+  } else {
+    Output2FILE::stream() = log_fd;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  if (load_signer(DEFAULT_RSA_PRIVATE_KEY_DER, sizeof(DEFAULT_RSA_PRIVATE_KEY_DER), certificate_name(Name(DEFAULT_KEY_NAME))) != 0) {
+    FILE_LOG(LOG_ERROR) << "main: cannot load the signing key, quit" << endl;
+    return -1;
+  }
+
+  // ndnfs may not be mounted yet
+  signer_ring *ring = NULL;
+  while (!stopping && (ring = attach_signer_ring(ndnfs::signer::shm_name.c_str())) == NULL)
+    sleep(1);
+  if (ring == NULL)
+    return 0;
+
+  if (sqlite3_open(ring->db_path, &ndnfs::signer::db) != SQLITE_OK) {
+    FILE_LOG(LOG_DEBUG) << "main: cannot connect to sqlite db: " << ring->db_path << ", quit" << endl;
+    sqlite3_close(ndnfs::signer::db);
+    unmap_signer_ring(ring, ndnfs::signer::shm_name.c_str(), false);
+    return -1;
+  }
+  // ndnfs writes to the database as well
+  sqlite3_busy_timeout(ndnfs::signer::db, 5000);
+
+  FILE_LOG(LOG_DEBUG) << "main: attached to " << ndnfs::signer::shm_name << ", prefix " << ring->prefix
+                      << ", root path " << ring->root_path << ", db " << ring->db_path
+                      << ", sha256 " << sha256_impl_name() << endl;
+
+  int32_t pid = getpid();
+  int slot = register_signer(ring, pid);
+  if (slot < 0) {
+    FILE_LOG(LOG_ERROR) << "main: " << SIGNER_MAX_SIGNERS << " signers attached already, quit" << endl;
+    unmap_signer_ring(ring, ndnfs::signer::shm_name.c_str(), false);
+    sqlite3_close(ndnfs::signer::db);
+    return -1;
+  }
+
+  vector<signer_job> jobs;
+  int idle = 0;
+  int64_t total = 0;
+  while (!stopping && !ring->closed.load()) {
+    // Taken for dead after a stall (e.g. a long wait on the database); ndnfs signs
+    // what this signer had taken, so it only has to take a slot again
+    if (!signer_heartbeat(ring, slot, pid) && (slot = register_signer(ring, pid)) < 0) {
+      FILE_LOG(LOG_ERROR) << "main: lost the signer slot, quit" << endl;
+      break;
+    }
+    jobs.clear();
+    signer_job job;
+    while (jobs.size() < SHA256_MAX_LANES && ring_pop(ring, job))
+      jobs.push_back(job);
+
+    if (jobs.empty()) {
+      // Back off up to 1 ms between polls of an empty ring
+      usleep(idle < 10 ? 10 : 1000);
+      idle ++;
+      continue;
+    }
+    idle = 0;
+    signJobs(ring, jobs);
+    total += jobs.size();
+  }
+  if (slot >= 0)
+    unregister_signer(ring, slot);
+
+  FILE_LOG(LOG_DEBUG) << "main: signer exit after " << total << " segments" << endl;
+  unmap_signer_ring(ring, ndnfs::signer::shm_name.c_str(), false);
+  sqlite3_close(ndnfs::signer::db);
+  return 0;
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Load of following changes to a tree through ndnfs-server: in poll mode, every round asks
+ * for the metadata of each file of a list with MustBeFresh Interests, as consumers without
+ * the change feed have to; in feed mode, every round asks for the latest block of the feed
+ * (<root>/%C1.FS.feed), and for the blocks published since the previous round.
+ * Prints the Interests, Data packets and bytes per round, and the changes seen.
+ * Usage: ./bench-feed -p prefix [-m poll|feed] [-l file list] [-r rounds] [-i interval ms] [-w window]
+ */
+
+#include <ndn-cpp/face.hpp>
+#include <ndn-cpp/interest.hpp>
+#include <ndn-cpp/data.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <vector>
+#include <map>
+#include <unistd.h>
+#include <chrono>
+
+#include "file.pb.h"
+#include "feed.pb.h"
+#include "namespace.h"
+
+using namespace std;
+using namespace ndn;
+using namespace std::chrono;
+
+static Face face("localhost");
+static Name prefix;
+
+struct round_stats {
+  int64_t interests;
+  int64_t data;
+  int64_t timeouts;
+  int64_t bytes;
+  int64_t changes;
+};
+
+static round_stats stats;
+static int outstanding = 0;
+
+static void express(const Name &name, const OnData &onData)
+{
+  Interest interest(name);
+  interest.setMustBeFresh(true);
+  interest.setInterestLifetimeMilliseconds(2000);
+  face.expressInterest(interest, onData, [](const ptr_lib::shared_ptr<const Interest> &) {
+    stats.timeouts ++;
+    outstanding --;
+  });
+  stats.interests ++;
+  outstanding ++;
+}
+
+static void received(const ptr_lib::shared_ptr<Data> &data)
+{
+  stats.data ++;
+  stats.bytes += data->wireEncode().size();
+  outstanding --;
+}
+
+// Poll mode: the version of each file, as last seen
+static vector<string> paths;
+static map<string, int64_t> versions;
+static size_t next_path = 0;
+static int window = 64;
+
+static void poll_next();
+
+static void on_file_meta(const ptr_lib::shared_ptr<const Interest> &interest, const ptr_lib::shared_ptr<Data> &data)
+{
+  received(data);
+  Ndnfs::FileInfo infof;
+  const Blob &content = data->getContent();
+  if (infof.ParseFromArray(content.buf(), content.size())) {
+    string uri = interest->getName().toUri();
+    int64_t &version = versions[uri];
+    if (version != 0 && version != infof.version())
+      stats.changes ++;
+    version = infof.version();
+  }
+  poll_next();
+}
+
+static void poll_next()
+{
+  while (outstanding < window && next_path < paths.size()) {
+    Name name(prefix);
+    name.append(Name(paths[next_path ++]));
+    name.append(Name::fromEscapedString(NdnfsNamespace::fileComponentName_));
+    express(name, on_file_meta);
+  }
+}
+
+static void poll_round()
+{
+  next_path = 0;
+  poll_next();
+}
+
+// Feed mode: blocks still to fetch in this round, and the content of the one being fetched
+static int64_t last_seq = -1;
+static int64_t round_start_seq = -1;
+static int64_t next_block = -1;
+static int64_t latest_block = -1;
+static string block_content;
+
+static void fetch_block(int64_t block);
+
+static void on_feed_data(const ptr_lib::shared_ptr<const Interest> &interest, const ptr_lib::shared_ptr<Data> &data)
+{
+  received(data);
+  const Name &name = data->getName();
+  // <feed>/<block>/<last-seq>/<segment>
+  int64_t block = name.get(name.size() - 3).toSequenceNumber();
+  int64_t seg = name.get(name.size() - 1).toSegment();
+  if (seg == 0)
+    block_content.clear();
+  block_content.append((const char *)data->getContent().buf(), data->getContent().size());
+
+  if (data->getMetaInfo().getFinalBlockId().getValue().size() > 0 &&
+      seg < (int64_t)data->getMetaInfo().getFinalBlockId().toSegment()) {
+    express(Name(name.getPrefix(name.size() - 1)).appendSegment(seg + 1), on_feed_data);
+    return;
+  }
+
+  Ndnfs::FeedBlock feedBlock;
+  if (!feedBlock.ParseFromString(block_content)) {
+    cerr << "Protobuf decoding error: " << name.toUri() << endl;
+    return;
+  }
+  // The latest block is fetched first, the blocks before it after; the first round only learns where the feed is
+  for (int i = 0; i < feedBlock.entry_size(); i ++) {
+    if (round_start_seq != -1 && feedBlock.entry(i).seq() > round_start_seq)
+      stats.changes ++;
+    last_seq = max(last_seq, feedBlock.entry(i).seq());
+  }
+  if (feedBlock.entry_size() == 0 && last_seq == -1)
+    last_seq = 0;
+
+  latest_block = max(latest_block, block);
+  if (next_block == -1)
+    next_block = block;
+  // A complete block is not asked for again
+  if (block == next_block && feedBlock.complete())
+    next_block ++;
+  if (next_block < latest_block)
+    fetch_block(next_block);
+}
+
+static void fetch_block(int64_t block)
+{
+  Name name(prefix);
+  name.append(Name::fromEscapedString(NdnfsNamespace::feedComponentName_));
+  if (block != -1)
+    name.appendSequenceNumber(block);
+  express(name, on_feed_data);
+}
+
+static void feed_round()
+{
+  // The latest block tells how far the feed went since the previous round
+  round_start_seq = last_seq;
+  fetch_block(-1);
+}
+
+int main(int argc, char **argv)
+{
+  string mode = "feed";
+  string list;
+  int rounds = 10;
+  int interval = 1000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:m:l:r:i:w:")) != -1) {
+    switch (opt) {
+    case 'p':
+      prefix = Name(optarg);
+      break;
+    case 'm':
+      mode = optarg;
+      break;
+    case 'l':
+      list = optarg;
+      break;
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    case 'i':
+      interval = atoi(optarg);
+      break;
+    case 'w':
+      window = atoi(optarg);
+      break;
+    default:
+      cerr << "usage: ./bench-feed -p prefix [-m poll|feed] [-l file list] [-r rounds] [-i interval ms] [-w window]" << endl;
+      return 1;
+    }
+  }
+
+  if (mode == "poll") {
+    ifstream in(list.c_str());
+    string path;
+    while (getline(in, path))
+      if (!path.empty())
+        paths.push_back(path);
+    if (paths.empty()) {
+      cerr << "poll mode needs a list of files (-l)" << endl;
+      return 1;
+    }
+  }
+
+  round_stats total = {0, 0, 0, 0, 0};
+  for (int round = 0; round < rounds; round ++) {
+    stats = round_stats();
+    steady_clock::time_point start = steady_clock::now();
+
+    if (mode == "poll")
+      poll_round();
+    else
+      feed_round();
+    while (outstanding > 0) {
+      face.processEvents();
+      usleep(100);
+    }
+
+    int64_t elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    cout << mode << " round " << round << ": " << stats.interests << " Interests, " << stats.data << " Data, "
+         << stats.timeouts << " timeouts, " << stats.bytes << " bytes, " << stats.changes << " changes, " << elapsed << " ms" << endl;
+    total.interests += stats.interests;
+    total.bytes += stats.bytes;
+    total.changes += stats.changes;
+
+    if (elapsed < interval)
+      usleep((interval - elapsed) * 1000);
+  }
+
+  cout << mode << " total: " << total.interests << " Interests, " << total.bytes << " bytes, " << total.changes << " changes in " << rounds << " rounds" << endl;
+  return 0;
+}
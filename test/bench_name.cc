@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Cost of building segment names for a deep path: the old way, escaping the path
+ * into a URI and parsing it again for every segment, against building the version
+ * name once and appending the segment number to a copy. Both ways are first checked
+ * to give the same names, for the deep path and for paths with unusual components.
+ * Usage: ./bench-name [-d depth] [-n segments]
+ */
+
+#include <ndn-cpp/name.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+#include <chrono>
+
+#include "name.h"
+
+using namespace std;
+using namespace ndn;
+using namespace std::chrono;
+
+static const string prefix = "/ndn/edu/ucla/remap/ndnfs";
+
+static Name uri_segment_name(const string &path, uint64_t version, uint64_t seg)
+{
+  string full_name = prefix + path;
+  string escapedString = Name::Component((uint8_t*)&full_name[0], full_name.size()).toEscapedString();
+  while(1) {
+    size_t found = escapedString.find("%2F");
+    if (found == string::npos)
+      break;
+    escapedString.replace(found, 3, "/");
+  }
+  Name seg_name(escapedString);
+  seg_name.appendVersion(version);
+  seg_name.appendSegment(seg);
+  return seg_name;
+}
+
+int main(int argc, char **argv)
+{
+  int depth = 16;
+  int segments = 100000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:n:")) != -1) {
+    switch (opt) {
+    case 'd':
+      depth = atoi(optarg);
+      break;
+    case 'n':
+      segments = atoi(optarg);
+      break;
+    default:
+      cerr << "usage: ./bench-name [-d depth] [-n segments]" << endl;
+      return 1;
+    }
+  }
+
+  string path;
+  for (int i = 0; i < depth; i ++)
+    path += "/directory-" + to_string(i);
+  path += "/file name with spaces.txt";
+  uint64_t version = 1400000000000000ULL;
+
+  // Both have to produce the same names
+  const char *paths[] = {
+    path.c_str(), "/...", "/a/..../b", "/a/...../b", "/..a", "/a..", "/a/.b/c.", "/%2F/%", "/a//b/", "/ \t"
+  };
+  for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i ++) {
+    Name expected = uri_segment_name(paths[i], version, 7);
+    Name built = build_file_name(Name(prefix), paths[i]).appendVersion(version).appendSegment(7);
+    if (!expected.equals(built)) {
+      cerr << "Name mismatch for " << paths[i] << ": " << expected.toUri() << " vs " << built.toUri() << endl;
+      return 1;
+    }
+  }
+
+  size_t total = 0;
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  for (int seg = 0; seg < segments; seg ++) {
+    Name name = uri_segment_name(path, version, seg);
+    total += name.size();
+  }
+  high_resolution_clock::time_point middle = high_resolution_clock::now();
+
+  Name version_name = build_file_name(Name(prefix), path.c_str()).appendVersion(version);
+  for (int seg = 0; seg < segments; seg ++) {
+    Name name(version_name);
+    name.appendSegment(seg);
+    total += name.size();
+  }
+  high_resolution_clock::time_point stop = high_resolution_clock::now();
+
+  cout << "Path depth: " << depth << ", segments: " << segments << " (" << total << " components)" << endl;
+  cout << "URI escape and parse: " << duration_cast<nanoseconds>(middle - start).count() / segments << " ns/segment" << endl;
+  cout << "Version name copy: " << duration_cast<nanoseconds>(stop - middle).count() / segments << " ns/segment" << endl;
+  return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * SHA-256 throughput over segment-sized packets, on one core: the per-packet path
+ * (OpenSSL, one packet at a time, as ndn-cpp hashes when signing) against each
+ * sha256_multi implementation the CPU supports (and the automatic choice), fed
+ * SHA256_MAX_LANES packets at a time, as the signing pool does.
+ * Usage: ./bench-sha256 [-s segment size] [-n segments]
+ */
+
+#include <openssl/sha.h>
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <chrono>
+
+#include "sha256.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Name, MetaInfo and SignatureInfo TLVs around the content of an encoded segment
+#define PACKET_OVERHEAD 96
+
+static double gbps(size_t bytes, high_resolution_clock::time_point start)
+{
+  double seconds = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count() / 1e9;
+  return bytes / seconds / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+  int seg_size = 8192;
+  int segments = 16384;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+    switch (opt) {
+    case 's':
+      seg_size = atoi(optarg);
+      break;
+    case 'n':
+      segments = atoi(optarg);
+      break;
+    default:
+      cerr << "usage: ./bench-sha256 [-s segment size] [-n segments]" << endl;
+      return 1;
+    }
+  }
+  // Whole batches only
+  segments = (segments + SHA256_MAX_LANES - 1) / SHA256_MAX_LANES * SHA256_MAX_LANES;
+
+  size_t packet_size = seg_size + PACKET_OVERHEAD;
+  vector<uint8_t> buffer(packet_size * segments);
+  srand(1);
+  for (size_t i = 0; i < buffer.size(); i ++)
+    buffer[i] = rand();
+
+  vector<const uint8_t *> packets(segments);
+  vector<size_t> sizes(segments);
+  for (int i = 0; i < segments; i ++) {
+    packets[i] = &buffer[i * packet_size];
+    // The last segment of a file is usually short
+    sizes[i] = (i % 61 == 60) ? packet_size / 3 : packet_size;
+  }
+  size_t total = 0;
+  for (int i = 0; i < segments; i ++)
+    total += sizes[i];
+
+  vector<uint8_t> expected(segments * SHA256_DIGEST_SIZE);
+  vector<uint8_t> digests(segments * SHA256_DIGEST_SIZE);
+
+  cout << "Segments: " << segments << " of " << seg_size << " bytes (+" << PACKET_OVERHEAD << " bytes of packet)" << endl;
+
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  for (int i = 0; i < segments; i ++)
+    SHA256(packets[i], sizes[i], &expected[i * SHA256_DIGEST_SIZE]);
+  cout << "per-packet openssl: " << gbps(total, start) << " GB/s" << endl;
+
+  const Sha256Impl impls[] = { SHA256_AUTO, SHA256_SCALAR, SHA256_SHANI, SHA256_AVX2, SHA256_AVX512 };
+  for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k ++) {
+    if (!sha256_select(impls[k]))
+      continue;
+
+    memset(&digests[0], 0, digests.size());
+    start = high_resolution_clock::now();
+    for (int i = 0; i < segments; i += SHA256_MAX_LANES)
+      sha256_multi(&packets[i], &sizes[i], &digests[i * SHA256_DIGEST_SIZE], SHA256_MAX_LANES);
+    double rate = gbps(total, start);
+
+    if (digests != expected) {
+      cerr << sha256_impl_name() << ": digest mismatch" << endl;
+      return 1;
+    }
+    cout << "sha256_multi " << sha256_impl_name() << ": " << rate << " GB/s" << endl;
+  }
+  return 0;
+}
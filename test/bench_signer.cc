@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2014 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Per-signature cost of signing segments through the KeyChain (which resolves the
+ * certificate and parses the private key for every packet) against the signer of
+ * ndnfs (key parsed once, prepared KeyLocator, batched hashing), and of RSA alone.
+ * Both have to produce the same signatures.
+ * Usage: ./bench-signer [-s segment size] [-n segments]
+ */
+
+#include <ndn-cpp/data.hpp>
+#include <ndn-cpp/security/key-chain.hpp>
+#include <ndn-cpp/security/identity/memory-identity-storage.hpp>
+#include <ndn-cpp/security/identity/memory-private-key-storage.hpp>
+#include <ndn-cpp/security/policy/no-verify-policy-manager.hpp>
+
+#include <openssl/rsa.h>
+#include <openssl/bn.h>
+#include <openssl/x509.h>
+#include <openssl/objects.h>
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <chrono>
+
+#include "signer.h"
+#include "sha256.h"
+
+using namespace std;
+using namespace ndn;
+using namespace std::chrono;
+
+static double us_per(high_resolution_clock::time_point start, high_resolution_clock::time_point stop, int count)
+{
+  return duration_cast<nanoseconds>(stop - start).count() / 1000.0 / count;
+}
+
+int main(int argc, char **argv)
+{
+  int seg_size = 8192;
+  int segments = 2000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+    switch (opt) {
+    case 's':
+      seg_size = atoi(optarg);
+      break;
+    case 'n':
+      segments = atoi(optarg);
+      break;
+    default:
+      cerr << "usage: ./bench-signer [-s segment size] [-n segments]" << endl;
+      return 1;
+    }
+  }
+
+  // A fresh 2048-bit key, in the encodings MemoryPrivateKeyStorage takes
+  RSA *rsa = RSA_new();
+  BIGNUM *e = BN_new();
+  BN_set_word(e, RSA_F4);
+  RSA_generate_key_ex(rsa, 2048, e, NULL);
+  BN_free(e);
+  uint8_t *public_der = NULL;
+  int public_size = i2d_RSA_PUBKEY(rsa, &public_der);
+  uint8_t *private_der = NULL;
+  int private_size = i2d_RSAPrivateKey(rsa, &private_der);
+  RSA_free(rsa);
+
+  ptr_lib::shared_ptr<MemoryIdentityStorage> identityStorage(new MemoryIdentityStorage());
+  ptr_lib::shared_ptr<MemoryPrivateKeyStorage> privateKeyStorage(new MemoryPrivateKeyStorage());
+  KeyChain keyChain
+    (ptr_lib::make_shared<IdentityManager>(identityStorage, privateKeyStorage),
+     ptr_lib::shared_ptr<NoVerifyPolicyManager>(new NoVerifyPolicyManager()));
+  Name keyName("/testname/DSK-123");
+  Name certificateName = keyName.getSubName(0, keyName.size() - 1).append("KEY").append
+         (keyName.get(keyName.size() - 1)).append("ID-CERT").append("0");
+  identityStorage->addKey(keyName, KEY_TYPE_RSA, Blob(public_der, public_size));
+  privateKeyStorage->setKeyPairForKeyName(keyName, KEY_TYPE_RSA, public_der, public_size, private_der, private_size);
+
+  if (load_signer(private_der, private_size, certificateName) != 0) {
+    cerr << "Cannot load the key" << endl;
+    return 1;
+  }
+
+  vector<uint8_t> content(seg_size);
+  for (int i = 0; i < seg_size; i ++)
+    content[i] = rand();
+  Name version_name("/ndn/edu/ucla/remap/ndnfs/bench/file");
+  version_name.appendVersion(1400000000000000ULL);
+
+  vector<Blob> expected(segments);
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  for (int seg = 0; seg < segments; seg ++) {
+    Data data(version_name);
+    data.getName().appendSegment(seg);
+    data.setContent(&content[0], seg_size);
+    keyChain.sign(data, certificateName);
+    expected[seg] = data.getSignature()->getSignature();
+  }
+  high_resolution_clock::time_point middle = high_resolution_clock::now();
+
+  int mismatches = 0;
+  for (int seg = 0; seg < segments; seg += SHA256_MAX_LANES) {
+    int n = min(segments - seg, SHA256_MAX_LANES);
+    SignedBlob encodings[SHA256_MAX_LANES];
+    const uint8_t *portions[SHA256_MAX_LANES];
+    size_t portion_sizes[SHA256_MAX_LANES];
+    uint8_t digests[SHA256_MAX_LANES * SHA256_DIGEST_SIZE];
+    for (int j = 0; j < n; j ++) {
+      Data data(version_name);
+      data.getName().appendSegment(seg + j);
+      data.setContent(&content[0], seg_size);
+      prepare_packet(data);
+      encodings[j] = data.wireEncode();
+      portions[j] = encodings[j].signedBuf();
+      portion_sizes[j] = encodings[j].signedSize();
+    }
+    sha256_multi(portions, portion_sizes, digests, n);
+    for (int j = 0; j < n; j ++) {
+      Blob signature = sign_digest(digests + j * SHA256_DIGEST_SIZE);
+      if (signature.size() != expected[seg + j].size() || memcmp(signature.buf(), expected[seg + j].buf(), signature.size()) != 0)
+        mismatches ++;
+    }
+  }
+  high_resolution_clock::time_point stop = high_resolution_clock::now();
+
+  // The floor: RSA alone, on a digest computed beforehand
+  const unsigned char *der = private_der;
+  RSA *key = d2i_RSAPrivateKey(NULL, &der, private_size);
+  uint8_t digest[SHA256_DIGEST_SIZE] = { 0 };
+  vector<uint8_t> signature(RSA_size(key));
+  unsigned int signature_size;
+  high_resolution_clock::time_point rsa_start = high_resolution_clock::now();
+  for (int seg = 0; seg < segments; seg ++)
+    RSA_sign(NID_sha256, digest, sizeof(digest), &signature[0], &signature_size, key);
+  high_resolution_clock::time_point rsa_stop = high_resolution_clock::now();
+  RSA_free(key);
+
+  if (mismatches > 0) {
+    cerr << mismatches << " signatures differ from the KeyChain ones" << endl;
+    return 1;
+  }
+
+  double keychain_us = us_per(start, middle, segments);
+  double signer_us = us_per(middle, stop, segments);
+  double rsa_us = us_per(rsa_start, rsa_stop, segments);
+  cout << "Segments: " << segments << " of " << seg_size << " bytes, sha256 " << sha256_impl_name() << endl;
+  cout << "KeyChain sign: " << keychain_us << " us/signature" << endl;
+  cout << "Signer: " << signer_us << " us/signature" << endl;
+  cout << "RSA only: " << rsa_us << " us/signature" << endl;
+  cout << "Overhead removed: " << keychain_us - signer_us << " us/signature, of "
+       << keychain_us - rsa_us << " over RSA" << endl;
+  return 0;
+}
@@ -131,6 +131,8 @@ static uint8_t DEFAULT_RSA_PRIVATE_KEY_DER[] = {
 #include "file.pb.h"
 
 #include <iostream>
+#include <cstdlib>
+#include <algorithm>
 #include <boost/chrono.hpp>
 
 using namespace std;
@@ -144,9 +146,12 @@ ndn::Name file_name;
 ndn::ptr_lib::shared_ptr<ndn::KeyChain> key_chain;
 ndn::Name certificate_name;
 
-int total_size = 0;
-int total_seg = 0;
-int current_seg = 0;
+int64_t total_size = 0;
+int64_t total_seg = 0;
+int64_t current_seg = 0;
+// Segment to start fetching from; negative counts from the end, so -1 fetches only the last one
+int64_t first_seg = 0;
+int64_t fetched_size = 0;
 
 bool done = false;
 bool do_verification = true;
@@ -174,6 +179,8 @@ void onMetaData (const ptr_lib::shared_ptr<const Interest>& interest, const ptr_
             cout << "  size:  " << infof.size() << endl;
             cout << "  version:   " << infof.version() << endl;
             cout << "  total segments: " << infof.totalseg() << endl;
+            if (infof.has_segsize())
+                cout << "  segment size: " << infof.segsize() << endl;
 
             total_size = infof.size();
             total_seg = infof.totalseg();
@@ -181,7 +188,12 @@ void onMetaData (const ptr_lib::shared_ptr<const Interest>& interest, const ptr_
             file_name.appendVersion((uint64_t)infof.version());
             cout << "File prefix with version is: " << file_name.toUri() << endl;
 
-            cout << "Start to fetch file segments..." << endl;
+            if (first_seg < 0)
+                current_seg = max(total_seg + first_seg, (int64_t)0);
+            else
+                current_seg = first_seg;
+
+            cout << "Start to fetch file segments from #" << current_seg << "..." << endl;
 
             ptr_lib::shared_ptr<Interest> interestPtr(new Interest());
             interestPtr->setName(Name(file_name).appendSegment((uint64_t)current_seg));
@@ -209,7 +221,9 @@ void onVerifyFailed(const ptr_lib::shared_ptr<Data>& data)
 
 void onFileData (const ptr_lib::shared_ptr<const Interest>& interest, const ptr_lib::shared_ptr<Data>& data) {
     const Name& data_name = data->getName();
-    cout << "FinalBlockId : " << data->getMetaInfo().getFinalBlockId().toSegment() << endl;
+    // Segments of a version that's still being streamed carry no FinalBlockId
+    if (data->getMetaInfo().getFinalBlockId().getValue().size() > 0)
+        cout << "FinalBlockId : " << data->getMetaInfo().getFinalBlockId().toSegment() << endl;
     
     if (do_verification) {
         key_chain->verifyData(data, onVerified, onVerifyFailed);
@@ -218,7 +232,8 @@ void onFileData (const ptr_lib::shared_ptr<const Interest>& interest, const ptr_
         cout << "Verification skipped." << endl;
     }
     
-    current_seg = (int)(data_name.rbegin()->toSegment());
+    fetched_size += data->getContent().size();
+    current_seg = (int64_t)(data_name.rbegin()->toSegment());
     current_seg++;  // segments are zero-indexed
     if (current_seg == total_seg) {
         stdtime stop = high_resolution_clock::now();
@@ -226,7 +241,8 @@ void onFileData (const ptr_lib::shared_ptr<const Interest>& interest, const ptr_
         cout << "Last segment received." << endl;
         cout << "Total run time: " << duration_cast<milliseconds>(stop - start).count() << " ms" << endl;
         cout << "Total segment fetched: " << current_seg << endl;
-        cout << "Throughput: " << (double) total_size / (double) duration_cast<milliseconds>(stop - start).count() / 1024 * 8 << " Kb/ms" << endl;
+        cout << "Total bytes fetched: " << fetched_size << endl;
+        cout << "Throughput: " << (double) fetched_size / (double) duration_cast<milliseconds>(stop - start).count() / 1024 * 8 << " Kb/ms" << endl;
         
         done = true;
     } else {
@@ -244,7 +260,7 @@ void onTimeout (const ptr_lib::shared_ptr<const Interest>& origInterest) {
 }
 
 void usage () {
-    fprintf(stderr, "usage: ./cat_file [-n name]\n");
+    fprintf(stderr, "usage: ./cat_file [-n name] [-s first segment, negative counts from the end]\n");
     exit(1);
 }
 
@@ -276,12 +292,15 @@ int main (int argc, char **argv) {
     handler.setCommandSigningInfo(*key_chain, certificate_name);
 
     int opt;
-    while ((opt = getopt(argc, argv, "n:r:v")) != -1) {
+    while ((opt = getopt(argc, argv, "n:r:s:v")) != -1) {
         switch (opt) {
         case 'n':
             name = optarg;
             cout << "main(): set name: " << name << endl;
             break;
+        case 's':
+            first_seg = atoll(optarg);
+            break;
         case 'r':
             // Fetch file from repo (unversioned but sequenced)
             repo_mode = true;
@@ -37,9 +37,9 @@ using namespace boost::chrono;
 Face handler("localhost");
 
 ndn::Name file_name;
-int total_size = 0;
-int total_seg = 0;
-int current_seg = 0;
+int64_t total_size = 0;
+int64_t total_seg = 0;
+int64_t current_seg = 0;
 
 int interest_pipe_size = 8;
 
@@ -109,7 +109,7 @@ void onFileData (const ptr_lib::shared_ptr<const Interest>& interest, const ptr_
     //current_seg = (int)(data_name.rbegin()->toSegment());
     //cout << current_seg << endl;
     current_seg++;
-    if ((int)(data_name.rbegin()->toSegment()) + 1 == total_seg) {
+    if ((int64_t)(data_name.rbegin()->toSegment()) + 1 == total_seg) {
         stdtime stop = high_resolution_clock::now();
         //stdduration td = stop - start;
         cout << "Last segment received." << endl;
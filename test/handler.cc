@@ -37,27 +37,10 @@ void Handler::onAttrData(const ptr_lib::shared_ptr<const Interest>& interest, co
   const Name& data_name = data->getName();
   Name::Component comp = data_name.get(data_name.size() - 2);
   string marker = comp.toEscapedString();
-  if (marker == NdnfsNamespace::dirComponentName_) {
-    Ndnfs::DirInfoArray infoa;
-    if (infoa.ParseFromArray(content.buf(),content.size()) && infoa.IsInitialized()) {
-      cout << "This is a directory:" << endl;
-      int n = infoa.di_size();
-      for (int i = 0; i<n; i++) {
-        const Ndnfs::DirInfo &info = infoa.di(i);
-        cout << info.path() << endl;
-      }
-      if (fetchFile_) {
-        cout << "Cannot fetch a directory." << endl;
-      }
-    }
-    else{
-      cerr << "Protobuf decoding error. "
-           << "This may be caused by a browser friendly format use by the server. "
-           << "The original message is dumped below."
-           << endl;
-      string dir_html((char*)content.buf(), content.size());
-      cerr << dir_html << endl;
-    }
+  // Directory listings are segmented: <dir>/%C1.FS.dir/<version>/<segment>
+  if (data_name.size() >= 3 && data_name.get(data_name.size() - 3).toEscapedString() == NdnfsNamespace::dirComponentName_) {
+    onDirData(interest, data);
+    return;
   }
   else if (marker == NdnfsNamespace::fileComponentName_) {
     Ndnfs::FileInfo infof;
@@ -109,8 +92,8 @@ void Handler::onAttrData(const ptr_lib::shared_ptr<const Interest>& interest, co
     Name modifiedInterestName(interest->getName());
     
     if (data->getName().size() > interest->getName().size() + 2) {
-      // this is more likely a dir interest
-      modifiedInterestName.append(Name::fromEscapedString(NdnfsNamespace::contentMetaString_));
+      // this is more likely a dir interest, answered with the HTML listing; ask for the dir.proto one
+      modifiedInterestName.append(Name::fromEscapedString(NdnfsNamespace::dirComponentName_));
     } else {
       // this is more likely a file interest, since data.name <= interest.name + [version] + [segment]
       modifiedInterestName.append(Name::fromEscapedString(NdnfsNamespace::fileComponentName_));
@@ -130,6 +113,46 @@ void Handler::onAttrData(const ptr_lib::shared_ptr<const Interest>& interest, co
   done_ = true;
 }
 
+void Handler::onDirData(const ptr_lib::shared_ptr<const Interest>& interest, const ptr_lib::shared_ptr<Data>& data) {
+  const Name& name = data->getName();
+  const Blob& content = data->getContent();
+  dirContent_.append((const char *)content.buf(), content.size());
+
+  // Fetch the rest of the listing, up to the final block
+  int64_t segment = (int64_t)name.get(name.size() - 1).toSegment();
+  int64_t finalSegment = segment;
+  if (data->getMetaInfo().getFinalBlockId().getValue().size() > 0) {
+    finalSegment = (int64_t)data->getMetaInfo().getFinalBlockId().toSegment();
+  }
+  if (segment < finalSegment) {
+    Name newInterestName(name.getPrefix(name.size() - 1));
+    newInterestName.appendSegment((uint64_t)(segment + 1));
+    Interest newInterest(newInterestName);
+
+    face_.expressInterest
+      (newInterest, bind(&Handler::onDirData, this, _1, _2),
+       bind(&Handler::onTimeout, this, _1));
+    return;
+  }
+
+  Ndnfs::DirInfoArray infoa;
+  if (infoa.ParseFromString(dirContent_) && infoa.IsInitialized()) {
+    cout << "This is a directory:" << endl;
+    int n = infoa.di_size();
+    for (int i = 0; i<n; i++) {
+      const Ndnfs::DirInfo &info = infoa.di(i);
+      cout << info.path() << endl;
+    }
+    if (fetchFile_) {
+      cout << "Cannot fetch a directory." << endl;
+    }
+  }
+  else{
+    cerr << "Protobuf decoding error" << endl;
+  }
+  done_ = true;
+}
+
 void Handler::onFileData (const ptr_lib::shared_ptr<const Interest>& interest, const ptr_lib::shared_ptr<Data>& data) {
   Name name = data->getName();
   
@@ -154,7 +177,7 @@ void Handler::onFileData (const ptr_lib::shared_ptr<const Interest>& interest, c
     cout << "Local file writing skipped." << endl;
   }
   
-  currentSegment_ = (int)(name.rbegin()->toSegment());
+  currentSegment_ = (int64_t)(name.rbegin()->toSegment());
   currentSegment_++;  // segments are zero-indexed
   if (currentSegment_ == totalSegment_) {
     cout << "Last segment received." << endl;
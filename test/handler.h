@@ -36,6 +36,12 @@ public:
   void 
   onAttrData(const ndn::ptr_lib::shared_ptr<const ndn::Interest>&, const ndn::ptr_lib::shared_ptr<ndn::Data>&);
   
+  /**
+   * onDirData collects the segments of a directory listing, and prints it once complete.
+   */
+  void 
+  onDirData(const ndn::ptr_lib::shared_ptr<const ndn::Interest>& interest, const ndn::ptr_lib::shared_ptr<ndn::Data>& data);
+  
   void 
   onFileData (const ndn::ptr_lib::shared_ptr<const ndn::Interest>& interest, const ndn::ptr_lib::shared_ptr<ndn::Data>& data);
   
@@ -54,8 +60,9 @@ private:
   
   std::string fileName_;
   std::string nameStr_;
-  int currentSegment_;
-  int totalSegment_;
+  std::string dirContent_;
+  int64_t currentSegment_;
+  int64_t totalSegment_;
   
   ndn::Face& face_;
   ndn::KeyChain& keyChain_;
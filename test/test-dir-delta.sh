@@ -0,0 +1,102 @@
+#!/bin/bash
+
+# Compares the size of the full listing of a large directory with the size of its delta
+# after a few edits made through the mount: some files are rewritten, some removed and
+# some created. Checks that the delta applied to the first listing gives the new listing,
+# and that the delta since the version of that one is empty. Requires nfd, ndncatchunks
+# (ndn-tools) and protoc.
+# Usage: ./test-dir-delta.sh [number of entries] [number of edits]
+
+COUNT=${1:-100000}
+EDITS=${2:-10}
+ACTUAL=/tmp/ndnfs-delta-actual
+MOUNT=/tmp/ndnfs-delta
+DB=/tmp/ndnfs-delta.db
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+
+# Versions are named with the 0xFD marker, followed by the number in big-endian
+version_component() {
+    hex=`printf '%x' $1`
+    if [ $((${#hex} % 2)) = 1 ]; then
+        hex=0$hex
+    fi
+    echo "%FD`echo $hex | sed 's/../%&/g'`"
+}
+
+decode() {
+    protoc --proto_path=../server --decode=Ndnfs.$1 ../server/dir.proto 2> /dev/null
+}
+
+# "name type" of each entry of a DirInfoArray
+listing_entries() {
+    decode DirInfoArray | awk '$1 == "path:" {path = $2} $1 == "type:" {print path, $2}' | sort
+}
+
+# "name change type" of each change of a DirDelta
+delta_changes() {
+    decode DirDelta | awk '$1 == "path:" {path = $2; type = ""} $1 == "change:" {change = $2} $1 == "type:" {type = $2}
+                           $1 == "}" && path != "" {print path, change, type; path = ""}'
+}
+
+rm -rf $ACTUAL $DB
+mkdir -p $ACTUAL/big $MOUNT
+(cd $ACTUAL/big && seq 1 $COUNT | xargs touch)
+
+../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=/dev/null &
+# Wait for the scan to index the directory
+while [ "`sqlite3 $DB "SELECT COUNT(*) FROM file_system WHERE parent = '/big';" 2>/dev/null`" != "$COUNT" ];
+do
+    sleep 1
+done
+
+../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+SERVER=$!
+sleep 1
+
+ndncatchunks $PREFIX/big/%C1.FS.dir > /tmp/ndnfs-delta-listing.out
+SINCE=`date +%s%6N`
+
+for i in `seq 1 $EDITS`;
+do
+    echo "edit $i" > $MOUNT/big/$i
+    rm $MOUNT/big/$((COUNT - i))
+    echo "new $i" > $MOUNT/big/new-$i
+done
+sleep 1
+
+ndncatchunks $PREFIX/big/%C1.FS.dir/`version_component $SINCE`/delta > /tmp/ndnfs-delta.out
+echo "Full listing of $COUNT entries: `stat -c %s /tmp/ndnfs-delta-listing.out` bytes"
+echo "Delta after $EDITS rewrites, removals and creations: `stat -c %s /tmp/ndnfs-delta.out` bytes"
+
+# DIR_CHANGE_REMOVED (fs/dir-change-types.h) drops the entry, other changes add or replace it
+listing_entries < /tmp/ndnfs-delta-listing.out > /tmp/ndnfs-delta-before.txt
+delta_changes < /tmp/ndnfs-delta.out > /tmp/ndnfs-delta-changes.txt
+awk 'FILENAME == ARGV[1] {entries[$1] = $2; next}
+     $2 == 2 {delete entries[$1]; next}
+     {entries[$1] = $3}
+     END {for (name in entries) print name, entries[name]}' \
+    /tmp/ndnfs-delta-before.txt /tmp/ndnfs-delta-changes.txt | sort > /tmp/ndnfs-delta-applied.txt
+ndncatchunks $PREFIX/big/%C1.FS.dir | listing_entries > /tmp/ndnfs-delta-after.txt
+
+STATUS=0
+if diff -q /tmp/ndnfs-delta-applied.txt /tmp/ndnfs-delta-after.txt > /dev/null; then
+    echo "Delta applied to the listing gives the new listing"
+else
+    echo "FAIL: delta applied to the listing differs from the new listing"
+    diff /tmp/ndnfs-delta-applied.txt /tmp/ndnfs-delta-after.txt | head
+    STATUS=1
+fi
+
+# Asked from the version it brought the listing to, the delta has no changes left
+VERSION=`decode DirDelta < /tmp/ndnfs-delta.out | awk '$1 == "version:" && !seen {print $2; seen = 1}'`
+ndncatchunks $PREFIX/big/%C1.FS.dir/`version_component $VERSION`/delta | delta_changes > /tmp/ndnfs-delta-again.txt
+if [ -s /tmp/ndnfs-delta-again.txt ]; then
+    echo "FAIL: the delta since version $VERSION repeats `wc -l < /tmp/ndnfs-delta-again.txt` changes"
+    STATUS=1
+else
+    echo "Delta since version $VERSION is empty"
+fi
+
+kill $SERVER
+umount $MOUNT
+exit $STATUS
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Lists a large directory through ndnfs-server, which reads the listing from the
+# directory index in the database. The directory is filled in the actual folder and
+# indexed by the startup scan. The listing is segmented, so it is fetched with
+# ndncatchunks; the first fetch builds it, later ones are served from the cache.
+# Requires nfd and ndncatchunks (ndn-tools) running locally.
+# Usage: ./test-dir-listing.sh [number of entries]
+
+COUNT=${1:-100000}
+ACTUAL=/tmp/ndnfs-listing-actual
+MOUNT=/tmp/ndnfs-listing
+DB=/tmp/ndnfs-listing.db
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+
+rm -rf $ACTUAL $DB
+mkdir -p $ACTUAL/big $MOUNT
+(cd $ACTUAL/big && seq 1 $COUNT | xargs touch)
+
+../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=/dev/null &
+# Wait for the scan to index the directory
+while [ "`sqlite3 $DB "SELECT COUNT(*) FROM file_system WHERE parent = '/big';" 2>/dev/null`" != "$COUNT" ];
+do
+    sleep 1
+done
+
+../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+SERVER=$!
+sleep 1
+
+for i in 1 2 3;
+do
+    start=`date +%s.%N`
+    ndncatchunks $PREFIX/big/%C1.FS.dir > /tmp/ndnfs-listing.out
+    stop=`date +%s.%N`
+    echo "Listing of $COUNT entries: `echo "$stop - $start" | bc` s"
+done
+
+echo "Listing size: `stat -c %s /tmp/ndnfs-listing.out` bytes"
+
+kill $SERVER
+umount $MOUNT
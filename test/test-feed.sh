@@ -0,0 +1,64 @@
+#!/bin/bash
+
+# Polling load of following a tree of 10000 files while some of them change: a consumer
+# asking for the metadata of every file each round, against one following the change feed.
+# Prints the Interests and bytes per round of both, and the CPU time ndnfs-server spent.
+# Requires nfd running locally.
+# Usage: ./test-feed.sh [number of files] [changes per second] [rounds]
+
+FILES=${1:-10000}
+RATE=${2:-10}
+ROUNDS=${3:-10}
+ACTUAL=/tmp/ndnfs-feed-actual
+MOUNT=/tmp/ndnfs-feed
+DB=/tmp/ndnfs-feed.db
+LIST=/tmp/ndnfs-feed.list
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+
+rm -rf $ACTUAL $DB $LIST
+mkdir -p $ACTUAL/tree $MOUNT
+for i in `seq 1 $FILES`;
+do
+    echo "file $i" > $ACTUAL/tree/f$i
+    echo "/tree/f$i" >> $LIST
+done
+
+../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=/dev/null &
+# Wait for the scan to publish the files
+while [ "`sqlite3 $DB "SELECT COUNT(*) FROM publish_feed;" 2>/dev/null`" -lt "$FILES" ];
+do
+    sleep 1
+done
+
+../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+SERVER=$!
+sleep 1
+
+# Changes RATE files per second, through the mount
+(
+    while true;
+    do
+        for i in `seq 1 $RATE`;
+        do
+            echo "changed" >> $MOUNT/tree/f$((RANDOM % FILES + 1))
+        done
+        sleep 1
+    done
+) &
+WRITER=$!
+
+cpu_ticks() {
+    awk '{ print $14 + $15 }' /proc/$SERVER/stat
+}
+
+for mode in poll feed;
+do
+    before=`cpu_ticks`
+    ../build/bench-feed -p $PREFIX -m $mode -l $LIST -r $ROUNDS -i 1000 | tail -1
+    after=`cpu_ticks`
+    echo "$mode: ndnfs-server CPU time $(( (after - before) * 1000 / `getconf CLK_TCK` )) ms"
+done
+
+kill $WRITER
+kill $SERVER
+umount $MOUNT
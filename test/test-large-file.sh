@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# Publishes a sparse 10 GB file with a marker at its end, and serves its last
+# segment; checks that size and segment numbers beyond 2 GB survive the FUSE
+# layer, the database and FileInfo. Requires nfd running locally.
+# Usage: ./test-large-file.sh [size in bytes, 10 GB by default]
+
+ACTUAL=/tmp/ndnfs-large-actual
+MOUNT=/tmp/ndnfs-large
+DB=/tmp/ndnfs-large.db
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+SIZE=${1:-10737418240}
+
+mkdir -p $ACTUAL $MOUNT
+rm -f $DB $ACTUAL/large.img
+
+../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=/dev/null &
+sleep 1
+
+# Release of the file publishes it, so the time below includes signing every segment
+start=`date +%s.%N`
+truncate -s $SIZE $MOUNT/large.img
+printf "ndnfs!" | dd of=$MOUNT/large.img bs=1 seek=$(($SIZE - 6)) conv=notrunc 2> /dev/null
+stop=`date +%s.%N`
+echo "Publish time: `echo "$stop - $start" | bc` s" > large-file.txt
+
+../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+SERVER=$!
+sleep 1
+
+../build/cat-file -n $PREFIX/large.img -s -1 > temp.txt
+(cat temp.txt | grep "size:\|total segments\|Last segment\|Throughput") >> large-file.txt
+
+if grep -q "size:  $SIZE" temp.txt && grep -q "Last segment received" temp.txt; then
+    echo "PASS" >> large-file.txt
+else
+    echo "FAIL" >> large-file.txt
+fi
+rm temp.txt
+
+kill $SERVER
+umount $MOUNT
+cat large-file.txt
@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# Eager against lazy signing of a large file: time to publish it at release, time
+# until the first segment is served, time to fetch the whole file, and the CPU time
+# ndnfs and ndnfs-server spend. Requires nfd running locally.
+# Usage: ./test-lazy.sh [test file]
+
+FILE=${1:-boost.zip}
+NAME=`basename $FILE`
+ACTUAL=/tmp/ndnfs-lazy-actual
+MOUNT=/tmp/ndnfs-lazy
+DB=/tmp/ndnfs-lazy.db
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+
+mkdir -p $ACTUAL $MOUNT
+rm -f lazy.txt
+
+# utime + stime of a process, in clock ticks
+cpu_ticks() {
+    awk '{ print $14 + $15 }' /proc/$1/stat
+}
+
+for lazy in 0 1;
+do
+    rm -f $DB $ACTUAL/$NAME
+    ../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=/dev/null -o noscan -o lazy_sign=$lazy &
+    sleep 1
+    FS=`pgrep -n -x ndnfs`
+
+    start=`date +%s.%N`
+    cp $FILE $MOUNT/$NAME
+    stop=`date +%s.%N`
+    echo "lazy_sign=$lazy" >> lazy.txt
+    echo "Publish time: `echo "$stop - $start" | bc` s, ndnfs CPU: `cpu_ticks $FS` ticks" >> lazy.txt
+
+    ../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+    SERVER=$!
+    sleep 1
+
+    start=`date +%s.%N`
+    ../build/cat-file -n $PREFIX/$NAME -s -1 > /dev/null
+    stop=`date +%s.%N`
+    echo "Time to first segment: `echo "$stop - $start" | bc` s" >> lazy.txt
+
+    start=`date +%s.%N`
+    ../build/cat-file -n $PREFIX/$NAME > /dev/null
+    stop=`date +%s.%N`
+    echo "Whole file: `echo "$stop - $start" | bc` s, server CPU: `cpu_ticks $SERVER` ticks" >> lazy.txt
+
+    kill $SERVER
+    umount $MOUNT
+    sleep 1
+done
+
+cat lazy.txt
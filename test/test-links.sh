@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Mirrors a directory through the mount with hard links (cp -al) and with copies (cp -a),
+# and compares the time each takes to publish. A file is then fetched under its hard link,
+# under a symlink to it, under an absolute symlink through the mount point, and under a
+# symlink created before the file. Requires nfd running locally.
+# Usage: ./test-links.sh [number of files] [file size in KB]
+
+COUNT=${1:-100}
+SIZE=${2:-4096}
+ACTUAL=/tmp/ndnfs-links-actual
+MOUNT=/tmp/ndnfs-links
+DB=/tmp/ndnfs-links.db
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+
+rm -rf $ACTUAL $DB
+mkdir -p $ACTUAL $MOUNT
+rm -f links.txt
+
+../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=/dev/null -o noscan &
+sleep 1
+
+mkdir $MOUNT/origin
+for i in `seq 1 $COUNT`;
+do
+    head -c $(($SIZE * 1024)) /dev/urandom > $MOUNT/origin/$i
+done
+
+start=`date +%s.%N`
+cp -al $MOUNT/origin $MOUNT/linked
+stop=`date +%s.%N`
+echo "Hard link mirror of $COUNT files: `echo "$stop - $start" | bc` s" >> links.txt
+
+start=`date +%s.%N`
+cp -a $MOUNT/origin $MOUNT/copied
+stop=`date +%s.%N`
+echo "Copied mirror of $COUNT files: `echo "$stop - $start" | bc` s" >> links.txt
+
+ln -s origin/1 $MOUNT/symlink
+ln -s $MOUNT/origin/1 $MOUNT/absolute
+ln -s origin/later $MOUNT/early
+cp $ACTUAL/origin/1 $MOUNT/origin/later
+
+../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+SERVER=$!
+sleep 1
+
+for name in linked/1 symlink absolute early;
+do
+    if ../build/cat-file -n $PREFIX/$name | cmp -s - $ACTUAL/origin/1; then
+        echo "$name: ok" >> links.txt
+    else
+        echo "$name: failed" >> links.txt
+    fi
+done
+
+kill $SERVER
+umount $MOUNT
+
+cat links.txt
@@ -0,0 +1,77 @@
+#!/bin/bash
+
+# A publish whose version can't be recorded: a trigger makes inserts into file_versions
+# fail for one file, which is then changed through the mount. The file should keep its
+# current version, still served whole, and leave no entry in the publish journal; once
+# the trigger is dropped, the next change publishes normally. Requires nfd running locally.
+
+ACTUAL=/tmp/ndnfs-failure-actual
+MOUNT=/tmp/ndnfs-failure
+DB=/tmp/ndnfs-failure.db
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+
+rm -rf $ACTUAL $DB failure.txt
+mkdir -p $ACTUAL $MOUNT
+
+../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=/dev/null &
+sleep 1
+
+../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+SERVER=$!
+sleep 1
+
+RESULT=PASS
+
+current_version() {
+    sqlite3 $DB "SELECT current_version FROM file_system WHERE path = '/file';"
+}
+
+journal_entries() {
+    sqlite3 $DB "SELECT COUNT(*) FROM publish_journal WHERE path = '/file';"
+}
+
+echo "first" > $MOUNT/file
+sleep 1
+first=`current_version`
+size=`stat -c %s $ACTUAL/file`
+echo "Published version $first, $size bytes" >> failure.txt
+
+sqlite3 $DB "CREATE TRIGGER fail_file BEFORE INSERT ON file_versions WHEN NEW.path = '/file' \
+             BEGIN SELECT RAISE(ABORT, 'test-publish-failure'); END;"
+echo "second, which is longer" > $MOUNT/file
+sleep 1
+
+# The failed publish leaves the current version and the journal as they were
+failed=`current_version`
+echo "After the failed publish: version $failed, `journal_entries` journal entries" >> failure.txt
+if [ "$failed" != "$first" ] || [ "`journal_entries`" != "0" ]; then
+    RESULT=FAIL
+fi
+../build/cat-file -n $PREFIX/file > temp.txt
+echo "`grep "Total bytes fetched" temp.txt`, expected $size" >> failure.txt
+if ! grep -q "Total bytes fetched: $size$" temp.txt; then
+    RESULT=FAIL
+fi
+
+sqlite3 $DB "DROP TRIGGER fail_file;"
+echo "third" >> $MOUNT/file
+sleep 1
+
+third=`current_version`
+size=`stat -c %s $ACTUAL/file`
+echo "After the trigger is dropped: version $third, `journal_entries` journal entries" >> failure.txt
+if [ "$third" == "$first" ] || [ "`journal_entries`" != "0" ]; then
+    RESULT=FAIL
+fi
+../build/cat-file -n $PREFIX/file > temp.txt
+echo "`grep "Total bytes fetched" temp.txt`, expected $size" >> failure.txt
+if ! grep -q "Total bytes fetched: $size$" temp.txt; then
+    RESULT=FAIL
+fi
+rm temp.txt
+
+echo $RESULT >> failure.txt
+
+kill $SERVER
+umount $MOUNT
+cat failure.txt
@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# Signing throughput with each reader, on files that are not in the page cache.
+# The test file is copied in once; then, after dropping the page cache, each
+# one-byte append publishes a new version, reading the whole file from disk.
+# Run as root (to drop the page cache).
+# Usage: sudo ./test-readers.sh [test file] [signing threads]
+
+FILE=${1:-boost.zip}
+THREADS=${2:-1}
+NAME=`basename $FILE`
+ACTUAL=/tmp/ndnfs-readers-actual
+MOUNT=/tmp/ndnfs-readers
+DB=/tmp/ndnfs-readers.db
+LOG=/tmp/ndnfs-readers.log
+
+mkdir -p $ACTUAL $MOUNT
+rm -f readers.txt
+
+for reader in pread mmap uring;
+do
+    rm -f $DB $LOG $ACTUAL/$NAME
+    ../build/ndnfs -s -f $ACTUAL $MOUNT -o db=$DB -o log=$LOG -o reader=$reader -o sign_threads=$THREADS &
+    sleep 1
+
+    cp $FILE $MOUNT/$NAME
+
+    for i in `seq 1 5`;
+    do
+        sync
+        echo 3 > /proc/sys/vm/drop_caches
+        printf "x" >> $MOUNT/$NAME
+    done
+
+    # The first publish is the warm copy
+    echo "reader $reader" >> readers.txt
+    (cat $LOG | grep "publish_file: timing" | tail -n +2) >> readers.txt
+
+    umount $MOUNT
+    sleep 1
+done
+
+cat readers.txt
@@ -0,0 +1,63 @@
+#!/bin/bash
+
+# Renames a directory of many files through the mount, and measures how long the rename
+# takes. The first file is then fetched under its old and its new name, right after the
+# rename and once the re-signing is done. Requires nfd running locally.
+# Usage: ./test-rename.sh [number of files] [file size in KB]
+
+COUNT=${1:-10000}
+SIZE=${2:-64}
+ACTUAL=/tmp/ndnfs-rename-actual
+MOUNT=/tmp/ndnfs-rename
+DB=/tmp/ndnfs-rename.db
+LOG=/tmp/ndnfs-rename.log
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+
+rm -rf $ACTUAL $DB $LOG
+mkdir -p $ACTUAL $MOUNT
+rm -f rename.txt
+
+../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=$LOG -o noscan &
+sleep 1
+
+mkdir $MOUNT/before
+head -c $(($SIZE * 1024)) /dev/urandom > /tmp/ndnfs-rename-file
+for i in `seq 1 $COUNT`;
+do
+    cp /tmp/ndnfs-rename-file $MOUNT/before/$i
+done
+
+../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+SERVER=$!
+sleep 1
+
+start=`date +%s.%N`
+mv $MOUNT/before $MOUNT/after
+stop=`date +%s.%N`
+echo "Rename of $COUNT files: `echo "$stop - $start" | bc` s" >> rename.txt
+
+fetch() {
+    if ../build/cat-file -n $PREFIX/$1 | cmp -s - /tmp/ndnfs-rename-file; then
+        echo "$1: ok" >> rename.txt
+    else
+        echo "$1: failed" >> rename.txt
+    fi
+}
+
+fetch before/1
+fetch after/1
+
+start=`date +%s.%N`
+while [ "`sqlite3 $DB 'SELECT COUNT(*) FROM renamed_versions;'`" != "0" ];
+do
+    sleep 0.1
+done
+stop=`date +%s.%N`
+echo "Re-signed in the background: `echo "$stop - $start" | bc` s" >> rename.txt
+
+fetch after/1
+
+kill $SERVER
+umount $MOUNT
+
+cat rename.txt
@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# Startup scan throughput: files are created in the actual folder while ndnfs is not
+# mounted, then each mount publishes all of them from a fresh database.
+# Usage: ./test-scan.sh [number of files] [file size in KB] [scan threads...]
+
+FILES=${1:-10000}
+SIZE=${2:-16}
+shift 2
+THREADS=${@:-1 2 4 `nproc`}
+ACTUAL=/tmp/ndnfs-scan-actual
+MOUNT=/tmp/ndnfs-scan
+DB=/tmp/ndnfs-scan.db
+LOG=/tmp/ndnfs-scan.log
+
+rm -rf $ACTUAL
+mkdir -p $ACTUAL $MOUNT
+rm -f scan.txt
+
+# 100 files per directory
+for i in `seq 1 $FILES`;
+do
+    DIR=$ACTUAL/d$((i / 100))
+    mkdir -p $DIR
+    head -c $((SIZE * 1024)) /dev/urandom > $DIR/f$i
+done
+
+for threads in $THREADS;
+do
+    rm -f $DB $LOG
+    ../build/ndnfs -s -f $ACTUAL $MOUNT -o db=$DB -o log=$LOG -o scan_threads=$threads &
+    sleep 1
+
+    until grep -q "scan_worker: published" $LOG;
+    do
+        sleep 1
+    done
+
+    echo "scan threads $threads" >> scan.txt
+    grep "scan_worker" $LOG >> scan.txt
+
+    # A second mount finds nothing to publish
+    umount $MOUNT
+    sleep 1
+    rm -f $LOG
+    ../build/ndnfs -s -f $ACTUAL $MOUNT -o db=$DB -o log=$LOG -o scan_threads=$threads &
+    sleep 1
+
+    until grep -q "scan_worker: published" $LOG;
+    do
+        sleep 1
+    done
+    grep "scan_worker: walked" $LOG >> scan.txt
+
+    umount $MOUNT
+    sleep 1
+done
+
+cat scan.txt
@@ -0,0 +1,49 @@
+#!/bin/bash
+
+# Throughput sweep across segment sizes: for each size, mounts a fresh ndnfs with
+# "-o seg_size", copies the test file in, serves it with ndnfs-server, and fetches
+# it with cat-file. Segments have to fit in one Data packet (8800 bytes), so the sweep
+# stops at 8192, and ndnfs is checked to refuse 16384. Requires nfd running locally.
+# Usage: ./test-seg-size.sh [test file]
+
+FILE=${1:-boost.zip}
+NAME=`basename $FILE`
+ACTUAL=/tmp/ndnfs-seg-actual
+MOUNT=/tmp/ndnfs-seg
+DB=/tmp/ndnfs-seg.db
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+
+mkdir -p $ACTUAL $MOUNT
+rm -f seg-size.txt
+
+if ../build/ndnfs -s -f $ACTUAL $MOUNT -o db=$DB -o log=/dev/null -o seg_size=16384 2>/dev/null; then
+    echo "seg_size 16384: accepted, should not fit in a Data packet" >> seg-size.txt
+    umount $MOUNT
+else
+    echo "seg_size 16384: refused" >> seg-size.txt
+fi
+
+for size in 1024 2048 4096 8192;
+do
+    rm -f $DB $ACTUAL/$NAME
+    ../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=/dev/null -o seg_size=$size &
+    sleep 1
+    cp $FILE $MOUNT/$NAME
+
+    ../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+    SERVER=$!
+    sleep 1
+
+    for i in `seq 1 20`;
+    do
+        ../build/cat-file -n $PREFIX/$NAME >> temp.txt
+    done
+
+    echo "seg_size $size" >> seg-size.txt
+    (cat temp.txt | grep Throughput) >> seg-size.txt
+    rm temp.txt
+
+    kill $SERVER
+    umount $MOUNT
+    sleep 1
+done
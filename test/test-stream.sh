@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# Appends to a file in a streaming directory while it's open, and fetches it
+# after every append; checks that each fetch returns every segment written so
+# far, then that the closed file is served whole. Requires nfd running locally.
+# Usage: ./test-stream.sh [number of appends]
+
+ACTUAL=/tmp/ndnfs-stream-actual
+MOUNT=/tmp/ndnfs-stream
+DB=/tmp/ndnfs-stream.db
+PREFIX=/ndn/edu/ucla/remap/ndnfs
+SEG_SIZE=8192
+APPENDS=${1:-10}
+
+mkdir -p $ACTUAL/stream $MOUNT
+rm -f $DB $ACTUAL/stream/growing stream.txt
+
+../build/ndnfs -s -f $ACTUAL $MOUNT -o prefix=$PREFIX -o db=$DB -o log=/dev/null -o seg_size=$SEG_SIZE -o stream_dirs=/stream &
+sleep 1
+
+../build/ndnfs-server -p $PREFIX -f $MOUNT -d $DB -l /dev/null &
+SERVER=$!
+sleep 1
+
+RESULT=PASS
+
+# Keep the file open for write, so its version stays in streaming mode
+exec 3>> $MOUNT/stream/growing
+for i in `seq 1 $APPENDS`;
+do
+    head -c $SEG_SIZE /dev/urandom >&3
+    # Let the segment get signed, and the previous metadata expire
+    sleep 1
+    ../build/cat-file -n $PREFIX/stream/growing > temp.txt
+    expected=$(($i * $SEG_SIZE))
+    echo "Append $i: `grep "Total bytes fetched" temp.txt`, expected $expected" >> stream.txt
+    if ! grep -q "Total bytes fetched: $expected$" temp.txt; then
+        RESULT=FAIL
+    fi
+done
+
+# A partial segment at the end is only published at close
+head -c $(($SEG_SIZE / 2)) /dev/urandom >&3
+exec 3>&-
+sleep 1
+
+../build/cat-file -n $PREFIX/stream/growing > temp.txt
+size=`stat -c %s $ACTUAL/stream/growing`
+echo "Closed: `grep "Total bytes fetched" temp.txt`, expected $size" >> stream.txt
+if ! grep -q "Total bytes fetched: $size$" temp.txt; then
+    RESULT=FAIL
+fi
+rm temp.txt
+
+echo $RESULT >> stream.txt
+
+kill $SERVER
+umount $MOUNT
+cat stream.txt
@@ -0,0 +1,73 @@
+#!/bin/bash
+
+# Comparison of two copies of a tree through the digest tree: both copies are imported,
+# mounted and served under two prefixes, a few files of the second one are changed,
+# and ndnfs-diff has to report exactly those, fetching only the nodes on their paths.
+# A flat directory of BIG_FILES files is served in buckets; a change in it should only
+# fetch its list of buckets and the bucket of the changed file.
+# Requires nfd running locally.
+# Usage: ./test-tree-diff.sh [number of directories] [files per directory] [files in the flat directory]
+
+DIRS=${1:-100}
+FILES=${2:-100}
+BIG_FILES=${3:-100000}
+PREFIX_A=/ndn/edu/ucla/remap/ndnfs-a
+PREFIX_B=/ndn/edu/ucla/remap/ndnfs-b
+
+rm -rf /tmp/ndnfs-diff-*
+for side in a b;
+do
+    mkdir -p /tmp/ndnfs-diff-$side-actual /tmp/ndnfs-diff-$side
+done
+for d in `seq 1 $DIRS`;
+do
+    mkdir -p /tmp/ndnfs-diff-a-actual/d$d
+    for f in `seq 1 $FILES`;
+    do
+        echo "file $d/$f" > /tmp/ndnfs-diff-a-actual/d$d/f$f
+    done
+done
+mkdir -p /tmp/ndnfs-diff-a-actual/big
+for f in `seq 1 $BIG_FILES`;
+do
+    echo "big $f" > /tmp/ndnfs-diff-a-actual/big/f$f
+done
+cp -a /tmp/ndnfs-diff-a-actual/. /tmp/ndnfs-diff-b-actual
+
+# The copies get versions of their own; only the content is compared
+for side in a b;
+do
+    if [ $side = a ]; then PREFIX=$PREFIX_A; else PREFIX=$PREFIX_B; fi
+    ../build/ndnfs-import -f /tmp/ndnfs-diff-$side-actual -p $PREFIX -d /tmp/ndnfs-diff-$side.db -l /dev/null
+    # The mount computes the digests of the imported tree
+    ../build/ndnfs -s -f /tmp/ndnfs-diff-$side-actual /tmp/ndnfs-diff-$side -o prefix=$PREFIX -o db=/tmp/ndnfs-diff-$side.db -o log=/dev/null &
+    ../build/ndnfs-server -p $PREFIX -f /tmp/ndnfs-diff-$side -d /tmp/ndnfs-diff-$side.db -l /dev/null &
+    SERVERS="$SERVERS $!"
+done
+sleep 2
+
+echo "Same trees:"
+../build/ndnfs-diff -a $PREFIX_A -b $PREFIX_B
+echo "exit status $?"
+
+echo "changed" >> /tmp/ndnfs-diff-b/d1/f1
+echo "changed" >> /tmp/ndnfs-diff-b/d$DIRS/f$FILES
+echo "new" > /tmp/ndnfs-diff-b/d2/new
+rm /tmp/ndnfs-diff-b/d3/f1
+mkdir /tmp/ndnfs-diff-b/newdir
+sleep 1
+
+echo "After changing 2 files, adding 1 file and 1 directory and removing 1 file in the second tree:"
+../build/ndnfs-diff -a $PREFIX_A -b $PREFIX_B
+echo "exit status $?"
+
+echo "changed" >> /tmp/ndnfs-diff-b/big/f1
+sleep 1
+
+echo "After also changing 1 file of the flat directory of $BIG_FILES files:"
+../build/ndnfs-diff -a $PREFIX_A -b $PREFIX_B
+echo "exit status $?"
+
+kill $SERVERS
+umount /tmp/ndnfs-diff-a
+umount /tmp/ndnfs-diff-b
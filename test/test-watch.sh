@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# Changes made directly in the actual folder of a mount started with -o watch:
+# a burst of new files, then a burst of modifications, should each be published
+# as one batch.
+# Usage: ./test-watch.sh [number of files] [watch delay in ms]
+
+FILES=${1:-1000}
+DELAY=${2:-500}
+ACTUAL=/tmp/ndnfs-watch-actual
+MOUNT=/tmp/ndnfs-watch
+DB=/tmp/ndnfs-watch.db
+LOG=/tmp/ndnfs-watch.log
+
+rm -rf $ACTUAL $DB $LOG
+mkdir -p $ACTUAL $MOUNT
+
+../build/ndnfs -s -f $ACTUAL $MOUNT -o db=$DB -o log=$LOG -o noscan -o watch_delay=$DELAY &
+sleep 1
+
+mkdir -p $ACTUAL/burst
+for i in `seq 1 $FILES`;
+do
+    echo "file $i" > $ACTUAL/burst/f$i
+done
+sleep $((DELAY / 1000 + 2))
+
+for i in `seq 1 $FILES`;
+do
+    echo "changed" >> $ACTUAL/burst/f$i
+done
+sleep $((DELAY / 1000 + 2))
+
+# Expect two batches of $FILES published files
+grep "publish_changes" $LOG
+echo "entries: `sqlite3 $DB "SELECT COUNT(*) FROM file_system WHERE path LIKE '/burst/%';"`"
+
+umount $MOUNT